@@ -21,7 +21,12 @@
 #include <direct.h>
 #endif
 #include <sys/stat.h>
+#ifndef WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 #include "util/check.hh"
+#include "util/file.hh"
 #include <string>
 #include "OnDiskWrapper.h"
 
@@ -33,6 +38,7 @@ namespace OnDiskPt
 int OnDiskWrapper::VERSION_NUM = 5;
 
 OnDiskWrapper::OnDiskWrapper()
+  :m_rootSourceNode(NULL)
 {
 }
 
@@ -41,7 +47,7 @@ OnDiskWrapper::~OnDiskWrapper()
   delete m_rootSourceNode;
 }
 
-bool OnDiskWrapper::BeginLoad(const std::string &filePath)
+bool OnDiskWrapper::BeginLoad(const std::string &filePath, bool useMmap, size_t prefetchDepth)
 {
   if (!OpenForLoad(filePath))
     return false;
@@ -49,12 +55,54 @@ bool OnDiskWrapper::BeginLoad(const std::string &filePath)
   if (!m_vocab.Load(*this))
     return false;
 
+  if (useMmap) {
+    MapFile(filePath + "/Source.dat", m_memSource);
+    MapFile(filePath + "/TargetInd.dat", m_memTargetInd);
+    MapFile(filePath + "/TargetColl.dat", m_memTargetColl);
+  }
+
   UINT64 rootFilePos = GetMisc("RootNodeOffset");
   m_rootSourceNode = new PhraseNode(rootFilePos, *this);
 
+  if (useMmap && prefetchDepth > 0) {
+    Prefetch(*m_rootSourceNode, prefetchDepth);
+  }
+
   return true;
 }
 
+void OnDiskWrapper::MapFile(const std::string &path, util::scoped_memory &mem)
+{
+  util::scoped_fd file(util::OpenReadOrThrow(path.c_str()));
+  util::MapRead(util::LAZY, file.get(), 0, util::SizeOrThrow(file.get()), mem);
+#ifndef WIN32
+  // lookups jump all over the files, read-ahead would mostly be wasted
+  madvise(mem.get(), mem.size(), MADV_RANDOM);
+#endif
+}
+
+void OnDiskWrapper::Prefetch(const PhraseNode &node, size_t depth)
+{
+#ifndef WIN32
+  // madvise wants a page aligned start
+  static const size_t pageSize = sysconf(_SC_PAGESIZE);
+  size_t offset = node.m_filePos % pageSize;
+  madvise(node.m_memLoad - offset, node.m_memLoadLast - node.m_memLoad + offset, MADV_WILLNEED);
+#endif
+
+  if (--depth == 0)
+    return;
+
+  for (size_t ind = 0; ind < node.m_numChildrenLoad; ++ind) {
+    Word wordFound;
+    UINT64 childFilePos;
+    node.GetChild(wordFound, childFilePos, ind, *this);
+
+    PhraseNode child(childFilePos, *this);
+    Prefetch(child, depth);
+  }
+}
+
 bool OnDiskWrapper::OpenForLoad(const std::string &filePath)
 {
   m_fileSource.open((filePath + "/Source.dat").c_str(), ios::in | ios::binary);
@@ -23,6 +23,7 @@
 #include "Vocab.h"
 #include "PhraseNode.h"
 #include "../moses/Word.h"
+#include "util/mmap.hh"
 
 namespace OnDiskPt
 {
@@ -40,6 +41,9 @@ protected:
   int m_numSourceFactors, m_numTargetFactors, m_numScores;
   std::fstream m_fileMisc, m_fileVocab, m_fileSource, m_fileTarget, m_fileTargetInd, m_fileTargetColl;
 
+  // only used when loaded with mmap. NULL otherwise
+  util::scoped_memory m_memSource, m_memTargetInd, m_memTargetColl;
+
   size_t m_defaultNodeSize;
   PhraseNode *m_rootSourceNode;
 
@@ -48,6 +52,8 @@ protected:
   void SaveMisc();
   bool OpenForLoad(const std::string &filePath);
   bool LoadMisc();
+  void MapFile(const std::string &path, util::scoped_memory &mem);
+  void Prefetch(const PhraseNode &node, size_t depth);
 
 public:
   static int VERSION_NUM;
@@ -55,7 +61,14 @@ public:
   OnDiskWrapper();
   ~OnDiskWrapper();
 
-  bool BeginLoad(const std::string &filePath);
+  /** Open a saved rule table.
+   * \param useMmap map Source.dat, TargetInd.dat and TargetColl.dat into memory
+   *   and read nodes and target phrases in place instead of through the streams.
+   *   Reading is then stateless, so one wrapper can be shared by all threads
+   * \param prefetchDepth with useMmap, ask the kernel to read ahead the top
+   *   levels of the source trie. 0 for none
+   */
+  bool BeginLoad(const std::string &filePath, bool useMmap = false, size_t prefetchDepth = 0);
 
   bool BeginSave(const std::string &filePath
                  , int numSourceFactors, int	numTargetFactors, int numScores);
@@ -81,6 +94,19 @@ public:
     return m_fileVocab;
   }
 
+  bool IsMapped() const {
+    return m_memSource.get() != NULL;
+  }
+  const char *GetMemSource() const {
+    return static_cast<const char*>(m_memSource.get());
+  }
+  const char *GetMemTargetInd() const {
+    return static_cast<const char*>(m_memTargetInd.get());
+  }
+  const char *GetMemTargetColl() const {
+    return static_cast<const char*>(m_memTargetColl.get());
+  }
+
   size_t GetNumSourceFactors() const {
     return m_numSourceFactors;
   }
@@ -42,6 +42,7 @@ PhraseNode::PhraseNode()
   ,m_currChild(NULL)
   ,m_saved(false)
   ,m_memLoad(NULL)
+  ,m_ownMemLoad(true)
 {
 }
 
@@ -53,22 +54,32 @@ PhraseNode::PhraseNode(UINT64 filePos, OnDiskWrapper &onDiskWrapper)
 
   size_t countSize = onDiskWrapper.GetNumCounts();
 
-  std::fstream &file = onDiskWrapper.GetFileSource();
-  file.seekg(filePos);
-  CHECK(filePos == (UINT64)file.tellg());
+  size_t memAlloc;
+  if (onDiskWrapper.IsMapped()) {
+    // use the node where it lies
+    m_ownMemLoad = false;
+    m_memLoad = const_cast<char*>(onDiskWrapper.GetMemSource()) + filePos;
+    m_numChildrenLoad = ((UINT64*)m_memLoad)[0];
+    memAlloc = GetNodeSize(m_numChildrenLoad, onDiskWrapper.GetSourceWordSize(), countSize);
+  } else {
+    m_ownMemLoad = true;
+    std::fstream &file = onDiskWrapper.GetFileSource();
+    file.seekg(filePos);
+    CHECK(filePos == (UINT64)file.tellg());
 
-  file.read((char*) &m_numChildrenLoad, sizeof(UINT64));
+    file.read((char*) &m_numChildrenLoad, sizeof(UINT64));
 
-  size_t memAlloc = GetNodeSize(m_numChildrenLoad, onDiskWrapper.GetSourceWordSize(), countSize);
-  m_memLoad = (char*) malloc(memAlloc);
+    memAlloc = GetNodeSize(m_numChildrenLoad, onDiskWrapper.GetSourceWordSize(), countSize);
+    m_memLoad = (char*) malloc(memAlloc);
 
-  // go to start of node again
-  file.seekg(filePos);
-  CHECK(filePos == (UINT64)file.tellg());
+    // go to start of node again
+    file.seekg(filePos);
+    CHECK(filePos == (UINT64)file.tellg());
 
-  // read everything into memory
-  file.read(m_memLoad, memAlloc);
-  CHECK(filePos + memAlloc == (UINT64)file.tellg());
+    // read everything into memory
+    file.read(m_memLoad, memAlloc);
+    CHECK(filePos + memAlloc == (UINT64)file.tellg());
+  }
 
   // get value
   m_value = ((UINT64*)m_memLoad)[1];
@@ -84,7 +95,8 @@ PhraseNode::PhraseNode(UINT64 filePos, OnDiskWrapper &onDiskWrapper)
 
 PhraseNode::~PhraseNode()
 {
-  free(m_memLoad);
+  if (m_ownMemLoad)
+    free(m_memLoad);
   //CHECK(m_saved);
 }
 
@@ -35,6 +35,7 @@ class SourcePhrase;
 class PhraseNode
 {
   friend std::ostream& operator<<(std::ostream&, const PhraseNode&);
+  friend class OnDiskWrapper;
 protected:
   UINT64 m_filePos, m_value;
 
@@ -49,6 +50,7 @@ protected:
 
   char *m_memLoad, *m_memLoadLast;
   UINT64 m_numChildrenLoad;
+  bool m_ownMemLoad; // false if m_memLoad points into a mapped file
 
   void AddTargetPhrase(size_t pos, const SourcePhrase &sourcePhrase
                        , TargetPhrase *targetPhrase, OnDiskWrapper &onDiskWrapper
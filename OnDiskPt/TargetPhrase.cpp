@@ -19,6 +19,7 @@
  ***********************************************************************/
 
 #include <algorithm>
+#include <cstring>
 #include <iostream>
 #include "moses/Util.h"
 #include "moses/TargetPhrase.h"
@@ -367,6 +368,82 @@ UINT64 TargetPhrase::ReadScoresFromFile(std::fstream &fileTPColl)
   return bytesRead;
 }
 
+UINT64 TargetPhrase::ReadOtherInfoFromMemory(const char *mem)
+{
+  UINT64 memUsed = 0;
+  memcpy(&m_filePos, mem, sizeof(UINT64));
+  memUsed += sizeof(UINT64);
+  CHECK(m_filePos != 0);
+
+  memUsed += ReadAlignFromMemory(mem + memUsed);
+  memUsed += ReadScoresFromMemory(mem + memUsed);
+
+  return memUsed;
+}
+
+UINT64 TargetPhrase::ReadFromMemory(const char *mem)
+{
+  UINT64 bytesRead = 0;
+
+  UINT64 numWords;
+  memcpy(&numWords, mem, sizeof(UINT64));
+  bytesRead += sizeof(UINT64);
+
+  for (size_t ind = 0; ind < numWords; ++ind) {
+    WordPtr word(new Word());
+    bytesRead += word->ReadFromMemory(mem + bytesRead);
+    AddWord(word);
+  }
+
+  // read source words
+  UINT64 numSourceWords;
+  memcpy(&numSourceWords, mem + bytesRead, sizeof(UINT64));
+  bytesRead += sizeof(UINT64);
+
+  PhrasePtr sp(new SourcePhrase());
+  for (size_t ind = 0; ind < numSourceWords; ++ind) {
+    WordPtr word( new Word());
+    bytesRead += word->ReadFromMemory(mem + bytesRead);
+    sp->AddWord(word);
+  }
+  SetSourcePhrase(sp);
+
+  return bytesRead;
+}
+
+UINT64 TargetPhrase::ReadAlignFromMemory(const char *mem)
+{
+  UINT64 bytesRead = 0;
+
+  UINT64 numAlign;
+  memcpy(&numAlign, mem, sizeof(UINT64));
+  bytesRead += sizeof(UINT64);
+
+  for (size_t ind = 0; ind < numAlign; ++ind) {
+    AlignPair alignPair;
+    memcpy(&alignPair.first, mem + bytesRead, sizeof(UINT64));
+    memcpy(&alignPair.second, mem + bytesRead + sizeof(UINT64), sizeof(UINT64));
+    m_align.push_back(alignPair);
+
+    bytesRead += sizeof(UINT64) * 2;
+  }
+
+  return bytesRead;
+}
+
+UINT64 TargetPhrase::ReadScoresFromMemory(const char *mem)
+{
+  CHECK(m_scores.size() > 0);
+
+  UINT64 bytesRead = sizeof(float) * m_scores.size();
+  memcpy(&m_scores[0], mem, bytesRead);
+
+  std::transform(m_scores.begin(),m_scores.end(),m_scores.begin(), Moses::TransformScore);
+  std::transform(m_scores.begin(),m_scores.end(),m_scores.begin(), Moses::FloorScore);
+
+  return bytesRead;
+}
+
 void TargetPhrase::DebugPrint(ostream &out, const Vocab &vocab) const
 {
   Phrase::DebugPrint(out, vocab);
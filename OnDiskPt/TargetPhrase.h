@@ -59,6 +59,8 @@ protected:
 
   UINT64 ReadAlignFromFile(std::fstream &fileTPColl);
   UINT64 ReadScoresFromFile(std::fstream &fileTPColl);
+  UINT64 ReadAlignFromMemory(const char *mem);
+  UINT64 ReadScoresFromMemory(const char *mem);
 
 public:
   TargetPhrase() {
@@ -106,6 +108,9 @@ public:
                                       , const std::vector<float> &weightT) const;
   UINT64 ReadOtherInfoFromFile(UINT64 filePos, std::fstream &fileTPColl);
   UINT64 ReadFromFile(std::fstream &fileTP);
+  // same as above, from a mapped rule table
+  UINT64 ReadOtherInfoFromMemory(const char *mem);
+  UINT64 ReadFromMemory(const char *mem);
 
   virtual void DebugPrint(std::ostream &out, const Vocab &vocab) const;
 
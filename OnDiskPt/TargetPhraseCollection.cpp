@@ -19,6 +19,7 @@
  ***********************************************************************/
 
 #include <algorithm>
+#include <cstring>
 #include <iostream>
 #include "moses/Util.h"
 #include "moses/TargetPhraseCollection.h"
@@ -157,8 +158,12 @@ void TargetPhraseCollection::ReadFromFile(size_t tableLimit, UINT64 filePos, OnD
   UINT64 numPhrases;
 
   UINT64 currFilePos = filePos;
-  fileTPColl.seekg(filePos);
-  fileTPColl.read((char*) &numPhrases, sizeof(UINT64));
+  if (onDiskWrapper.IsMapped()) {
+    memcpy(&numPhrases, onDiskWrapper.GetMemTargetColl() + filePos, sizeof(UINT64));
+  } else {
+    fileTPColl.seekg(filePos);
+    fileTPColl.read((char*) &numPhrases, sizeof(UINT64));
+  }
 
   // table limit
   if (tableLimit) {
@@ -167,6 +172,11 @@ void TargetPhraseCollection::ReadFromFile(size_t tableLimit, UINT64 filePos, OnD
 
   currFilePos += sizeof(UINT64);
 
+  if (onDiskWrapper.IsMapped()) {
+    ReadFromMemory(numPhrases, currFilePos, onDiskWrapper);
+    return;
+  }
+
   for (size_t ind = 0; ind < numPhrases; ++ind) {
     TargetPhrase *tp = new TargetPhrase(numScores);
 
@@ -179,6 +189,24 @@ void TargetPhraseCollection::ReadFromFile(size_t tableLimit, UINT64 filePos, OnD
   }
 }
 
+void TargetPhraseCollection::ReadFromMemory(size_t numPhrases, UINT64 filePos, const OnDiskWrapper &onDiskWrapper)
+{
+  const char *memTPColl = onDiskWrapper.GetMemTargetColl() + filePos;
+  const char *memTP = onDiskWrapper.GetMemTargetInd();
+
+  size_t numScores = onDiskWrapper.GetNumScores();
+  m_coll.reserve(numPhrases);
+
+  for (size_t ind = 0; ind < numPhrases; ++ind) {
+    TargetPhrase *tp = new TargetPhrase(numScores);
+
+    memTPColl += tp->ReadOtherInfoFromMemory(memTPColl);
+    tp->ReadFromMemory(memTP + tp->GetFilePos());
+
+    m_coll.push_back(tp);
+  }
+}
+
 UINT64 TargetPhraseCollection::GetFilePos() const
 {
   return m_filePos;
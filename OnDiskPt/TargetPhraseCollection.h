@@ -49,6 +49,8 @@ protected:
   UINT64 m_filePos;
   std::string m_debugStr;
 
+  void ReadFromMemory(size_t numPhrases, UINT64 filePos, const OnDiskWrapper &onDiskWrapper);
+
 public:
   static size_t s_sortScoreInd;
 
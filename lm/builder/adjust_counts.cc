@@ -21,37 +21,13 @@ const WordIndex* FindDifference(const NGram &full, const NGram &lower_last) {
 
 class StatCollector {
   public:
-    StatCollector(std::size_t order, std::vector<uint64_t> &counts, std::vector<Discount> &discounts) 
-      : orders_(order), full_(orders_.back()), counts_(counts), discounts_(discounts) {
+    explicit StatCollector(std::size_t order) 
+      : orders_(order), full_(orders_.back()) {
       memset(&orders_[0], 0, sizeof(OrderStat) * order);
     }
 
     ~StatCollector() {}
 
-    void CalculateDiscounts() {
-      counts_.resize(orders_.size());
-      discounts_.resize(orders_.size());
-      for (std::size_t i = 0; i < orders_.size(); ++i) {
-        const OrderStat &s = orders_[i];
-        counts_[i] = s.count;
-
-        for (unsigned j = 1; j < 4; ++j) {
-          // TODO: Specialize error message for j == 3, meaning 3+
-          UTIL_THROW_IF(s.n[j] == 0, BadDiscountException, "Could not calculate Kneser-Ney discounts for "
-              << (i+1) << "-grams with adjusted count " << (j+1) << " because we didn't observe any "
-              << (i+1) << "-grams with adjusted count " << j << "; Is this small or artificial data?");
-        }
-
-        // See equation (26) in Chen and Goodman.
-        discounts_[i].amount[0] = 0.0;
-        float y = static_cast<float>(s.n[1]) / static_cast<float>(s.n[1] + 2.0 * s.n[2]);
-        for (unsigned j = 1; j < 4; ++j) {
-          discounts_[i].amount[j] = static_cast<float>(j) - static_cast<float>(j + 1) * y * static_cast<float>(s.n[j+1]) / static_cast<float>(s.n[j]);
-          UTIL_THROW_IF(discounts_[i].amount[j] < 0.0 || discounts_[i].amount[j] > j, BadDiscountException, "ERROR: " << (i+1) << "-gram discount out of range for adjusted count " << j << ": " << discounts_[i].amount[j]);
-        }
-      }
-    }
-
     void Add(std::size_t order_minus_1, uint64_t count) {
       OrderStat &stat = orders_[order_minus_1];
       ++stat.count;
@@ -63,18 +39,11 @@ class StatCollector {
       if (count < 5) ++full_.n[count];
     }
 
-  private:
-    struct OrderStat {
-      // n_1 in equation 26 of Chen and Goodman etc
-      uint64_t n[5];
-      uint64_t count;
-    };
+    const std::vector<OrderStat> &Stats() const { return orders_; }
 
+  private:
     std::vector<OrderStat> orders_;
     OrderStat &full_;
-
-    std::vector<uint64_t> &counts_;
-    std::vector<Discount> &discounts_;
 };
 
 // Reads all entries in order like NGramStream does.  
@@ -138,16 +107,40 @@ class CollapseStream {
 
 } // namespace
 
+void CalculateDiscounts(const std::vector<OrderStat> &stats, std::vector<uint64_t> &counts, std::vector<Discount> &discounts) {
+  counts.resize(stats.size());
+  discounts.resize(stats.size());
+  for (std::size_t i = 0; i < stats.size(); ++i) {
+    const OrderStat &s = stats[i];
+    counts[i] = s.count;
+
+    for (unsigned j = 1; j < 4; ++j) {
+      // TODO: Specialize error message for j == 3, meaning 3+
+      UTIL_THROW_IF(s.n[j] == 0, BadDiscountException, "Could not calculate Kneser-Ney discounts for "
+          << (i+1) << "-grams with adjusted count " << (j+1) << " because we didn't observe any "
+          << (i+1) << "-grams with adjusted count " << j << "; Is this small or artificial data?");
+    }
+
+    // See equation (26) in Chen and Goodman.
+    discounts[i].amount[0] = 0.0;
+    float y = static_cast<float>(s.n[1]) / static_cast<float>(s.n[1] + 2.0 * s.n[2]);
+    for (unsigned j = 1; j < 4; ++j) {
+      discounts[i].amount[j] = static_cast<float>(j) - static_cast<float>(j + 1) * y * static_cast<float>(s.n[j+1]) / static_cast<float>(s.n[j]);
+      UTIL_THROW_IF(discounts[i].amount[j] < 0.0 || discounts[i].amount[j] > j, BadDiscountException, "ERROR: " << (i+1) << "-gram discount out of range for adjusted count " << j << ": " << discounts[i].amount[j]);
+    }
+  }
+}
+
 void AdjustCounts::Run(const ChainPositions &positions) {
   UTIL_TIMER("(%w s) Adjusted counts\n");
 
   const std::size_t order = positions.size();
-  StatCollector stats(order, counts_, discounts_);
+  StatCollector stats(order);
   if (order == 1) {
     // Only unigrams.  Just collect stats.  
     for (NGramStream full(positions[0]); full; ++full) 
       stats.AddFull(full->Count());
-    stats.CalculateDiscounts();
+    Finish(stats.Stats());
     return;
   }
 
@@ -155,14 +148,26 @@ void AdjustCounts::Run(const ChainPositions &positions) {
   streams.Init(positions, positions.size() - 1);
   CollapseStream full(positions[positions.size() - 1]);
 
-  // Initialization: <unk> has count 0 and so does <s>.  
   NGramStream *lower_valid = streams.begin();
-  streams[0]->Count() = 0;
-  *streams[0]->begin() = kUNK;
-  stats.Add(0, 0);
-  (++streams[0])->Count() = 0;
-  *streams[0]->begin() = kBOS;
-  // not in stats because it will get put in later.  
+  if (first_shard_) {
+    // Initialization: <unk> has count 0 and so does <s>.  
+    streams[0]->Count() = 0;
+    *streams[0]->begin() = kUNK;
+    stats.Add(0, 0);
+    (++streams[0])->Count() = 0;
+    *streams[0]->begin() = kBOS;
+    // not in stats because it will get put in later.  
+  } else if (full) {
+    // Later shard: pretend the unigram of the first last word was already
+    // started, as it would be if the previous shard's N-grams came first.  
+    streams[0]->Count() = 0;
+    *streams[0]->begin() = *(full->end() - 1);
+  } else {
+    for (NGramStream *s = streams.begin(); s != streams.end(); ++s)
+      s->Poison();
+    Finish(stats.Stats());
+    return;
+  }
 
   // iterate over full (the stream of the highest order ngrams)
   for (; full; ++full) {
@@ -208,9 +213,17 @@ void AdjustCounts::Run(const ChainPositions &positions) {
   for (NGramStream *s = streams.begin(); s != streams.end(); ++s)
     s->Poison();
 
-  stats.CalculateDiscounts();
+  Finish(stats.Stats());
 
   // NOTE: See special early-return case for unigrams near the top of this function
 }
 
+void AdjustCounts::Finish(const std::vector<OrderStat> &stats) {
+  if (stats_) {
+    *stats_ = stats;
+  } else {
+    CalculateDiscounts(stats, *counts_, *discounts_);
+  }
+}
+
 }} // namespaces
@@ -19,6 +19,23 @@ class BadDiscountException : public util::Exception {
     ~BadDiscountException() throw();
 };
 
+// Statistics about adjusted counts of one order.  
+struct OrderStat {
+  // n_1 in equation 26 of Chen and Goodman etc
+  uint64_t n[5];
+  uint64_t count;
+
+  // Sum statistics from shards.  
+  OrderStat &operator+=(const OrderStat &other) {
+    for (unsigned i = 0; i < 5; ++i) n[i] += other.n[i];
+    count += other.count;
+    return *this;
+  }
+};
+
+// Set counts and discounts from statistics, which may be the sum of shards.  
+void CalculateDiscounts(const std::vector<OrderStat> &stats, std::vector<uint64_t> &counts, std::vector<Discount> &discounts);
+
 /* Compute adjusted counts.  
  * Input: unique suffix sorted N-grams (and just the N-grams) with raw counts.
  * Output: [1,N]-grams with adjusted counts.  
@@ -28,13 +45,26 @@ class BadDiscountException : public util::Exception {
 class AdjustCounts {
   public:
     AdjustCounts(std::vector<uint64_t> &counts, std::vector<Discount> &discounts)
-      : counts_(counts), discounts_(discounts) {}
+      : counts_(&counts), discounts_(&discounts), stats_(NULL), first_shard_(true) {}
+
+    /* Process a shard: the N-grams whose last word is in a contiguous range.
+     * Output of all shards concatenated in order is the same as unsharded
+     * output.  Only the first shard emits <unk> and <s>.  Statistics are
+     * written to stats so the caller can sum them and CalculateDiscounts.  
+     */
+    AdjustCounts(std::vector<OrderStat> &stats, bool first_shard)
+      : counts_(NULL), discounts_(NULL), stats_(&stats), first_shard_(first_shard) {}
 
     void Run(const ChainPositions &positions);
 
   private:
-    std::vector<uint64_t> &counts_;
-    std::vector<Discount> &discounts_;
+    void Finish(const std::vector<OrderStat> &stats);
+
+    std::vector<uint64_t> *counts_;
+    std::vector<Discount> *discounts_;
+
+    std::vector<OrderStat> *stats_;
+    bool first_shard_;
 };
 
 } // namespace builder
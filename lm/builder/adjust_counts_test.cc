@@ -34,23 +34,30 @@ struct Gram4 {
   uint64_t count;
 };
 
+const Gram4 kGrams[] = {
+  {{0,0,0,0},10},
+  {{0,0,3,0},3},
+  // bos
+  {{1,1,1,2},5},
+  {{0,0,3,2},5},
+};
+
 class WriteInput {
   public:
+    // Write kGrams[begin, end).
+    explicit WriteInput(std::size_t begin = 0, std::size_t end = sizeof(kGrams) / sizeof(Gram4)) : begin_(begin), end_(end) {}
+
     void Run(const util::stream::ChainPosition &position) {
       NGramStream input(position);
-      Gram4 grams[] = {
-        {{0,0,0,0},10},
-        {{0,0,3,0},3},
-        // bos
-        {{1,1,1,2},5},
-        {{0,0,3,2},5},
-      };
-      for (size_t i = 0; i < sizeof(grams) / sizeof(Gram4); ++i, ++input) {
-        memcpy(input->begin(), grams[i].ids, sizeof(WordIndex) * 4);
-        input->Count() = grams[i].count;
+      for (size_t i = begin_; i < end_; ++i, ++input) {
+        memcpy(input->begin(), kGrams[i].ids, sizeof(WordIndex) * 4);
+        input->Count() = kGrams[i].count;
       }
       input.Poison();
     }
+
+  private:
+    std::size_t begin_, end_;
 };
 
 BOOST_AUTO_TEST_CASE(Simple) {
@@ -103,4 +110,60 @@ BOOST_AUTO_TEST_CASE(Simple) {
   bi.NextInMemory();
 }
 
+// Shards split by last word should concatenate to the unsharded output.
+BOOST_AUTO_TEST_CASE(Sharded) {
+  KeepCopy whole[4], shards[2][4];
+  std::vector<uint64_t> counts;
+  std::vector<Discount> discount;
+  std::vector<OrderStat> stats[2];
+  const std::size_t bounds[3] = {0, 2, 4};
+  util::stream::ChainConfig config;
+  config.total_memory = 100;
+  config.block_count = 1;
+  {
+    Chains chains(4);
+    for (unsigned i = 0; i < 4; ++i) {
+      config.entry_size = NGram::TotalSize(i + 1);
+      chains.push_back(config);
+    }
+    chains[3] >> WriteInput();
+    ChainPositions for_adjust(chains);
+    for (unsigned i = 0; i < 4; ++i) {
+      chains[i] >> boost::ref(whole[i]);
+    }
+    chains >> util::stream::kRecycle;
+    BOOST_CHECK_THROW(AdjustCounts(counts, discount).Run(for_adjust), BadDiscountException);
+  }
+  for (unsigned s = 0; s < 2; ++s) {
+    Chains chains(4);
+    for (unsigned i = 0; i < 4; ++i) {
+      config.entry_size = NGram::TotalSize(i + 1);
+      chains.push_back(config);
+    }
+    chains[3] >> WriteInput(bounds[s], bounds[s + 1]);
+    ChainPositions for_adjust(chains);
+    for (unsigned i = 0; i < 4; ++i) {
+      chains[i] >> boost::ref(shards[s][i]);
+    }
+    chains >> util::stream::kRecycle;
+    AdjustCounts(stats[s], s == 0).Run(for_adjust);
+  }
+  // The N-grams are in undefined order, so only compare lower orders.  
+  for (unsigned i = 0; i < 3; ++i) {
+    BOOST_REQUIRE_EQUAL(whole[i].Size(), shards[0][i].Size() + shards[1][i].Size());
+    BOOST_CHECK(!memcmp(whole[i].Get(), shards[0][i].Get(), shards[0][i].Size()));
+    BOOST_CHECK(!memcmp(whole[i].Get() + shards[0][i].Size(), shards[1][i].Get(), shards[1][i].Size()));
+  }
+  BOOST_REQUIRE_EQUAL(4UL, stats[0].size());
+  BOOST_REQUIRE_EQUAL(4UL, stats[1].size());
+  std::vector<OrderStat> sum(stats[0]);
+  for (unsigned i = 0; i < 4; ++i) {
+    sum[i] += stats[1][i];
+  }
+  std::vector<uint64_t> summed_counts;
+  BOOST_CHECK_THROW(CalculateDiscounts(sum, summed_counts, discount), BadDiscountException);
+  BOOST_REQUIRE_EQUAL(4UL, summed_counts.size());
+  BOOST_CHECK_EQUAL(counts[0], summed_counts[0]);
+}
+
 }}} // namespaces
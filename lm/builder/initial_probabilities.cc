@@ -83,6 +83,8 @@ class MergeRight {
       util::stream::Stream summed(from_adder_);
 
       NGramStream grams(primary);
+      // Shards after the first have no unigrams.  
+      if (!grams) return;
 
       // Without interpolation, the interpolation weight goes to <unk>.
       if (grams->Order() == 1 && !interpolate_unigrams_) {
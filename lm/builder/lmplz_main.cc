@@ -1,13 +1,19 @@
 #include "lm/builder/pipeline.hh"
+#include "lm/model.hh"
 #include "util/file.hh"
 #include "util/file_piece.hh"
 #include "util/usage.hh"
 
 #include <iostream>
+#include <sstream>
 
 #include <boost/program_options.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
 #include <boost/version.hpp>
 
+#include <unistd.h>
+
 namespace {
 class SizeNotify {
   public:
@@ -25,6 +31,46 @@ boost::program_options::typed_value<std::string> *SizeOption(std::size_t &to, co
   return boost::program_options::value<std::string>()->notifier(SizeNotify(to))->default_value(default_value);
 }
 
+/* Builds a binary model from ARPA read on a pipe, so that the ARPA never hits
+ * the disk and loading overlaps with printing.  The model reads the pipe by
+ * name because it only loads files by name.  
+ */
+class BinaryBuilder {
+  public:
+    // Takes ownership of arpa when run.  A failure is left in error.  
+    BinaryBuilder(int arpa, const std::string &type, const lm::ngram::Config &config, std::string &error)
+      : arpa_(arpa), type_(type), config_(config), error_(error) {}
+
+    void operator()() {
+      util::scoped_fd arpa(arpa_);
+      try {
+        std::ostringstream name;
+        name << "/dev/fd/" << arpa_;
+        using namespace lm::ngram;
+        if (type_ == "probing") {
+          ProbingModel(name.str().c_str(), config_);
+        } else if (config_.prob_bits) {
+          QuantTrieModel(name.str().c_str(), config_);
+        } else {
+          TrieModel(name.str().c_str(), config_);
+        }
+      } catch (const std::exception &e) {
+        error_ = e.what();
+        // Read the rest so that the pipeline does not block writing to the pipe.  
+        try {
+          char buf[4096];
+          while (util::ReadOrEOF(arpa.get(), buf, sizeof(buf))) {}
+        } catch (const util::Exception &) {}
+      }
+    }
+
+  private:
+    int arpa_;
+    std::string type_;
+    lm::ngram::Config config_;
+    std::string &error_;
+};
+
 } // namespace
 
 int main(int argc, char *argv[]) {
@@ -33,7 +79,8 @@ int main(int argc, char *argv[]) {
     po::options_description options("Language model building options");
     lm::builder::PipelineConfig pipeline;
 
-    std::string text, arpa;
+    std::string text, arpa, binary, binary_type;
+    unsigned int prob_bits, backoff_bits;
 
     options.add_options()
       ("order,o", po::value<std::size_t>(&pipeline.order)
@@ -48,10 +95,15 @@ int main(int argc, char *argv[]) {
       ("sort_block", SizeOption(pipeline.sort.buffer_size, "64M"), "Size of IO operations for sort (determines arity)")
       ("vocab_estimate", po::value<lm::WordIndex>(&pipeline.vocab_estimate)->default_value(1000000), "Assume this vocabulary size for purposes of calculating memory in step 1 (corpus count) and pre-sizing the hash table")
       ("block_count", po::value<std::size_t>(&pipeline.block_count)->default_value(2), "Block count (per order)")
+      ("shards", po::value<std::size_t>(&pipeline.shards)->default_value(1), "Split the vocabulary into this many ranges and calculate adjusted counts, initial probabilities, and interpolation for them in parallel")
       ("vocab_file", po::value<std::string>(&pipeline.vocab_file)->default_value(""), "Location to write vocabulary file")
       ("verbose_header", po::bool_switch(&pipeline.verbose_header), "Add a verbose header to the ARPA file that includes information such as token count, smoothing type, etc.")
       ("text", po::value<std::string>(&text), "Read text from a file instead of stdin")
-      ("arpa", po::value<std::string>(&arpa), "Write ARPA to a file instead of stdout");
+      ("arpa", po::value<std::string>(&arpa), "Write ARPA to a file instead of stdout")
+      ("binary", po::value<std::string>(&binary), "Write a KenLM binary file instead of ARPA")
+      ("binary_type", po::value<std::string>(&binary_type)->default_value("probing"), "Binary data structure: probing or trie")
+      ("prob_bits", po::value<unsigned int>(&prob_bits)->default_value(0), "Quantize trie probabilities to this many bits (0 to disable)")
+      ("backoff_bits", po::value<unsigned int>(&backoff_bits)->default_value(0), "Quantize trie backoffs to this many bits (defaults to prob_bits)");
     if (argc == 1) {
       std::cerr << 
         "Builds unpruned language models with modified Kneser-Ney smoothing.\n\n"
@@ -67,7 +119,8 @@ int main(int argc, char *argv[]) {
         "}\n\n"
         "Provide the corpus on stdin.  The ARPA file will be written to stdout.  Order of\n"
         "the model (-o) is the only mandatory option.  As this is an on-disk program,\n"
-        "setting the temporary file location (-T) and sorting memory (-S) is recommended.\n\n"
+        "setting the temporary file location (-T) and sorting memory (-S) is recommended.\n"
+        "With --binary, the model is written directly in KenLM's binary format instead.\n\n"
         "Memory sizes are specified like GNU sort: a number followed by a unit character.\n"
         "Valid units are \% for percentage of memory (supported platforms only) and (in\n"
         "increasing powers of 1024): b, K, M, G, T, P, E, Z, Y.  Default is K (*1024).\n\n";
@@ -100,18 +153,67 @@ int main(int argc, char *argv[]) {
     if (vm.count("text")) {
       in.reset(util::OpenReadOrThrow(text.c_str()));
     }
+    if (vm.count("arpa") && vm.count("binary")) {
+      std::cerr << "Specify at most one of --arpa and --binary." << std::endl;
+      return 1;
+    }
     if (vm.count("arpa")) {
       out.reset(util::CreateOrThrow(arpa.c_str()));
     }
 
+    boost::scoped_ptr<boost::thread> binary_thread;
+    std::string binary_error;
+    if (vm.count("binary")) {
+      lm::ngram::Config model_config;
+      model_config.write_mmap = binary.c_str();
+      model_config.temporary_directory_prefix = pipeline.sort.temp_prefix.c_str();
+      if (binary_type == "probing") {
+        model_config.write_method = lm::ngram::Config::WRITE_AFTER;
+        if (prob_bits || backoff_bits) {
+          std::cerr << "Quantization is only implemented in the trie data structure." << std::endl;
+          return 1;
+        }
+      } else if (binary_type == "trie") {
+        model_config.write_method = lm::ngram::Config::WRITE_MMAP;
+        if (prob_bits > 25 || backoff_bits > 25) {
+          std::cerr << "Bit counts are limited to 25." << std::endl;
+          return 1;
+        }
+        if (!prob_bits && backoff_bits) {
+          std::cerr << "You specified backoff quantization but not probability quantization." << std::endl;
+          return 1;
+        }
+        model_config.prob_bits = prob_bits;
+        model_config.backoff_bits = backoff_bits ? backoff_bits : prob_bits;
+      } else {
+        std::cerr << "Unknown binary type " << binary_type << ".  Use probing or trie." << std::endl;
+        return 1;
+      }
+      int fds[2];
+      UTIL_THROW_IF(pipe(fds), util::ErrnoException, "Could not create a pipe for the binary file");
+      out.reset(fds[1]);
+      binary_thread.reset(new boost::thread(BinaryBuilder(fds[0], binary_type, model_config, binary_error)));
+    }
+
     // Read from stdin
     try {
-      lm::builder::Pipeline(pipeline, in.release(), out.release());
+      try {
+        lm::builder::Pipeline(pipeline, in.release(), out.release());
+      } catch (...) {
+        // Pipeline closed the pipe, so the binary builder finishes too.  
+        if (binary_thread) binary_thread->join();
+        throw;
+      }
+      if (binary_thread) binary_thread->join();
     } catch (const util::MallocException &e) {
       std::cerr << e.what() << std::endl;
       std::cerr << "Try rerunning with a more conservative -S setting than " << vm["memory"].as<std::string>() << std::endl;
       return 1;
     }
+    if (!binary_error.empty()) {
+      std::cerr << "Building the binary file failed: " << binary_error << std::endl;
+      return 1;
+    }
     util::PrintUsage(std::cerr);
   } catch (const std::exception &e) {
     std::cerr << e.what() << std::endl;
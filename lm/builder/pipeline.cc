@@ -17,6 +17,8 @@
 #include <iostream>
 #include <vector>
 
+#include <assert.h>
+
 namespace lm { namespace builder {
 
 namespace {
@@ -30,17 +32,42 @@ void PrintStatistics(const std::vector<uint64_t> &counts, const std::vector<Disc
   }
 }
 
+// Return the byte offset of the first n-gram in a sorted file whose word at
+// index field is at least word.  field must be the primary sort key.  
+uint64_t FindWord(int fd, std::size_t entry_size, std::size_t field, WordIndex word) {
+  uint64_t begin = 0, end = util::SizeOrThrow(fd) / entry_size;
+  while (begin != end) {
+    uint64_t mid = begin + (end - begin) / 2;
+    WordIndex got;
+    util::PReadOrThrow(fd, &got, sizeof(WordIndex), mid * entry_size + field * sizeof(WordIndex));
+    if (got < word) {
+      begin = mid + 1;
+    } else {
+      end = mid;
+    }
+  }
+  return begin * entry_size;
+}
+
 class Master {
   public:
     explicit Master(const PipelineConfig &config) 
       : config_(config), chains_(config.order), files_(config.order) {
       config_.minimum_block = std::max(NGram::TotalSize(config_.order), config_.minimum_block);
+      if (Sharded()) shards_.Init(config_.shards);
     }
 
     const PipelineConfig &Config() const { return config_; }
 
     Chains &MutableChains() { return chains_; }
 
+    bool Sharded() const { return config_.shards > 1; }
+
+    // Shards actually used, which may be fewer than configured.  
+    std::size_t ShardCount() const { return shards_.size(); }
+
+    Chains &MutableShard(std::size_t shard) { return shards_[shard]; }
+
     template <class T> Master &operator>>(const T &worker) {
       chains_ >> worker;
       return *this;
@@ -56,7 +83,7 @@ class Master {
       const std::size_t merge_using = ngrams.Merge(std::min(config_.TotalMemory() - min_chains, ngrams.DefaultLazy()));
 
       std::vector<uint64_t> count_bounds(1, types);
-      CreateChains(config_.TotalMemory() - merge_using, count_bounds);
+      CreateChains(config_.TotalMemory() - merge_using, count_bounds, chains_);
       ngrams.Output(chains_.back(), merge_using);
 
       // Setup unigram file.  
@@ -70,7 +97,7 @@ class Master {
         sorts[i - 1].Merge(0);
       }
       // There's no lazy merge, so just divide memory amongst the chains.
-      CreateChains(config_.TotalMemory(), counts);
+      CreateChains(config_.TotalMemory(), counts, chains_);
       chains_.back().ActivateProgress();
       chains_[0] >> files_[0].Source();
       second_config.entry_size = NGram::TotalSize(1);
@@ -103,7 +130,7 @@ class Master {
       }
       std::reverse(laziness.begin(), laziness.end());
 
-      CreateChains(for_merge + min_chains, counts);
+      CreateChains(for_merge + min_chains, counts, chains_);
       chains_.back().ActivateProgress();
       chains_[0] >> files_[0].Source();
       for (std::size_t i = 1; i < config_.order; ++i) {
@@ -118,11 +145,7 @@ class Master {
         chains_[i] >> files_[i].Sink();
       }
       chains_.Wait(true);
-      // Use less memory.  Because we can.
-      CreateChains(std::min(config_.sort.buffer_size * config_.order, config_.TotalMemory()), counts);
-      for (std::size_t i = 0; i < config_.order; ++i) {
-        chains_[i] >> files_[i].Source();
-      }
+      ReadFinal(counts);
     }
 
     template <class Compare> void SetupSorts(Sorts<Compare> &sorts) {
@@ -135,10 +158,186 @@ class Master {
       chains_.Wait(true);
     }
 
+    /* Sharding splits the vocabulary into contiguous ranges of word ids.
+     * Adjusted counts and interpolation take the n-grams ending with a word in
+     * the range (the primary key of suffix order) and initial probabilities
+     * take the n-grams whose context ends with a word in the range (the
+     * primary key of context order).  Gammas for a context therefore stay in
+     * the same shard from initial probabilities to interpolation.  Splitting
+     * requires a complete merge, so files are fully merged where the
+     * unsharded pipeline would merge lazily.  
+     */
+
+    // Merge the N-grams completely and start each shard reading its range.  
+    void InitForShardedAdjust(util::stream::Sort<SuffixOrder, AddCombiner> &ngrams, WordIndex types) {
+      util::scoped_fd merged(ngrams.StealCompleted());
+      const std::size_t entry_size = NGram::TotalSize(config_.order);
+      const std::size_t last = config_.order - 1;
+      ChooseBounds(merged.get(), entry_size, types);
+
+      std::vector<uint64_t> count_bounds(1, types);
+      for (std::size_t s = 0; s + 1 < bounds_.size(); ++s) {
+        shards_.push_back(config_.order);
+        CreateChains(config_.TotalMemory() / (bounds_.size() - 1), count_bounds, shards_.back());
+        shards_.back().back() >> util::stream::PRead(util::DupOrThrow(merged.get()),
+            FindWord(merged.get(), entry_size, last, bounds_[s]),
+            FindWord(merged.get(), entry_size, last, bounds_[s + 1]),
+            true);
+      }
+      files_.push_back(util::MakeTemp(config_.TempPrefix()));
+    }
+
+    void AdjustShards() {
+      stats_.resize(shards_.size());
+      for (std::size_t s = 0; s < shards_.size(); ++s) {
+        shards_[s] >> AdjustCounts(stats_[s], s == 0);
+      }
+    }
+
+    // Call after adjusted counts have finished on every shard.  
+    void ShardDiscounts(std::vector<uint64_t> &counts, std::vector<Discount> &discounts) {
+      std::vector<OrderStat> sum(stats_.front());
+      for (std::size_t s = 1; s < stats_.size(); ++s) {
+        for (std::size_t i = 0; i < sum.size(); ++i) {
+          sum[i] += stats_[s][i];
+        }
+      }
+      CalculateDiscounts(sum, counts, discounts);
+      // Each shard wrote its unigrams to an offset computed from word ids.  
+      UTIL_THROW_IF(counts[0] != bounds_.back(), util::Exception, "Vocab words don't match up.  Is there a null byte in the input?");
+    }
+
+    /* Sort orders 2 and up, taking input from every shard.  Unigrams are
+     * written in place: they do not need sorting and each shard has a range of
+     * word ids.  
+     */
+    template <class Compare> void SetupShardedSorts(Sorts<Compare> &sorts) {
+      sorts.Init(config_.order - 1);
+      for (std::size_t i = 1; i < config_.order; ++i) {
+        sorts.push_back(shards_.size(), NGram::TotalSize(i + 1), config_.sort, Compare(i + 1));
+      }
+      for (std::size_t s = 0; s < shards_.size(); ++s) {
+        shards_[s][0] >> util::stream::PWriteAndRecycle(files_[0].File(), bounds_[s] * NGram::TotalSize(1));
+        for (std::size_t i = 1; i < config_.order; ++i) {
+          sorts[i - 1].Input(shards_[s][i]);
+        }
+      }
+      WaitShards();
+    }
+
+    /* Initial probabilities need the sum over all unigrams, so the first
+     * shard reads every unigram and the rest read none.  
+     */
+    void ShardedReadTwice(const std::vector<uint64_t> &counts, Sorts<ContextOrder> &sorts, FixedArray<Chains> &second, util::stream::ChainConfig second_config) {
+      FixedArray<util::scoped_fd> merged(config_.order - 1);
+      for (std::size_t i = 1; i < config_.order; ++i) {
+        merged.push_back(sorts[i - 1].StealCompleted());
+      }
+      second.Init(shards_.size());
+      for (std::size_t s = 0; s < shards_.size(); ++s) {
+        Chains &shard = shards_[s];
+        CreateChains(config_.TotalMemory() / shards_.size(), counts, shard);
+        second.push_back(config_.order);
+        const uint64_t unigram_end = s ? 0 : files_[0].Size();
+        shard[0] >> util::stream::PRead(files_[0].File(), 0, unigram_end);
+        second_config.entry_size = NGram::TotalSize(1);
+        second.back().push_back(second_config);
+        second.back().back() >> util::stream::PRead(files_[0].File(), 0, unigram_end);
+        for (std::size_t i = 1; i < config_.order; ++i) {
+          const int fd = merged[i - 1].get();
+          const std::size_t entry_size = NGram::TotalSize(i + 1);
+          // The context of an (i+1)-gram ends at index i - 1.  
+          const uint64_t begin = FindWord(fd, entry_size, i - 1, bounds_[s]);
+          const uint64_t end = FindWord(fd, entry_size, i - 1, bounds_[s + 1]);
+          shard[i] >> util::stream::PRead(util::DupOrThrow(fd), begin, end, true);
+          second_config.entry_size = entry_size;
+          second.back().push_back(second_config);
+          second.back().back() >> util::stream::PRead(util::DupOrThrow(fd), begin, end, true);
+        }
+      }
+    }
+
+    // gammas has order - 1 files for each shard.  
+    void ShardedInterpolate(const std::vector<uint64_t> &counts, Sorts<SuffixOrder> &primary, FixedArray<util::stream::FileBuffer> &gammas) {
+      FixedArray<util::scoped_fd> merged(config_.order - 1);
+      for (std::size_t i = 1; i < config_.order; ++i) {
+        merged.push_back(primary[i - 1].StealCompleted());
+      }
+      // Interpolation preserves the number of n-grams, so each shard writes
+      // to the same offsets it reads from.  
+      FixedArray<util::stream::FileBuffer> out(config_.order);
+      for (std::size_t i = 0; i < config_.order; ++i) {
+        out.push_back(util::MakeTemp(config_.TempPrefix()));
+      }
+      FixedArray<Chains> gamma_chains(shards_.size());
+      util::stream::ChainConfig read_backoffs(config_.read_backoffs);
+      read_backoffs.entry_size = sizeof(float);
+      for (std::size_t s = 0; s < shards_.size(); ++s) {
+        Chains &shard = shards_[s];
+        CreateChains(config_.TotalMemory() / shards_.size(), counts, shard);
+        std::vector<uint64_t> begins;
+        for (std::size_t i = 0; i < config_.order; ++i) {
+          const int fd = i ? merged[i - 1].get() : files_[0].File();
+          const std::size_t entry_size = NGram::TotalSize(i + 1);
+          begins.push_back(FindWord(fd, entry_size, i, bounds_[s]));
+          shard[i] >> util::stream::PRead(fd, begins.back(), FindWord(fd, entry_size, i, bounds_[s + 1]));
+        }
+        gamma_chains.push_back(config_.order - 1);
+        for (std::size_t i = 0; i < config_.order - 1; ++i) {
+          gamma_chains.back().push_back(read_backoffs);
+          gamma_chains.back().back() >> gammas[s * (config_.order - 1) + i].Source();
+        }
+        shard >> Interpolate(counts[0], ChainPositions(gamma_chains.back()));
+        gamma_chains.back() >> util::stream::kRecycle;
+        for (std::size_t i = 0; i < config_.order; ++i) {
+          shard[i] >> util::stream::PWriteAndRecycle(out[i].File(), begins[i]);
+        }
+      }
+      WaitShards();
+      for (Chains *i = gamma_chains.begin(); i != gamma_chains.end(); ++i) {
+        i->Wait(true);
+      }
+      files_.clear();
+      for (std::size_t i = 0; i < config_.order; ++i) {
+        files_.push_back(util::DupOrThrow(out[i].File()));
+      }
+      ReadFinal(counts);
+    }
+
   private:
+    // Divide the vocabulary into ranges with about the same number of N-grams.  
+    void ChooseBounds(int fd, std::size_t entry_size, WordIndex types) {
+      const uint64_t entries = util::SizeOrThrow(fd) / entry_size;
+      bounds_.assign(1, 0);
+      for (std::size_t s = 1; s < config_.shards; ++s) {
+        WordIndex word;
+        util::PReadOrThrow(fd, &word, sizeof(WordIndex), (entries * s / config_.shards) * entry_size + (config_.order - 1) * sizeof(WordIndex));
+        // Frequent words can span shards; merge them.  
+        if (word > bounds_.back()) bounds_.push_back(word);
+      }
+      assert(types > bounds_.back());
+      bounds_.push_back(types);
+      std::cerr << "Sharding into " << (bounds_.size() - 1) << " ranges of words." << std::endl;
+    }
+
+    void WaitShards() {
+      for (Chains *i = shards_.begin(); i != shards_.end(); ++i) {
+        i->Wait(true);
+      }
+    }
+
+    // Read the buffered output of interpolation.  
+    void ReadFinal(const std::vector<uint64_t> &counts) {
+      // Use less memory.  Because we can.
+      CreateChains(std::min(config_.sort.buffer_size * config_.order, config_.TotalMemory()), counts, chains_);
+      for (std::size_t i = 0; i < config_.order; ++i) {
+        chains_[i] >> files_[i].Source();
+      }
+    }
+
     // Create chains, allocating memory to them.  Totally heuristic.  Count
     // bounds are upper bounds on the counts or not present.
-    void CreateChains(std::size_t remaining_mem, const std::vector<uint64_t> &count_bounds) {
+    void CreateChains(std::size_t remaining_mem, const std::vector<uint64_t> &count_bounds, Chains &chains) {
       std::vector<std::size_t> assignments;
       assignments.reserve(config_.order);
       // Start by assigning maximum memory usage (to be refined later).
@@ -187,11 +386,11 @@ class Master {
         assignments[*i] = remaining_mem * (portions[*i] / sum);
         block_count[*i] = config_.block_count;
       }
-      chains_.clear();
+      chains.clear();
       std::cerr << "Chain sizes:";
       for (std::size_t i = 0; i < config_.order; ++i) {
         std::cerr << ' ' << (i+1) << ":" << assignments[i];
-        chains_.push_back(util::stream::ChainConfig(NGram::TotalSize(i + 1), block_count[i], assignments[i]));
+        chains.push_back(util::stream::ChainConfig(NGram::TotalSize(i + 1), block_count[i], assignments[i]));
       }
       std::cerr << std::endl;
     }
@@ -201,6 +400,12 @@ class Master {
     Chains chains_;
     // Often only unigrams, but sometimes all orders.  
     FixedArray<util::stream::FileBuffer> files_;
+
+    // Only used when sharding.  
+    FixedArray<Chains> shards_;
+    // Shard s has words [bounds_[s], bounds_[s + 1]).
+    std::vector<WordIndex> bounds_;
+    std::vector<std::vector<OrderStat> > stats_;
 };
 
 void CountText(int text_file /* input */, int vocab_file /* output */, Master &master, uint64_t &token_count, std::string &text_file_name) {
@@ -227,7 +432,11 @@ void CountText(int text_file /* input */, int vocab_file /* output */, Master &m
   util::stream::Sort<SuffixOrder, AddCombiner> sorter(chain, config.sort, SuffixOrder(config.order), AddCombiner());
   chain.Wait(true);
   std::cerr << "=== 2/5 Calculating and sorting adjusted counts ===" << std::endl;
-  master.InitForAdjust(sorter, type_count);
+  if (master.Sharded()) {
+    master.InitForShardedAdjust(sorter, type_count);
+  } else {
+    master.InitForAdjust(sorter, type_count);
+  }
 }
 
 void InitialProbabilities(const std::vector<uint64_t> &counts, const std::vector<Discount> &discounts, Master &master, Sorts<SuffixOrder> &primary, FixedArray<util::stream::FileBuffer> &gammas) {
@@ -273,21 +482,58 @@ void InterpolateProbabilities(const std::vector<uint64_t> &counts, Master &maste
   master.BufferFinal(counts);
 }
 
+void ShardedInitialProbabilities(std::vector<uint64_t> &counts, std::vector<Discount> &discounts, Master &master, Sorts<SuffixOrder> &primary, FixedArray<util::stream::FileBuffer> &gammas) {
+  const PipelineConfig &config = master.Config();
+  FixedArray<Chains> second;
+
+  {
+    Sorts<ContextOrder> sorts;
+    master.SetupShardedSorts(sorts);
+    master.ShardDiscounts(counts, discounts);
+    PrintStatistics(counts, discounts);
+    lm::ngram::ShowSizes(counts);
+    std::cerr << "=== 3/5 Calculating and sorting initial probabilities ===" << std::endl;
+    master.ShardedReadTwice(counts, sorts, second, config.initial_probs.adder_in);
+  }
+
+  FixedArray<Chains> gamma_chains(master.ShardCount());
+  gammas.Init(master.ShardCount() * (config.order - 1));
+  for (std::size_t s = 0; s < master.ShardCount(); ++s) {
+    gamma_chains.push_back(config.order);
+    InitialProbabilities(config.initial_probs, discounts, master.MutableShard(s), second[s], gamma_chains.back());
+    // Don't care about gamma for 0.  
+    gamma_chains.back()[0] >> util::stream::kRecycle;
+    for (std::size_t i = 1; i < config.order; ++i) {
+      gammas.push_back(util::MakeTemp(config.TempPrefix()));
+      gamma_chains.back()[i] >> gammas.back().Sink();
+    }
+  }
+  // Has to be done here due to gamma_chains scope.
+  master.SetupShardedSorts(primary);
+}
+
 } // namespace
 
 void Pipeline(PipelineConfig config, int text_file, int out_arpa) {
+  // Closed if this throws, so that a reader of out_arpa sees the end.
+  util::scoped_fd out_file(out_arpa);
   // Some fail-fast sanity checks.
   if (config.sort.buffer_size * 4 > config.TotalMemory()) {
     config.sort.buffer_size = config.TotalMemory() / 4;
     std::cerr << "Warning: changing sort block size to " << config.sort.buffer_size << " bytes due to low total memory." << std::endl;
   }
+  if (config.shards > 1 && config.order == 1) {
+    config.shards = 1;
+    std::cerr << "Warning: not sharding a unigram model." << std::endl;
+  }
+  UTIL_THROW_IF(!config.shards, util::Exception, "Need at least one shard.");
   if (config.minimum_block < NGram::TotalSize(config.order)) {
     config.minimum_block = NGram::TotalSize(config.order);
     std::cerr << "Warning: raising minimum block to " << config.minimum_block << " to fit an ngram in every block." << std::endl;
   }
   UTIL_THROW_IF(config.sort.buffer_size < config.minimum_block, util::Exception, "Sort block size " << config.sort.buffer_size << " is below the minimum block size " << config.minimum_block << ".");
-  UTIL_THROW_IF(config.TotalMemory() < config.minimum_block * config.order * config.block_count, util::Exception,
-      "Not enough memory to fit " << (config.order * config.block_count) << " blocks with minimum size " << config.minimum_block << ".  Increase memory to " << (config.minimum_block * config.order * config.block_count) << " bytes or decrease the minimum block size.");
+  UTIL_THROW_IF(config.TotalMemory() < config.minimum_block * config.order * config.block_count * config.shards, util::Exception,
+      "Not enough memory to fit " << (config.order * config.block_count * config.shards) << " blocks with minimum size " << config.minimum_block << ".  Increase memory to " << (config.minimum_block * config.order * config.block_count * config.shards) << " bytes or decrease the minimum block size.");
 
   UTIL_TIMER("(%w s) Total wall time elapsed\n");
   Master master(config);
@@ -301,9 +547,15 @@ void Pipeline(PipelineConfig config, int text_file, int out_arpa) {
 
   std::vector<uint64_t> counts;
   std::vector<Discount> discounts;
-  master >> AdjustCounts(counts, discounts);
-
-  {
+  if (master.Sharded()) {
+    master.AdjustShards();
+    FixedArray<util::stream::FileBuffer> gammas;
+    Sorts<SuffixOrder> primary;
+    ShardedInitialProbabilities(counts, discounts, master, primary, gammas);
+    std::cerr << "=== 4/5 Calculating and writing order-interpolated probabilities ===" << std::endl;
+    master.ShardedInterpolate(counts, primary, gammas);
+  } else {
+    master >> AdjustCounts(counts, discounts);
     FixedArray<util::stream::FileBuffer> gammas;
     Sorts<SuffixOrder> primary;
     InitialProbabilities(counts, discounts, master, primary, gammas);
@@ -314,7 +566,7 @@ void Pipeline(PipelineConfig config, int text_file, int out_arpa) {
   VocabReconstitute vocab(vocab_file.get());
   UTIL_THROW_IF(vocab.Size() != counts[0], util::Exception, "Vocab words don't match up.  Is there a null byte in the input?");
   HeaderInfo header_info(text_file_name, token_count);
-  master >> PrintARPA(vocab, counts, (config.verbose_header ? &header_info : NULL), out_arpa) >> util::stream::kRecycle;
+  master >> PrintARPA(vocab, counts, (config.verbose_header ? &header_info : NULL), out_file.release()) >> util::stream::kRecycle;
   master.MutableChains().Wait(true);
 }
 
@@ -30,6 +30,10 @@ struct PipelineConfig {
   // Number of blocks to use.  This will be overridden to 1 if everything fits.
   std::size_t block_count;
 
+  // Number of ranges of the vocabulary to process in parallel.  1 disables
+  // sharding.  
+  std::size_t shards;
+
   const std::string &TempPrefix() const { return sort.temp_prefix; }
   std::size_t TotalMemory() const { return sort.total_memory; }
 };
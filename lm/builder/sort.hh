@@ -95,6 +95,12 @@ template <class Compare> class Sorts : public FixedArray<util::stream::Sort<Comp
       new (P::end()) S(chain, config, compare);
       P::Constructed();
     }
+
+    // Sort several chains together.  Each has to be added with Input.
+    void push_back(std::size_t inputs, std::size_t entry_size, const util::stream::SortConfig &config, const Compare &compare) {
+      new (P::end()) S(inputs, entry_size, config, compare);
+      P::Constructed();
+    }
 };
 
 } // namespace builder
@@ -11,6 +11,7 @@
 #include <fstream>
 
 #include "Data.h"
+#include "NBestPool.h"
 #include "Scorer.h"
 #include "ScorerFactory.h"
 #include "Util.h"
@@ -131,6 +132,15 @@ void Data::removeDuplicates()
 
 void Data::load(const std::string &featfile, const std::string &scorefile)
 {
+  if (NBestPool::IsPool(featfile) || NBestPool::IsPool(scorefile)) {
+    // a pool holds both the features and the scores
+    if (featfile != scorefile) {
+      throw runtime_error("The n-best pool " + (NBestPool::IsPool(featfile) ? featfile : scorefile)
+                          + " must be given as both the feature and the score file");
+    }
+    NBestPool(featfile).Load(*m_feature_data, *m_score_data, m_sparse_weights);
+    return;
+  }
   m_feature_data->load(featfile, m_sparse_weights);
   m_score_data->load(scorefile);
 }
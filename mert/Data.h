@@ -69,6 +69,10 @@ public:
 
   void loadNBest(const std::string &file);
 
+  /**
+   * Load features and scores. An NBestPool holds both; it is loaded by giving
+   * it as featfile and scorefile.
+   */
   void load(const std::string &featfile, const std::string &scorefile);
 
   void save(const std::string &featfile, const std::string &scorefile, bool bin=false);
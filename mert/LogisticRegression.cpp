@@ -0,0 +1,223 @@
+#include "LogisticRegression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <iostream>
+
+#include "moses/ThreadPool.h"
+
+using namespace std;
+using Moses::TaskGroup;
+
+namespace
+{
+
+const size_t kExamplesPerTask = 4096;
+const size_t kMemory = 10;          // correction pairs kept by L-BFGS
+const double kArmijo = 1e-4;        // sufficient decrease in the line search
+const size_t kMaxLineSearchSteps = 40;
+
+double Dot(const vector<double>& a, const vector<double>& b)
+{
+  double sum = 0.0;
+  for (size_t i = 0; i < a.size(); ++i) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+/**
+ * Negative log-likelihood and its gradient over a range of examples.
+ */
+class ObjectiveTask : public Moses::Task
+{
+public:
+  ObjectiveTask(const vector<MosesTuning::MiraFeatureVector>& examples,
+                const vector<bool>& positive, size_t begin, size_t end,
+                const vector<double>& weights, double& loss, vector<double>& gradient)
+    : m_examples(examples), m_positive(positive), m_begin(begin), m_end(end),
+      m_weights(weights), m_loss(loss), m_gradient(gradient) {}
+
+  virtual void Run() {
+    m_loss = 0.0;
+    m_gradient.assign(m_weights.size(), 0.0);
+    for (size_t e = m_begin; e < m_end; ++e) {
+      const MosesTuning::MiraFeatureVector& x = m_examples[e];
+      const double y = m_positive[e] ? 1.0 : -1.0;
+      double margin = 0.0;
+      for (size_t i = 0; i < x.size(); ++i) {
+        margin += m_weights[x.feat(i)] * x.val(i);
+      }
+      margin *= y;
+      // log(1 + exp(-margin)), without overflow
+      if (margin > 0) {
+        m_loss += log1p(exp(-margin));
+      } else {
+        m_loss += -margin + log1p(exp(margin));
+      }
+      const double scale = -y / (1.0 + exp(margin));
+      for (size_t i = 0; i < x.size(); ++i) {
+        m_gradient[x.feat(i)] += scale * x.val(i);
+      }
+    }
+  }
+
+private:
+  const vector<MosesTuning::MiraFeatureVector>& m_examples;
+  const vector<bool>& m_positive;
+  size_t m_begin, m_end;
+  const vector<double>& m_weights;
+  double& m_loss;
+  vector<double>& m_gradient;
+};
+
+} // namespace
+
+namespace MosesTuning
+{
+
+
+LogisticRegression::LogisticRegression() : m_size(0) {}
+
+void LogisticRegression::AddExample(const MiraFeatureVector& x, bool positive)
+{
+  m_examples.push_back(x);
+  m_positive.push_back(positive);
+  for (size_t i = 0; i < x.size(); ++i) {
+    m_size = max(m_size, x.feat(i) + 1);
+  }
+}
+
+double LogisticRegression::Objective(const vector<double>& weights, double l2,
+                                     vector<double>& gradient, Moses::ThreadPool* pool) const
+{
+  const size_t chunks = (m_examples.size() + kExamplesPerTask - 1) / kExamplesPerTask;
+  vector<double> losses(chunks);
+  vector<vector<double> > gradients(chunks);
+  {
+    TaskGroup group(pool);
+    for (size_t c = 0; c < chunks; ++c) {
+      const size_t begin = c * kExamplesPerTask;
+      const size_t end = min(begin + kExamplesPerTask, m_examples.size());
+      group.Spawn(new ObjectiveTask(m_examples, m_positive, begin, end, weights,
+                                    losses[c], gradients[c]));
+    }
+  }
+
+  double loss = 0.5 * l2 * Dot(weights, weights);
+  gradient.resize(weights.size());
+  for (size_t i = 0; i < weights.size(); ++i) {
+    gradient[i] = l2 * weights[i];
+  }
+  for (size_t c = 0; c < chunks; ++c) {
+    loss += losses[c];
+    for (size_t i = 0; i < weights.size(); ++i) {
+      gradient[i] += gradients[c][i];
+    }
+  }
+  return loss;
+}
+
+double LogisticRegression::Train(vector<ValType>& result, double l2,
+                                 size_t maxIterations, Moses::ThreadPool* pool) const
+{
+  const size_t n = m_size;
+  vector<double> w(n, 0.0), g;
+  double f = Objective(w, l2, g, pool);
+
+  deque<vector<double> > ss, ys;
+  deque<double> rhos;
+  vector<double> d(n), next(n), nextG;
+  for (size_t iter = 0; iter < maxIterations; ++iter) {
+    const double gnorm = sqrt(Dot(g, g));
+    if (gnorm < 1e-5 * max(1.0, sqrt(Dot(w, w)))) {
+      break;
+    }
+
+    // search direction -H*g, by the two-loop recursion
+    for (size_t i = 0; i < n; ++i) {
+      d[i] = -g[i];
+    }
+    vector<double> alphas(ss.size());
+    for (size_t k = ss.size(); k-- > 0;) {
+      alphas[k] = rhos[k] * Dot(ss[k], d);
+      for (size_t i = 0; i < n; ++i) {
+        d[i] -= alphas[k] * ys[k][i];
+      }
+    }
+    if (!ss.empty()) {
+      const double gamma = Dot(ss.back(), ys.back()) / Dot(ys.back(), ys.back());
+      for (size_t i = 0; i < n; ++i) {
+        d[i] *= gamma;
+      }
+    }
+    for (size_t k = 0; k < ss.size(); ++k) {
+      const double beta = rhos[k] * Dot(ys[k], d);
+      for (size_t i = 0; i < n; ++i) {
+        d[i] += (alphas[k] - beta) * ss[k][i];
+      }
+    }
+    double slope = Dot(d, g);
+    if (slope >= 0) {
+      // not a descent direction: forget the history
+      ss.clear();
+      ys.clear();
+      rhos.clear();
+      for (size_t i = 0; i < n; ++i) {
+        d[i] = -g[i];
+      }
+      slope = -gnorm * gnorm;
+    }
+
+    // backtracking line search
+    double step = ss.empty() ? 1.0 / gnorm : 1.0;
+    double nextF = 0.0;
+    bool found = false;
+    for (size_t t = 0; t < kMaxLineSearchSteps; ++t, step *= 0.5) {
+      for (size_t i = 0; i < n; ++i) {
+        next[i] = w[i] + step * d[i];
+      }
+      nextF = Objective(next, l2, nextG, pool);
+      if (nextF <= f + kArmijo * step * slope) {
+        found = true;
+        break;
+      }
+    }
+    if (!found) {
+      break;
+    }
+
+    vector<double> s(n), y(n);
+    for (size_t i = 0; i < n; ++i) {
+      s[i] = next[i] - w[i];
+      y[i] = nextG[i] - g[i];
+    }
+    const double sy = Dot(s, y);
+    if (sy > 1e-10) {
+      if (ss.size() == kMemory) {
+        ss.pop_front();
+        ys.pop_front();
+        rhos.pop_front();
+      }
+      ss.push_back(s);
+      ys.push_back(y);
+      rhos.push_back(1.0 / sy);
+    }
+    w.swap(next);
+    g.swap(nextG);
+    f = nextF;
+    cerr << "Iteration " << (iter + 1) << ": objective = " << f << endl;
+  }
+
+  result.assign(w.begin(), w.end());
+  return f;
+}
+
+}
+
+// --Emacs trickery--
+// Local Variables:
+// mode:c++
+// c-basic-offset:2
+// End:
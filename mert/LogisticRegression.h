@@ -0,0 +1,70 @@
+/*
+ * LogisticRegression.h
+ * pro - Pairwise Ranking Optimisation
+ *
+ * A binary logistic regression classifier without a bias term, which is
+ * what PRO otherwise trains with megam.
+ */
+
+#ifndef MERT_LOGISTIC_REGRESSION_H
+#define MERT_LOGISTIC_REGRESSION_H
+
+#include <vector>
+
+#include "MiraFeatureVector.h"
+
+namespace Moses
+{
+class ThreadPool;
+}
+
+namespace MosesTuning
+{
+
+
+class LogisticRegression
+{
+public:
+  LogisticRegression();
+
+  /**
+   * Add a training example
+   * \param x        Feature values, indexed as in MiraFeatureVector
+   * \param positive Label of the example
+   */
+  void AddExample(const MiraFeatureVector& x, bool positive);
+
+  std::size_t NumberOfExamples() const {
+    return m_examples.size();
+  }
+
+  /**
+   * Minimise the negative log-likelihood of the examples plus
+   * l2/2 * |w|^2 with L-BFGS, starting from the zero vector.
+   * The examples are split into fixed chunks whose gradients are computed
+   * by tasks of pool (or of the pool of the calling thread if NULL) and
+   * summed in order, so the weights do not depend on the number of threads.
+   * \return the final value of the objective
+   */
+  double Train(std::vector<ValType>& weights, double l2,
+               std::size_t maxIterations, Moses::ThreadPool* pool = NULL) const;
+
+  //! value and gradient of the objective at weights
+  double Objective(const std::vector<double>& weights, double l2,
+                   std::vector<double>& gradient, Moses::ThreadPool* pool = NULL) const;
+
+private:
+  std::vector<MiraFeatureVector> m_examples;
+  std::vector<bool> m_positive;
+  std::size_t m_size; // one more than the largest feature index
+};
+
+}
+
+#endif // MERT_LOGISTIC_REGRESSION_H
+
+// --Emacs trickery--
+// Local Variables:
+// mode:c++
+// c-basic-offset:2
+// End:
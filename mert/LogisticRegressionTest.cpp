@@ -0,0 +1,58 @@
+#include "LogisticRegression.h"
+
+#define BOOST_TEST_MODULE MertLogisticRegression
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+
+using namespace MosesTuning;
+
+namespace
+{
+
+MiraFeatureVector MakeVector(ValType x0, ValType x1)
+{
+  std::vector<ValType> dense;
+  dense.push_back(x0);
+  dense.push_back(x1);
+  return MiraFeatureVector(dense, std::vector<std::size_t>(), std::vector<ValType>());
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(train_unregularised)
+{
+  // three positive and one negative example at the same point:
+  // the likelihood is highest where sigmoid(w.x) = 3/4
+  LogisticRegression regression;
+  for (int i = 0; i < 3; ++i) {
+    regression.AddExample(MakeVector(1, 0), true);
+  }
+  regression.AddExample(MakeVector(1, 0), false);
+  BOOST_CHECK_EQUAL(regression.NumberOfExamples(), 4u);
+
+  std::vector<ValType> weights;
+  regression.Train(weights, 0.0, 100);
+  BOOST_REQUIRE_EQUAL(weights.size(), 2u);
+  BOOST_CHECK_CLOSE(weights[0], std::log(3.0), 0.01);
+  BOOST_CHECK_EQUAL(weights[1], 0);
+}
+
+BOOST_AUTO_TEST_CASE(train_regularised)
+{
+  LogisticRegression regression;
+  regression.AddExample(MakeVector(1, 2), true);
+  regression.AddExample(MakeVector(-1, -2), false);
+  regression.AddExample(MakeVector(0.5, -1), true);
+  regression.AddExample(MakeVector(2, 1), false);
+
+  std::vector<ValType> weights;
+  const double objective = regression.Train(weights, 1.0, 100);
+
+  // the gradient vanishes at the optimum
+  std::vector<double> w(weights.begin(), weights.end()), gradient;
+  BOOST_CHECK_CLOSE(regression.Objective(w, 1.0, gradient), objective, 0.01);
+  for (std::size_t i = 0; i < gradient.size(); ++i) {
+    BOOST_CHECK_SMALL(gradient[i], 1e-4);
+  }
+}
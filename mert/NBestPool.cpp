@@ -0,0 +1,396 @@
+/*
+ *  NBestPool.cpp
+ *  mert - Minimum Error Rate Training
+ *
+ */
+
+#include "NBestPool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <boost/unordered_map.hpp>
+
+#include "util/file.hh"
+#include "util/murmur_hash.hh"
+
+#include "FeatureData.h"
+#include "ScoreData.h"
+#include "Util.h"
+
+using namespace std;
+
+namespace
+{
+
+const char kPoolMagic[8] = {'M', 'E', 'R', 'T', 'P', 'O', 'O', 'L'};
+const uint32_t kPoolVersion = 1;
+
+inline uint64_t Align8(uint64_t size)
+{
+  return (size + 7) & ~static_cast<uint64_t>(7);
+}
+
+//! hash of the dense features and score statistics of an entry
+inline uint64_t HashEntry(const MosesTuning::FeatureStats& features, const MosesTuning::ScoreStats& scores)
+{
+  uint64_t hash = util::MurmurHashNative(features.getArray(), features.bytes());
+  return util::MurmurHashNative(scores.getArray(), scores.bytes(), hash);
+}
+
+//! an entry to append: position of its sentence in FeatureData and ScoreData, and in their arrays
+struct Entry {
+  size_t features, scores, index;
+  uint64_t hash;
+};
+
+void WritePadding(ostream& out, uint64_t size)
+{
+  static const char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  out.write(zeros, Align8(size) - size);
+}
+
+template <class T>
+void WriteColumn(ostream& out, const vector<T>& column)
+{
+  out.write(reinterpret_cast<const char*>(column.empty() ? NULL : &column[0]), column.size() * sizeof(T));
+  WritePadding(out, column.size() * sizeof(T));
+}
+
+} // namespace
+
+namespace MosesTuning
+{
+
+NBestPool::Layout::Layout(const Header& header)
+{
+  sentences = sizeof(Header) + header.names_size;
+  begins = sentences + Align8(header.num_sentences * sizeof(int32_t));
+  hashes = begins + (header.num_sentences + 1) * sizeof(uint64_t);
+  features = hashes + header.num_entries * sizeof(uint64_t);
+  scores = features + Align8(header.num_features * header.num_entries * sizeof(float));
+  sparseBegins = scores + Align8(header.num_scores * header.num_entries * sizeof(int32_t));
+  sparseIds = sparseBegins + (header.num_entries + 1) * sizeof(uint64_t);
+  sparseValues = sparseIds + Align8(header.num_sparse * sizeof(uint32_t));
+  size = sparseValues + Align8(header.num_sparse * sizeof(float));
+}
+
+void NBestPool::Segment::Find(int sentence, uint64_t& begin, uint64_t& end) const
+{
+  const int32_t* last = sentences + header->num_sentences;
+  const int32_t* found = lower_bound(sentences, last, sentence);
+  if (found == last || *found != sentence) {
+    begin = end = 0;
+    return;
+  }
+  begin = begins[found - sentences];
+  end = begins[found - sentences + 1];
+}
+
+NBestPool::NBestPool(const string& file)
+  : m_file(file)
+{
+  Map();
+}
+
+bool NBestPool::IsPool(const string& file)
+{
+  ifstream in(file.c_str(), ios::in | ios::binary);
+  char magic[sizeof(kPoolMagic)];
+  return in.read(magic, sizeof(magic)) && memcmp(magic, kPoolMagic, sizeof(magic)) == 0;
+}
+
+void NBestPool::Map()
+{
+  m_segments.clear();
+  m_memory.reset();
+  ifstream exists(m_file.c_str());
+  if (!exists) {
+    return;
+  }
+
+  util::scoped_fd fd(util::OpenReadOrThrow(m_file.c_str()));
+  const uint64_t size = util::SizeOrThrow(fd.get());
+  if (size == 0) {
+    return;
+  }
+  util::MapRead(util::LAZY, fd.get(), 0, size, m_memory);
+
+  const char* base = static_cast<const char*>(m_memory.get());
+  for (uint64_t offset = 0; offset < size; ) {
+    const Header* header = reinterpret_cast<const Header*>(base + offset);
+    if (size - offset < sizeof(Header) || memcmp(header->magic, kPoolMagic, sizeof(kPoolMagic)) != 0) {
+      throw runtime_error("Not an n-best pool: " + m_file);
+    }
+    if (header->version != kPoolVersion) {
+      throw runtime_error("Unsupported n-best pool version in " + m_file);
+    }
+    const Layout layout(*header);
+    if (header->segment_size != layout.size || size - offset < layout.size) {
+      throw runtime_error("Truncated n-best pool: " + m_file);
+    }
+
+    const char* start = base + offset;
+    Segment segment;
+    segment.header = header;
+    const char* name = start + sizeof(Header);
+    segment.features = name;
+    name += segment.features.size() + 1;
+    segment.scoreType = name;
+    name += segment.scoreType.size() + 1;
+    for (uint32_t i = 0; i < header->num_sparse_names; ++i) {
+      segment.sparseNames.push_back(name);
+      name += segment.sparseNames.back().size() + 1;
+    }
+    segment.sentences = reinterpret_cast<const int32_t*>(start + layout.sentences);
+    segment.begins = reinterpret_cast<const uint64_t*>(start + layout.begins);
+    segment.hashes = reinterpret_cast<const uint64_t*>(start + layout.hashes);
+    segment.featureColumns = reinterpret_cast<const float*>(start + layout.features);
+    segment.scoreColumns = reinterpret_cast<const int32_t*>(start + layout.scores);
+    segment.sparseBegins = reinterpret_cast<const uint64_t*>(start + layout.sparseBegins);
+    segment.sparseIds = reinterpret_cast<const uint32_t*>(start + layout.sparseIds);
+    segment.sparseValues = reinterpret_cast<const float*>(start + layout.sparseValues);
+    m_segments.push_back(segment);
+
+    offset += layout.size;
+  }
+}
+
+size_t NBestPool::NumberOfEntries() const
+{
+  size_t entries = 0;
+  for (size_t i = 0; i < m_segments.size(); ++i) {
+    entries += m_segments[i].header->num_entries;
+  }
+  return entries;
+}
+
+size_t NBestPool::Append(const FeatureData& features, const ScoreData& scores,
+                         const string& scoreType, bool allowDuplicates)
+{
+  const string names = features.Features();
+  const size_t num_features = features.NumberOfFeatures();
+  const size_t num_scores = scores.NumberOfScores();
+  if (!m_segments.empty()) {
+    const Segment& last = m_segments.back();
+    if (last.features != names || last.scoreType != scoreType || last.header->num_scores != num_scores) {
+      throw runtime_error("The features or scores do not match those of the n-best pool " + m_file);
+    }
+  }
+
+  vector<int> sentences;
+  for (size_t i = 0; i < features.size(); ++i) {
+    sentences.push_back(features.get(i).getIndex());
+  }
+  sort(sentences.begin(), sentences.end());
+
+  vector<Entry> entries;
+  vector<uint64_t> begins;
+  vector<int32_t> appended;
+
+  typedef boost::unordered_multimap<uint64_t, pair<size_t, uint64_t> > Seen;
+  for (size_t s = 0; s < sentences.size(); ++s) {
+    const int sentence = sentences[s];
+    const FeatureArray& featureArray = features.get(features.getIndex(sentence));
+    if (!scores.exists(sentence) || scores.get(scores.getIndex(sentence)).size() != featureArray.size()) {
+      stringstream msg;
+      msg << "The features and scores of sentence " << sentence << " do not match";
+      throw runtime_error(msg.str());
+    }
+    const ScoreArray& scoreArray = scores.get(scores.getIndex(sentence));
+
+    // earlier entries of the sentence: (segment, row) in the pool, or
+    // (m_segments.size(), index) among the entries to append
+    Seen seen;
+    if (!allowDuplicates) {
+      for (size_t g = 0; g < m_segments.size(); ++g) {
+        uint64_t begin, end;
+        m_segments[g].Find(sentence, begin, end);
+        for (uint64_t row = begin; row < end; ++row) {
+          seen.insert(make_pair(m_segments[g].hashes[row], make_pair(g, row)));
+        }
+      }
+    }
+
+    const size_t first = entries.size();
+    for (size_t k = 0; k < featureArray.size(); ++k) {
+      const FeatureStats& featureStats = featureArray.get(k);
+      const ScoreStats& scoreStats = scoreArray.get(k);
+      if (featureStats.size() != num_features || scoreStats.size() != num_scores) {
+        stringstream msg;
+        msg << "Entry " << k << " of sentence " << sentence << " has the wrong number of features or scores";
+        throw runtime_error(msg.str());
+      }
+      Entry entry = { static_cast<size_t>(features.getIndex(sentence)),
+                      static_cast<size_t>(scores.getIndex(sentence)), k,
+                      HashEntry(featureStats, scoreStats)
+                    };
+
+      bool duplicate = false;
+      pair<Seen::const_iterator, Seen::const_iterator> range = seen.equal_range(entry.hash);
+      for (Seen::const_iterator i = range.first; i != range.second && !duplicate; ++i) {
+        const size_t g = i->second.first;
+        const uint64_t row = i->second.second;
+        if (g == m_segments.size()) {
+          duplicate = featureStats == featureArray.get(row) && scoreStats == scoreArray.get(row);
+          continue;
+        }
+        const Segment& segment = m_segments[g];
+        const uint64_t n = segment.header->num_entries;
+        duplicate = true;
+        for (size_t f = 0; f < num_features && duplicate; ++f) {
+          duplicate = segment.featureColumns[f * n + row] == featureStats.get(f);
+        }
+        for (size_t c = 0; c < num_scores && duplicate; ++c) {
+          duplicate = segment.scoreColumns[c * n + row] == scoreStats.get(c);
+        }
+      }
+      if (duplicate) {
+        continue;
+      }
+      if (!allowDuplicates) {
+        seen.insert(make_pair(entry.hash, make_pair(m_segments.size(), static_cast<uint64_t>(k))));
+      }
+      entries.push_back(entry);
+    }
+    if (entries.size() > first) {
+      appended.push_back(sentence);
+      begins.push_back(first);
+    }
+  }
+  begins.push_back(entries.size());
+
+  // the columns
+  const size_t n = entries.size();
+  vector<uint64_t> hashes(n);
+  vector<float> featureColumns(num_features * n);
+  vector<int32_t> scoreColumns(num_scores * n);
+  vector<uint64_t> sparseBegins;
+  vector<uint32_t> sparseIds;
+  vector<float> sparseValues;
+  vector<string> sparseNames;
+  boost::unordered_map<size_t, uint32_t> sparseIndex; // SparseVector id to local id
+  for (size_t e = 0; e < n; ++e) {
+    const FeatureStats& featureStats = features.get(entries[e].features, entries[e].index);
+    const ScoreStats& scoreStats = scores.get(entries[e].scores, entries[e].index);
+    hashes[e] = entries[e].hash;
+    for (size_t f = 0; f < num_features; ++f) {
+      featureColumns[f * n + e] = featureStats.get(f);
+    }
+    for (size_t c = 0; c < num_scores; ++c) {
+      scoreColumns[c * n + e] = scoreStats.get(c);
+    }
+
+    sparseBegins.push_back(sparseIds.size());
+    const SparseVector& sparse = featureStats.getSparse();
+    const vector<size_t> ids = sparse.feats();
+    for (size_t i = 0; i < ids.size(); ++i) {
+      pair<boost::unordered_map<size_t, uint32_t>::iterator, bool> inserted =
+        sparseIndex.insert(make_pair(ids[i], static_cast<uint32_t>(sparseNames.size())));
+      if (inserted.second) {
+        sparseNames.push_back(SparseVector::decode(ids[i]));
+      }
+      sparseIds.push_back(inserted.first->second);
+      sparseValues.push_back(sparse.get(ids[i]));
+    }
+  }
+  sparseBegins.push_back(sparseIds.size());
+
+  string nameBlock = names;
+  nameBlock.push_back('\0');
+  nameBlock += scoreType;
+  nameBlock.push_back('\0');
+  for (size_t i = 0; i < sparseNames.size(); ++i) {
+    nameBlock += sparseNames[i];
+    nameBlock.push_back('\0');
+  }
+
+  Header header;
+  memcpy(header.magic, kPoolMagic, sizeof(kPoolMagic));
+  header.version = kPoolVersion;
+  header.num_features = num_features;
+  header.num_scores = num_scores;
+  header.num_sentences = appended.size();
+  header.num_sparse_names = sparseNames.size();
+  header.names_size = Align8(nameBlock.size());
+  header.num_entries = n;
+  header.num_sparse = sparseIds.size();
+  header.segment_size = Layout(header).size;
+
+  {
+    ofstream out(m_file.c_str(), ios::out | ios::binary | ios::app);
+    if (!out) {
+      throw runtime_error("Unable to open n-best pool: " + m_file);
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(nameBlock.data(), nameBlock.size());
+    WritePadding(out, nameBlock.size());
+    WriteColumn(out, appended);
+    WriteColumn(out, begins);
+    WriteColumn(out, hashes);
+    WriteColumn(out, featureColumns);
+    WriteColumn(out, scoreColumns);
+    WriteColumn(out, sparseBegins);
+    WriteColumn(out, sparseIds);
+    WriteColumn(out, sparseValues);
+    if (!out) {
+      throw runtime_error("Failed to write n-best pool: " + m_file);
+    }
+  }
+
+  Map();
+  return n;
+}
+
+void NBestPool::Load(FeatureData& features, ScoreData& scores, const SparseVector& sparseWeights) const
+{
+  TRACE_ERR("loading n-best pool from " << m_file << endl);
+  FeatureStats featureStats;
+  ScoreStats scoreStats;
+  for (size_t g = 0; g < m_segments.size(); ++g) {
+    const Segment& segment = m_segments[g];
+    const Header& header = *segment.header;
+    const uint64_t n = header.num_entries;
+    if (!features.existsFeatureNames()) {
+      features.setFeatureMap(segment.features);
+    }
+
+    vector<size_t> sparseIds(segment.sparseNames.size());
+    for (size_t i = 0; i < sparseIds.size(); ++i) {
+      sparseIds[i] = SparseVector::encode(segment.sparseNames[i]);
+    }
+
+    for (uint32_t s = 0; s < header.num_sentences; ++s) {
+      const int sentence = segment.sentences[s];
+      for (uint64_t row = segment.begins[s]; row < segment.begins[s + 1]; ++row) {
+        featureStats.reset();
+        for (size_t f = 0; f < header.num_features; ++f) {
+          featureStats.add(segment.featureColumns[f * n + row]);
+        }
+        if (sparseWeights.size()) {
+          // merge the sparse features, as FeatureStats::set does
+          SparseVector sparse;
+          for (uint64_t i = segment.sparseBegins[row]; i < segment.sparseBegins[row + 1]; ++i) {
+            sparse.set(SparseVector::decode(sparseIds[segment.sparseIds[i]]), segment.sparseValues[i]);
+          }
+          featureStats.add(inner_product(sparseWeights, sparse));
+        } else {
+          for (uint64_t i = segment.sparseBegins[row]; i < segment.sparseBegins[row + 1]; ++i) {
+            featureStats.addSparse(SparseVector::decode(sparseIds[segment.sparseIds[i]]), segment.sparseValues[i]);
+          }
+        }
+        features.add(featureStats, sentence);
+
+        scoreStats.reset();
+        for (size_t c = 0; c < header.num_scores; ++c) {
+          scoreStats.add(segment.scoreColumns[c * n + row]);
+        }
+        scores.add(scoreStats, sentence);
+      }
+    }
+  }
+}
+
+}
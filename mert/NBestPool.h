@@ -0,0 +1,116 @@
+/*
+ *  NBestPool.h
+ *  mert - Minimum Error Rate Training
+ *
+ *  A binary file holding the feature and score statistics of the n-best
+ *  lists of all tuning iterations, which is appended to once per iteration.
+ *
+ */
+
+#ifndef MERT_NBEST_POOL_H_
+#define MERT_NBEST_POOL_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "util/mmap.hh"
+
+#include "FeatureStats.h"
+
+namespace MosesTuning
+{
+
+class FeatureData;
+class ScoreData;
+
+/**
+ * A pool of n-best entries, stored as a sequence of segments. Each call to
+ * Append() writes one segment at the end of the file, holding only the
+ * entries that were not in the pool yet.
+ *
+ * Within a segment the entries are grouped by sentence and stored in
+ * columns: a hash of the statistics of each entry, then one column per
+ * dense feature, one per score statistic and the sparse features as
+ * (name, value) pairs. The file is mmapped, so checking new entries for
+ * duplicates only reads the hash columns of the sentences concerned, and
+ * loading the statistics needs no parsing.
+ */
+class NBestPool
+{
+public:
+  //! maps file if it exists; otherwise the pool is empty
+  explicit NBestPool(const std::string& file);
+
+  //! whether file starts like a pool. Text and gzipped files do not
+  static bool IsPool(const std::string& file);
+
+  std::size_t NumberOfSegments() const {
+    return m_segments.size();
+  }
+
+  std::size_t NumberOfEntries() const;
+
+  /**
+   * Append the entries of features and scores as a new segment.
+   * Unless allowDuplicates, entries with the same features and scores as
+   * an entry of the same sentence, in the pool or earlier in features, are
+   * dropped (as Data::removeDuplicates does).
+   * Returns the number of entries appended.
+   */
+  std::size_t Append(const FeatureData& features, const ScoreData& scores,
+                     const std::string& scoreType, bool allowDuplicates = false);
+
+  //! add every entry of the pool to features and scores
+  void Load(FeatureData& features, ScoreData& scores, const SparseVector& sparseWeights) const;
+
+private:
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_features;
+    uint32_t num_scores;
+    uint32_t num_sentences;
+    uint32_t num_sparse_names;
+    uint32_t names_size;
+    uint64_t num_entries;
+    uint64_t num_sparse;
+    uint64_t segment_size;
+  };
+
+  //! a mapped segment, with pointers to its columns
+  struct Segment {
+    const Header* header;
+    std::string features; // dense feature names, as in FeatureData::Features()
+    std::string scoreType;
+    std::vector<std::string> sparseNames;
+    const int32_t* sentences; // sorted
+    const uint64_t* begins; // first entry of each sentence, and num_entries
+    const uint64_t* hashes;
+    const float* featureColumns; // column f starts at f * num_entries
+    const int32_t* scoreColumns;
+    const uint64_t* sparseBegins;
+    const uint32_t* sparseIds;
+    const float* sparseValues;
+
+    //! range of entries of sentence, empty if the segment has none
+    void Find(int sentence, uint64_t& begin, uint64_t& end) const;
+  };
+
+  //! offsets of the columns of a segment, from its start
+  struct Layout {
+    explicit Layout(const Header& header);
+    uint64_t sentences, begins, hashes, features, scores;
+    uint64_t sparseBegins, sparseIds, sparseValues, size;
+  };
+
+  void Map();
+
+  std::string m_file;
+  util::scoped_memory m_memory;
+  std::vector<Segment> m_segments;
+};
+
+}
+
+#endif  // MERT_NBEST_POOL_H_
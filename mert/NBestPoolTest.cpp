@@ -0,0 +1,99 @@
+#include "NBestPool.h"
+#include "Data.h"
+#include "Scorer.h"
+#include "ScorerFactory.h"
+
+#define BOOST_TEST_MODULE MertNBestPool
+#include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+#include <boost/scoped_ptr.hpp>
+
+using namespace MosesTuning;
+
+namespace
+{
+
+const char kPoolFile[] = "nbest_pool_test.pool";
+
+void AddEntry(Data& data, int sentence, const std::string& features,
+              ScoreStatsType s0, ScoreStatsType s1)
+{
+  if (!data.existsFeatureNames()) {
+    data.InitFeatureMap(features);
+  }
+  data.AddFeatures(features, sentence);
+  std::vector<ScoreStatsType> stats(data.getScorer()->NumberOfScores());
+  stats[0] = s0;
+  stats[1] = s1;
+  ScoreStats entry;
+  entry.set(stats);
+  data.getScoreData()->add(entry, sentence);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(append_and_load)
+{
+  std::remove(kPoolFile);
+  boost::scoped_ptr<Scorer> scorer(ScorerFactory::getScorer("BLEU", ""));
+
+  {
+    Data data(scorer.get());
+    AddEntry(data, 3, "lm= -1 w= -2 WT_a~b= 1 ", 1, 2);
+    AddEntry(data, 3, "lm= -1.5 w= -2 ", 1, 3);
+    AddEntry(data, 1, "lm= -4 w= -1 ", 0, 1);
+    NBestPool pool(kPoolFile);
+    BOOST_CHECK_EQUAL(pool.Append(*data.getFeatureData(), *data.getScoreData(), "BLEU"), 3u);
+  }
+
+  {
+    // the second iteration repeats one entry of sentence 3
+    Data data(scorer.get());
+    AddEntry(data, 3, "lm= -1.5 w= -2 ", 1, 3);
+    AddEntry(data, 3, "lm= -1.5 w= -2 ", 1, 4);
+    AddEntry(data, 2, "lm= -2 w= -3 ", 2, 2);
+    NBestPool pool(kPoolFile);
+    BOOST_CHECK_EQUAL(pool.Append(*data.getFeatureData(), *data.getScoreData(), "BLEU"), 2u);
+    BOOST_CHECK_EQUAL(pool.NumberOfSegments(), 2u);
+    BOOST_CHECK_EQUAL(pool.NumberOfEntries(), 5u);
+  }
+
+  BOOST_CHECK(NBestPool::IsPool(kPoolFile));
+  Data data(scorer.get());
+  data.load(kPoolFile, kPoolFile);
+  FeatureDataHandle features = data.getFeatureData();
+  ScoreDataHandle scores = data.getScoreData();
+  BOOST_CHECK_EQUAL(data.Features(), "lm_0 w_0 ");
+  BOOST_REQUIRE_EQUAL(features->size(), 3u);
+
+  // sentences in order of the segments, and within them by index
+  const FeatureArray& s3 = features->get(features->getIndex(3));
+  BOOST_REQUIRE_EQUAL(s3.size(), 3u);
+  BOOST_CHECK_EQUAL(s3.get(0).get(0), -1.0f);
+  BOOST_CHECK_EQUAL(s3.get(0).getSparse().get("WT_a~b="), 1.0f);
+  BOOST_CHECK_EQUAL(s3.get(1).get(0), -1.5f);
+  BOOST_CHECK_EQUAL(s3.get(2).get(0), -1.5f);
+  BOOST_CHECK_EQUAL(scores->get(scores->getIndex(3)).get(2).get(1), 4);
+  BOOST_CHECK_EQUAL(features->get(features->getIndex(1)).size(), 1u);
+  BOOST_CHECK_EQUAL(features->get(features->getIndex(2)).get(0).get(1), -3.0f);
+  BOOST_CHECK_EQUAL(scores->get(scores->getIndex(2)).get(0).get(0), 2);
+
+  std::remove(kPoolFile);
+}
+
+BOOST_AUTO_TEST_CASE(mismatched_features)
+{
+  std::remove(kPoolFile);
+  boost::scoped_ptr<Scorer> scorer(ScorerFactory::getScorer("BLEU", ""));
+  {
+    Data data(scorer.get());
+    AddEntry(data, 0, "lm= -1 w= -2 ", 1, 2);
+    NBestPool(kPoolFile).Append(*data.getFeatureData(), *data.getScoreData(), "BLEU");
+  }
+  Data data(scorer.get());
+  AddEntry(data, 0, "lm= -1 ", 1, 2);
+  NBestPool pool(kPoolFile);
+  BOOST_CHECK_THROW(pool.Append(*data.getFeatureData(), *data.getScoreData(), "BLEU"), std::runtime_error);
+  std::remove(kPoolFile);
+}
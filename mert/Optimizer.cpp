@@ -4,15 +4,18 @@
 #include "util/check.hh"
 #include <vector>
 #include <limits>
-#include <map>
+#include <algorithm>
 #include <cfloat>
 #include <iostream>
 #include <stdint.h>
 
 #include "Point.h"
 #include "Util.h"
+#include "moses/ThreadPool.h"
 
 using namespace std;
+using namespace MosesTuning;
+using Moses::TaskGroup;
 
 static const float MIN_FLOAT = -1.0 * numeric_limits<float>::max();
 static const float MAX_FLOAT = numeric_limits<float>::max();
@@ -32,6 +35,189 @@ inline float intersect(float m1, float b1, float m2, float b2)
   return isect;
 }
 
+/**
+ * Require that the intersection points of a sentence be at least kMinInterval apart.
+ */
+const float kMinInterval = 0.0001;
+
+/**
+ * Number of sentences whose envelopes are computed by one task.
+ */
+const unsigned kSentencesPerTask = 64;
+
+/**
+ * A change of the 1best of a sentence at position x on the line.
+ */
+struct ThresholdEntry {
+  float x;
+  unsigned sentence;
+  unsigned best;
+};
+
+inline bool ThresholdLess(const ThresholdEntry& a, const ThresholdEntry& b)
+{
+  return a.x < b.x;
+}
+
+inline bool GradientLess(const pair<float,unsigned>& a, const pair<float,unsigned>& b)
+{
+  return a.first < b.first;
+}
+
+/**
+ * Compute the upper envelope of the lines of the nbest list of sentence S,
+ * appending to thresholds the points where its 1best changes.
+ */
+void ComputeEnvelope(const FeatureArray& nbest, const Point& origin, const Point& direction,
+                     unsigned S, unsigned& first1best, vector<ThresholdEntry>& thresholds)
+{
+  // First, we determine the translation with the best feature score
+  // for each sentence and each value of x.
+  // The candidates are sorted by gradient, keeping nbest order among equal
+  // gradients; the gradients and f0 are then scanned as contiguous arrays.
+  const size_t n = nbest.size();
+  vector<pair<float,unsigned> > gradient(n);
+  vector<float> f0(n);
+  for (unsigned j = 0; j < n; j++) {
+    // gradient of the feature function for this particular target sentence
+    gradient[j] = pair<float,unsigned>(direction * nbest.get(j), j);
+    // compute the feature function at the origin point
+    f0[j] = origin * nbest.get(j);
+  }
+  stable_sort(gradient.begin(), gradient.end(), GradientLess);
+  vector<float> m(n), b(n);
+  for (size_t i = 0; i < n; i++) {
+    m[i] = gradient[i].first;
+    b[i] = f0[gradient[i].second];
+  }
+
+  // Now let's compute the 1best for each value of x.
+  // Several candidates can have the lowest slope (e.g., for word penalty where the gradient is an integer).
+  size_t highest_f0 = 0;
+  for (size_t i = 1; i < n && m[i] == m[0]; i++) {
+    if (b[i] > b[highest_f0])
+      highest_f0 = i;//the highest line is the one with he highest f0
+  }
+  first1best = gradient[highest_f0].second;
+
+  // Now we look for the intersections points indicating a change of 1 best.
+  // We use the fact that the function is convex, which means that the gradient can only go up.
+  const size_t first = thresholds.size();
+  size_t current = highest_f0;
+  while (true) {
+    size_t leftmost = current;
+    float leftmostx = MAX_FLOAT;
+    for (size_t i = current + 1; i < n; i++) {
+      // Look for all candidate with a gradient bigger than the current one, and
+      // find the one with the leftmost intersection.
+      if (m[current] != m[i]) {
+        float curintersect = intersect(m[current], b[current], m[i], b[i]);
+        if (curintersect <= leftmostx) {
+          // We have found an intersection to the left of the leftmost we had so far.
+          // We might have curintersect==leftmostx for example is 2 candidates are the same
+          // in that case its better its better to update leftmost to i to avoid some recomputing later.
+          leftmostx = curintersect;
+          leftmost = i; // this is the new reference
+        }
+      }
+    }
+    if (leftmost == current) {
+      // We didn't find any more intersections.
+      // The rightmost bestindex is the one with the highest slope.
+
+      // They should be equal but there might be.
+      CHECK(abs(m[leftmost] - m[n - 1]) < 0.0001);
+      // A small difference due to rounding error
+      break;
+    }
+    // We have found the next intersection!
+    ThresholdEntry newt = { leftmostx, S, gradient[leftmost].second }; //new onebest for Sentence S
+
+    if (thresholds.size() > first && leftmostx - thresholds.back().x < kMinInterval) {
+      // Require that the intersection Point be at least kMinInterval to the right of the previous
+      // one (for this sentence). If not, we replace the previous intersection Point with
+      // this one.
+      // Yes, it can even happen that the new intersection Point is slightly to the left of
+      // the old one, because of numerical imprecision. We do not check that we are to the
+      // right of the penultimate point also. It this happen the 1best the interval will
+      // be wrong we are going to replace the previous one by the new one because we do not want to keep
+      // 2 very close threshold: if the minima is there it could be an artifact.
+      thresholds.back() = newt;
+    } else {
+      thresholds.push_back(newt);
+    }
+    current = leftmost;
+  }
+}
+
+/**
+ * Computes the envelopes of a range of sentences, and sorts their thresholds.
+ */
+class EnvelopeTask : public Moses::Task
+{
+public:
+  EnvelopeTask(const FeatureData& data, const Point& origin, const Point& direction,
+               unsigned begin, unsigned end, vector<unsigned>& first1best,
+               vector<ThresholdEntry>& thresholds)
+    : m_data(data), m_origin(origin), m_direction(direction),
+      m_begin(begin), m_end(end), m_first1best(first1best), m_thresholds(thresholds) {}
+
+  virtual void Run() {
+    for (unsigned S = m_begin; S < m_end; S++) {
+      ComputeEnvelope(m_data.get(S), m_origin, m_direction, S, m_first1best[S], m_thresholds);
+    }
+    // stable, so that sentences stay in order at equal thresholds
+    stable_sort(m_thresholds.begin(), m_thresholds.end(), ThresholdLess);
+  }
+
+private:
+  const FeatureData& m_data;
+  const Point& m_origin;
+  const Point& m_direction;
+  unsigned m_begin;
+  unsigned m_end;
+  vector<unsigned>& m_first1best;
+  vector<ThresholdEntry>& m_thresholds;
+};
+
+/**
+ * Merges two sorted runs into the first one.
+ */
+class MergeTask : public Moses::Task
+{
+public:
+  MergeTask(vector<ThresholdEntry>& left, vector<ThresholdEntry>& right)
+    : m_left(left), m_right(right) {}
+
+  virtual void Run() {
+    const size_t middle = m_left.size();
+    m_left.insert(m_left.end(), m_right.begin(), m_right.end());
+    inplace_merge(m_left.begin(), m_left.begin() + middle, m_left.end(), ThresholdLess);
+    vector<ThresholdEntry>().swap(m_right);
+  }
+
+private:
+  vector<ThresholdEntry>& m_left;
+  vector<ThresholdEntry>& m_right;
+};
+
+/**
+ * Merges sorted runs of consecutive sentences pairwise, in parallel, into
+ * entries. Entries at equal thresholds stay in sentence order.
+ */
+void MergeRuns(vector<vector<ThresholdEntry> >& runs, vector<ThresholdEntry>& entries)
+{
+  for (size_t step = 1; step < runs.size(); step *= 2) {
+    TaskGroup group;
+    for (size_t r = 0; r + step < runs.size(); r += 2 * step) {
+      group.Spawn(new MergeTask(runs[r], runs[r + step]));
+    }
+  }
+  if (!runs.empty()) {
+    entries.swap(runs[0]);
+  }
+}
+
 } // namespace
 
 namespace MosesTuning
@@ -71,187 +257,70 @@ statscore_t Optimizer::GetStatScore(const Point& param) const
   return score;
 }
 
-map<float,diff_t >::iterator AddThreshold(map<float,diff_t >& thresholdmap, float newt, const pair<unsigned,unsigned>& newdiff)
-{
-  map<float,diff_t>::iterator it = thresholdmap.find(newt);
-  if (it != thresholdmap.end()) {
-    // the threshold already exists!! this is very unlikely
-    if (it->second.back().first == newdiff.first)
-      // there was already a diff for this sentence, we change the 1 best;
-      it->second.back().second = newdiff.second;
-    else
-      it->second.push_back(newdiff);
-  } else {
-    // normal case
-    pair<map<float,diff_t>::iterator, bool> ins = thresholdmap.insert(threshold(newt, diff_t(1, newdiff)));
-    CHECK(ins.second);                // we really inserted something
-    it = ins.first;
-  }
-  return it;
-}
-
 statscore_t Optimizer::LineOptimize(const Point& origin, const Point& direction, Point& bestpoint) const
 {
-  // We are looking for the best Point on the line y=Origin+x*direction
-  float min_int = 0.0001;
-  //typedef pair<unsigned,unsigned> diff;//first the sentence that changes, second is the new 1best for this sentence
-  //list<threshold> thresholdlist;
-
-  map<float,diff_t> thresholdmap;
-  thresholdmap[MIN_FLOAT] = diff_t();
-  vector<unsigned> first1best;       // the vector of nbests for x=-inf
-  for (unsigned int S = 0; S < size(); S++) {
-    map<float,diff_t >::iterator previnserted = thresholdmap.begin();
-    // First, we determine the translation with the best feature score
-    // for each sentence and each value of x.
-    //cerr << "Sentence " << S << endl;
-    multimap<float, unsigned> gradient;
-    vector<float> f0;
-    f0.resize(m_feature_data->get(S).size());
-    for (unsigned j = 0; j < m_feature_data->get(S).size(); j++) {
-      // gradient of the feature function for this particular target sentence
-      gradient.insert(pair<float, unsigned>(direction * (m_feature_data->get(S,j)), j));
-      // compute the feature function at the origin point
-      f0[j] = origin * m_feature_data->get(S, j);
-    }
-    // Now let's compute the 1best for each value of x.
-
-    //    vector<pair<float,unsigned> > onebest;
-
-
-    multimap<float,unsigned>::iterator gradientit = gradient.begin();
-    multimap<float,unsigned>::iterator highest_f0 = gradient.begin();
-
-    float smallest = gradientit->first;//smallest gradient
-    // Several candidates can have the lowest slope (e.g., for word penalty where the gradient is an integer).
-
-    gradientit++;
-    while (gradientit != gradient.end() && gradientit->first == smallest) {
-      //   cerr<<"ni"<<gradientit->second<<endl;;
-      //cerr<<"fos"<<f0[gradientit->second]<<" "<<f0[index]<<" "<<index<<endl;
-      if (f0[gradientit->second] > f0[highest_f0->second])
-        highest_f0 = gradientit;//the highest line is the one with he highest f0
-      gradientit++;
+  // We are looking for the best Point on the line y=Origin+x*direction.
+  // The envelopes of the sentences are computed in parallel, each task
+  // sorting the thresholds of its sentences; the sorted runs are then merged.
+  vector<unsigned> first1best(size());       // the vector of nbests for x=-inf
+  vector<vector<ThresholdEntry> > runs((size() + kSentencesPerTask - 1) / kSentencesPerTask);
+  {
+    TaskGroup group;
+    for (size_t r = 0; r < runs.size(); ++r) {
+      const unsigned begin = r * kSentencesPerTask;
+      const unsigned end = min<unsigned>(begin + kSentencesPerTask, size());
+      group.Spawn(new EnvelopeTask(*m_feature_data, origin, direction, begin, end, first1best, runs[r]));
     }
+  }
+  vector<ThresholdEntry> entries;
+  MergeRuns(runs, entries);
 
-    gradientit = highest_f0;
-    first1best.push_back(highest_f0->second);
-
-    // Now we look for the intersections points indicating a change of 1 best.
-    // We use the fact that the function is convex, which means that the gradient can only go up.
-    while (gradientit != gradient.end()) {
-      map<float,unsigned>::iterator leftmost = gradientit;
-      float m = gradientit->first;
-      float b = f0[gradientit->second];
-      multimap<float,unsigned>::iterator gradientit2 = gradientit;
-      gradientit2++;
-      float leftmostx = MAX_FLOAT;
-      for (; gradientit2 != gradient.end(); gradientit2++) {
-        //cerr<<"--"<<d++<<' '<<gradientit2->first<<' '<<gradientit2->second<<endl;
-        // Look for all candidate with a gradient bigger than the current one, and
-        // find the one with the leftmost intersection.
-        float curintersect;
-        if (m != gradientit2->first) {
-          curintersect = intersect(m, b, gradientit2->first, f0[gradientit2->second]);
-          //cerr << "curintersect: " << curintersect << " leftmostx: " << leftmostx << endl;
-          if (curintersect<=leftmostx) {
-            // We have found an intersection to the left of the leftmost we had so far.
-            // We might have curintersect==leftmostx for example is 2 candidates are the same
-            // in that case its better its better to update leftmost to gradientit2 to avoid some recomputing later.
-            leftmostx = curintersect;
-            leftmost = gradientit2; // this is the new reference
-          }
-        }
-      }
-      if (leftmost == gradientit) {
-        // We didn't find any more intersections.
-        // The rightmost bestindex is the one with the highest slope.
-
-        // They should be equal but there might be.
-        CHECK(abs(leftmost->first-gradient.rbegin()->first) < 0.0001);
-        // A small difference due to rounding error
-        break;
-      }
-      // We have found the next intersection!
-
-      pair<unsigned,unsigned> newd(S, leftmost->second);//new onebest for Sentence S is leftmost->second
-
-      if (leftmostx-previnserted->first < min_int) {
-        // Require that the intersection Point be at least min_int to the right of the previous
-        // one (for this sentence). If not, we replace the previous intersection Point with
-        // this one.
-        // Yes, it can even happen that the new intersection Point is slightly to the left of
-        // the old one, because of numerical imprecision. We do not check that we are to the
-        // right of the penultimate point also. It this happen the 1best the interval will
-        // be wrong we are going to replace previnsert by the new one because we do not want to keep
-        // 2 very close threshold: if the minima is there it could be an artifact.
-
-        map<float,diff_t>::iterator tit = thresholdmap.find(leftmostx);
-        if (tit == previnserted) {
-          // The threshold is the same as before can happen if 2 candidates are the same for example.
-          CHECK(previnserted->second.back().first == newd.first);
-          previnserted->second.back()=newd; // just replace the 1 best for sentence S
-          // previnsert doesn't change
-        } else {
-
-          if (tit == thresholdmap.end()) {
-            thresholdmap[leftmostx]=previnserted->second; // We keep the diffs at previnsert
-            thresholdmap.erase(previnserted); // erase old previnsert
-            previnserted = thresholdmap.find(leftmostx); // point previnsert to the new threshold
-            previnserted->second.back()=newd; // We update the diff for sentence S
-            // Threshold already exists but is not the previous one.
-          } else {
-            // We append the diffs in previnsert to tit before destroying previnsert.
-            tit->second.insert(tit->second.end(),previnserted->second.begin(),previnserted->second.end());
-            CHECK(tit->second.back().first == newd.first);
-            tit->second.back()=newd;    // change diff for sentence S
-            thresholdmap.erase(previnserted); // erase old previnsert
-            previnserted = tit;  // point previnsert to the new threshold
-          }
-        }
-
-        CHECK(previnserted != thresholdmap.end());
-      } else { //normal insertion process
-        previnserted = AddThreshold(thresholdmap, leftmostx, newd);
-      }
-      gradientit = leftmost;
-    } // while (gradientit!=gradient.end()){
-  }   // loop on S
-
-  // Now the thresholdlist is up to date: it contains a list of all the parameter_ts where
+  // Now the thresholds are sorted: group them into a list of all the parameter_ts where
   // the function changed its value, along with the nbest list for the interval after each threshold.
+  // Entries at the same threshold are kept in sentence order.
+  vector<float> thresholds(1, MIN_FLOAT); // first diff corrrespond to MIN_FLOAT and first1best
+  diffs_t diffs;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const pair<unsigned,unsigned> newd(entries[i].sentence, entries[i].best);
+    if (!diffs.empty() && entries[i].x == thresholds.back()) {
+      // the threshold already exists!! this is very unlikely
+      if (diffs.back().back().first == newd.first)
+        // there was already a diff for this sentence, we change the 1 best;
+        diffs.back().back().second = newd.second;
+      else
+        diffs.back().push_back(newd);
+    } else {
+      thresholds.push_back(entries[i].x);
+      diffs.push_back(diff_t(1, newd));
+    }
+  }
 
-  map<float,diff_t >::iterator thrit;
   if (verboselevel() > 6) {
-    cerr << "Thresholds:(" << thresholdmap.size() << ")" << endl;
-    for (thrit = thresholdmap.begin(); thrit != thresholdmap.end(); thrit++) {
-      cerr << "x: " << thrit->first << " diffs";
-      for (size_t j = 0; j < thrit->second.size(); ++j) {
-        cerr << " " <<thrit->second[j].first << "," << thrit->second[j].second;
+    cerr << "Thresholds:(" << thresholds.size() << ")" << endl;
+    for (size_t i = 0; i < thresholds.size(); ++i) {
+      cerr << "x: " << thresholds[i] << " diffs";
+      if (i > 0) {
+        for (size_t j = 0; j < diffs[i-1].size(); ++j) {
+          cerr << " " << diffs[i-1][j].first << "," << diffs[i-1][j].second;
+        }
       }
       cerr << endl;
     }
   }
 
   // Last thing to do is compute the Stat score (i.e., BLEU) and find the minimum.
-  thrit = thresholdmap.begin();
-  ++thrit;       // first diff corrrespond to MIN_FLOAT and first1best
-  diffs_t diffs;
-  for (; thrit != thresholdmap.end(); thrit++)
-    diffs.push_back(thrit->second);
   vector<statscore_t> scores = GetIncStatScore(first1best, diffs);
 
-  thrit = thresholdmap.begin();
   statscore_t bestscore = MIN_FLOAT;
   float bestx = MIN_FLOAT;
 
-  // We skipped the first el of thresholdlist but GetIncStatScore return 1 more for first1best.
-  CHECK(scores.size() == thresholdmap.size());
+  // We skipped the first threshold but GetIncStatScore return 1 more for first1best.
+  CHECK(scores.size() == thresholds.size());
   for (unsigned int sc = 0; sc != scores.size(); sc++) {
-    //cerr << "x=" << thrit->first << " => " << scores[sc] << endl;
+    //cerr << "x=" << thresholds[sc] << " => " << scores[sc] << endl;
 
     //enforce positivity
-    Point respoint = origin + direction * thrit->first;
+    Point respoint = origin + direction * thresholds[sc];
     bool is_valid = true;
     for (unsigned int k=0; k < respoint.getdim(); k++) {
       if (m_positive[k] && respoint[k] <= 0.0)
@@ -259,9 +328,9 @@ statscore_t Optimizer::LineOptimize(const Point& origin, const Point& direction,
     }
 
     if (is_valid && scores[sc] > bestscore) {
-      // This is the score for the interval [lit2->first, (lit2+1)->first]
+      // This is the score for the interval [thresholds[sc], thresholds[sc+1]]
       // unless we're at the last score, when it's the score
-      // for the interval [lit2->first,+inf].
+      // for the interval [thresholds[sc],+inf].
       bestscore = scores[sc];
 
       // If we're not in [-inf,x1] or [xn,+inf], then just take the value
@@ -269,16 +338,8 @@ statscore_t Optimizer::LineOptimize(const Point& origin, const Point& direction,
       // take x to be the last interval boundary + 0.1, and for the leftmost
       // interval, take x to be the first interval boundary - 1000.
       // These values are taken from cmert.
-      float leftx = thrit->first;
-      if (thrit == thresholdmap.begin()) {
-        leftx = MIN_FLOAT;
-      }
-      ++thrit;
-      float rightx = MAX_FLOAT;
-      if (thrit != thresholdmap.end()) {
-        rightx = thrit->first;
-      }
-      --thrit;
+      float leftx = (sc == 0) ? MIN_FLOAT : thresholds[sc];
+      float rightx = (sc + 1 < thresholds.size()) ? thresholds[sc + 1] : MAX_FLOAT;
       //cerr << "leftx: " << leftx << " rightx: " << rightx << endl;
       if (leftx == MIN_FLOAT) {
         bestx = rightx-1000;
@@ -289,7 +350,6 @@ statscore_t Optimizer::LineOptimize(const Point& origin, const Point& direction,
       }
       //cerr << "x = " << "set new bestx to: " << bestx << endl;
     }
-    ++thrit;
   }
 
   if (abs(bestx) < 0.00015) {
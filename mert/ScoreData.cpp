@@ -91,8 +91,10 @@ void ScoreData::add(ScoreArray& e)
     size_t pos = getIndex(e.getIndex());
     m_array.at(pos).merge(e);
   } else {
+    const size_t idx = m_array.size();
     m_array.push_back(e);
-    setIndex();
+    m_index_to_array_name[idx] = e.getIndex();
+    m_array_name_to_index[e.getIndex()] = idx;
   }
 }
 
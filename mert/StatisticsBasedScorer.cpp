@@ -69,7 +69,7 @@ void  StatisticsBasedScorer::score(const candidates_t& candidates, const diffs_t
   int numCounts = m_score_data->get(0,candidates[0]).size();
   vector<int> totals(numCounts);
   for (size_t i = 0; i < candidates.size(); ++i) {
-    ScoreStats stats = m_score_data->get(i,candidates[i]);
+    const ScoreStats& stats = m_score_data->get(i,candidates[i]);
     if (stats.size() != totals.size()) {
       stringstream msg;
       msg << "Statistics for (" << "," << candidates[i] << ") have incorrect "
@@ -85,15 +85,19 @@ void  StatisticsBasedScorer::score(const candidates_t& candidates, const diffs_t
 
   candidates_t last_candidates(candidates);
   // apply each of the diffs, and get new scores
+  // (on the raw statistics arrays, so that the inner loop can be vectorized)
+  const size_t numTotals = totals.size();
+  int *total = &totals[0];
   for (size_t i = 0; i < diffs.size(); ++i) {
     for (size_t j = 0; j < diffs[i].size(); ++j) {
       size_t sid = diffs[i][j].first;
       size_t nid = diffs[i][j].second;
       size_t last_nid = last_candidates[sid];
-      for (size_t k  = 0; k < totals.size(); ++k) {
-        int diff = m_score_data->get(sid,nid).get(k)
-                   - m_score_data->get(sid,last_nid).get(k);
-        totals[k] += diff;
+      const ScoreArray& nbest = m_score_data->get(sid);
+      const ScoreStatsType *next = nbest.get(nid).getArray();
+      const ScoreStatsType *last = nbest.get(last_nid).getArray();
+      for (size_t k  = 0; k < numTotals; ++k) {
+        total[k] += next[k] - last[k];
       }
       last_candidates[sid] = nid;
     }
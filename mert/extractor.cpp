@@ -12,6 +12,7 @@
 #include <boost/scoped_ptr.hpp>
 
 #include "Data.h"
+#include "NBestPool.h"
 #include "Scorer.h"
 #include "ScorerFactory.h"
 #include "Timer.h"
@@ -36,6 +37,8 @@ void usage()
   cerr << "[--ffile|-F] the feature data output file" << endl;
   cerr << "[--prev-ffile|-E] comma separated list of previous feature data" << endl;
   cerr << "[--prev-scfile|-R] comma separated list of previous scorer data" << endl;
+  cerr << "[--pool|-P] append the new entries to this n-best pool instead of" << endl;
+  cerr << "\twriting the feature and scorer data files" << endl;
   cerr << "[--factors|-f] list of factors passed to the scorer (e.g. 0|2)" << endl;
   cerr << "[--filter|-l] filter command used to preprocess the sentences" << endl;
   cerr << "[--allow-duplicates|-d] omit the duplicate removal step" << endl;
@@ -56,6 +59,7 @@ static struct option long_options[] = {
   {"ffile", required_argument, 0, 'F'},
   {"prev-scfile", required_argument, 0, 'R'},
   {"prev-ffile", required_argument, 0, 'E'},
+  {"pool", required_argument, 0, 'P'},
   {"verbose", required_argument, 0, 'v'},
   {"help", no_argument, 0, 'h'},
   {"allow-duplicates", no_argument, 0, 'd'},
@@ -74,6 +78,7 @@ struct ProgramOption {
   string featureDataFile;
   string prevScoreDataFile;
   string prevFeatureDataFile;
+  string poolFile;
   bool binmode;
   bool allowDuplicates;
   int verbosity;
@@ -89,6 +94,7 @@ struct ProgramOption {
       featureDataFile("features.data"),
       prevScoreDataFile(""),
       prevFeatureDataFile(""),
+      poolFile(""),
       binmode(false),
       allowDuplicates(false),
       verbosity(0) { }
@@ -99,7 +105,7 @@ void ParseCommandOptions(int argc, char** argv, ProgramOption* opt)
   int c;
   int option_index;
 
-  while ((c = getopt_long(argc, argv, "s:r:f:l:n:S:F:R:E:v:hbd", long_options, &option_index)) != -1) {
+  while ((c = getopt_long(argc, argv, "s:r:f:l:n:S:F:R:E:P:v:hbd", long_options, &option_index)) != -1) {
     switch (c) {
     case 's':
       opt->scorerType = string(optarg);
@@ -134,6 +140,9 @@ void ParseCommandOptions(int argc, char** argv, ProgramOption* opt)
     case 'R':
       opt->prevScoreDataFile = string(optarg);
       break;
+    case 'P':
+      opt->poolFile = string(optarg);
+      break;
     case 'v':
       opt->verbosity = atoi(optarg);
       break;
@@ -232,6 +241,16 @@ int main(int argc, char** argv)
 
 //    PrintUserTime("Nbest entries loaded and scored");
 
+    if (option.poolFile.length() > 0) {
+      // only the entries that are new to the pool are written
+      NBestPool pool(option.poolFile);
+      size_t appended = pool.Append(*data.getFeatureData(), *data.getScoreData(),
+                                    scorer->getName(), option.allowDuplicates);
+      TRACE_ERR("Appended " << appended << " entries to " << option.poolFile << endl);
+      PrintUserTime("Stopping...");
+      return EXIT_SUCCESS;
+    }
+
     //ADDED_BY_TS
     if (!option.allowDuplicates) {
       data.removeDuplicates();
@@ -31,6 +31,7 @@ de recherches du Canada
 #include <ctime>
 #include <cassert>
 #include <iostream>
+#include <limits>
 #include <string>
 #include <vector>
 #include <utility>
@@ -39,6 +40,8 @@ de recherches du Canada
 #include <boost/program_options.hpp>
 #include <boost/scoped_ptr.hpp>
 
+#include "moses/ThreadPool.h"
+
 #include "BleuScorer.h"
 #include "HypPackEnumerator.h"
 #include "MiraFeatureVector.h"
@@ -49,25 +52,183 @@ using namespace MosesTuning;
 
 namespace po = boost::program_options;
 
-ValType evaluate(HypPackEnumerator* train, const AvgWeightVector& wv)
+namespace
+{
+
+const ValType BLEU_RATIO = 5;
+
+//! sentences per task when evaluating
+const size_t kSentencesPerTask = 64;
+
+/**
+ * The hypotheses of one sentence, pointing into the enumerator. When
+ * streaming they are only valid until the enumerator moves on.
+ */
+struct HypPack {
+  size_t id;
+  vector<const MiraFeatureVector*> features;
+  vector<const ScoreDataItem*> scores;
+};
+
+/**
+ * Read up to batchSize packs from the current one on, leaving the
+ * enumerator on the last pack read (or finished).
+ */
+void readBatch(HypPackEnumerator* train, size_t batchSize, vector<HypPack>& batch)
+{
+  batch.clear();
+  while(true) {
+    batch.push_back(HypPack());
+    HypPack& pack = batch.back();
+    pack.id = train->cur_id();
+    for(size_t i=0; i<train->cur_size(); i++) {
+      pack.features.push_back(&train->featuresAt(i));
+      pack.scores.push_back(&train->scoresAt(i));
+    }
+    if(batch.size() >= batchSize) return;
+    train->next();
+    if(train->finished()) return;
+  }
+}
+
+/**
+ * Adds the scores of the model best hypotheses of a range of packs to stats
+ */
+class EvaluateTask : public Moses::Task
+{
+public:
+  EvaluateTask(const vector<HypPack>& batch, size_t begin, size_t end,
+               const AvgWeightVector& wv, vector<ValType>& stats)
+    : m_batch(batch), m_begin(begin), m_end(end), m_wv(wv), m_stats(stats) {}
+
+  virtual void Run() {
+    for(size_t s=m_begin; s<m_end; s++) {
+      const HypPack& pack = m_batch[s];
+      // Find max model
+      size_t max_index=0;
+      ValType max_score=0;
+      for(size_t i=0; i<pack.features.size(); i++) {
+        ValType score = m_wv.score(*pack.features[i]);
+        if(i==0 || score > max_score) {
+          max_index = i;
+          max_score = score;
+        }
+      }
+      // Update stats
+      const vector<float>& sent = *pack.scores[max_index];
+      for(size_t i=0; i<sent.size(); i++) {
+        m_stats[i]+=sent[i];
+      }
+    }
+  }
+
+private:
+  const vector<HypPack>& m_batch;
+  size_t m_begin, m_end;
+  const AvgWeightVector& m_wv;
+  vector<ValType>& m_stats;
+};
+
+/**
+ * The hope, fear and model best hypotheses of a sentence
+ */
+struct HopeFear {
+  size_t hope_index, fear_index, model_index;
+  ValType hope_scale;
+  ValType hopeBleu, fearBleu;
+  int numHyps;
+};
+
+/**
+ * Hope / fear decodes a sentence, against weights and a background corpus
+ * that do not change while the task runs.
+ */
+class HopeFearTask : public Moses::Task
+{
+public:
+  HopeFearTask(const HypPack& pack, const MiraWeightVector& wv, const vector<ValType>& bg,
+               bool safe_hope, HopeFear& result)
+    : m_pack(pack), m_wv(wv), m_bg(bg), m_safe_hope(safe_hope), m_result(result) {}
+
+  virtual void Run() {
+    ValType hope_scale = 1.0;
+    size_t hope_index=0, fear_index=0, model_index=0;
+    ValType hope_score=0, fear_score=0, model_score=0;
+    for(size_t safe_loop=0; safe_loop<2; safe_loop++) {
+      ValType hope_bleu, hope_model;
+      for(size_t i=0; i< m_pack.features.size(); i++) {
+        const MiraFeatureVector& vec=*m_pack.features[i];
+        ValType score = m_wv.score(vec);
+        ValType bleu = sentenceLevelBackgroundBleu(*m_pack.scores[i],m_bg);
+        // Hope
+        if(i==0 || (hope_scale*score + bleu) > hope_score) {
+          hope_score = hope_scale*score + bleu;
+          hope_index = i;
+          hope_bleu = bleu;
+          hope_model = score;
+        }
+        // Fear
+        if(i==0 || (score - bleu) > fear_score) {
+          fear_score = score - bleu;
+          fear_index = i;
+        }
+        // Model
+        if(i==0 || score > model_score) {
+          model_score = score;
+          model_index = i;
+        }
+      }
+      // Outer loop rescales the contribution of model score to 'hope' in antagonistic cases
+      // where model score is having far more influence than BLEU
+      hope_bleu *= BLEU_RATIO; // We only care about cases where model has MUCH more influence than BLEU
+      if(m_safe_hope && safe_loop==0 && abs(hope_model)>1e-8 && abs(hope_bleu)/abs(hope_model)<hope_scale)
+        hope_scale = abs(hope_bleu) / abs(hope_model);
+      else break;
+    }
+    m_result.hope_index = hope_index;
+    m_result.fear_index = fear_index;
+    m_result.model_index = model_index;
+    m_result.hope_scale = hope_scale;
+    m_result.numHyps = m_pack.features.size();
+    // Bleu difference
+    m_result.hopeBleu = sentenceLevelBackgroundBleu(*m_pack.scores[hope_index], m_bg);
+    m_result.fearBleu = sentenceLevelBackgroundBleu(*m_pack.scores[fear_index], m_bg);
+    assert(hope_index==fear_index || m_result.hopeBleu + 1e-8 >= m_result.fearBleu);
+  }
+
+private:
+  const HypPack& m_pack;
+  const MiraWeightVector& m_wv;
+  const vector<ValType>& m_bg;
+  bool m_safe_hope;
+  HopeFear& m_result;
+};
+
+} // namespace
+
+/**
+ * BLEU of the model best hypotheses. Unless streaming, the sentences are
+ * scored in parallel and their statistics summed in order.
+ */
+ValType evaluate(HypPackEnumerator* train, const AvgWeightVector& wv, bool streaming, Moses::ThreadPool* pool)
 {
   vector<ValType> stats(kBleuNgramOrder*2+1,0);
+  vector<HypPack> batch;
   for(train->reset(); !train->finished(); train->next()) {
-    // Find max model
-    size_t max_index=0;
-    ValType max_score=0;
-    for(size_t i=0; i<train->cur_size(); i++) {
-      MiraFeatureVector vec(train->featuresAt(i));
-      ValType score = wv.score(vec);
-      if(i==0 || score > max_score) {
-        max_index = i;
-        max_score = score;
+    readBatch(train, streaming ? 1 : numeric_limits<size_t>::max(), batch);
+    const size_t tasks = (batch.size() + kSentencesPerTask - 1) / kSentencesPerTask;
+    vector<vector<ValType> > taskStats(tasks, vector<ValType>(stats.size(), 0));
+    {
+      Moses::TaskGroup group(pool);
+      for(size_t t=0; t<tasks; t++) {
+        const size_t begin = t * kSentencesPerTask;
+        group.Spawn(new EvaluateTask(batch, begin, min(begin + kSentencesPerTask, batch.size()), wv, taskStats[t]));
       }
     }
-    // Update stats
-    const vector<float>& sent = train->scoresAt(max_index);
-    for(size_t i=0; i<sent.size(); i++) {
-      stats[i]+=sent[i];
+    for(size_t t=0; t<tasks; t++) {
+      for(size_t i=0; i<stats.size(); i++) {
+        stats[i]+=taskStats[t][i];
+      }
     }
   }
   return unsmoothedBleu(stats);
@@ -75,7 +236,6 @@ ValType evaluate(HypPackEnumerator* train, const AvgWeightVector& wv)
 
 int main(int argc, char** argv)
 {
-  const ValType BLEU_RATIO = 5;
   bool help;
   string denseInitFile;
   string sparseInitFile;
@@ -91,6 +251,8 @@ int main(int argc, char** argv)
   bool model_bg = false; // Use model for background corpus
   bool verbose = false; // Verbose updates
   bool safe_hope = false; // Model score cannot have more than BLEU_RATIO times more influence than BLEU
+  size_t batch_size = 1; // Sentences decoded against the same weights
+  size_t threads = 1;
 
   // Command-line processing follows pro.cpp
   po::options_description desc("Allowed options");
@@ -110,7 +272,13 @@ int main(int argc, char** argv)
   ("model-bg", po::value(&model_bg)->zero_tokens()->default_value(false), "Use model instead of hope for BLEU background")
   ("verbose", po::value(&verbose)->zero_tokens()->default_value(false), "Verbose updates")
   ("safe-hope", po::value(&safe_hope)->zero_tokens()->default_value(false), "Mode score's influence on hope decoding is limited")
+  ("batch-size,b", po::value<size_t>(&batch_size), "Number of sentences hope / fear decoded in parallel, against the same weights, before their updates are applied in order (default 1)")
   ;
+#ifdef WITH_THREADS
+  desc.add_options()
+  ("threads,T", po::value<size_t>(&threads), "Number of threads (default 1)")
+  ;
+#endif
 
   po::options_description cmdline_options;
   cmdline_options.add(desc);
@@ -126,6 +294,18 @@ int main(int argc, char** argv)
 
   cerr << "kbmira with c=" << c << " decay=" << decay << " no_shuffle=" << no_shuffle << endl;
 
+  if (batch_size < 1) batch_size = 1;
+  if (streaming && batch_size > 1) {
+    cerr << "Error: --batch-size needs the n-best lists in memory, it cannot be used with --streaming" << endl;
+    exit(1);
+  }
+  Moses::ThreadPool* pool = NULL;
+#ifdef WITH_THREADS
+  if (threads > 1) {
+    pool = new Moses::ThreadPool(threads);
+  }
+#endif
+
   if (vm.count("random-seed")) {
     cerr << "Initialising random seed to " << seed << endl;
     srand(seed);
@@ -194,7 +374,7 @@ int main(int argc, char** argv)
     train.reset(new StreamingHypPackEnumerator(featureFiles, scoreFiles));
   else
     train.reset(new RandomAccessHypPackEnumerator(featureFiles, scoreFiles, no_shuffle));
-  cerr << "Initial BLEU = " << evaluate(train.get(), wv.avg()) << endl;
+  cerr << "Initial BLEU = " << evaluate(train.get(), wv.avg(), streaming, pool) << endl;
   ValType bestBleu = 0;
   for(int j=0; j<n_iters; j++) {
     // MIRA train for one epoch
@@ -202,87 +382,61 @@ int main(int argc, char** argv)
     int iNumExamples = 0;
     int iNumUpdates = 0;
     ValType totalLoss = 0.0;
+    vector<HypPack> batch;
+    vector<HopeFear> results;
     for(train->reset(); !train->finished(); train->next()) {
       // Hope / fear decode
-      ValType hope_scale = 1.0;
-      size_t hope_index=0, fear_index=0, model_index=0;
-      ValType hope_score=0, fear_score=0, model_score=0;
-      int iNumHypsBackup = iNumHyps;
-      for(size_t safe_loop=0; safe_loop<2; safe_loop++) {
-        iNumHyps = iNumHypsBackup;
-        ValType hope_bleu, hope_model;
-        for(size_t i=0; i< train->cur_size(); i++) {
-          const MiraFeatureVector& vec=train->featuresAt(i);
-          ValType score = wv.score(vec);
-          ValType bleu = sentenceLevelBackgroundBleu(train->scoresAt(i),bg);
-          // Hope
-          if(i==0 || (hope_scale*score + bleu) > hope_score) {
-            hope_score = hope_scale*score + bleu;
-            hope_index = i;
-            hope_bleu = bleu;
-            hope_model = score;
+      readBatch(train.get(), batch_size, batch);
+      results.resize(batch.size());
+      {
+        Moses::TaskGroup group(pool);
+        for(size_t s=0; s<batch.size(); s++) {
+          group.Spawn(new HopeFearTask(batch[s], wv, bg, safe_hope, results[s]));
+        }
+      }
+      // Update weights, in sentence order
+      for(size_t s=0; s<batch.size(); s++) {
+        const HypPack& pack = batch[s];
+        const HopeFear& hf = results[s];
+        iNumHyps += hf.numHyps;
+        if(hf.hope_index!=hf.fear_index) {
+          // Vector difference
+          const MiraFeatureVector& hope=*pack.features[hf.hope_index];
+          const MiraFeatureVector& fear=*pack.features[hf.fear_index];
+          MiraFeatureVector diff = hope - fear;
+          // Bleu difference, against the background the sentence was decoded with
+          ValType delta = hf.hopeBleu - hf.fearBleu;
+          // Loss and update
+          ValType diff_score = wv.score(diff);
+          ValType loss = delta - diff_score;
+          if(verbose) {
+            cerr << "Updating sent " << pack.id << endl;
+            cerr << "Wght: " << wv << endl;
+            cerr << "Hope: " << hope << " BLEU:" << hf.hopeBleu << " Score:" << wv.score(hope) << endl;
+            cerr << "Fear: " << fear << " BLEU:" << hf.fearBleu << " Score:" << wv.score(fear) << endl;
+            cerr << "Diff: " << diff << " BLEU:" << delta << " Score:" << diff_score << endl;
+            cerr << "Loss: " << loss << " Scale: " << hf.hope_scale << endl;
+            cerr << endl;
           }
-          // Fear
-          if(i==0 || (score - bleu) > fear_score) {
-            fear_score = score - bleu;
-            fear_index = i;
+          if(loss > 0) {
+            ValType eta = min(c, loss / diff.sqrNorm());
+            wv.update(diff,eta);
+            totalLoss+=loss;
+            iNumUpdates++;
           }
-          // Model
-          if(i==0 || score > model_score) {
-            model_score = score;
-            model_index = i;
+          // Update BLEU statistics
+          const vector<float>& hope_stats = *pack.scores[hf.hope_index];
+          const vector<float>& model_stats = *pack.scores[hf.model_index];
+          for(size_t k=0; k<bg.size(); k++) {
+            bg[k]*=decay;
+            if(model_bg)
+              bg[k]+=model_stats[k];
+            else
+              bg[k]+=hope_stats[k];
           }
-          iNumHyps++;
         }
-        // Outer loop rescales the contribution of model score to 'hope' in antagonistic cases
-        // where model score is having far more influence than BLEU
-        hope_bleu *= BLEU_RATIO; // We only care about cases where model has MUCH more influence than BLEU
-        if(safe_hope && safe_loop==0 && abs(hope_model)>1e-8 && abs(hope_bleu)/abs(hope_model)<hope_scale)
-          hope_scale = abs(hope_bleu) / abs(hope_model);
-        else break;
+        iNumExamples++;
       }
-      // Update weights
-      if(hope_index!=fear_index) {
-        // Vector difference
-        const MiraFeatureVector& hope=train->featuresAt(hope_index);
-        const MiraFeatureVector& fear=train->featuresAt(fear_index);
-        MiraFeatureVector diff = hope - fear;
-        // Bleu difference
-        const vector<float>& hope_stats = train->scoresAt(hope_index);
-        ValType hopeBleu = sentenceLevelBackgroundBleu(hope_stats, bg);
-        const vector<float>& fear_stats = train->scoresAt(fear_index);
-        ValType fearBleu = sentenceLevelBackgroundBleu(fear_stats, bg);
-        assert(hopeBleu + 1e-8 >= fearBleu);
-        ValType delta = hopeBleu - fearBleu;
-        // Loss and update
-        ValType diff_score = wv.score(diff);
-        ValType loss = delta - diff_score;
-        if(verbose) {
-          cerr << "Updating sent " << train->cur_id() << endl;
-          cerr << "Wght: " << wv << endl;
-          cerr << "Hope: " << hope << " BLEU:" << hopeBleu << " Score:" << wv.score(hope) << endl;
-          cerr << "Fear: " << fear << " BLEU:" << fearBleu << " Score:" << wv.score(fear) << endl;
-          cerr << "Diff: " << diff << " BLEU:" << delta << " Score:" << diff_score << endl;
-          cerr << "Loss: " << loss << " Scale: " << hope_scale << endl;
-          cerr << endl;
-        }
-        if(loss > 0) {
-          ValType eta = min(c, loss / diff.sqrNorm());
-          wv.update(diff,eta);
-          totalLoss+=loss;
-          iNumUpdates++;
-        }
-        // Update BLEU statistics
-        const vector<float>& model_stats = train->scoresAt(model_index);
-        for(size_t k=0; k<bg.size(); k++) {
-          bg[k]*=decay;
-          if(model_bg)
-            bg[k]+=model_stats[k];
-          else
-            bg[k]+=hope_stats[k];
-        }
-      }
-      iNumExamples++;
     }
     // Training Epoch summary
     cerr << iNumUpdates << "/" << iNumExamples << " updates"
@@ -291,7 +445,7 @@ int main(int argc, char** argv)
 
     // Evaluate current average weights
     AvgWeightVector avg = wv.avg();
-    ValType bleu = evaluate(train.get(), avg);
+    ValType bleu = evaluate(train.get(), avg, streaming, pool);
     cerr << ", BLEU = " << bleu << endl;
     if(bleu > bestBleu) {
       size_t num_dense = train->num_dense();
@@ -326,6 +480,13 @@ int main(int argc, char** argv)
     }
   }
   cerr << "Best BLEU = " << bestBleu << endl;
+
+#ifdef WITH_THREADS
+  if (pool) {
+    pool->Stop(true);
+    delete pool;
+  }
+#endif
 }
 // --Emacs trickery--
 // Local Variables:
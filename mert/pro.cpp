@@ -27,21 +27,26 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
   *
   *   For details of PRO, refer to Hopkins & May (EMNLP 2011)
  **/
+#include <algorithm>
 #include <cmath>
 #include <cstddef>
 #include <cstdlib>
 #include <ctime>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <vector>
 #include <utility>
 
 #include <boost/program_options.hpp>
 
+#include "util/murmur_hash.hh"
+#include "moses/ThreadPool.h"
+
 #include "BleuScorer.h"
 #include "FeatureDataIterator.h"
+#include "LogisticRegression.h"
 #include "ScoreDataIterator.h"
-#include "BleuScorer.h"
 
 using namespace std;
 using namespace MosesTuning;
@@ -51,15 +56,24 @@ namespace po = boost::program_options;
 namespace MosesTuning
 {
 
+// TODO: Add these constants to options
+const unsigned int n_candidates = 5000; // Gamma, in Hopkins & May
+const unsigned int n_samples = 50; // Xi, in Hopkins & May
+const float min_diff = 0.05;
+const float bleuSmoothing = 1.0f;
+
+//! sentences read ahead and sampled in parallel
+const size_t kSentencesPerBlock = 256;
+
 class SampledPair
 {
 private:
-  pair<size_t,size_t> m_translation1;
-  pair<size_t,size_t> m_translation2;
+  size_t m_translation1;
+  size_t m_translation2;
   float m_score_diff;
 
 public:
-  SampledPair(const pair<size_t,size_t>& t1, const pair<size_t,size_t>& t2, float diff ) {
+  SampledPair(size_t t1, size_t t2, float diff ) {
     if (diff > 0) {
       m_translation1 = t1;
       m_translation2 = t2;
@@ -74,10 +88,10 @@ public:
   float getDiff() const {
     return m_score_diff;
   }
-  const pair<size_t,size_t>& getTranslation1() const {
+  size_t getTranslation1() const {
     return m_translation1;
   }
-  const pair<size_t,size_t>& getTranslation2() const {
+  size_t getTranslation2() const {
     return m_translation2;
   }
 };
@@ -100,6 +114,67 @@ static void outputSample(ostream& out, const FeatureDataItem& f1, const FeatureD
   }
 }
 
+/**
+ * The hypotheses of one sentence, from all the feature and score files,
+ * and the pairs sampled from them.
+ */
+struct SentenceSamples {
+  vector<FeatureDataItem> features;
+  vector<ScoreDataItem> scores;
+  vector<SampledPair> pairs;
+};
+
+/**
+ * Samples the pairs of one sentence. Each sentence has its own random
+ * number generator, seeded from the random seed and the sentence number,
+ * so the samples do not depend on the number of threads.
+ */
+class SampleTask : public Moses::Task
+{
+public:
+  SampleTask(SentenceSamples& sentence, unsigned int seed, bool smoothBP)
+    : m_sentence(sentence), m_seed(seed), m_smoothBP(smoothBP) {}
+
+  virtual void Run() {
+    const vector<ScoreDataItem>& hypotheses = m_sentence.scores;
+    unsigned int state = m_seed;
+
+    //collect the candidates
+    vector<SampledPair> samples;
+    vector<float> scores;
+    size_t n_translations = hypotheses.size();
+    for(size_t  i=0; i<n_candidates; i++) {
+      size_t translation1 = rand_r(&state) % n_translations;
+      float bleu1 = smoothedSentenceBleu(hypotheses[translation1], bleuSmoothing, m_smoothBP);
+
+      size_t translation2 = rand_r(&state) % n_translations;
+      float bleu2 = smoothedSentenceBleu(hypotheses[translation2], bleuSmoothing, m_smoothBP);
+
+      if (abs(bleu1-bleu2) < min_diff)
+        continue;
+
+      samples.push_back(SampledPair(translation1, translation2, bleu1-bleu2));
+      scores.push_back(1.0-abs(bleu1-bleu2));
+    }
+
+    float sample_threshold = -1.0;
+    if (samples.size() > n_samples) {
+      nth_element(scores.begin(), scores.begin() + (n_samples-1), scores.end());
+      sample_threshold = 0.99999-scores[n_samples-1];
+    }
+
+    for (size_t i = 0; m_sentence.pairs.size() < n_samples && i < samples.size(); ++i) {
+      if (samples[i].getDiff() < sample_threshold) continue;
+      m_sentence.pairs.push_back(samples[i]);
+    }
+  }
+
+private:
+  SentenceSamples& m_sentence;
+  unsigned int m_seed;
+  bool m_smoothBP;
+};
+
 }
 
 int main(int argc, char** argv)
@@ -109,12 +184,11 @@ int main(int argc, char** argv)
   vector<string> featureFiles;
   int seed;
   string outputFile;
-  // TODO: Add these constants to options
-  const unsigned int n_candidates = 5000; // Gamma, in Hopkins & May
-  const unsigned int n_samples = 50; // Xi, in Hopkins & May
-  const float min_diff = 0.05;
+  bool train = false;
+  double l2 = 1.0;
+  size_t iterations = 30;
+  size_t threads = 1;
   bool smoothBP = false;
-  const float bleuSmoothing = 1.0f;
 
   po::options_description desc("Allowed options");
   desc.add_options()
@@ -124,7 +198,15 @@ int main(int argc, char** argv)
   ("random-seed,r", po::value<int>(&seed), "Seed for random number generation")
   ("output-file,o", po::value<string>(&outputFile), "Output file")
   ("smooth-brevity-penalty,b", po::value(&smoothBP)->zero_tokens()->default_value(false), "Smooth the brevity penalty, as in Nakov et al. (Coling 2012)")
+  ("train", po::value(&train)->zero_tokens()->default_value(false), "Train a logistic regression on the samples and output the weights, instead of the samples for megam")
+  ("l2", po::value<double>(&l2), "L2 regularisation of the logistic regression (default 1)")
+  ("iters,J", po::value<size_t>(&iterations), "Maximum number of logistic regression iterations (default 30)")
   ;
+#ifdef WITH_THREADS
+  desc.add_options()
+  ("threads,T", po::value<size_t>(&threads), "Number of threads (default 1)")
+  ;
+#endif
 
   po::options_description cmdline_options;
   cmdline_options.add(desc);
@@ -140,10 +222,9 @@ int main(int argc, char** argv)
 
   if (vm.count("random-seed")) {
     cerr << "Initialising random seed to " << seed << endl;
-    srand(seed);
   } else {
     cerr << "Initialising random seed from system clock" << endl;
-    srand(time(NULL));
+    seed = time(NULL);
   }
 
   if (scoreFiles.size() == 0 || featureFiles.size() == 0) {
@@ -170,6 +251,12 @@ int main(int argc, char** argv)
     out = &cout;
   }
 
+  Moses::ThreadPool* pool = NULL;
+#ifdef WITH_THREADS
+  if (threads > 1) {
+    pool = new Moses::ThreadPool(threads);
+  }
+#endif
 
   vector<FeatureDataIterator> featureDataIters;
   vector<ScoreDataIterator> scoreDataIters;
@@ -178,89 +265,99 @@ int main(int argc, char** argv)
     scoreDataIters.push_back(ScoreDataIterator(scoreFiles[i]));
   }
 
-  //loop through nbest lists
+  LogisticRegression regression;
+  size_t num_dense = 0;
+
+  //loop through nbest lists, a block of sentences at a time
   size_t sentenceId = 0;
-  while(1) {
-    vector<pair<size_t,size_t> > hypotheses;
-    //TODO: de-deuping. Collect hashes of score,feature pairs and
-    //only add index if it's unique.
-    if (featureDataIters[0] == FeatureDataIterator::end()) {
-      break;
-    }
-    for (size_t i = 0; i < featureFiles.size(); ++i) {
-      if (featureDataIters[i] == FeatureDataIterator::end()) {
-        cerr << "Error: Feature file " << i << " ended prematurely" << endl;
-        exit(1);
-      }
-      if (scoreDataIters[i] == ScoreDataIterator::end()) {
-        cerr << "Error: Score file " << i << " ended prematurely" << endl;
-        exit(1);
+  bool finished = false;
+  while(!finished) {
+    vector<SentenceSamples> block;
+    block.reserve(kSentencesPerBlock);
+    while (block.size() < kSentencesPerBlock) {
+      //TODO: de-deuping. Collect hashes of score,feature pairs and
+      //only add index if it's unique.
+      if (featureDataIters[0] == FeatureDataIterator::end()) {
+        finished = true;
+        break;
       }
-      if (featureDataIters[i]->size() != scoreDataIters[i]->size()) {
-        cerr << "Error: For sentence " << sentenceId << " features and scores have different size" << endl;
-        exit(1);
-      }
-      for (size_t j = 0; j < featureDataIters[i]->size(); ++j) {
-        hypotheses.push_back(pair<size_t,size_t>(i,j));
+      block.push_back(SentenceSamples());
+      SentenceSamples& sentence = block.back();
+      for (size_t i = 0; i < featureFiles.size(); ++i) {
+        if (featureDataIters[i] == FeatureDataIterator::end()) {
+          cerr << "Error: Feature file " << i << " ended prematurely" << endl;
+          exit(1);
+        }
+        if (scoreDataIters[i] == ScoreDataIterator::end()) {
+          cerr << "Error: Score file " << i << " ended prematurely" << endl;
+          exit(1);
+        }
+        if (featureDataIters[i]->size() != scoreDataIters[i]->size()) {
+          cerr << "Error: For sentence " << (sentenceId + block.size() - 1) << " features and scores have different size" << endl;
+          exit(1);
+        }
+        sentence.features.insert(sentence.features.end(), featureDataIters[i]->begin(), featureDataIters[i]->end());
+        sentence.scores.insert(sentence.scores.end(), scoreDataIters[i]->begin(), scoreDataIters[i]->end());
+        //advance the iterators
+        ++featureDataIters[i];
+        ++scoreDataIters[i];
       }
     }
 
-    //collect the candidates
-    vector<SampledPair> samples;
-    vector<float> scores;
-    size_t n_translations = hypotheses.size();
-    for(size_t  i=0; i<n_candidates; i++) {
-      size_t rand1 = rand() % n_translations;
-      pair<size_t,size_t> translation1 = hypotheses[rand1];
-      float bleu1 = smoothedSentenceBleu(scoreDataIters[translation1.first]->operator[](translation1.second), bleuSmoothing, smoothBP);
-
-      size_t rand2 = rand() % n_translations;
-      pair<size_t,size_t> translation2 = hypotheses[rand2];
-      float bleu2 = smoothedSentenceBleu(scoreDataIters[translation2.first]->operator[](translation2.second), bleuSmoothing, smoothBP);
-
-      /*
-      cerr << "t(" << translation1.first << "," << translation1.second << ") = " << bleu1 <<
-        " t(" << translation2.first << "," << translation2.second << ") = " <<
-          bleu2  << " diff = " << abs(bleu1-bleu2) << endl;
-      */
-      if (abs(bleu1-bleu2) < min_diff)
-        continue;
-
-      samples.push_back(SampledPair(translation1, translation2, bleu1-bleu2));
-      scores.push_back(1.0-abs(bleu1-bleu2));
+    {
+      Moses::TaskGroup group(pool);
+      for (size_t s = 0; s < block.size(); ++s) {
+        const uint64_t id = sentenceId + s;
+        const unsigned int sentenceSeed = util::MurmurHashNative(&id, sizeof(id), seed);
+        group.Spawn(new SampleTask(block[s], sentenceSeed, smoothBP));
+      }
     }
 
-    float sample_threshold = -1.0;
-    if (samples.size() > n_samples) {
-      nth_element(scores.begin(), scores.begin() + (n_samples-1), scores.end());
-      sample_threshold = 0.99999-scores[n_samples-1];
+    for (size_t s = 0; s < block.size(); ++s) {
+      const SentenceSamples& sentence = block[s];
+      if (!sentence.features.empty()) {
+        num_dense = sentence.features[0].dense.size();
+      }
+      for (size_t i = 0; i < sentence.pairs.size(); ++i) {
+        const FeatureDataItem& f1 = sentence.features[sentence.pairs[i].getTranslation1()];
+        const FeatureDataItem& f2 = sentence.features[sentence.pairs[i].getTranslation2()];
+        if (train) {
+          MiraFeatureVector v1(f1), v2(f2);
+          regression.AddExample(v1 - v2, true);
+          regression.AddExample(v2 - v1, false);
+          continue;
+        }
+        *out << "1";
+        outputSample(*out, f1, f2);
+        *out << endl;
+        *out << "0";
+        outputSample(*out, f2, f1);
+        *out << endl;
+      }
     }
+    sentenceId += block.size();
+  }
 
-    size_t collected = 0;
-    for (size_t i = 0; collected < n_samples && i < samples.size(); ++i) {
-      if (samples[i].getDiff() < sample_threshold) continue;
-      ++collected;
-      size_t file_id1 = samples[i].getTranslation1().first;
-      size_t hypo_id1 = samples[i].getTranslation1().second;
-      size_t file_id2 = samples[i].getTranslation2().first;
-      size_t hypo_id2 = samples[i].getTranslation2().second;
-      *out << "1";
-      outputSample(*out, featureDataIters[file_id1]->operator[](hypo_id1),
-                   featureDataIters[file_id2]->operator[](hypo_id2));
-      *out << endl;
-      *out << "0";
-      outputSample(*out, featureDataIters[file_id2]->operator[](hypo_id2),
-                   featureDataIters[file_id1]->operator[](hypo_id1));
-      *out << endl;
+  if (train) {
+    cerr << "Training on " << regression.NumberOfExamples() << " examples" << endl;
+    vector<ValType> weights;
+    regression.Train(weights, l2, iterations, pool);
+    weights.resize(max(weights.size(), num_dense));
+    // same format as megam, and as kbmira
+    for (size_t i = 0; i < weights.size(); ++i) {
+      if (i < num_dense)
+        *out << "F" << i << " " << weights[i] << endl;
+      else if (abs(weights[i]) > 1e-8)
+        *out << SparseVector::decode(i - num_dense) << " " << weights[i] << endl;
     }
-    //advance all iterators
-    for (size_t i = 0; i < featureFiles.size(); ++i) {
-      ++featureDataIters[i];
-      ++scoreDataIters[i];
-    }
-    ++sentenceId;
   }
 
   outFile.close();
 
+#ifdef WITH_THREADS
+  if (pool) {
+    pool->Stop(true);
+    delete pool;
+  }
+#endif
 }
@@ -0,0 +1,63 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "moses/TypeDef.h"
+#include "moses/TranslationModel/RuleTable/BinaryImageCreator.h"
+
+#include "util/exception.hh"
+
+using namespace Moses;
+
+void printHelp(char **argv)
+{
+  std::cerr << "Usage " << argv[0] << ":\n"
+            "  options: \n"
+            "\t-in  string       -- input rule table file name, sorted with LC_ALL=C sort\n"
+            "\t-out string       -- binary rule table file name\n"
+            "\t-nscores int      -- number of score components in rule table\n"
+            "\n"
+            "  The output file is given as path of PhraseDictionaryMemory in moses.ini.\n\n";
+}
+
+int main(int argc, char **argv)
+{
+  std::string inFilePath;
+  std::string outFilePath;
+  size_t numScoreComponent = 5;
+
+  if(1 >= argc) {
+    printHelp(argv);
+    return 1;
+  }
+  for(int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if("-in" == arg && i+1 < argc) {
+      ++i;
+      inFilePath = argv[i];
+    } else if("-out" == arg && i+1 < argc) {
+      ++i;
+      outFilePath = argv[i];
+    } else if("-nscores" == arg && i+1 < argc) {
+      ++i;
+      numScoreComponent = atoi(argv[i]);
+    } else {
+      //something's wrong... print help
+      printHelp(argv);
+      return 1;
+    }
+  }
+
+  if(inFilePath.empty() || outFilePath.empty()) {
+    printHelp(argv);
+    return 1;
+  }
+
+  try {
+    RuleTableBinaryImageCreator(inFilePath, outFilePath, numScoreComponent);
+  } catch (const util::Exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
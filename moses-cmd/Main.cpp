@@ -745,6 +745,14 @@ int main(int argc, char** argv)
     pool.Stop(true); //flush remaining jobs
 #endif
 
+    IFVERBOSE(1) {
+      if (staticData.GetUseTransOptCache()) {
+        const TranslationOptionCache &cache = staticData.GetTransOptCache();
+        TRACE_ERR("Persistent cache: " << cache.GetHits() << " hits, " << cache.GetMisses() << " misses, "
+                  << cache.GetSize() << " phrases, " << (cache.GetMemoryUse() >> 10) << " KB" << endl);
+      }
+    }
+
     delete ioWrapper;
 
   } catch (const std::exception &e) {
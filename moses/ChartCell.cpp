@@ -151,6 +151,15 @@ void ChartCell::CleanupArcList()
   }
 }
 
+//! renumber the hypotheses of a cell that was decoded with cell-local ids
+void ChartCell::OffsetHypothesisIds(unsigned offset)
+{
+  MapType::iterator iter;
+  for (iter = m_hypoColl.begin(); iter != m_hypoColl.end(); ++iter) {
+    iter->second.OffsetHypothesisIds(offset);
+  }
+}
+
 //! debug info - size of each hypo collection in this cell
 void ChartCell::OutputSizes(std::ostream &out) const
 {
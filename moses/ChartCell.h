@@ -115,6 +115,7 @@ public:
   const ChartHypothesis *GetBestHypothesis() const;
 
   void CleanupArcList();
+  void OffsetHypothesisIds(unsigned offset);
 
   void OutputSizes(std::ostream &out) const;
   size_t GetSize() const;
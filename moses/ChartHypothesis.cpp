@@ -20,6 +20,7 @@
 
 #include <algorithm>
 #include <vector>
+#include <boost/functional/hash.hpp>
 #include "ChartHypothesis.h"
 #include "RuleCubeItem.h"
 #include "ChartCell.h"
@@ -54,6 +55,8 @@ ChartHypothesis::ChartHypothesis(const ChartTranslationOptions &transOpt,
   ,m_winningHypo(NULL)
   ,m_manager(manager)
   ,m_id(manager.GetNextHypoId())
+  ,m_recombinationHash(0)
+  ,m_recombinationHashComputed(false)
 {
   // underlying hypotheses for sub-spans
   const std::vector<HypothesisDimension> &childEntries = item.GetHypothesisDimensions();
@@ -137,6 +140,20 @@ int ChartHypothesis::RecombineCompare(const ChartHypothesis &compare) const
   return 0;
 }
 
+size_t ChartHypothesis::GetRecombinationHash() const
+{
+  if (!m_recombinationHashComputed) {
+    size_t seed = 0;
+    for (unsigned i = 0; i < m_ffStates.size(); ++i) {
+      // RecombineCompare() only matches a missing state with a missing state
+      boost::hash_combine(seed, m_ffStates[i] ? m_ffStates[i]->Hash() : 0);
+    }
+    m_recombinationHash = seed;
+    m_recombinationHashComputed = true;
+  }
+  return m_recombinationHash;
+}
+
 /** calculate total score
   * @todo this should be in ScoreBreakdown
  */
@@ -208,6 +225,17 @@ struct CompareChartChartHypothesisTotalScore {
   }
 };
 
+void ChartHypothesis::OffsetIds(unsigned offset)
+{
+  m_id += offset;
+  if (m_arcList) {
+    ChartArcList::iterator iter;
+    for (iter = m_arcList->begin() ; iter != m_arcList->end() ; ++iter) {
+      (*iter)->m_id += offset;
+    }
+  }
+}
+
 void ChartHypothesis::CleanupArcList()
 {
   // point this hypo's main hypo to itself
@@ -27,6 +27,7 @@
 #include "Phrase.h"
 #include "ChartTranslationOptions.h"
 #include "ObjectPool.h"
+#include "SentenceArena.h"
 
 namespace Moses
 {
@@ -40,7 +41,7 @@ typedef std::vector<ChartHypothesis*> ChartArcList;
 /** a hypothesis in the hierarchical/syntax decoder.
  * Contain a pointer to the current target phrase, a vector of previous hypos, and some scores
  */
-class ChartHypothesis
+class ChartHypothesis : public SentenceArenaObject
 {
   friend std::ostream& operator<<(std::ostream&, const ChartHypothesis&);
 
@@ -66,6 +67,8 @@ protected:
   ChartManager& m_manager;
 
   unsigned m_id; /* pkoehn wants to log the order in which hypotheses were generated */
+  mutable size_t m_recombinationHash; /*! cached GetRecombinationHash() */
+  mutable bool m_recombinationHashComputed;
 
   //! not implemented
   ChartHypothesis();
@@ -100,6 +103,9 @@ public:
     return m_id;
   }
 
+  //! shift the ids of this hypo and its arcs, see ChartManager::GetNextHypoId()
+  void OffsetIds(unsigned offset);
+
   //! Get the rule that created this hypothesis
   const TargetPhrase &GetCurrTargetPhrase()const {
     return m_targetPhrase;
@@ -130,6 +136,10 @@ public:
 
   int RecombineCompare(const ChartHypothesis &compare) const;
 
+  /** hash of the feature function states, consistent with
+   *  RecombineCompare(). Computed once the states are final, on first use */
+  size_t GetRecombinationHash() const;
+
   void Evaluate();
 
   void AddArc(ChartHypothesis *loserHypo);
@@ -275,6 +275,15 @@ void ChartHypothesisCollection::CleanupArcList()
   }
 }
 
+//! add offset to the ids of all hypos in the collection, including arcs
+void ChartHypothesisCollection::OffsetHypothesisIds(unsigned offset)
+{
+  HCType::iterator iter;
+  for (iter = m_hypos.begin() ; iter != m_hypos.end() ; ++iter) {
+    (*iter)->OffsetIds(offset);
+  }
+}
+
 /** Return all hypos, and all hypos in the arclist, in order to create the output searchgraph, ie. the hypergraph. The output is the debug hypo information.
  * @todo this is a useful function. Make sure it outputs everything required, especially scores.
  * \param translationId unique, contiguous id for the input sentence
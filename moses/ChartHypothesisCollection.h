@@ -20,8 +20,8 @@
  ***********************************************************************/
 #pragma once
 
-#include <set>
 #include "ChartHypothesis.h"
+#include "RecombinationTable.h"
 #include "RuleCube.h"
 
 
@@ -68,7 +68,7 @@ class ChartHypothesisCollection
   friend std::ostream& operator<<(std::ostream&, const ChartHypothesisCollection&);
 
 protected:
-  typedef std::set<ChartHypothesis*, ChartHypothesisRecombinationOrderer> HCType;
+  typedef RecombinationTable<ChartHypothesis> HCType;
   HCType m_hypos;
   HypoList m_hyposOrdered;
 
@@ -108,6 +108,7 @@ public:
 
   void SortHypotheses();
   void CleanupArcList();
+  void OffsetHypothesisIds(unsigned offset);
 
   //! return vector of hypothesis that has been sorted by score
   const HypoList &GetSortedHypotheses() const {
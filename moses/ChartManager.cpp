@@ -31,6 +31,7 @@
 #include "StaticData.h"
 #include "DecodeStep.h"
 #include "TreeInput.h"
+#include "ThreadPool.h"
 #include "moses/FF/WordPenaltyProducer.h"
 
 using namespace std;
@@ -40,6 +41,52 @@ namespace Moses
 {
 extern bool g_debug;
 
+#ifdef WITH_THREADS
+namespace
+{
+// the counters of m_cellHypothesisId live on the stack of CellTask::Run()
+void KeepCellHypothesisId(unsigned *) {}
+}
+#endif
+
+/** Creates the translation options of one cell, unless that has already
+ *  been done, and decodes it. Hypothesis ids are counted from 0 in numHypos.
+ */
+class ChartManager::CellTask : public Task
+{
+public:
+  CellTask(ChartManager &manager, const WordsRange &range
+           , ChartTranslationOptionList &transOptList, bool createOptions
+           , unsigned &numHypos)
+    : m_manager(manager), m_range(range), m_transOptList(transOptList)
+    , m_createOptions(createOptions), m_numHypos(numHypos) {}
+
+  void Run() {
+    SentenceArena::Scope arenaScope(&m_manager.GetArena());
+#ifdef WITH_THREADS
+    unsigned *prevCellId = m_manager.m_cellHypothesisId.release();
+    m_manager.m_cellHypothesisId.reset(&m_numHypos);
+#endif
+
+    if (m_createOptions) {
+      m_manager.CreateTranslationOptions(m_range, m_transOptList);
+    }
+    m_manager.DecodeCell(m_range, m_transOptList);
+
+#ifdef WITH_THREADS
+    m_manager.m_cellHypothesisId.release();
+    m_manager.m_cellHypothesisId.reset(prevCellId);
+#endif
+  }
+
+private:
+  ChartManager &m_manager;
+  WordsRange m_range;
+  ChartTranslationOptionList &m_transOptList;
+  bool m_createOptions;
+  unsigned &m_numHypos;
+};
+
 /* constructor. Initialize everything prior to decoding a particular sentence.
  * \param source the sentence to be decoded
  * \param system which particular set of models to use.
@@ -51,11 +98,26 @@ ChartManager::ChartManager(InputType const& source)
   ,m_hypothesisId(0)
   ,m_parser(source, m_hypoStackColl)
   ,m_translationOptionList(StaticData::Instance().GetRuleLimit())
+  ,m_parallelCells(false)
+#ifdef WITH_THREADS
+  ,m_cellHypothesisId(&KeepCellHypothesisId)
+#endif
 {
+#if defined(WITH_THREADS) && !defined(USE_HYPO_POOL)
+  // as in SearchNormal, only with other threads to help and without the
+  // statistics of verbosity 2
+  const StaticData &staticData = StaticData::Instance();
+  ThreadPool *pool = ThreadPool::GetCurrent();
+  m_parallelCells = staticData.UseParallelChartCells()
+                    && pool && pool->GetNumThreads() > 1
+                    && staticData.GetVerboseLevel() < 2;
+#endif
 }
 
 ChartManager::~ChartManager()
 {
+  RemoveAllInColl(m_cellOptionLists);
+
   clock_t end = clock();
   float et = (end - m_start);
   et /= (float)CLOCKS_PER_SEC;
@@ -66,6 +128,8 @@ ChartManager::~ChartManager()
 //! decode the sentence. This contains the main laps. Basically, the CKY++ algorithm
 void ChartManager::ProcessSentence()
 {
+  SentenceArena::Scope arenaScope(&m_arena);
+
   VERBOSE(1,"Translating: " << m_source << endl);
 
   ResetSentenceStats(m_source);
@@ -78,23 +142,20 @@ void ChartManager::ProcessSentence()
   // MAIN LOOP
   size_t size = m_source.GetSize();
   for (size_t width = 1; width <= size; ++width) {
+    if (m_parallelCells && width < size) {
+      ProcessCellsInParallel(width);
+      continue;
+    }
+
     for (size_t startPos = 0; startPos <= size-width; ++startPos) {
       size_t endPos = startPos + width - 1;
       WordsRange range(startPos, endPos);
 
       // create trans opt
-      m_translationOptionList.Clear();
-      m_parser.Create(range, m_translationOptionList);
-      m_translationOptionList.ApplyThreshold();
+      CreateTranslationOptions(range, m_translationOptionList);
 
       // decode
-      ChartCell &cell = m_hypoStackColl.Get(range);
-
-      cell.ProcessSentence(m_translationOptionList, m_hypoStackColl);
-      m_translationOptionList.Clear();
-      cell.PruneToSize();
-      cell.CleanupArcList();
-      cell.SortHypotheses();
+      DecodeCell(range, m_translationOptionList);
     }
   }
 
@@ -119,6 +180,65 @@ void ChartManager::ProcessSentence()
   }
 }
 
+//! look up the rules of a range
+void ChartManager::CreateTranslationOptions(const WordsRange &range, ChartTranslationOptionList &transOptList)
+{
+  transOptList.Clear();
+  m_parser.Create(range, transOptList);
+  transOptList.ApplyThreshold();
+}
+
+//! cube pruning for one cell, then prepare the cell for use by wider spans
+void ChartManager::DecodeCell(const WordsRange &range, ChartTranslationOptionList &transOptList)
+{
+  ChartCell &cell = m_hypoStackColl.Get(range);
+
+  cell.ProcessSentence(transOptList, m_hypoStackColl);
+  transOptList.Clear();
+  cell.PruneToSize();
+  cell.CleanupArcList();
+  cell.SortHypotheses();
+}
+
+/** Decode all cells of one width on the threads of the pool. The cells of
+ *  a width only read the cells of smaller widths, and each dotted rule chart
+ *  of the rule lookup belongs to one start position, so the cells can be
+ *  decoded independently. If a rule table does not support concurrent
+ *  lookups, the rules of all cells are looked up here first.
+ *  Each cell counts its hypothesis ids from 0; they are shifted afterwards
+ *  so that they come out as in the serial loop.
+ */
+void ChartManager::ProcessCellsInParallel(size_t width)
+{
+  const size_t numCells = m_source.GetSize() - width + 1;
+  const bool createOptions = m_parser.IsConcurrent();
+
+  while (m_cellOptionLists.size() < numCells) {
+    m_cellOptionLists.push_back(new ChartTranslationOptionList(StaticData::Instance().GetRuleLimit()));
+  }
+
+  if (!createOptions) {
+    for (size_t startPos = 0; startPos < numCells; ++startPos) {
+      CreateTranslationOptions(WordsRange(startPos, startPos + width - 1), *m_cellOptionLists[startPos]);
+    }
+  }
+
+  std::vector<unsigned> numHypos(numCells, 0);
+  {
+    TaskGroup group;
+    for (size_t startPos = 0; startPos < numCells; ++startPos) {
+      WordsRange range(startPos, startPos + width - 1);
+      group.Spawn(new CellTask(*this, range, *m_cellOptionLists[startPos], createOptions, numHypos[startPos]));
+    }
+    group.Wait();
+  }
+
+  for (size_t startPos = 0; startPos < numCells; ++startPos) {
+    m_hypoStackColl.Get(WordsRange(startPos, startPos + width - 1)).OffsetHypothesisIds(m_hypothesisId);
+    m_hypothesisId += numHypos[startPos];
+  }
+}
+
 /** add specific translation options and hypotheses according to the XML override translation scheme.
  *  Doesn't seem to do anything about walls and zones.
  *  @todo check walls & zones. Check that the implementation doesn't leak, xml options sometimes does if you're not careful
@@ -30,8 +30,12 @@
 #include "SentenceStats.h"
 #include "ChartTranslationOptionList.h"
 #include "ChartParser.h"
+#include "SentenceArena.h"
 
 #include <boost/shared_ptr.hpp>
+#ifdef WITH_THREADS
+#include <boost/thread/tss.hpp>
+#endif
 
 namespace Moses
 {
@@ -54,6 +58,7 @@ private:
                                  const ChartTrellisNode &,
                                  ChartTrellisDetourQueue &);
 
+  SentenceArena m_arena; /**< hypotheses and states of this sentence. must be destroyed last */
   InputType const& m_source; /**< source sentence to be translated */
   ChartCellCollection m_hypoStackColl;
   std::auto_ptr<SentenceStats> m_sentenceStats;
@@ -64,6 +69,18 @@ private:
 
   ChartTranslationOptionList m_translationOptionList; /**< pre-computed list of translation options for the phrases in this sentence */
 
+  bool m_parallelCells; /**< decode the cells of each width on the thread pool */
+  std::vector<ChartTranslationOptionList*> m_cellOptionLists; /**< translation options of each cell of a width, for parallel cells */
+#ifdef WITH_THREADS
+  boost::thread_specific_ptr<unsigned> m_cellHypothesisId; /**< id counter of the cell being decoded by the calling thread, if any */
+#endif
+
+  class CellTask;
+
+  void CreateTranslationOptions(const WordsRange &range, ChartTranslationOptionList &transOptList);
+  void DecodeCell(const WordsRange &range, ChartTranslationOptionList &transOptList);
+  void ProcessCellsInParallel(size_t width);
+
 public:
   ChartManager(InputType const& source);
   ~ChartManager();
@@ -80,6 +97,10 @@ public:
     return m_source;
   }
 
+  SentenceArena &GetArena() {
+    return m_arena;
+  }
+
   //! debug data collected when decoding sentence
   SentenceStats& GetSentenceStats() const {
     return *m_sentenceStats;
@@ -96,8 +117,19 @@ public:
     m_sentenceStats = std::auto_ptr<SentenceStats>(new SentenceStats(source));
   }
 
-  //! contigious hypo id for each input sentence. For debugging purposes
+  /** contigious hypo id for each input sentence. For debugging purposes.
+   *  Cells decoded in parallel count from 0 and are renumbered afterwards,
+   *  see ProcessCellsInParallel()
+   */
   unsigned GetNextHypoId() {
+#ifdef WITH_THREADS
+    if (m_parallelCells) {
+      unsigned *cellId = m_cellHypothesisId.get();
+      if (cellId) {
+        return (*cellId)++;
+      }
+    }
+#endif
     return m_hypothesisId++;
   }
 
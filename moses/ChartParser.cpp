@@ -64,6 +64,9 @@ void ChartParserUnknown::Process(const Word &sourceWord, const WordsRange &range
   Word &newWord = unksrc->GetWord(0);
   newWord.SetIsOOV(true);
 
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(m_mutex);
+#endif
   m_unksrcs.push_back(unksrc);
 
   //TranslationOption *transOpt;
@@ -151,6 +154,17 @@ ChartParser::~ChartParser()
   StaticData::Instance().CleanUpAfterSentenceProcessing(m_source);
 }
 
+bool ChartParser::IsConcurrent() const
+{
+  std::vector<ChartRuleLookupManager*>::const_iterator iter;
+  for (iter = m_ruleLookupManagers.begin(); iter != m_ruleLookupManagers.end(); ++iter) {
+    if (!(*iter)->IsConcurrent()) {
+      return false;
+    }
+  }
+  return true;
+}
+
 void ChartParser::Create(const WordsRange &wordsRange, ChartParserCallback &to)
 {
   assert(m_decodeGraphList.size() == m_ruleLookupManagers.size());
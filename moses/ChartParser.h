@@ -27,6 +27,10 @@
 #include <list>
 #include <vector>
 
+#ifdef WITH_THREADS
+#include <boost/thread/mutex.hpp>
+#endif
+
 namespace Moses
 {
 
@@ -51,6 +55,9 @@ private:
   std::vector<Phrase*> m_unksrcs;
   std::list<TargetPhraseCollection*> m_cacheTargetPhraseCollection;
   StackVec m_emptyStackVec;
+#ifdef WITH_THREADS
+  boost::mutex m_mutex; // Process() is called for all 1-word ranges at once by parallel cells
+#endif
 };
 
 class ChartParser
@@ -61,6 +68,9 @@ public:
 
   void Create(const WordsRange &range, ChartParserCallback &to);
 
+  //! whether Create() may be called concurrently for the ranges of one width
+  bool IsConcurrent() const;
+
 private:
   ChartParserUnknown m_unknown;
   std::vector <DecodeGraph*> m_decodeGraphList;
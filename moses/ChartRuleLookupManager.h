@@ -67,6 +67,14 @@ public:
     const WordsRange &range,
     ChartParserCallback &outColl) = 0;
 
+  /** Whether GetChartRuleCollection() may be called from several threads at
+   *  once for ranges with different start positions (ranges of the same
+   *  width are then looked up together, widths in increasing order).
+   */
+  virtual bool IsConcurrent() const {
+    return false;
+  }
+
 private:
   //! Non-copyable: copy constructor and assignment operator not implemented.
   ChartRuleLookupManager(const ChartRuleLookupManager &);
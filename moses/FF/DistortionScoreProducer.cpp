@@ -19,6 +19,9 @@ struct DistortionState_traditional : public FFState {
     if (range.GetEndPos() > o.range.GetEndPos()) return 1;
     return 0;
   }
+  size_t Hash() const {
+    return range.GetEndPos();
+  }
 };
 
 DistortionScoreProducer::DistortionScoreProducer(const std::string &line)
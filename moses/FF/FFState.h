@@ -2,17 +2,26 @@
 #define moses_FFState_h
 
 #include "util/check.hh"
+#include <cstddef>
 #include <vector>
+#include "moses/SentenceArena.h"
 
 
 namespace Moses
 {
 
-class FFState
+class FFState : public SentenceArenaObject
 {
 public:
   virtual ~FFState();
   virtual int Compare(const FFState& other) const = 0;
+
+  /** hash used for recombination. States that Compare() equal must hash
+   *  equal; the default makes every state collide and leaves the decision
+   *  to Compare() */
+  virtual size_t Hash() const {
+    return 0;
+  }
 };
 
 class DummyState : public FFState
@@ -22,6 +31,9 @@ public:
   int Compare(const FFState& other) const {
     return 0;
   }
+  size_t Hash() const {
+    return 0;
+  }
 };
 
 }
@@ -60,7 +60,7 @@ void FeatureFunction::Initialize(const std::string& description, const std::stri
     m_description = dstream.str();
   }
 
-  ScoreComponentCollection::RegisterScoreProducer(this);
+  m_index = ScoreComponentCollection::RegisterScoreProducer(this);
   m_producers.push_back(this);
 }
 
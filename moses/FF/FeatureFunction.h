@@ -37,6 +37,7 @@ protected:
   std::vector<std::vector<std::string> > m_args;
   bool m_tuneable;
   size_t m_numScoreComponents;
+  size_t m_index; // index of the first score of this producer in the dense score vector
   //In case there's multiple producers with the same description
   static std::multiset<std::string> description_counts;
 
@@ -68,6 +69,11 @@ public:
     return m_numScoreComponents;
   }
 
+  //! where the scores of this producer start in a ScoreComponentCollection
+  size_t GetIndex() const {
+    return m_index;
+  }
+
   //! returns a string description of this producer
   const std::string& GetScoreProducerDescription() const {
     return m_description;
@@ -116,9 +116,8 @@ void GlobalLexicalModel::InitializeForInput( Sentence const& in )
   m_local->input = &in;
 }
 
-float GlobalLexicalModel::ScorePhrase( const TargetPhrase& targetPhrase ) const
+float GlobalLexicalModel::ScorePhrase( const Sentence& input, const TargetPhrase& targetPhrase ) const
 {
-  const Sentence& input = *(m_local->input);
   float score = 0;
   for(size_t targetIndex = 0; targetIndex < targetPhrase.GetSize(); targetIndex++ ) {
     float sum = 0;
@@ -152,15 +151,22 @@ float GlobalLexicalModel::ScorePhrase( const TargetPhrase& targetPhrase ) const
   return score;
 }
 
-float GlobalLexicalModel::GetFromCacheOrScorePhrase( const TargetPhrase& targetPhrase ) const
+float GlobalLexicalModel::GetFromCacheOrScorePhrase( const InputType& input, const TargetPhrase& targetPhrase ) const
 {
-  LexiconCache& m_cache = m_local->cache;
+  // hypotheses may be scored on a thread other than the one decoding the
+  // sentence (parallel stack expansion), whose cache belongs to another input
+  ThreadLocalStorage *local = m_local.get();
+  if (local == NULL || local->input != &input) {
+    return ScorePhrase( static_cast<const Sentence&>(input), targetPhrase );
+  }
+
+  LexiconCache& m_cache = local->cache;
   const LexiconCache::const_iterator query = m_cache.find( &targetPhrase );
   if ( query != m_cache.end() ) {
     return query->second;
   }
 
-  float score = ScorePhrase( targetPhrase );
+  float score = ScorePhrase( *local->input, targetPhrase );
   m_cache.insert( pair<const TargetPhrase*, float>(&targetPhrase, score) );
   //VERBOSE(2, "add to cache " << targetPhrase << ": " << score << endl);
   return score;
@@ -171,7 +177,7 @@ void GlobalLexicalModel::Evaluate
  ScoreComponentCollection* accumulator) const
 {
   accumulator->PlusEquals( this,
-                           GetFromCacheOrScorePhrase(context.GetTargetPhrase()) );
+                           GetFromCacheOrScorePhrase(context.GetSource(), context.GetTargetPhrase()) );
 }
 
 bool GlobalLexicalModel::IsUseable(const FactorMask &mask) const
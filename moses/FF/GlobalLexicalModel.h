@@ -57,8 +57,8 @@ private:
 
   void Load();
 
-  float ScorePhrase( const TargetPhrase& targetPhrase ) const;
-  float GetFromCacheOrScorePhrase( const TargetPhrase& targetPhrase ) const;
+  float ScorePhrase( const Sentence& input, const TargetPhrase& targetPhrase ) const;
+  float GetFromCacheOrScorePhrase( const InputType& input, const TargetPhrase& targetPhrase ) const;
 
 public:
   GlobalLexicalModel(const std::string &line);
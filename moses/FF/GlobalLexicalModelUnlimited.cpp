@@ -108,7 +108,8 @@ void GlobalLexicalModelUnlimited::InitializeForInput( Sentence const& in )
 
 void GlobalLexicalModelUnlimited::Evaluate(const Hypothesis& cur_hypo, ScoreComponentCollection* accumulator) const
 {
-  const Sentence& input = *(m_local->input);
+  // not m_local: the hypothesis may be scored on another thread
+  const Sentence& input = static_cast<const Sentence&>(cur_hypo.GetInput());
   const TargetPhrase& targetPhrase = cur_hypo.GetCurrTargetPhrase();
 
   for(int targetIndex = 0; targetIndex < targetPhrase.GetSize(); targetIndex++ ) {
@@ -1,5 +1,6 @@
 #include "osmHyp.h"
 #include <sstream>
+#include <boost/functional/hash.hpp>
 
 using namespace std;
 using namespace lm::ngram;
@@ -40,6 +41,16 @@ int osmState::Compare(const FFState& otherBase) const
 }
 
 
+size_t osmState::Hash() const
+{
+  // Compare() only looks at the length of the LM state
+  size_t seed = lmState.length;
+  boost::hash_combine(seed, j);
+  boost::hash_combine(seed, E);
+  boost::hash_combine(seed, boost::hash_range(gap.begin(), gap.end()));
+  return seed;
+}
+
 std::string osmState :: getName() const
 {
 
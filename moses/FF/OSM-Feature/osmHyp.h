@@ -16,6 +16,7 @@ class osmState : public FFState
 public:
   osmState(const lm::ngram::State & val);
   int Compare(const FFState& other) const;
+  size_t Hash() const;
   void saveState(int jVal, int eVal, std::map <int , std::string> & gapVal);
   int getJ()const {
     return j;
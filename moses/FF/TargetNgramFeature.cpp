@@ -37,6 +37,11 @@ int TargetNgramState::Compare(const FFState& other) const
   }
 }
 
+size_t TargetNgramState::Hash() const
+{
+  return boost::hash_range(m_words.begin(), m_words.end());
+}
+
 TargetNgramFeature::TargetNgramFeature(const std::string &line)
   :StatefulFeatureFunction("TargetNgramFeature", 0, line)
 {
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <map>
+#include <boost/functional/hash.hpp>
 #include <boost/unordered_set.hpp>
 
 #include "StatefulFeatureFunction.h"
@@ -24,6 +25,7 @@ public:
     return m_words;
   }
   virtual int Compare(const FFState& other) const;
+  virtual size_t Hash() const;
 
 private:
   std::vector<Word> m_words;
@@ -171,6 +173,17 @@ public:
     }
     return 0;
   }
+
+  size_t Hash() const {
+    size_t seed = 0;
+    if (m_startPos > 0) {
+      boost::hash_combine(seed, GetPrefix());
+    }
+    if (m_endPos < m_inputSize - 1) {
+      boost::hash_combine(seed, GetSuffix());
+    }
+    return seed;
+  }
 };
 
 /** Sets the features of observed ngrams.
@@ -22,6 +22,7 @@
 #include <algorithm>
 #include <cmath>
 #include <fstream>
+#include <functional>
 #include <sstream>
 #include <stdexcept>
 
@@ -36,16 +37,29 @@ namespace Moses
 
 const string FName::SEP = "_";
 FName::Name2Id FName::name2id;
-vector<string> FName::id2name;
+deque<string> FName::id2name;
 FName::Id2Count FName::id2hopeCount;
 FName::Id2Count FName::id2fearCount;
 #ifdef WITH_THREADS
 boost::shared_mutex FName::m_idLock;
+boost::thread_specific_ptr<FName::Name2Id> FName::m_threadIds;
 #endif
 
 void FName::init(const StringPiece &name)
 {
 #ifdef WITH_THREADS
+  // names this thread has seen before need no lock
+  Name2Id *threadIds = m_threadIds.get();
+  if (threadIds == NULL) {
+    threadIds = new Name2Id();
+    m_threadIds.reset(threadIds);
+  }
+  Name2Id::const_iterator t = FindStringPiece(*threadIds, name);
+  if (t != threadIds->end()) {
+    m_id = t->second;
+    return;
+  }
+
   //reader lock
   boost::shared_lock<boost::shared_mutex> lock(m_idLock);
 #endif
@@ -68,6 +82,9 @@ void FName::init(const StringPiece &name)
     }
     m_id = res.first->second;
   }
+#ifdef WITH_THREADS
+  threadIds->insert(std::make_pair(std::string(name.data(), name.size()), m_id));
+#endif
 }
 
 size_t FName::getId(const string& name)
@@ -145,6 +162,10 @@ size_t FName::hash() const
 
 const std::string& FName::name() const
 {
+#ifdef WITH_THREADS
+  // id2name may be growing. Its elements don't move, though
+  boost::shared_lock<boost::shared_mutex> lock(m_idLock);
+#endif
   return id2name[m_id];
 }
 
@@ -159,6 +180,22 @@ bool FName::operator!=(const FName& rhs) const
   return ! (*this == rhs);
 }
 
+namespace
+{
+//! orders sparse features by name id
+struct FeatureLess {
+  bool operator()(const pair<FName, FValue>& lhs, const pair<FName, FValue>& rhs) const {
+    return lhs.first < rhs.first;
+  }
+};
+
+struct Assign {
+  FValue operator()(FValue /*lhs*/, FValue rhs) const {
+    return rhs;
+  }
+};
+}
+
 FVector::FVector(size_t coreFeatures) : m_coreFeatures(coreFeatures) {}
 
 void FVector::resize(size_t newsize)
@@ -299,10 +336,20 @@ ostream& operator<<(ostream& out, const FVector& fv)
   return fv.print(out);
 }
 
+FVector::const_iterator FVector::find(const FName& name) const
+{
+  const_iterator fi = lower_bound(m_features.begin(), m_features.end(),
+                                  make_pair(name, FValue()), FeatureLess());
+  if (fi != m_features.end() && fi->first == name) {
+    return fi;
+  }
+  return m_features.end();
+}
+
 const FValue& FVector::get(const FName& name) const
 {
   static const FValue DEFAULT = 0;
-  const_iterator fi = m_features.find(name);
+  const_iterator fi = find(name);
   if (fi == m_features.end()) {
     return DEFAULT;
   } else {
@@ -312,7 +359,7 @@ const FValue& FVector::get(const FName& name) const
 
 FValue FVector::getBackoff(const FName& name, float backoff) const
 {
-  const_iterator fi = m_features.find(name);
+  const_iterator fi = find(name);
   if (fi == m_features.end()) {
     return backoff;
   } else {
@@ -348,7 +395,63 @@ void FVector::capMin(FValue minValue)
 
 void FVector::set(const FName& name, const FValue& value)
 {
-  m_features[name] = value;
+  getRef(name) = value;
+}
+
+FValue& FVector::getRef(const FName& name)
+{
+  iterator fi = lower_bound(m_features.begin(), m_features.end(),
+                            make_pair(name, FValue()), FeatureLess());
+  if (fi == m_features.end() || fi->first != name) {
+    fi = m_features.insert(fi, make_pair(name, FValue()));
+  }
+  return fi->second;
+}
+
+void FVector::erase(const vector<FName>& names)
+{
+  // names are in the order of m_features, so this is a single pass
+  FNVmap::iterator out = m_features.begin();
+  vector<FName>::const_iterator n = names.begin();
+  for (FNVmap::iterator i = m_features.begin(); i != m_features.end(); ++i) {
+    if (n != names.end() && i->first == *n) {
+      ++n;
+      continue;
+    }
+    *out++ = *i;
+  }
+  m_features.erase(out, m_features.end());
+}
+
+template <class Op>
+void FVector::combine(const FVector& rhs, Op op)
+{
+  // a few updates of a long vector are binary searches, otherwise merge
+  if (rhs.m_features.size() * 16 < m_features.size()) {
+    for (const_iterator i = rhs.cbegin(); i != rhs.cend(); ++i) {
+      FValue &value = getRef(i->first);
+      value = op(value, i->second);
+    }
+    return;
+  }
+
+  FNVmap merged;
+  merged.reserve(m_features.size() + rhs.m_features.size());
+  const_iterator i = m_features.begin();
+  const_iterator j = rhs.m_features.begin();
+  while (i != m_features.end() || j != rhs.m_features.end()) {
+    if (j == rhs.m_features.end() || (i != m_features.end() && i->first < j->first)) {
+      merged.push_back(*i++);
+    } else if (i == m_features.end() || j->first < i->first) {
+      merged.push_back(make_pair(j->first, op(FValue(), j->second)));
+      ++j;
+    } else {
+      merged.push_back(make_pair(i->first, op(i->second, j->second)));
+      ++i;
+      ++j;
+    }
+  }
+  m_features.swap(merged);
 }
 
 void FVector::printCoreFeatures()
@@ -367,8 +470,7 @@ FVector& FVector::operator+= (const FVector& rhs)
 {
   if (rhs.m_coreFeatures.size() > m_coreFeatures.size())
     resize(rhs.m_coreFeatures.size());
-  for (const_iterator i = rhs.cbegin(); i != rhs.cend(); ++i)
-    set(i->first, get(i->first) + i->second);
+  combine(rhs, plus<FValue>());
   for (size_t i = 0; i < rhs.m_coreFeatures.size(); ++i)
     m_coreFeatures[i] += rhs.m_coreFeatures[i];
   return *this;
@@ -377,8 +479,7 @@ FVector& FVector::operator+= (const FVector& rhs)
 // add only sparse features
 void FVector::sparsePlusEquals(const FVector& rhs)
 {
-  for (const_iterator i = rhs.cbegin(); i != rhs.cend(); ++i)
-    set(i->first, get(i->first) + i->second);
+  combine(rhs, plus<FValue>());
 }
 
 // assign only core features
@@ -438,8 +539,7 @@ size_t FVector::pruneSparseFeatures(size_t threshold)
     }
   }
 
-  for (size_t i = 0; i < toErase.size(); ++i)
-    m_features.erase(toErase[i]);
+  erase(toErase);
 
   return count;
 }
@@ -458,8 +558,7 @@ size_t FVector::pruneZeroWeightFeatures()
     }
   }
 
-  for (size_t i = 0; i < toErase.size(); ++i)
-    m_features.erase(toErase[i]);
+  erase(toErase);
 
   return count;
 }
@@ -536,8 +635,7 @@ FVector& FVector::operator-= (const FVector& rhs)
 {
   if (rhs.m_coreFeatures.size() > m_coreFeatures.size())
     resize(rhs.m_coreFeatures.size());
-  for (const_iterator i = rhs.cbegin(); i != rhs.cend(); ++i)
-    set(i->first, get(i->first) -(i->second));
+  combine(rhs, minus<FValue>());
   for (size_t i = 0; i < m_coreFeatures.size(); ++i) {
     if (i < rhs.m_coreFeatures.size()) {
       m_coreFeatures[i] -= rhs.m_coreFeatures[i];
@@ -713,8 +811,7 @@ size_t FVector::l1regularize(float lambda)
   }
 
   // erase features that have become zero
-  for (size_t i = 0; i < toErase.size(); ++i)
-    m_features.erase(toErase[i]);
+  erase(toErase);
   numberPruned -= size();
   return numberPruned;
 }
@@ -763,8 +860,7 @@ size_t FVector::sparseL1regularize(float lambda)
   }
 
   // erase features that have become zero
-  for (size_t i = 0; i < toErase.size(); ++i)
-    m_features.erase(toErase[i]);
+  erase(toErase);
   numberPruned -= size();
   return numberPruned;
 }
@@ -794,8 +890,25 @@ FValue FVector::inner_product(const FVector& rhs) const
 {
   CHECK(m_coreFeatures.size() == rhs.m_coreFeatures.size());
   FValue product = 0.0;
-  for (const_iterator i = cbegin(); i != cend(); ++i) {
-    product += ((i->second)*(rhs.get(i->first)));
+  if (m_features.size() * 16 < rhs.m_features.size()) {
+    for (const_iterator i = cbegin(); i != cend(); ++i) {
+      product += ((i->second)*(rhs.get(i->first)));
+    }
+  } else {
+    // merge join of the two sorted arrays
+    const_iterator i = m_features.begin();
+    const_iterator j = rhs.m_features.begin();
+    while (i != m_features.end() && j != rhs.m_features.end()) {
+      if (i->first < j->first) {
+        ++i;
+      } else if (j->first < i->first) {
+        ++j;
+      } else {
+        product += i->second * j->second;
+        ++i;
+        ++j;
+      }
+    }
   }
   for (size_t i = 0; i < m_coreFeatures.size(); ++i) {
     product += m_coreFeatures[i]*rhs.m_coreFeatures[i];
@@ -817,12 +930,7 @@ void FVector::merge(const FVector &other)
   }
 
   // sparse
-  FNVmap::const_iterator iter;
-  for (iter = other.m_features.begin(); iter != other.m_features.end(); ++iter) {
-    const FName  &otherKey = iter->first;
-    const FValue otherVal = iter->second;
-    m_features[otherKey] = otherVal;
-  }
+  combine(other, Assign());
 }
 
 const FVector operator+(const FVector& lhs, const FVector& rhs)
@@ -22,6 +22,7 @@
 #ifndef FEATUREVECTOR_H
 #define FEATUREVECTOR_H
 
+#include <deque>
 #include <iostream>
 #include <map>
 #include <sstream>
@@ -42,6 +43,7 @@
 
 #ifdef WITH_THREADS
 #include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/tss.hpp>
 #endif
 
 #include "util/check.hh"
@@ -53,7 +55,10 @@ namespace Moses
 typedef float FValue;
 
 /**
- * Feature name
+ * Feature name.
+ * Names are interned into dense ids, in order of first use. Each thread keeps
+ * a cache of the names it has interned, so only the first use of a name in a
+ * thread takes the lock on the shared table.
  **/
 struct FName {
 
@@ -63,7 +68,7 @@ struct FName {
   typedef boost::unordered_map<size_t,size_t> Id2Count;
   //typedef std::map<std::string, size_t> Name2Id;
   static Name2Id name2id;
-  static std::vector<std::string> id2name;
+  static std::deque<std::string> id2name;
   static Id2Count id2hopeCount;
   static Id2Count id2fearCount;
 
@@ -87,6 +92,10 @@ struct FName {
 
   bool operator==(const FName& rhs) const ;
   bool operator!=(const FName& rhs) const ;
+  //! order of interning. Sparse features in an FVector are kept in this order
+  bool operator<(const FName& rhs) const {
+    return m_id < rhs.m_id;
+  }
 
   static size_t getId(const std::string& name);
   static size_t getHopeIdCount(const std::string& name);
@@ -101,6 +110,8 @@ private:
 #ifdef WITH_THREADS
   //reader-writer lock
   static boost::shared_mutex m_idLock;
+  //names already interned by this thread
+  static boost::thread_specific_ptr<Name2Id> m_threadIds;
 #endif
 };
 
@@ -123,6 +134,9 @@ class ProxyFVector;
 
 /**
  * A sparse feature (or weight) vector.
+ * The core features are a dense array. The sparse features are (name, value)
+ * pairs sorted by name id, so that sums and inner products of two vectors are
+ * linear merges.
  **/
 class FVector
 {
@@ -141,7 +155,7 @@ public:
   **/
   void resize(size_t newsize);
 
-  typedef boost::unordered_map<FName,FValue,FNameHash, FNameEquals> FNVmap;
+  typedef std::vector<std::pair<FName,FValue> > FNVmap;
   /** Iterators */
   typedef FNVmap::iterator iterator;
   typedef FNVmap::const_iterator const_iterator;
@@ -152,14 +166,14 @@ public:
     return m_features.end();
   }
   const_iterator cbegin() const {
-    return m_features.cbegin();
+    return m_features.begin();
   }
   const_iterator cend() const {
-    return m_features.cend();
+    return m_features.end();
   }
 
   bool hasNonDefaultValue(FName name) const {
-    return m_features.find(name) != m_features.end();
+    return find(name) != m_features.end();
   }
   void clear();
 
@@ -269,6 +283,14 @@ private:
   const FValue& get(const FName& name) const;
   FValue getBackoff(const FName& name, float backoff) const;
   void set(const FName& name, const FValue& value);
+  //! value of name, inserted as 0 if not present
+  FValue& getRef(const FName& name);
+  const_iterator find(const FName& name) const;
+  //! remove the given features. names must be in id order
+  void erase(const std::vector<FName>& names);
+  //! for each sparse feature f of rhs, set this[f] = op(this[f], rhs[f])
+  template <class Op>
+  void combine(const FVector& rhs, Op op);
 
   FNVmap m_features;
   std::valarray<FValue> m_coreFeatures;
@@ -359,15 +381,15 @@ public:
    }*/
 
   FValue operator++() {
-    return ++m_fv->m_features[m_name];
+    return ++m_fv->getRef(m_name);
   }
 
   FValue operator +=(FValue lhs) {
-    return (m_fv->m_features[m_name] += lhs);
+    return (m_fv->getRef(m_name) += lhs);
   }
 
   FValue operator -=(FValue lhs) {
-    return (m_fv->m_features[m_name] -= lhs);
+    return (m_fv->getRef(m_name) -= lhs);
   }
 
 private:
@@ -63,6 +63,8 @@ Hypothesis::Hypothesis(Manager& manager, InputType const& source, const TargetPh
   , m_transOpt(NULL)
   , m_manager(manager)
   , m_id(m_manager.GetNextHypoId())
+  , m_recombinationHash(0)
+  , m_recombinationHashComputed(false)
 {
   // used for initial seeding of trans process
   // initialize scores
@@ -77,7 +79,7 @@ Hypothesis::Hypothesis(Manager& manager, InputType const& source, const TargetPh
 /***
  * continue prevHypo by appending the phrases in transOpt
  */
-Hypothesis::Hypothesis(const Hypothesis &prevHypo, const TranslationOption &transOpt)
+Hypothesis::Hypothesis(const Hypothesis &prevHypo, const TranslationOption &transOpt, bool registerHypo)
   : m_prevHypo(&prevHypo)
   , m_targetPhrase(transOpt.GetTargetPhrase())
   , m_sourcePhrase(transOpt.GetSourcePhrase())
@@ -94,7 +96,9 @@ Hypothesis::Hypothesis(const Hypothesis &prevHypo, const TranslationOption &tran
   , m_arcList(NULL)
   , m_transOpt(&transOpt)
   , m_manager(prevHypo.GetManager())
-  , m_id(m_manager.GetNextHypoId())
+  , m_id(0)
+  , m_recombinationHash(0)
+  , m_recombinationHashComputed(false)
 {
   m_scoreBreakdown.PlusEquals(transOpt.GetScoreBreakdown());
 
@@ -105,7 +109,9 @@ Hypothesis::Hypothesis(const Hypothesis &prevHypo, const TranslationOption &tran
   //_hash_computed = false;
   m_sourceCompleted.SetValue(m_currSourceWordsRange.GetStartPos(), m_currSourceWordsRange.GetEndPos(), true);
   m_wordDeleted = transOpt.IsDeletionOption();
-  m_manager.GetSentenceStats().AddCreated();
+  if (registerHypo) {
+    Register();
+  }
 }
 
 Hypothesis::~Hypothesis()
@@ -125,6 +131,12 @@ Hypothesis::~Hypothesis()
   }
 }
 
+void Hypothesis::Register()
+{
+  m_id = m_manager.GetNextHypoId();
+  m_manager.GetSentenceStats().AddCreated();
+}
+
 void Hypothesis::AddArc(Hypothesis *loserHypo)
 {
   if (!m_arcList) {
@@ -152,15 +164,15 @@ void Hypothesis::AddArc(Hypothesis *loserHypo)
 /***
  * return the subclass of Hypothesis most appropriate to the given translation option
  */
-Hypothesis* Hypothesis::CreateNext(const TranslationOption &transOpt, const Phrase* constraint) const
+Hypothesis* Hypothesis::CreateNext(const TranslationOption &transOpt, const Phrase* constraint, bool registerHypo) const
 {
-  return Create(*this, transOpt, constraint);
+  return Create(*this, transOpt, constraint, registerHypo);
 }
 
 /***
  * return the subclass of Hypothesis most appropriate to the given translation option
  */
-Hypothesis* Hypothesis::Create(const Hypothesis &prevHypo, const TranslationOption &transOpt, const Phrase* constrainingPhrase)
+Hypothesis* Hypothesis::Create(const Hypothesis &prevHypo, const TranslationOption &transOpt, const Phrase* constrainingPhrase, bool registerHypo)
 {
 
   // This method includes code for constraint decoding
@@ -198,9 +210,9 @@ Hypothesis* Hypothesis::Create(const Hypothesis &prevHypo, const TranslationOpti
 
 #ifdef USE_HYPO_POOL
     Hypothesis *ptr = s_objectPool.getPtr();
-    return new(ptr) Hypothesis(prevHypo, transOpt);
+    return new(ptr) Hypothesis(prevHypo, transOpt, registerHypo);
 #else
-    return new Hypothesis(prevHypo, transOpt);
+    return new Hypothesis(prevHypo, transOpt, registerHypo);
 #endif
 
   } else {
@@ -251,6 +263,20 @@ int Hypothesis::RecombineCompare(const Hypothesis &compare) const
   return 0;
 }
 
+size_t Hypothesis::GetRecombinationHash() const
+{
+  if (!m_recombinationHashComputed) {
+    size_t seed = m_sourceCompleted.Hash();
+    for (unsigned i = 0; i < m_ffStates.size(); ++i) {
+      // RecombineCompare() only matches a missing state with a missing state
+      boost::hash_combine(seed, m_ffStates[i] ? m_ffStates[i]->Hash() : 0);
+    }
+    m_recombinationHash = seed;
+    m_recombinationHashComputed = true;
+  }
+  return m_recombinationHash;
+}
+
 void Hypothesis::EvaluateWith(const StatefulFeatureFunction &sfff,
                               int state_idx)
 {
@@ -276,8 +302,6 @@ void Hypothesis::EvaluateWith(const StatelessFeatureFunction& slff)
  */
 void Hypothesis::Evaluate(const SquareMatrix &futureScore)
 {
-  clock_t t=0; // used to track time
-
   // some stateless score producers cache their values in the translation
   // option: add these here
   // language model scores for n-grams completely contained within a target
@@ -304,6 +328,13 @@ void Hypothesis::Evaluate(const SquareMatrix &futureScore)
     }
   }
 
+  EvaluateTotalScore(futureScore);
+}
+
+void Hypothesis::EvaluateTotalScore(const SquareMatrix &futureScore)
+{
+  clock_t t=0; // used to track time
+
   IFVERBOSE(2) {
     t = clock();  // track time excluding LM
   }
@@ -35,6 +35,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "ScoreComponentCollection.h"
 #include "InputType.h"
 #include "ObjectPool.h"
+#include "SentenceArena.h"
 
 namespace Moses
 {
@@ -60,7 +61,7 @@ typedef std::vector<Hypothesis*> ArcList;
 		The expansion of hypotheses is handled in the class Manager, which
     stores active hypothesis in the search in hypothesis stacks.
 ***/
-class Hypothesis
+class Hypothesis : public SentenceArenaObject
 {
   friend std::ostream& operator<<(std::ostream&, const Hypothesis&);
 
@@ -88,11 +89,13 @@ protected:
   Manager& m_manager;
 
   int m_id; /*! numeric ID of this hypothesis, used for logging */
+  mutable size_t m_recombinationHash; /*! cached GetRecombinationHash() */
+  mutable bool m_recombinationHashComputed;
 
   /*! used by initial seeding of the translation process */
   Hypothesis(Manager& manager, InputType const& source, const TargetPhrase &emptyTarget);
   /*! used when creating a new hypothesis using a translation option (phrase translation) */
-  Hypothesis(const Hypothesis &prevHypo, const TranslationOption &transOpt);
+  Hypothesis(const Hypothesis &prevHypo, const TranslationOption &transOpt, bool registerHypo);
 
 public:
   static ObjectPool<Hypothesis> &GetObjectPool() {
@@ -102,7 +105,7 @@ public:
   ~Hypothesis();
 
   /** return the subclass of Hypothesis most appropriate to the given translation option */
-  static Hypothesis* Create(const Hypothesis &prevHypo, const TranslationOption &transOpt, const Phrase* constraint);
+  static Hypothesis* Create(const Hypothesis &prevHypo, const TranslationOption &transOpt, const Phrase* constraint, bool registerHypo = true);
 
   static Hypothesis* Create(Manager& manager, const WordsBitmap &initialCoverage);
 
@@ -110,7 +113,12 @@ public:
   static Hypothesis* Create(Manager& manager, InputType const& source, const TargetPhrase &emptyTarget);
 
   /** return the subclass of Hypothesis most appropriate to the given translation option */
-  Hypothesis* CreateNext(const TranslationOption &transOpt, const Phrase* constraint) const;
+  Hypothesis* CreateNext(const TranslationOption &transOpt, const Phrase* constraint, bool registerHypo = true) const;
+
+  /** assign the ID and count the hypothesis in the sentence stats. Done by the
+   *  constructor unless registerHypo is false, which lets hypotheses be built on
+   *  other threads and registered later, in the order of the serial decoder */
+  void Register();
 
   void PrintHypothesis() const;
 
@@ -144,6 +152,8 @@ public:
   }
 
   void Evaluate(const SquareMatrix &futureScore);
+  //! future and total score, once all feature functions have been evaluated
+  void EvaluateTotalScore(const SquareMatrix &futureScore);
 
   int GetId()const {
     return m_id;
@@ -200,6 +210,10 @@ public:
 
   int RecombineCompare(const Hypothesis &compare) const;
 
+  /** hash of the coverage and the feature function states, consistent with
+   *  RecombineCompare(). Computed once the states are final, on first use */
+  size_t GetRecombinationHash() const;
+
   void GetOutputPhrase(Phrase &out) const;
 
   void ToStream(std::ostream& out) const {
@@ -2,8 +2,8 @@
 #define moses_HypothesisStack_h
 
 #include <vector>
-#include <set>
 #include "Hypothesis.h"
+#include "RecombinationTable.h"
 #include "WordsBitmap.h"
 
 namespace Moses
@@ -18,7 +18,7 @@ class HypothesisStack
 {
 
 protected:
-  typedef std::set< Hypothesis*, HypothesisRecombinationOrderer > _HCType;
+  typedef RecombinationTable<Hypothesis> _HCType;
   _HCType m_hypos; /**< contains hypotheses */
   Manager& m_manager;
 
@@ -20,8 +20,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 ***********************************************************************/
 
 #include <algorithm>
-#include <set>
-#include <queue>
+#include <boost/unordered_map.hpp>
 #include "HypothesisStackNormal.h"
 #include "TypeDef.h"
 #include "Util.h"
@@ -149,49 +148,61 @@ void HypothesisStackNormal::PruneToSize(size_t newSize)
   if ( size() <= newSize ) return; // ok, if not over the limit
 
   // we need to store a temporary list of hypotheses
-  vector< Hypothesis* > hypos = GetSortedListNOTCONST();
-  bool* included = (bool*) malloc(sizeof(bool) * hypos.size());
-  for(size_t i=0; i<hypos.size(); i++) included[i] = false;
+  vector< Hypothesis* > hypos(m_hypos.begin(), m_hypos.end());
+  vector< bool > included(hypos.size(), false);
 
   // clear out original set
-  for( iterator iter = m_hypos.begin(); iter != m_hypos.end(); ) {
-    iterator removeHyp = iter++;
-    Detach(removeHyp);
-  }
+  m_hypos.clear();
 
-  // add best hyps for each coverage according to minStackDiversity
   if ( m_minHypoStackDiversity > 0 ) {
-    map< WordsBitmapID, size_t > diversityCount;
+    // diversity needs the hypotheses in order of score
+    sort(hypos.begin(), hypos.end(), CompareHypothesisTotalScore());
+
+    // add best hyps for each coverage according to minStackDiversity
+    boost::unordered_map< WordsBitmapID, size_t > diversityCount;
     for(size_t i=0; i<hypos.size(); i++) {
       Hypothesis *hyp = hypos[i];
-      WordsBitmapID coverage = hyp->GetWordsBitmap().GetID();;
-      if (diversityCount.find( coverage ) == diversityCount.end())
-        diversityCount[ coverage ] = 0;
+      WordsBitmapID coverage = hyp->GetWordsBitmap().GetID();
+      size_t &count = diversityCount[ coverage ];
 
-      if (diversityCount[ coverage ] < m_minHypoStackDiversity) {
+      if (count < m_minHypoStackDiversity) {
         m_hypos.insert( hyp );
         included[i] = true;
-        diversityCount[ coverage ]++;
-        if (diversityCount[ coverage ] == m_minHypoStackDiversity)
+        count++;
+        if (count == m_minHypoStackDiversity)
           SetWorstScoreForBitmap( coverage, hyp->GetTotalScore());
       }
     }
-  }
 
-  // only add more if stack not full after satisfying minStackDiversity
-  if ( size() < newSize ) {
+    // only add more if stack not full after satisfying minStackDiversity
+    if ( size() < newSize ) {
+
+      // add best remaining hypotheses
+      for(size_t i=0; i<hypos.size()
+          && size() < newSize
+          && hypos[i]->GetTotalScore() > m_bestScore+m_beamWidth; i++) {
+        if (! included[i]) {
+          m_hypos.insert( hypos[i] );
+          included[i] = true;
+          if (size() == newSize)
+            m_worstScore = hypos[i]->GetTotalScore();
+        }
+      }
+    }
+  } else if (newSize > 0) {
+    // only the newSize best can stay: partition rather than sort
+    vector< Hypothesis* >::iterator nth = hypos.begin() + newSize - 1;
+    nth_element(hypos.begin(), nth, hypos.end(), CompareHypothesisTotalScore());
 
-    // add best remaining hypotheses
-    for(size_t i=0; i<hypos.size()
-        && size() < newSize
-        && hypos[i]->GetTotalScore() > m_bestScore+m_beamWidth; i++) {
-      if (! included[i]) {
+    for(size_t i=0; i<newSize; i++) {
+      if (hypos[i]->GetTotalScore() > m_bestScore+m_beamWidth) {
         m_hypos.insert( hypos[i] );
         included[i] = true;
-        if (size() == newSize)
-          m_worstScore = hypos[i]->GetTotalScore();
       }
     }
+    // the stack is full: the worst of the best is the new threshold
+    if (size() == newSize)
+      m_worstScore = (*nth)->GetTotalScore();
   }
 
   // delete hypotheses that have not been included
@@ -201,7 +212,6 @@ void HypothesisStackNormal::PruneToSize(size_t newSize)
       m_manager.GetSentenceStats().AddPruning();
     }
   }
-  free(included);
 
   // some reporting....
   VERBOSE(3,", pruned to size " << size() << endl);
@@ -45,15 +45,13 @@ LanguageModel::~LanguageModel() {}
 
 float LanguageModel::GetWeight() const
 {
-  //return StaticData::Instance().GetAllWeights().GetScoresForProducer(this)[0];
-  return StaticData::Instance().GetWeights(this)[0];
+  return StaticData::Instance().GetAllWeights().GetScoreComponent(this, 0);
 }
 
 float LanguageModel::GetOOVWeight() const
 {
   if (m_enableOOVFeature) {
-    //return StaticData::Instance().GetAllWeights().GetScoresForProducer(this)[1];
-    return StaticData::Instance().GetWeights(this)[1];
+    return StaticData::Instance().GetAllWeights().GetScoreComponent(this, 1);
   } else {
     return 0;
   }
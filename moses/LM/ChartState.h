@@ -165,6 +165,18 @@ public:
     }
     return 0;
   }
+
+  size_t Hash() const {
+    size_t seed = 0;
+    if (m_hypo.GetCurrSourceRange().GetStartPos() > 0) {
+      boost::hash_combine(seed, GetPrefix());
+    }
+    size_t inputSize = m_hypo.GetManager().GetSource().GetSize();
+    if (m_hypo.GetCurrSourceRange().GetEndPos() < inputSize - 1) {
+      boost::hash_combine(seed, m_lmRightContext->Hash());
+    }
+    return seed;
+  }
 };
 
 } // namespace
@@ -265,7 +265,7 @@ FFState* LanguageModelImplementation::EvaluateChart(const ChartHypothesis& hypo,
 
         // get prefixScore and finalizedScore
         prefixScore = prevState->GetPrefixScore();
-        finalizedScore = prevHypo->GetScoreBreakdown().GetScoresForProducer(this)[0] - prefixScore;
+        finalizedScore = prevHypo->GetScoreBreakdown().GetScoreComponent(this, 0) - prefixScore;
 
         // get language model state
         delete lmState;
@@ -297,7 +297,7 @@ FFState* LanguageModelImplementation::EvaluateChart(const ChartHypothesis& hypo,
         if (subPhraseLength > GetNGramOrder() - 1) {
           // add its finalized language model score
           finalizedScore +=
-            prevHypo->GetScoreBreakdown().GetScoresForProducer(this)[0] // full score
+            prevHypo->GetScoreBreakdown().GetScoreComponent(this, 0) // full score
             - prevState->GetPrefixScore();                              // - prefix score
 
           // copy language model state
@@ -19,11 +19,19 @@ License along with this library; if not, write to the Free Software
 Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 ***********************************************************************/
 
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <memory>
 #include <stdlib.h>
+#include <vector>
+#include <boost/functional/hash.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+
+#ifdef WITH_THREADS
+#include <boost/thread/tss.hpp>
+#endif
 
 #include "lm/binary_format.hh"
 #include "lm/enumerate_vocab.hh"
@@ -58,6 +66,9 @@ struct KenLMState : public FFState {
     if (state.length > other.state.length) return 1;
     return std::memcmp(state.words, other.state.words, sizeof(lm::WordIndex) * state.length);
   }
+  size_t Hash() const {
+    return lm::ngram::hash_value(state);
+  }
 };
 
 /*
@@ -78,6 +89,10 @@ public:
 
   FFState *Evaluate(const Hypothesis &hypo, const FFState *ps, ScoreComponentCollection *out) const;
 
+  void IssueRequestsFor(Hypothesis &hypo, const FFState *input_state);
+
+  void sync();
+
   FFState *EvaluateChart(const ChartHypothesis& cur_hypo, int featureID, ScoreComponentCollection *accumulator) const;
 
   void IncrementalCallback(Incremental::Manager &manager) const {
@@ -108,6 +123,51 @@ private:
     }
   }
 
+  float Score(const Hypothesis &hypo, const lm::ngram::State &in_state, lm::ngram::State &out_state) const;
+
+  /* Requests issued for a batch of hypotheses (see SearchNormalBatch).  The
+   * score of a hypothesis only depends on the previous state and on the
+   * words of the new target phrase (and, at the end of the sentence, on the
+   * words before it), so expansions sharing these are scored once.
+   */
+  struct BatchKey {
+    lm::ngram::State state;
+    std::vector<lm::WordIndex> words;
+    bool sourceCompleted;
+
+    bool operator==(const BatchKey &other) const {
+      return sourceCompleted == other.sourceCompleted && state == other.state && words == other.words;
+    }
+  };
+  struct BatchKeyHasher {
+    size_t operator()(const BatchKey &key) const {
+      size_t seed = lm::ngram::hash_value(key.state, key.sourceCompleted);
+      boost::hash_range(seed, key.words.begin(), key.words.end());
+      return seed;
+    }
+  };
+  struct BatchResult {
+    float score;
+    lm::ngram::State state;
+  };
+  struct Batch {
+    // unique requests, with one of the hypotheses that issued them
+    boost::unordered_map<BatchKey, const Hypothesis*, BatchKeyHasher> requests;
+    // scored by the last sync()
+    boost::unordered_map<BatchKey, BatchResult, BatchKeyHasher> results;
+    size_t issued;
+
+    Batch() : issued(0) {}
+  };
+
+#ifdef WITH_THREADS
+  mutable boost::thread_specific_ptr<Batch> m_batch;
+#else
+  mutable std::auto_ptr<Batch> m_batch;
+#endif
+
+  void MakeBatchKey(const Hypothesis &hypo, const lm::ngram::State &in_state, BatchKey &key) const;
+
   boost::shared_ptr<Model> m_ngram;
 
   std::vector<lm::WordIndex> m_lmIdLookup;
@@ -230,6 +290,37 @@ template <class Model> FFState *LanguageModelKen<Model>::Evaluate(const Hypothes
     return ret.release();
   }
 
+  float score;
+  const BatchResult *result = NULL;
+  if (m_batch.get() && !m_batch->results.empty()) {
+    BatchKey key;
+    MakeBatchKey(hypo, in_state, key);
+    typename boost::unordered_map<BatchKey, BatchResult, BatchKeyHasher>::const_iterator iter = m_batch->results.find(key);
+    if (iter != m_batch->results.end()) {
+      result = &iter->second;
+    }
+  }
+  if (result) {
+    score = result->score;
+    ret->state = result->state;
+  } else {
+    score = Score(hypo, in_state, ret->state);
+  }
+
+  if (OOVFeatureEnabled()) {
+    std::vector<float> scores(2);
+    scores[0] = score;
+    scores[1] = 0.0;
+    out->PlusEquals(this, scores);
+  } else {
+    out->PlusEquals(this, score);
+  }
+
+  return ret.release();
+}
+
+template <class Model> float LanguageModelKen<Model>::Score(const Hypothesis &hypo, const lm::ngram::State &in_state, lm::ngram::State &out_state) const
+{
   const std::size_t begin = hypo.GetCurrTargetWordsRange().GetStartPos();
   //[begin, end) in STL-like fashion.
   const std::size_t end = hypo.GetCurrTargetWordsRange().GetEndPos() + 1;
@@ -237,7 +328,7 @@ template <class Model> FFState *LanguageModelKen<Model>::Evaluate(const Hypothes
 
   std::size_t position = begin;
   typename Model::State aux_state;
-  typename Model::State *state0 = &ret->state, *state1 = &aux_state;
+  typename Model::State *state0 = &out_state, *state1 = &aux_state;
 
   float score = m_ngram->Score(in_state, TranslateID(hypo.GetWord(position)), *state0);
   ++position;
@@ -250,29 +341,85 @@ template <class Model> FFState *LanguageModelKen<Model>::Evaluate(const Hypothes
     // Score end of sentence.
     std::vector<lm::WordIndex> indices(m_ngram->Order() - 1);
     const lm::WordIndex *last = LastIDs(hypo, &indices.front());
-    score += m_ngram->FullScoreForgotState(&indices.front(), last, m_ngram->GetVocabulary().EndSentence(), ret->state).prob;
+    score += m_ngram->FullScoreForgotState(&indices.front(), last, m_ngram->GetVocabulary().EndSentence(), out_state).prob;
   } else if (adjust_end < end) {
     // Get state after adding a long phrase.
     std::vector<lm::WordIndex> indices(m_ngram->Order() - 1);
     const lm::WordIndex *last = LastIDs(hypo, &indices.front());
-    m_ngram->GetState(&indices.front(), last, ret->state);
-  } else if (state0 != &ret->state) {
+    m_ngram->GetState(&indices.front(), last, out_state);
+  } else if (state0 != &out_state) {
     // Short enough phrase that we can just reuse the state.
-    ret->state = *state0;
+    out_state = *state0;
   }
 
-  score = TransformLMScore(score);
+  return TransformLMScore(score);
+}
 
-  if (OOVFeatureEnabled()) {
-    std::vector<float> scores(2);
-    scores[0] = score;
-    scores[1] = 0.0;
-    out->PlusEquals(this, scores);
-  } else {
-    out->PlusEquals(this, score);
+template <class Model> void LanguageModelKen<Model>::MakeBatchKey(const Hypothesis &hypo, const lm::ngram::State &in_state, BatchKey &key) const
+{
+  key.state = in_state;
+  key.sourceCompleted = hypo.IsSourceCompleted();
+
+  const WordsRange &range = hypo.GetCurrTargetWordsRange();
+  key.words.reserve(range.GetNumWordsCovered() + m_ngram->Order() - 1);
+  for (size_t position = range.GetStartPos(); position <= range.GetEndPos(); ++position) {
+    key.words.push_back(TranslateID(hypo.GetWord(position)));
   }
+  if (key.sourceCompleted) {
+    // end of sentence is scored with the last words of the whole hypothesis
+    std::vector<lm::WordIndex> indices(m_ngram->Order() - 1);
+    lm::WordIndex *last = LastIDs(hypo, &indices.front());
+    key.words.insert(key.words.end(), &indices.front(), last);
+  }
+}
 
-  return ret.release();
+template <class Model> void LanguageModelKen<Model>::IssueRequestsFor(Hypothesis &hypo, const FFState *input_state)
+{
+  if (!input_state || !hypo.GetCurrTargetLength()) return;
+
+  if (m_batch.get() == NULL) {
+    m_batch.reset(new Batch());
+  }
+
+  BatchKey key;
+  MakeBatchKey(hypo, static_cast<const KenLMState&>(*input_state).state, key);
+  m_batch->requests.insert(std::make_pair(key, &hypo));
+  ++m_batch->issued;
+}
+
+template <class Iterator> struct CompareBatchRequests {
+  bool operator()(const Iterator &a, const Iterator &b) const {
+    return a->first.state < b->first.state;
+  }
+};
+
+template <class Model> void LanguageModelKen<Model>::sync()
+{
+  if (m_batch.get() == NULL) return;
+
+  typedef typename boost::unordered_map<BatchKey, const Hypothesis*, BatchKeyHasher>::const_iterator RequestIter;
+  Batch &batch = *m_batch;
+
+  // score requests with the same context together, so its n-grams are
+  // still cached when the next phrase after it is scored
+  std::vector<RequestIter> requests;
+  requests.reserve(batch.requests.size());
+  for (RequestIter iter = batch.requests.begin(); iter != batch.requests.end(); ++iter) {
+    requests.push_back(iter);
+  }
+  std::sort(requests.begin(), requests.end(), CompareBatchRequests<RequestIter>());
+
+  batch.results.clear();
+  batch.results.rehash(requests.size());
+  for (typename std::vector<RequestIter>::const_iterator iter = requests.begin(); iter != requests.end(); ++iter) {
+    const BatchKey &key = (*iter)->first;
+    BatchResult &result = batch.results[key];
+    result.score = Score(*(*iter)->second, key.state, result.state);
+  }
+  VERBOSE(3, GetScoreProducerDescription() << " batch: " << batch.issued << " requests, "
+          << requests.size() << " scored" << std::endl);
+  batch.requests.clear();
+  batch.issued = 0;
 }
 
 class LanguageModelChartStateKenLM : public FFState
@@ -293,6 +440,18 @@ public:
     return ret;
   }
 
+  size_t Hash() const {
+    // not lm::ngram::hash_value(ChartState): it also hashes the full flag of
+    // an empty left state, which Compare() ignores
+    const lm::ngram::Left &left = m_state.left;
+    size_t seed = left.length;
+    if (left.length) {
+      boost::hash_combine(seed, left.pointers[left.length - 1]);
+      boost::hash_combine(seed, left.full);
+    }
+    return lm::ngram::hash_value(m_state.right, seed);
+  }
+
 private:
   lm::ngram::ChartState m_state;
 };
@@ -318,7 +477,7 @@ template <class Model> FFState *LanguageModelKen<Model>::EvaluateChart(const Cha
       // Non-terminal is first so we can copy instead of rescoring.
       const ChartHypothesis *prevHypo = hypo.GetPrevHypo(nonTermIndexMap[phrasePos]);
       const lm::ngram::ChartState &prevState = static_cast<const LanguageModelChartStateKenLM*>(prevHypo->GetFFState(featureID))->GetChartState();
-      float prob = UntransformLMScore(prevHypo->GetScoreBreakdown().GetScoresForProducer(this)[0]);
+      float prob = UntransformLMScore(prevHypo->GetScoreBreakdown().GetScoreComponent(this, 0));
       ruleScore.BeginNonTerminal(prevState, prob);
       phrasePos++;
     }
@@ -329,7 +488,7 @@ template <class Model> FFState *LanguageModelKen<Model>::EvaluateChart(const Cha
     if (word.IsNonTerminal()) {
       const ChartHypothesis *prevHypo = hypo.GetPrevHypo(nonTermIndexMap[phrasePos]);
       const lm::ngram::ChartState &prevState = static_cast<const LanguageModelChartStateKenLM*>(prevHypo->GetFFState(featureID))->GetChartState();
-      float prob = UntransformLMScore(prevHypo->GetScoreBreakdown().GetScoresForProducer(this)[0]);
+      float prob = UntransformLMScore(prevHypo->GetScoreBreakdown().GetScoreComponent(this, 0));
       ruleScore.NonTerminal(prevState, prob);
     } else {
       ruleScore.Terminal(TranslateID(word));
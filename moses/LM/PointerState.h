@@ -16,6 +16,9 @@ struct PointerState : public FFState {
     else if (other.lmstate < lmstate) return -1;
     return 0;
   }
+  size_t Hash() const {
+    return reinterpret_cast<size_t>(lmstate);
+  }
 };
 
 } // namespace
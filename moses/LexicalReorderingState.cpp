@@ -203,6 +203,12 @@ int PhraseBasedReorderingState::Compare(const FFState& o) const
   return 1;
 }
 
+// the previous scores are left out: equal states still hash equal
+size_t PhraseBasedReorderingState::Hash() const
+{
+  return hash_value(m_prevRange);
+}
+
 LexicalReorderingState* PhraseBasedReorderingState::Expand(const TranslationOption& topt, Scores& scores) const
 {
   ReorderingType reoType;
@@ -301,6 +307,13 @@ int BidirectionalReorderingState::Compare(const FFState& o) const
     return m_forward->Compare(*other.m_forward);
 }
 
+size_t BidirectionalReorderingState::Hash() const
+{
+  size_t seed = m_backward->Hash();
+  boost::hash_combine(seed, m_forward->Hash());
+  return seed;
+}
+
 LexicalReorderingState* BidirectionalReorderingState::Expand(const TranslationOption& topt, Scores& scores) const
 {
   LexicalReorderingState *newbwd = m_backward->Expand(topt, scores);
@@ -325,6 +338,11 @@ int HierarchicalReorderingBackwardState::Compare(const FFState& o) const
   return m_reoStack.Compare(other.m_reoStack);
 }
 
+size_t HierarchicalReorderingBackwardState::Hash() const
+{
+  return m_reoStack.Hash();
+}
+
 LexicalReorderingState* HierarchicalReorderingBackwardState::Expand(const TranslationOption& topt, Scores& scores) const
 {
 
@@ -417,6 +435,11 @@ int HierarchicalReorderingForwardState::Compare(const FFState& o) const
   return 1;
 }
 
+size_t HierarchicalReorderingForwardState::Hash() const
+{
+  return hash_value(m_prevRange);
+}
+
 // For compatibility with the phrase-based reordering model, scoring is one step delayed.
 // The forward model takes determines orientations heuristically as follows:
 //  mono:   if the next phrase comes after the conditioning phrase and
@@ -457,7 +480,7 @@ LexicalReorderingState* HierarchicalReorderingForwardState::Expand(const Transla
   return new HierarchicalReorderingForwardState(this, topt);
 }
 
-LexicalReorderingState::ReorderingType HierarchicalReorderingForwardState::GetOrientationTypeMSD(WordsRange currRange, WordsBitmap coverage) const
+LexicalReorderingState::ReorderingType HierarchicalReorderingForwardState::GetOrientationTypeMSD(WordsRange currRange, const WordsBitmap &coverage) const
 {
   if (currRange.GetStartPos() > m_prevRange.GetEndPos() &&
       (!coverage.GetValue(m_prevRange.GetEndPos()+1) || currRange.GetStartPos() == m_prevRange.GetEndPos()+1)) {
@@ -469,7 +492,7 @@ LexicalReorderingState::ReorderingType HierarchicalReorderingForwardState::GetOr
   return D;
 }
 
-LexicalReorderingState::ReorderingType HierarchicalReorderingForwardState::GetOrientationTypeMSLR(WordsRange currRange, WordsBitmap coverage) const
+LexicalReorderingState::ReorderingType HierarchicalReorderingForwardState::GetOrientationTypeMSLR(WordsRange currRange, const WordsBitmap &coverage) const
 {
   if (currRange.GetStartPos() > m_prevRange.GetEndPos() &&
       (!coverage.GetValue(m_prevRange.GetEndPos()+1) || currRange.GetStartPos() == m_prevRange.GetEndPos()+1)) {
@@ -483,7 +506,7 @@ LexicalReorderingState::ReorderingType HierarchicalReorderingForwardState::GetOr
   return DL;
 }
 
-LexicalReorderingState::ReorderingType HierarchicalReorderingForwardState::GetOrientationTypeMonotonic(WordsRange currRange, WordsBitmap coverage) const
+LexicalReorderingState::ReorderingType HierarchicalReorderingForwardState::GetOrientationTypeMonotonic(WordsRange currRange, const WordsBitmap &coverage) const
 {
   if (currRange.GetStartPos() > m_prevRange.GetEndPos() &&
       (!coverage.GetValue(m_prevRange.GetEndPos()+1) || currRange.GetStartPos() == m_prevRange.GetEndPos()+1)) {
@@ -492,7 +515,7 @@ LexicalReorderingState::ReorderingType HierarchicalReorderingForwardState::GetOr
   return NM;
 }
 
-LexicalReorderingState::ReorderingType HierarchicalReorderingForwardState::GetOrientationTypeLeftRight(WordsRange currRange, WordsBitmap /* coverage */) const
+LexicalReorderingState::ReorderingType HierarchicalReorderingForwardState::GetOrientationTypeLeftRight(WordsRange currRange, const WordsBitmap &/* coverage */) const
 {
   if (currRange.GetStartPos() > m_prevRange.GetEndPos()) {
     return R;
@@ -86,6 +86,7 @@ class LexicalReorderingState : public FFState
 {
 public:
   virtual int Compare(const FFState& o) const = 0;
+  virtual size_t Hash() const = 0;
   virtual LexicalReorderingState* Expand(const TranslationOption& hypo, Scores& scores) const = 0;
 
   static LexicalReorderingState* CreateLexicalReorderingState(const std::vector<std::string>& config,
@@ -140,6 +141,7 @@ public:
   }
 
   virtual int Compare(const FFState& o) const;
+  virtual size_t Hash() const;
   virtual LexicalReorderingState* Expand(const TranslationOption& topt, Scores& scores) const;
 };
 
@@ -156,6 +158,7 @@ public:
   PhraseBasedReorderingState(const PhraseBasedReorderingState *prev, const TranslationOption &topt);
 
   virtual int Compare(const FFState& o) const;
+  virtual size_t Hash() const;
   virtual LexicalReorderingState* Expand(const TranslationOption& topt, Scores& scores) const;
 
   ReorderingType GetOrientationTypeMSD(WordsRange currRange) const;
@@ -177,6 +180,7 @@ public:
                                       const TranslationOption &topt, ReorderingStack reoStack);
 
   virtual int Compare(const FFState& o) const;
+  virtual size_t Hash() const;
   virtual LexicalReorderingState* Expand(const TranslationOption& hypo, Scores& scores) const;
 
 private:
@@ -200,13 +204,14 @@ public:
   HierarchicalReorderingForwardState(const HierarchicalReorderingForwardState *prev, const TranslationOption &topt);
 
   virtual int Compare(const FFState& o) const;
+  virtual size_t Hash() const;
   virtual LexicalReorderingState* Expand(const TranslationOption& hypo, Scores& scores) const;
 
 private:
-  ReorderingType GetOrientationTypeMSD(WordsRange currRange, WordsBitmap coverage) const;
-  ReorderingType GetOrientationTypeMSLR(WordsRange currRange, WordsBitmap coverage) const;
-  ReorderingType GetOrientationTypeMonotonic(WordsRange currRange, WordsBitmap coverage) const;
-  ReorderingType GetOrientationTypeLeftRight(WordsRange currRange, WordsBitmap coverage) const;
+  ReorderingType GetOrientationTypeMSD(WordsRange currRange, const WordsBitmap &coverage) const;
+  ReorderingType GetOrientationTypeMSLR(WordsRange currRange, const WordsBitmap &coverage) const;
+  ReorderingType GetOrientationTypeMonotonic(WordsRange currRange, const WordsBitmap &coverage) const;
+  ReorderingType GetOrientationTypeLeftRight(WordsRange currRange, const WordsBitmap &coverage) const;
 };
 
 }
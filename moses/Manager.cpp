@@ -79,6 +79,8 @@ Manager::~Manager()
  */
 void Manager::ProcessSentence()
 {
+  SentenceArena::Scope arenaScope(&m_arena);
+
   // reset statistics
   ResetSentenceStats(m_source);
 
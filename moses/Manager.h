@@ -34,6 +34,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "WordsBitmap.h"
 #include "Search.h"
 #include "SearchCubePruning.h"
+#include "SentenceArena.h"
 
 namespace Moses
 {
@@ -111,6 +112,7 @@ private:
 
 protected:
   // data
+  SentenceArena m_arena; /**< hypotheses, translation options and states of this sentence. must be destroyed last */
 //	InputType const& m_source; /**< source sentence to be translated */
   TranslationOptionCollection *m_transOptColl; /**< pre-computed list of translation options for the phrases in this sentence */
   Search *m_search;
@@ -145,6 +147,9 @@ public:
   void printThisHypothesis(long translationId, const Hypothesis* hypo, const std::vector <const TargetPhrase* > & remainingPhrases, float remainingScore , std::ostream& outputStream) const;
   void GetWordGraph(long translationId, std::ostream &outputWordGraphStream) const;
   int GetNextHypoId();
+  SentenceArena &GetArena() {
+    return m_arena;
+  }
 #ifdef HAVE_PROTOBUF
   void SerializeSearchGraphPB(long translationId, std::ostream& outputStream) const;
 #endif
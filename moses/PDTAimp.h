@@ -157,14 +157,11 @@ public:
     //TODO: Multiple models broken here
     std::vector<float> weights = StaticData::Instance().GetWeights(m_obj);
 
-    std::vector<TargetPhrase> tCands;
-    tCands.reserve(cands.size());
-    std::vector<std::pair<float,size_t> > costs;
-    costs.reserve(cands.size());
+    std::vector<TargetPhrase> tCands(cands.size());
 
     // convert into TargetPhrases
     for(size_t i=0; i<cands.size(); ++i) {
-      TargetPhrase targetPhrase;
+      TargetPhrase &targetPhrase = tCands[i];
 
       StringTgtCand::Tokens const& factorStrings=cands[i].tokens;
       Scores const& probVector=cands[i].scores;
@@ -182,12 +179,11 @@ public:
       }
 
       CreateTargetPhrase(targetPhrase,factorStrings,scoreVector, Scores(0), &wacands[i], &src);
-      costs.push_back(std::make_pair(-targetPhrase.GetFutureScore(),tCands.size()));
-      tCands.push_back(targetPhrase);
     }
 
-    TargetPhraseCollection *rv;
-    rv=PruneTargetCandidates(tCands,costs);
+    // keep the best m_tableLimit, only copying these
+    TargetPhraseCollection *rv=new TargetPhraseCollection;
+    rv->AddBest(tCands.begin(), tCands.end(), m_obj->m_tableLimit);
     if(rv->IsEmpty()) {
       delete rv;
       return 0;
@@ -300,28 +296,6 @@ public:
     targetPhrase.Evaluate(*srcPtr, m_obj->GetFeaturesToApply());
   }
 
-  TargetPhraseCollection* PruneTargetCandidates(std::vector<TargetPhrase> const & tCands,
-      std::vector<std::pair<float,size_t> >& costs) const {
-    // convert into TargetPhraseCollection
-    TargetPhraseCollection *rv=new TargetPhraseCollection;
-
-    // set limit to tableLimit or actual size, whatever is smaller
-    std::vector<std::pair<float,size_t> >::iterator nth =
-      costs.begin() + ((m_obj->m_tableLimit>0 && // 0 indicates no limit
-                        m_obj->m_tableLimit < costs.size()) ?
-                       m_obj->m_tableLimit : costs.size());
-
-    // find the nth phrase according to future cost
-    std::nth_element(costs.begin(),nth ,costs.end());
-
-    // add n top phrases to the return list
-    for(std::vector<std::pair<float,size_t> >::iterator
-        it = costs.begin(); it != nth; ++it)
-      rv->Add(new TargetPhrase(tCands[it->second]));
-
-    return rv;
-  }
-
   // POD for target phrase scores
   struct TScores {
     float total;
@@ -504,26 +478,21 @@ public:
       CHECK(static_cast<size_t>(i->first.second-1)<m_rangeCache[i->first.first].size());
       CHECK(m_rangeCache[i->first.first][i->first.second-1]==0);
 
-      std::vector<TargetPhrase> tCands;
-      tCands.reserve(i->second.size());
-      std::vector<std::pair<float,size_t> > costs;
-      costs.reserve(i->second.size());
-
-      for(E2Costs::const_iterator j=i->second.begin(); j!=i->second.end(); ++j) {
+      std::vector<TargetPhrase> tCands(i->second.size());
+      std::vector<TargetPhrase>::iterator targetPhrase = tCands.begin();
+      for(E2Costs::const_iterator j=i->second.begin(); j!=i->second.end(); ++j, ++targetPhrase) {
         TScores const & scores=j->second;
-        TargetPhrase targetPhrase;
-        CreateTargetPhrase(targetPhrase
+        CreateTargetPhrase(*targetPhrase
                            , j ->first
                            , scores.transScore
                            , scores.inputScores
                            , NULL
                            , scores.src);
-        costs.push_back(std::make_pair(-targetPhrase.GetFutureScore(),tCands.size()));
-        tCands.push_back(targetPhrase);
-        //std::cerr << i->first.first << "-" << i->first.second << ": " << targetPhrase << std::endl;
+        //std::cerr << i->first.first << "-" << i->first.second << ": " << *targetPhrase << std::endl;
       }
 
-      TargetPhraseCollection *rv=PruneTargetCandidates(tCands,costs);
+      TargetPhraseCollection *rv=new TargetPhraseCollection;
+      rv->AddBest(tCands.begin(), tCands.end(), m_obj->m_tableLimit);
 
       if(rv->IsEmpty())
         delete rv;
@@ -65,6 +65,8 @@ Parameter::Parameter()
   AddParam("stack", "s", "maximum stack size for histogram pruning");
   AddParam("stack-diversity", "sd", "minimum number of hypothesis of each coverage in stack (default 0)");
   AddParam("threads","th", "number of threads to use in decoding (defaults to single-threaded)");
+  AddParam("parallel-stack-expansion", "pse", "expand the hypotheses of a stack on all idle decoding threads (phrase-based search without cube pruning). Default is no");
+  AddParam("parallel-chart-cells", "pcc", "decode the chart cells of each span width on all idle decoding threads (chart decoding). Default is no");
   AddParam("translation-details", "T", "for each best hypothesis, report translation details to the given file");
   AddParam("translation-option-threshold", "tot", "threshold for translation options relative to best for input phrase");
   AddParam("early-discarding-threshold", "edt", "threshold for constructing hypotheses based on estimate cost");
@@ -95,6 +97,7 @@ Parameter::Parameter()
   AddParam("clean-lm-cache", "clean language model caches after N translations (default N=1)");
   AddParam("use-persistent-cache", "cache translation options across sentences (default true)");
   AddParam("persistent-cache-size", "maximum size of cache for translation options (default 10,000 input phrases)");
+  AddParam("persistent-cache-memory", "approximate memory budget of the cache for translation options in MB (default 256)");
   AddParam("recover-input-path", "r", "(conf net/word lattice only) - recover input path corresponding to the best translation");
   AddParam("output-word-graph", "owg", "Output stack info as word graph. Takes filename, 0=only hypos in stack, 1=stack + nbest hypos");
   AddParam("time-out", "seconds after which is interrupted (-1=no time-out, default is -1)");
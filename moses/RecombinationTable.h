@@ -0,0 +1,250 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2006 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#ifndef moses_RecombinationTable_h
+#define moses_RecombinationTable_h
+
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace Moses
+{
+
+/** Set of hypotheses that can't be recombined with each other, i.e. the
+ *  contents of a stack or of a chart cell. Open addressing with linear
+ *  probing on H::GetRecombinationHash(); H::RecombineCompare() is only
+ *  called to confirm a hash match. Erased slots are marked deleted rather
+ *  than moved, so erasing does not invalidate iterators to other elements
+ *  (inserting may). The iteration order is the slot order.
+ */
+template <class H>
+class RecombinationTable
+{
+  struct Slot {
+    Slot() : hypo(NULL), hash(0), deleted(false) {}
+    H *hypo;
+    size_t hash;
+    bool deleted;
+  };
+  typedef typename std::vector<Slot> Slots;
+
+public:
+  class const_iterator
+  {
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef H* value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef H* const* pointer;
+    typedef H* const& reference;
+
+    const_iterator() : m_slots(NULL), m_index(0) {}
+
+    reference operator*() const {
+      return (*m_slots)[m_index].hypo;
+    }
+    pointer operator->() const {
+      return &(*m_slots)[m_index].hypo;
+    }
+    const_iterator &operator++() {
+      m_index = Next(*m_slots, m_index + 1);
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator ret(*this);
+      ++*this;
+      return ret;
+    }
+    bool operator==(const const_iterator &other) const {
+      return m_index == other.m_index;
+    }
+    bool operator!=(const const_iterator &other) const {
+      return m_index != other.m_index;
+    }
+
+  private:
+    friend class RecombinationTable;
+    const_iterator(const Slots &slots, size_t index) : m_slots(&slots), m_index(index) {}
+
+    const Slots *m_slots;
+    size_t m_index;
+  };
+  // elements can't be modified in place, as with std::set
+  typedef const_iterator iterator;
+
+  RecombinationTable() : m_size(0), m_deleted(0) {}
+
+  const_iterator begin() const {
+    return const_iterator(m_slots, Next(m_slots, 0));
+  }
+  const_iterator end() const {
+    return const_iterator(m_slots, m_slots.size());
+  }
+  size_t size() const {
+    return m_size;
+  }
+  bool empty() const {
+    return m_size == 0;
+  }
+
+  /** add hypo unless a hypothesis that recombines with it is already in the
+   *  table. Returns the position of hypo or of the existing hypothesis, and
+   *  whether hypo was added */
+  std::pair<iterator, bool> insert(H *hypo);
+
+  //! hypothesis recombining with hypo, or end()
+  iterator find(const H *hypo) const;
+
+  void erase(const iterator &iter);
+
+  //! remove all hypotheses, without deleting them
+  void clear();
+
+private:
+  static size_t Next(const Slots &slots, size_t index) {
+    while (index < slots.size() && slots[index].hypo == NULL) {
+      ++index;
+    }
+    return index;
+  }
+
+  //! rehash into a table big enough for another insertion
+  void Grow();
+
+  Slots m_slots; /**< size is 0 or a power of 2 */
+  size_t m_size; /**< number of hypotheses */
+  size_t m_deleted; /**< number of deleted slots, they lengthen the probes */
+};
+
+template <class H>
+std::pair<typename RecombinationTable<H>::iterator, bool> RecombinationTable<H>::insert(H *hypo)
+{
+  // keep the load, deleted slots included, at most 1/2
+  if (2 * (m_size + m_deleted + 1) > m_slots.size()) {
+    Grow();
+  }
+
+  const size_t hash = hypo->GetRecombinationHash();
+  const size_t mask = m_slots.size() - 1;
+  size_t firstDeleted = m_slots.size();
+  for (size_t index = hash & mask; ; index = (index + 1) & mask) {
+    Slot &slot = m_slots[index];
+    if (slot.hypo == NULL) {
+      if (slot.deleted) {
+        // keep looking for an equal hypothesis, but remember where to go
+        if (firstDeleted == m_slots.size()) {
+          firstDeleted = index;
+        }
+        continue;
+      }
+      // not there: add it
+      if (firstDeleted != m_slots.size()) {
+        index = firstDeleted;
+        --m_deleted;
+      }
+      Slot &target = m_slots[index];
+      target.hypo = hypo;
+      target.hash = hash;
+      target.deleted = false;
+      ++m_size;
+      return std::make_pair(const_iterator(m_slots, index), true);
+    }
+    if (slot.hash == hash && slot.hypo->RecombineCompare(*hypo) == 0) {
+      return std::make_pair(const_iterator(m_slots, index), false);
+    }
+  }
+}
+
+template <class H>
+typename RecombinationTable<H>::iterator RecombinationTable<H>::find(const H *hypo) const
+{
+  if (m_size == 0) {
+    return end();
+  }
+  const size_t hash = hypo->GetRecombinationHash();
+  const size_t mask = m_slots.size() - 1;
+  for (size_t index = hash & mask; ; index = (index + 1) & mask) {
+    const Slot &slot = m_slots[index];
+    if (slot.hypo == NULL) {
+      if (!slot.deleted) {
+        return end();
+      }
+    } else if (slot.hash == hash && slot.hypo->RecombineCompare(*hypo) == 0) {
+      return const_iterator(m_slots, index);
+    }
+  }
+}
+
+template <class H>
+void RecombinationTable<H>::erase(const iterator &iter)
+{
+  Slot &slot = m_slots[iter.m_index];
+  slot.hypo = NULL;
+  slot.deleted = true;
+  ++m_deleted;
+  if (--m_size == 0) {
+    // cheap point to get rid of the deleted slots
+    clear();
+  }
+}
+
+template <class H>
+void RecombinationTable<H>::clear()
+{
+  if (m_deleted + m_size == 0) {
+    return;
+  }
+  for (typename Slots::iterator iter = m_slots.begin(); iter != m_slots.end(); ++iter) {
+    *iter = Slot();
+  }
+  m_size = 0;
+  m_deleted = 0;
+}
+
+template <class H>
+void RecombinationTable<H>::Grow()
+{
+  // aim for a load of at most 1/4 after rehashing
+  size_t capacity = 16;
+  while (capacity < 4 * (m_size + 1)) {
+    capacity *= 2;
+  }
+
+  Slots old(capacity);
+  old.swap(m_slots);
+  m_deleted = 0;
+
+  const size_t mask = capacity - 1;
+  for (typename Slots::const_iterator iter = old.begin(); iter != old.end(); ++iter) {
+    if (iter->hypo == NULL) {
+      continue;
+    }
+    size_t index = iter->hash & mask;
+    while (m_slots[index].hypo != NULL) {
+      index = (index + 1) & mask;
+    }
+    m_slots[index] = *iter;
+  }
+}
+
+}
+
+#endif
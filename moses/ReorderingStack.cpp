@@ -20,6 +20,11 @@ int ReorderingStack::Compare(const ReorderingStack& o)  const
   return 0;
 }
 
+size_t ReorderingStack::Hash() const
+{
+  return boost::hash_range(m_stack.begin(), m_stack.end());
+}
+
 // Method to push (shift element into the stack and reduce if reqd)
 int ReorderingStack::ShiftReduce(WordsRange input_span)
 {
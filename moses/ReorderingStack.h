@@ -28,6 +28,7 @@ private:
 public:
 
   int Compare(const ReorderingStack& o) const;
+  size_t Hash() const;
   int ShiftReduce(WordsRange input_span);
 
 private:
@@ -16,7 +16,7 @@ ScoreComponentCollection::ScoreComponentCollection() : m_scores(s_denseVectorSiz
 {}
 
 
-void ScoreComponentCollection::RegisterScoreProducer
+size_t ScoreComponentCollection::RegisterScoreProducer
 (const FeatureFunction* scoreProducer)
 {
   size_t start = s_denseVectorSize;
@@ -24,6 +24,7 @@ void ScoreComponentCollection::RegisterScoreProducer
   VERBOSE(1, "FeatureFunction: " << scoreProducer->GetScoreProducerDescription() << " start: " << start << " end: " << (end-1) << endl);
   s_scoreIndexes[scoreProducer] = pair<size_t,size_t>(start,end);
   s_denseVectorSize = end;
+  return start;
 }
 
 
@@ -69,16 +69,10 @@ private:
   typedef std::map<const FeatureFunction*,IndexPair> ScoreIndexMap;
   static  ScoreIndexMap s_scoreIndexes;
   static size_t s_denseVectorSize;
+  //! every FeatureFunction registers itself on construction and keeps its start index
   static IndexPair GetIndexes(const FeatureFunction* sp) {
-    ScoreIndexMap::const_iterator indexIter = s_scoreIndexes.find(sp);
-    if (indexIter == s_scoreIndexes.end()) {
-      std::cerr << "ERROR: FeatureFunction: " << sp->GetScoreProducerDescription() <<
-                " not registered with ScoreIndexMap" << std::endl;
-      std::cerr << "You must call ScoreComponentCollection.RegisterScoreProducer() " <<
-                " for every FeatureFunction" << std::endl;
-      abort();
-    }
-    return indexIter->second;
+    const size_t start = sp->GetIndex();
+    return IndexPair(start, start + sp->GetNumScoreComponents());
   }
 
 public:
@@ -102,8 +96,9 @@ public:
   /**
     * Register a ScoreProducer with a fixed number of scores, so that it can
     * be allocated space in the dense part of the feature vector.
+    * Returns the index of its first score.
     **/
-  static void RegisterScoreProducer(const FeatureFunction* scoreProducer);
+  static size_t RegisterScoreProducer(const FeatureFunction* scoreProducer);
 
   /** Load from file */
   bool Load(const std::string& filename) {
@@ -272,9 +267,13 @@ public:
   }
 
   float PartialInnerProduct(const FeatureFunction* sp, const std::vector<float>& rhs) const {
-    std::vector<float> lhs = GetScoresForProducer(sp);
-    CHECK(lhs.size() == rhs.size());
-    return std::inner_product(lhs.begin(), lhs.end(), rhs.begin(), 0.0f);
+    IndexPair indexes = GetIndexes(sp);
+    CHECK(indexes.second - indexes.first == rhs.size());
+    float product = 0.0f;
+    for (size_t i = 0; i < rhs.size(); ++i) {
+      product += m_scores[i + indexes.first] * rhs[i];
+    }
+    return product;
   }
 
   //! return a vector of all the scores associated with a certain FeatureFunction
@@ -289,6 +288,13 @@ public:
     return res;
   }
 
+  //! score number index of sp; GetScoresForProducer(sp)[index] without the copy
+  float GetScoreComponent(const FeatureFunction* sp, size_t index) const {
+    IndexPair indexes = GetIndexes(sp);
+    CHECK(index < indexes.second - indexes.first);
+    return m_scores[indexes.first + index];
+  }
+
   //! get subset of scores that belong to a certain sparse ScoreProducer
   FVector GetVectorForProducer(const FeatureFunction* sp) const;
 
@@ -1,11 +1,36 @@
+#include <algorithm>
 #include "Manager.h"
 #include "Timer.h"
 #include "SearchNormal.h"
+#include "ThreadPool.h"
 
 using namespace std;
 
 namespace Moses
 {
+
+/** Expands a slice of the hypotheses of a stack into a buffer */
+class SearchNormal::ExpansionTask : public Task
+{
+public:
+  ExpansionTask(SearchNormal &search
+                , const Hypothesis * const *begin, const Hypothesis * const *end
+                , ExpansionBuffer &buffer)
+    : m_search(search), m_begin(begin), m_end(end), m_buffer(buffer) {}
+
+  void Run() {
+    SentenceArena::Scope arenaScope(&m_search.m_manager.GetArena());
+    for (const Hypothesis * const *iter = m_begin; iter != m_end; ++iter) {
+      m_search.ProcessOneHypothesis(**iter, &m_buffer);
+    }
+  }
+
+private:
+  SearchNormal &m_search;
+  const Hypothesis * const *m_begin, * const *m_end;
+  ExpansionBuffer &m_buffer;
+};
+
 /**
  * Organizing main function
  *
@@ -20,10 +45,20 @@ SearchNormal::SearchNormal(Manager& manager, const InputType &source, const Tran
   ,m_start(clock())
   ,interrupted_flag(0)
   ,m_transOptColl(transOptColl)
+  ,m_parallelExpansion(false)
 {
   VERBOSE(1, "Translating: " << m_source << endl);
   const StaticData &staticData = StaticData::Instance();
 
+#if defined(WITH_THREADS) && !defined(USE_HYPO_POOL)
+  // only worth it if there are other threads to help. The time statistics
+  // collected at verbosity 2 are not thread-safe.
+  ThreadPool *pool = ThreadPool::GetCurrent();
+  m_parallelExpansion = staticData.UseParallelStackExpansion()
+                        && pool && pool->GetNumThreads() > 1
+                        && staticData.GetVerboseLevel() < 2;
+#endif
+
   if (m_initialTargetPhrase.GetSize() > 0) {
     VERBOSE(1, "Search extends partial output: " << m_initialTargetPhrase<<endl);
   }
@@ -90,10 +125,14 @@ void SearchNormal::ProcessSentence()
     }
 
     // go through each hypothesis on the stack and try to expand it
-    HypothesisStackNormal::const_iterator iterHypo;
-    for (iterHypo = sourceHypoColl.begin() ; iterHypo != sourceHypoColl.end() ; ++iterHypo) {
-      Hypothesis &hypothesis = **iterHypo;
-      ProcessOneHypothesis(hypothesis); // expand the hypothesis
+    if (m_parallelExpansion) {
+      ExpandStackInParallel(sourceHypoColl);
+    } else {
+      HypothesisStackNormal::const_iterator iterHypo;
+      for (iterHypo = sourceHypoColl.begin() ; iterHypo != sourceHypoColl.end() ; ++iterHypo) {
+        Hypothesis &hypothesis = **iterHypo;
+        ProcessOneHypothesis(hypothesis); // expand the hypothesis
+      }
     }
     // some logging
     IFVERBOSE(2) {
@@ -112,12 +151,52 @@ void SearchNormal::ProcessSentence()
 }
 
 
+/**
+ * Expand all hypotheses of a stack on the threads of the pool.
+ * Each task expands a slice of the stack into its own buffer, without
+ * touching the stacks. The buffers are then added to the stacks in stack
+ * order, so recombination, pruning and hypothesis IDs come out exactly as
+ * in the serial loop.
+ */
+void SearchNormal::ExpandStackInParallel(const HypothesisStackNormal &sourceHypoColl)
+{
+  vector<const Hypothesis*> hypos(sourceHypoColl.begin(), sourceHypoColl.end());
+  if (hypos.empty()) {
+    return;
+  }
+
+  // a few slices per thread, so that the threads are kept busy when the
+  // hypotheses differ in the number of expansions
+  const size_t numThreads = StaticData::Instance().ThreadCount();
+  const size_t sliceSize = std::max<size_t>(1, hypos.size() / (4 * numThreads));
+  const size_t numSlices = (hypos.size() + sliceSize - 1) / sliceSize;
+
+  vector<ExpansionBuffer> buffers(numSlices);
+  {
+    TaskGroup group;
+    for (size_t i = 0; i < numSlices; ++i) {
+      const size_t begin = i * sliceSize;
+      const size_t end = std::min(begin + sliceSize, hypos.size());
+      group.Spawn(new ExpansionTask(*this, &hypos[begin], &hypos[0] + end, buffers[i]));
+    }
+    group.Wait();
+  }
+
+  for (size_t i = 0; i < numSlices; ++i) {
+    const ExpansionBuffer &buffer = buffers[i];
+    for (ExpansionBuffer::const_iterator iter = buffer.begin(); iter != buffer.end(); ++iter) {
+      AddExpandedHypothesis(*iter);
+    }
+  }
+}
+
 /** Find all translation options to expand one hypothesis, trigger expansion
  * this is mostly a check for overlap with already covered words, and for
  * violation of reordering limits.
  * \param hypothesis hypothesis to be expanded upon
+ * \param buffer if not NULL, new hypotheses go here instead of onto the stacks
  */
-void SearchNormal::ProcessOneHypothesis(const Hypothesis &hypothesis)
+void SearchNormal::ProcessOneHypothesis(const Hypothesis &hypothesis, ExpansionBuffer *buffer)
 {
   // since we check for reordering limits, its good to have that limit handy
   int maxDistortion = StaticData::Instance().GetMaxDistortion();
@@ -125,7 +204,7 @@ void SearchNormal::ProcessOneHypothesis(const Hypothesis &hypothesis)
 
   // no limit of reordering: only check for overlap
   if (maxDistortion < 0) {
-    const WordsBitmap hypoBitmap	= hypothesis.GetWordsBitmap();
+    const WordsBitmap &hypoBitmap	= hypothesis.GetWordsBitmap();
     const size_t hypoFirstGapPos	= hypoBitmap.GetFirstGapPos()
                                     , sourceSize			= m_source.GetSize();
 
@@ -146,7 +225,7 @@ void SearchNormal::ProcessOneHypothesis(const Hypothesis &hypothesis)
         }
 
         //TODO: does this method include incompatible WordLattice hypotheses?
-        ExpandAllHypotheses(hypothesis, startPos, endPos);
+        ExpandAllHypotheses(hypothesis, startPos, endPos, buffer);
       }
     }
 
@@ -155,7 +234,7 @@ void SearchNormal::ProcessOneHypothesis(const Hypothesis &hypothesis)
 
   // if there are reordering limits, make sure it is not violated
   // the coverage bitmap is handy here (and the position of the first gap)
-  const WordsBitmap hypoBitmap = hypothesis.GetWordsBitmap();
+  const WordsBitmap &hypoBitmap = hypothesis.GetWordsBitmap();
   const size_t	hypoFirstGapPos	= hypoBitmap.GetFirstGapPos()
                                   , sourceSize			= m_source.GetSize();
 
@@ -220,7 +299,7 @@ void SearchNormal::ProcessOneHypothesis(const Hypothesis &hypothesis)
 
       // any length extension is okay if starting at left-most edge
       if (leftMostEdge) {
-        ExpandAllHypotheses(hypothesis, startPos, endPos);
+        ExpandAllHypotheses(hypothesis, startPos, endPos, buffer);
       }
       // starting somewhere other than left-most edge, use caution
       else {
@@ -240,7 +319,7 @@ void SearchNormal::ProcessOneHypothesis(const Hypothesis &hypothesis)
         }
 
         // everything is fine, we're good to go
-        ExpandAllHypotheses(hypothesis, startPos, endPos);
+        ExpandAllHypotheses(hypothesis, startPos, endPos, buffer);
 
       }
     }
@@ -253,9 +332,10 @@ void SearchNormal::ProcessOneHypothesis(const Hypothesis &hypothesis)
  * \param hypothesis hypothesis to be expanded upon
  * \param startPos first word position of span covered
  * \param endPos last word position of span covered
+ * \param buffer if not NULL, new hypotheses go here instead of onto the stacks
  */
 
-void SearchNormal::ExpandAllHypotheses(const Hypothesis &hypothesis, size_t startPos, size_t endPos)
+void SearchNormal::ExpandAllHypotheses(const Hypothesis &hypothesis, size_t startPos, size_t endPos, ExpansionBuffer *buffer)
 {
   // early discarding: check if hypothesis is too bad to build
   // this idea is explained in (Moore&Quirk, MT Summit 2007)
@@ -272,7 +352,11 @@ void SearchNormal::ExpandAllHypotheses(const Hypothesis &hypothesis, size_t star
   const TranslationOptionList &transOptList = m_transOptColl.GetTranslationOptionList(WordsRange(startPos, endPos));
   TranslationOptionList::const_iterator iter;
   for (iter = transOptList.begin() ; iter != transOptList.end() ; ++iter) {
-    ExpandHypothesis(hypothesis, **iter, expectedScore);
+    if (buffer) {
+      BufferHypothesis(hypothesis, **iter, expectedScore, *buffer);
+    } else {
+      ExpandHypothesis(hypothesis, **iter, expectedScore);
+    }
   }
 }
 
@@ -365,6 +449,78 @@ void SearchNormal::ExpandHypothesis(const Hypothesis &hypothesis, const Translat
   }
 }
 
+/**
+ * Thread-safe counterpart of ExpandHypothesis() used by parallel stack
+ * expansion: build (and score) the hypothesis but leave the early
+ * discarding decision, the hypothesis ID and the stack to
+ * AddExpandedHypothesis().
+ */
+void SearchNormal::BufferHypothesis(const Hypothesis &hypothesis, const TranslationOption &transOpt, float expectedScore, ExpansionBuffer &buffer) const
+{
+  const StaticData &staticData = StaticData::Instance();
+
+  if (staticData.UseEarlyDiscarding()) {
+    expectedScore += transOpt.GetFutureScore();
+    // Without stack diversity, the worst score of a stack only goes up while
+    // it is filled. What is too bad for the stack now would not have been
+    // built by the serial decoder either.
+    if (staticData.GetMinHypoStackDiversity() == 0) {
+      size_t wordsTranslated = hypothesis.GetWordsBitmap().GetNumWordsCovered() + transOpt.GetSize();
+      float allowedScore = m_hypoStackColl[wordsTranslated]->GetWorstScore()
+                           + staticData.GetEarlyDiscardingThreshold();
+      if (expectedScore < allowedScore) {
+        return;
+      }
+    }
+  }
+
+  Hypothesis *newHypo = hypothesis.CreateNext(transOpt, m_constraint, false);
+  if (newHypo == NULL) return;
+  if (! staticData.UseEarlyDiscarding()) {
+    newHypo->Evaluate(m_transOptColl.GetFutureScore());
+  }
+
+  ExpandedHypothesis expanded;
+  expanded.hypo = newHypo;
+  expanded.expectedScore = expectedScore;
+  buffer.push_back(expanded);
+}
+
+/**
+ * Add a hypothesis built by BufferHypothesis() to its stack, repeating the
+ * early discarding check of ExpandHypothesis() against the current state
+ * of the stack.
+ */
+void SearchNormal::AddExpandedHypothesis(const ExpandedHypothesis &expanded)
+{
+  const StaticData &staticData = StaticData::Instance();
+  Hypothesis *newHypo = expanded.hypo;
+  size_t wordsTranslated = newHypo->GetWordsBitmap().GetNumWordsCovered();
+  HypothesisStack &stack = *m_hypoStackColl[wordsTranslated];
+
+  if (staticData.UseEarlyDiscarding()) {
+    float allowedScore = stack.GetWorstScore();
+    if (staticData.GetMinHypoStackDiversity()) {
+      float allowedScoreForBitmap = stack.GetWorstScoreForBitmap( newHypo->GetWordsBitmap().GetID() );
+      allowedScore = std::min( allowedScore, allowedScoreForBitmap );
+    }
+    allowedScore += staticData.GetEarlyDiscardingThreshold();
+    if (expanded.expectedScore < allowedScore) {
+      FREEHYPO( newHypo );
+      return;
+    }
+  }
+
+  newHypo->Register();
+
+  // logging for the curious
+  IFVERBOSE(3) {
+    newHypo->PrintHypothesis();
+  }
+
+  stack.AddPrune(newHypo);
+}
+
 const std::vector < HypothesisStack* >& SearchNormal::GetHypothesisStacks() const
 {
   return m_hypoStackColl;
@@ -28,12 +28,26 @@ protected:
   size_t interrupted_flag; /**< flag indicating that decoder ran out of time (see switch -time-out) */
   HypothesisStackNormal* actual_hypoStack; /**actual (full expanded) stack of hypotheses*/
   const TranslationOptionCollection &m_transOptColl; /**< pre-computed list of translation options for the phrases in this sentence */
+  bool m_parallelExpansion; /**< expand the hypotheses of a stack on several threads */
+
+  /** a hypothesis built by a worker thread, waiting to be added to its stack */
+  struct ExpandedHypothesis {
+    Hypothesis *hypo;
+    float expectedScore; /**< for early discarding, see ExpandHypothesis() */
+  };
+  typedef std::vector<ExpandedHypothesis> ExpansionBuffer;
+  class ExpansionTask;
 
   // functions for creating hypotheses
-  void ProcessOneHypothesis(const Hypothesis &hypothesis);
-  void ExpandAllHypotheses(const Hypothesis &hypothesis, size_t startPos, size_t endPos);
+  void ProcessOneHypothesis(const Hypothesis &hypothesis, ExpansionBuffer *buffer = NULL);
+  void ExpandAllHypotheses(const Hypothesis &hypothesis, size_t startPos, size_t endPos, ExpansionBuffer *buffer = NULL);
   virtual void ExpandHypothesis(const Hypothesis &hypothesis,const TranslationOption &transOpt, float expectedScore);
 
+  // parallel stack expansion
+  void ExpandStackInParallel(const HypothesisStackNormal &sourceHypoColl);
+  void BufferHypothesis(const Hypothesis &hypothesis, const TranslationOption &transOpt, float expectedScore, ExpansionBuffer &buffer) const;
+  void AddExpandedHypothesis(const ExpandedHypothesis &expanded);
+
 public:
   SearchNormal(Manager& manager, const InputType &source, const TranslationOptionCollection &transOptColl);
   ~SearchNormal();
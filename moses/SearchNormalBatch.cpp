@@ -16,12 +16,15 @@ SearchNormalBatch::SearchNormalBatch(Manager& manager, const InputType &source,
   m_max_stack_size = StaticData::Instance().GetMaxHypoStackSize();
 
   // Split the feature functions into sets of stateless, stateful
-  // distributed lm, and stateful non-distributed.
+  // language models, and other stateful. Language models are given the
+  // whole batch before they are evaluated: distributed LMs send the
+  // requests together, KenLM scores each (state, phrase) pair once.
   const vector<const StatefulFeatureFunction*>& ffs =
     StatefulFeatureFunction::GetStatefulFeatureFunctions();
   for (unsigned i = 0; i < ffs.size(); ++i) {
-    if (ffs[i]->GetScoreProducerDescription() == "DLM_5gram") { // TODO WFT
-      m_dlm_ffs[i] = const_cast<LanguageModel*>(static_cast<const LanguageModel* const>(ffs[i]));
+    const LanguageModel *lm = dynamic_cast<const LanguageModel*>(ffs[i]);
+    if (lm) {
+      m_dlm_ffs[i] = const_cast<LanguageModel*>(lm);
       m_dlm_ffs[i]->SetFFStateIdx(i);
     } else {
       m_stateful_ffs[i] = const_cast<StatefulFeatureFunction*>(ffs[i]);
@@ -196,6 +199,7 @@ void SearchNormalBatch::EvalAndMergePartialHypos()
       LanguageModel &lm = *(dlm_iter->second);
       hypo->EvaluateWith(lm, (*dlm_iter).first);
     }
+    hypo->EvaluateTotalScore(m_transOptColl.GetFutureScore());
 
     // Put completed hypothesis onto its stack.
     size_t wordsTranslated = hypo->GetWordsBitmap().GetNumWordsCovered();
@@ -12,7 +12,8 @@ class TranslationOptionCollection;
 
 /** Implements the phrase-based stack decoding algorithm (no cube pruning) with a twist...
  *  Language model requests are batched together, duplicate requests are removed, and requests are sent together.
- *  Useful for distributed LM where network latency is an issue.
+ *  Useful for distributed LM where network latency is an issue, and for large KenLM models,
+ *  where expansions sharing the LM state and target phrase are scored once.
  */
 class SearchNormalBatch: public SearchNormal
 {
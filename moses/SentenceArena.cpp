@@ -0,0 +1,171 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2013 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <cstdlib>
+#include <new>
+
+#include "SentenceArena.h"
+#include "util/pool.hh"
+
+namespace Moses
+{
+
+namespace
+{
+// blocks are multiples of this, which keeps every object suitably aligned
+const size_t kAlignment = 16;
+// blocks up to this size are recycled through per-lane free lists
+const size_t kMaxRecycledSize = 512;
+const size_t kNumSizeClasses = kMaxRecycledSize / kAlignment + 1;
+}
+
+//! header in front of every object. lane is NULL for heap allocations
+struct SentenceArena::Block {
+  union {
+    Lane *lane;
+    Block *nextFree; //! while in a free list
+  };
+  size_t size;
+};
+
+struct SentenceArena::Lane {
+  explicit Lane(SentenceArena *owner) : arena(owner) {
+    for (size_t i = 0; i < kNumSizeClasses; ++i) {
+      freeBlocks[i] = NULL;
+    }
+  }
+
+  SentenceArena *arena;
+  util::Pool pool;
+  //! singly-linked free lists, one per size class
+  Block *freeBlocks[kNumSizeClasses];
+};
+
+#ifdef WITH_THREADS
+// lanes belong to their arena, so no cleanup when the thread exits
+boost::thread_specific_ptr<SentenceArena::Lane> SentenceArena::s_currentLane(NULL);
+
+SentenceArena::Lane *SentenceArena::GetCurrentLane()
+{
+  return s_currentLane.get();
+}
+
+void SentenceArena::SetCurrentLane(Lane *lane)
+{
+  s_currentLane.reset(lane);
+}
+#else
+SentenceArena::Lane *SentenceArena::s_currentLane = NULL;
+
+SentenceArena::Lane *SentenceArena::GetCurrentLane()
+{
+  return s_currentLane;
+}
+
+void SentenceArena::SetCurrentLane(Lane *lane)
+{
+  s_currentLane = lane;
+}
+#endif
+
+SentenceArena::Scope::Scope(SentenceArena *arena)
+  : m_arena(arena)
+  , m_lane(arena ? arena->AcquireLane() : NULL)
+  , m_previous(GetCurrentLane())
+{
+  SetCurrentLane(m_lane);
+}
+
+SentenceArena::Scope::~Scope()
+{
+  SetCurrentLane(m_previous);
+  if (m_arena) {
+    m_arena->ReleaseLane(m_lane);
+  }
+}
+
+SentenceArena::SentenceArena()
+{}
+
+SentenceArena::~SentenceArena()
+{
+  for (size_t i = 0; i < m_lanes.size(); ++i) {
+    delete m_lanes[i];
+  }
+}
+
+SentenceArena::Lane *SentenceArena::AcquireLane()
+{
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(m_mutex);
+#endif
+  if (m_idleLanes.empty()) {
+    m_lanes.push_back(new Lane(this));
+    return m_lanes.back();
+  }
+  Lane *lane = m_idleLanes.back();
+  m_idleLanes.pop_back();
+  return lane;
+}
+
+void SentenceArena::ReleaseLane(Lane *lane)
+{
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(m_mutex);
+#endif
+  m_idleLanes.push_back(lane);
+}
+
+void *SentenceArena::Allocate(size_t size)
+{
+  size = (size + kAlignment - 1) & ~(kAlignment - 1);
+  Lane *lane = GetCurrentLane();
+  Block *block;
+  if (lane == NULL) {
+    block = static_cast<Block*>(std::malloc(sizeof(Block) + size));
+    if (block == NULL) throw std::bad_alloc();
+  } else if (size <= kMaxRecycledSize && lane->freeBlocks[size / kAlignment] != NULL) {
+    block = lane->freeBlocks[size / kAlignment];
+    lane->freeBlocks[size / kAlignment] = block->nextFree;
+  } else {
+    block = static_cast<Block*>(lane->pool.Allocate(sizeof(Block) + size));
+  }
+  block->lane = lane;
+  block->size = size;
+  return block + 1;
+}
+
+void SentenceArena::Free(void *ptr)
+{
+  if (ptr == NULL) return;
+  Block *block = static_cast<Block*>(ptr) - 1;
+  if (block->lane == NULL) {
+    std::free(block);
+    return;
+  }
+  if (block->size > kMaxRecycledSize) return;
+
+  // only recycle into a lane of the same arena, the memory lives as long
+  Lane *lane = GetCurrentLane();
+  if (lane == NULL || lane->arena != block->lane->arena) return;
+  block->nextFree = lane->freeBlocks[block->size / kAlignment];
+  lane->freeBlocks[block->size / kAlignment] = block;
+}
+
+}
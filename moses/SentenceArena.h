@@ -0,0 +1,114 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2013 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#ifndef moses_SentenceArena_h
+#define moses_SentenceArena_h
+
+#include <cstddef>
+#include <vector>
+
+#ifdef WITH_THREADS
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+#endif
+
+namespace Moses
+{
+
+/** Bump allocator for objects that live no longer than the sentence being
+ * decoded (hypotheses, translation options, feature function states).
+ * All memory is given back in one go when the arena is destroyed.
+ *
+ * Each thread allocates from its own lane, so no locking is needed on the
+ * allocation path. A lane is bound to the calling thread by a Scope; objects
+ * deriving from SentenceArenaObject that are created while a Scope is active
+ * come from that lane, all others from the heap. Small blocks freed while a
+ * lane of the same arena is bound are recycled, the rest is reclaimed with
+ * the arena.
+ */
+class SentenceArena
+{
+  struct Block;
+  struct Lane;
+
+public:
+  /** Binds a lane of an arena to the calling thread until the scope ends.
+   * A NULL arena makes the scope allocate from the heap, for objects that
+   * must outlive the sentence (e.g. the persistent translation option cache).
+   */
+  class Scope
+  {
+  public:
+    explicit Scope(SentenceArena *arena);
+    ~Scope();
+  private:
+    SentenceArena *m_arena;
+    Lane *m_lane, *m_previous;
+
+    Scope(const Scope &);
+    void operator=(const Scope &);
+  };
+
+  SentenceArena();
+  ~SentenceArena();
+
+  static void *Allocate(size_t size);
+  static void Free(void *ptr);
+
+private:
+  std::vector<Lane*> m_lanes, m_idleLanes;
+#ifdef WITH_THREADS
+  boost::mutex m_mutex;
+  static boost::thread_specific_ptr<Lane> s_currentLane;
+#else
+  static Lane *s_currentLane;
+#endif
+
+  static Lane *GetCurrentLane();
+  static void SetCurrentLane(Lane *lane);
+
+  Lane *AcquireLane();
+  void ReleaseLane(Lane *lane);
+
+  SentenceArena(const SentenceArena &);
+  void operator=(const SentenceArena &);
+};
+
+/** Base class for objects that are allocated from the current sentence
+ * arena (if there is one). Deleting such an object is always safe.
+ */
+class SentenceArenaObject
+{
+public:
+  static void *operator new(size_t size) {
+    return SentenceArena::Allocate(size);
+  }
+  static void *operator new(size_t /* size */, void *ptr) {
+    return ptr;
+  }
+  static void operator delete(void *ptr) {
+    SentenceArena::Free(ptr);
+  }
+  static void operator delete(void * /* ptr */, void * /* place */) {
+  }
+};
+
+}
+
+#endif
@@ -79,14 +79,6 @@ StaticData::~StaticData()
 {
   RemoveAllInColl(m_decodeGraphs);
 
-  typedef std::map<std::pair<std::pair<size_t, std::string>, Phrase>, std::pair<TranslationOptionList*,clock_t> > Coll;
-  Coll::iterator iter;
-  for (iter = m_transOptCache.begin(); iter != m_transOptCache.end(); ++iter) {
-    std::pair<TranslationOptionList*,clock_t> &valuePair =iter->second;
-    TranslationOptionList *transOptList = valuePair.first;
-    delete transOptList;
-  }
-
   /*
   const std::vector<FeatureFunction*> &producers = FeatureFunction::GetFeatureFunctions();
   for(size_t i=0;i<producers.size();++i) {
@@ -279,8 +271,16 @@ bool StaticData::LoadData(Parameter *parameter)
   // caching of translation options
   if (m_inputType == SentenceInput) {
     SetBooleanParameter( &m_useTransOptCache, "use-persistent-cache", true );
-    m_transOptCacheMaxSize = (m_parameter->GetParam("persistent-cache-size").size() > 0)
-                             ? Scan<size_t>(m_parameter->GetParam("persistent-cache-size")[0]) : DEFAULT_MAX_TRANS_OPT_CACHE_SIZE;
+    size_t maxEntries = (m_parameter->GetParam("persistent-cache-size").size() > 0)
+                        ? Scan<size_t>(m_parameter->GetParam("persistent-cache-size")[0]) : DEFAULT_MAX_TRANS_OPT_CACHE_SIZE;
+    size_t maxMemory = (m_parameter->GetParam("persistent-cache-memory").size() > 0)
+                       ? Scan<size_t>(m_parameter->GetParam("persistent-cache-memory")[0]) : DEFAULT_TRANS_OPT_CACHE_MEMORY;
+    if (maxEntries == 0 || maxMemory == 0) {
+      m_useTransOptCache = false;
+    }
+    if (m_useTransOptCache) {
+      m_transOptCache.reset(new TranslationOptionCache(maxEntries, maxMemory << 20));
+    }
   } else {
     m_useTransOptCache = false;
   }
@@ -463,6 +463,22 @@ bool StaticData::LoadData(Parameter *parameter)
     }
   }
 
+  SetBooleanParameter( &m_parallelStackExpansion, "parallel-stack-expansion", false );
+#ifndef WITH_THREADS
+  if (m_parallelStackExpansion) {
+    UserMessage::Add("Error: parallel stack expansion requested but moses not built with thread support");
+    return false;
+  }
+#endif
+
+  SetBooleanParameter( &m_parallelChartCells, "parallel-chart-cells", false );
+#ifndef WITH_THREADS
+  if (m_parallelChartCells) {
+    UserMessage::Add("Error: parallel chart cells requested but moses not built with thread support");
+    return false;
+  }
+#endif
+
   m_startTranslationId = (m_parameter->GetParam("start-translation-id").size() > 0) ?
                          Scan<long>(m_parameter->GetParam("start-translation-id")[0]) : 0;
 
@@ -771,69 +787,20 @@ bool StaticData::LoadDecodeGraphs()
   return true;
 }
 
-const TranslationOptionList* StaticData::FindTransOptListInCache(const DecodeGraph &decodeGraph, const Phrase &sourcePhrase) const
+TranslationOptionCache::ListPtr StaticData::FindTransOptListInCache(const DecodeGraph &decodeGraph, const Phrase &sourcePhrase) const
 {
-  std::pair<size_t, std::string> cacheKey(decodeGraph.GetPosition(), m_currentWeightSetting);
-  std::pair<std::pair<size_t, std::string>, Phrase> key(cacheKey, sourcePhrase);
-#ifdef WITH_THREADS
-  boost::mutex::scoped_lock lock(m_transOptCacheMutex);
-#endif
-  std::map<std::pair<std::pair<size_t, std::string>, Phrase>, std::pair<TranslationOptionList*,clock_t> >::iterator iter
-  = m_transOptCache.find(key);
-  if (iter == m_transOptCache.end())
-    return NULL;
-  iter->second.second = clock(); // update last used time
-  return iter->second.first;
-}
-
-void StaticData::ReduceTransOptCache() const
-{
-  if (m_transOptCache.size() <= m_transOptCacheMaxSize) return; // not full
-  clock_t t = clock();
-
-  // find cutoff for last used time
-  priority_queue< clock_t > lastUsedTimes;
-
-  std::map<std::pair<std::pair<size_t, std::string>, Phrase>, std::pair<TranslationOptionList*,clock_t> >::iterator iter;
-  iter = m_transOptCache.begin();
-  while( iter != m_transOptCache.end() ) {
-    lastUsedTimes.push( iter->second.second );
-    iter++;
-  }
-  for( size_t i=0; i < lastUsedTimes.size()-m_transOptCacheMaxSize/2; i++ )
-    lastUsedTimes.pop();
-  clock_t cutoffLastUsedTime = lastUsedTimes.top();
-
-  // remove all old entries
-  iter = m_transOptCache.begin();
-  while( iter != m_transOptCache.end() ) {
-    if (iter->second.second < cutoffLastUsedTime) {
-      std::map<std::pair<std::pair<size_t, std::string>, Phrase>, std::pair<TranslationOptionList*,clock_t> >::iterator iterRemove = iter++;
-      delete iterRemove->second.first;
-      m_transOptCache.erase(iterRemove);
-    } else iter++;
-  }
-  VERBOSE(2,"Reduced persistent translation option cache in " << ((clock()-t)/(float)CLOCKS_PER_SEC) << " seconds." << std::endl);
+  return m_transOptCache->Find(decodeGraph.GetPosition(), m_currentWeightSetting, sourcePhrase);
 }
 
 void StaticData::AddTransOptListToCache(const DecodeGraph &decodeGraph, const Phrase &sourcePhrase, const TranslationOptionList &transOptList) const
 {
-  if (m_transOptCacheMaxSize == 0) return;
-  std::pair<size_t, std::string> cacheKey(decodeGraph.GetPosition(), m_currentWeightSetting);
-  std::pair<std::pair<size_t, std::string>, Phrase> key(cacheKey, sourcePhrase);
-  TranslationOptionList* storedTransOptList = new TranslationOptionList(transOptList);
-#ifdef WITH_THREADS
-  boost::mutex::scoped_lock lock(m_transOptCacheMutex);
-#endif
-  m_transOptCache[key] = make_pair( storedTransOptList, clock() );
-  ReduceTransOptCache();
+  m_transOptCache->Add(decodeGraph.GetPosition(), m_currentWeightSetting, sourcePhrase, transOptList);
 }
+
 void StaticData::ClearTransOptionCache() const
 {
-  map<std::pair<std::pair<size_t, std::string>, Phrase>, std::pair< TranslationOptionList*, clock_t > >::iterator iterCache;
-  for (iterCache = m_transOptCache.begin() ; iterCache != m_transOptCache.end() ; ++iterCache) {
-    TranslationOptionList *transOptList = iterCache->second.first;
-    delete transOptList;
+  if (m_transOptCache.get()) {
+    m_transOptCache->Clear();
   }
 }
 
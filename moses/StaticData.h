@@ -45,6 +45,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "SentenceStats.h"
 #include "DecodeGraph.h"
 #include "TranslationOptionList.h"
+#include "TranslationOptionCache.h"
 #include "ScoreComponentCollection.h"
 #include "moses/TranslationModel/PhraseDictionary.h"
 
@@ -167,13 +168,7 @@ protected:
   size_t m_timeout_threshold; //! seconds after which time out is activated
 
   bool m_useTransOptCache; //! flag indicating, if the persistent translation option cache should be used
-  mutable std::map<std::pair<std::pair<size_t, std::string>, Phrase>, std::pair<TranslationOptionList*,clock_t> > m_transOptCache; //! persistent translation option cache
-  size_t m_transOptCacheMaxSize; //! maximum size for persistent translation option cache
-  //FIXME: Single lock for cache not most efficient. However using a
-  //reader-writer for LRU cache is tricky - how to record last used time?
-#ifdef WITH_THREADS
-  mutable boost::mutex m_transOptCacheMutex;
-#endif
+  std::auto_ptr<TranslationOptionCache> m_transOptCache; //! persistent translation option cache
   bool m_isAlwaysCreateDirectTranslationOption;
   //! constructor. only the 1 static variable can be created
 
@@ -206,6 +201,8 @@ protected:
   WordAlignmentSort m_wordAlignmentSort;
 
   int m_threadCount;
+  bool m_parallelStackExpansion; //! expand each stack of a sentence on several threads
+  bool m_parallelChartCells; //! decode the cells of each span width on several threads
   long m_startTranslationId;
 
   // alternate weight settings
@@ -227,7 +224,6 @@ protected:
   //! load decoding steps
   bool LoadDecodeGraphs();
 
-  void ReduceTransOptCache() const;
   bool m_continuePartialTranslation;
 
   std::string m_binPath;
@@ -590,7 +586,12 @@ public:
   void ClearTransOptionCache() const;
 
 
-  const TranslationOptionList* FindTransOptListInCache(const DecodeGraph &decodeGraph, const Phrase &sourcePhrase) const;
+  TranslationOptionCache::ListPtr FindTransOptListInCache(const DecodeGraph &decodeGraph, const Phrase &sourcePhrase) const;
+
+  //! only valid if GetUseTransOptCache()
+  const TranslationOptionCache &GetTransOptCache() const {
+    return *m_transOptCache;
+  }
 
   bool PrintAllDerivations() const {
     return m_printAllDerivations;
@@ -636,6 +637,14 @@ public:
     return m_threadCount;
   }
 
+  bool UseParallelStackExpansion() const {
+    return m_parallelStackExpansion;
+  }
+
+  bool UseParallelChartCells() const {
+    return m_parallelChartCells;
+  }
+
   long GetStartTranslationId() const {
     return m_startTranslationId;
   }
@@ -22,6 +22,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #ifndef moses_TargetPhraseCollection_h
 #define moses_TargetPhraseCollection_h
 
+#include <algorithm>
 #include <vector>
 #include <iostream>
 #include "TargetPhrase.h"
@@ -81,6 +82,25 @@ public:
     m_collection.push_back(targetPhrase);
   }
 
+  /** add copies of the best tableLimit (all if 0) target phrases of the
+   *  candidates [begin, end), sorted by descending future score, ties in
+   *  candidate order. Only the phrases that are kept are copied, and the
+   *  candidates are left as they are, so they can be shared (e.g. cached) */
+  template <class Iterator>
+  void AddBest(Iterator begin, Iterator end, size_t tableLimit) {
+    std::vector<std::pair<float, size_t> > order;
+    order.reserve(end - begin);
+    for (Iterator iter = begin; iter != end; ++iter) {
+      order.push_back(std::make_pair(-iter->GetFutureScore(), order.size()));
+    }
+    const size_t size = (tableLimit && tableLimit < order.size()) ? tableLimit : order.size();
+    std::partial_sort(order.begin(), order.begin() + size, order.end());
+    m_collection.reserve(m_collection.size() + size);
+    for (size_t i = 0; i < size; ++i) {
+      m_collection.push_back(new TargetPhrase(begin[order[i].second]));
+    }
+  }
+
   void Prune(bool adhereTableLimit, size_t tableLimit);
   void Sort(bool adhereTableLimit, size_t tableLimit);
 
@@ -88,6 +108,10 @@ public:
     RemoveAllInColl(m_collection);
   }
 
+  void Swap(TargetPhraseCollection &other) {
+    m_collection.swap(other.m_collection);
+  }
+
 };
 
 }
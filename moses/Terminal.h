@@ -63,4 +63,23 @@ public:
   }
 };
 
+class TerminalLess
+{
+public:
+  // Strict weak ordering of words representing terminals, by factor id, so
+  // that it does not depend on where the factors were allocated.  As with
+  // the hasher, it's assumed that all words will have the same subset of
+  // active factors.
+  bool operator()(const Word &t1, const Word &t2) const {
+    for (size_t i = 0; i < MAX_NUM_FACTORS; ++i) {
+      const Factor *f1 = t1[i];
+      const Factor *f2 = t2[i];
+      if (f1 && f2 && f1 != f2) {
+        return f1->GetId() < f2->GetId();
+      }
+    }
+    return false;
+  }
+};
+
 }  // namespace Moses
@@ -22,7 +22,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include "ThreadPool.h"
 
-#ifdef WITH_THREADS
+#include <stdexcept>
 
 using namespace std;
 using namespace Moses;
@@ -30,51 +30,182 @@ using namespace Moses;
 namespace Moses
 {
 
+#ifdef WITH_THREADS
+
+namespace
+{
+
+struct WorkerContext {
+  WorkerContext(ThreadPool *p, size_t i) : pool(p), id(i) {}
+  ThreadPool *pool;
+  size_t id;
+};
+
+boost::thread_specific_ptr<WorkerContext> s_context;
+
+}
+
 ThreadPool::ThreadPool( size_t numThreads )
-  : m_stopped(false), m_stopping(false), m_queueLimit(0)
+  : m_pending(0), m_queued(0), m_sleeping(0), m_nextWorker(0)
+  , m_stopped(false), m_stopping(false), m_queueLimit(0)
 {
+  if (numThreads == 0) numThreads = 1;
   for (size_t i = 0; i < numThreads; ++i) {
-    m_threads.create_thread(boost::bind(&ThreadPool::Execute,this));
+    m_workers.push_back(new Worker);
+  }
+  for (size_t i = 0; i < numThreads; ++i) {
+    m_threads.create_thread(boost::bind(&ThreadPool::Execute,this,i));
   }
 }
 
-void ThreadPool::Execute()
+ThreadPool::~ThreadPool()
 {
-  do {
-    Task* task = NULL;
-    {
-      // Find a job to perform
-      boost::mutex::scoped_lock lock(m_mutex);
-      if (m_tasks.empty() && !m_stopped) {
-        m_threadNeeded.wait(lock);
-      }
-      if (!m_stopped && !m_tasks.empty()) {
-        task = m_tasks.front();
-        m_tasks.pop();
-      }
+  Stop();
+  for (size_t i = 0; i < m_workers.size(); ++i) {
+    delete m_workers[i];
+  }
+}
+
+ThreadPool *ThreadPool::GetCurrent()
+{
+  WorkerContext *context = s_context.get();
+  return context ? context->pool : NULL;
+}
+
+size_t ThreadPool::CurrentWorker() const
+{
+  WorkerContext *context = s_context.get();
+  return (context && context->pool == this) ? context->id : m_workers.size();
+}
+
+void ThreadPool::Execute(size_t id)
+{
+  s_context.reset(new WorkerContext(this, id));
+  while (true) {
+    Job job;
+    if (TakeChild(job) || (!m_stopped && TakeSubmitted(job))) {
+      Run(job);
+      continue;
     }
-    //Execute job
-    if (task) {
-      task->Run();
-      if (task->DeleteAfterExecution()) {
-        delete task;
-      }
+    // Nothing to do: sleep until a job is pushed. m_sleeping is raised
+    // before m_pending is re-checked so that Push() cannot miss us.
+    boost::mutex::scoped_lock lock(m_mutex);
+    if (m_stopped) break;
+    ++m_sleeping;
+    if (m_pending == 0) {
+      m_threadNeeded.wait(lock);
     }
-    m_threadAvailable.notify_all();
-  } while (!m_stopped);
+    --m_sleeping;
+  }
 }
 
-void ThreadPool::Submit( Task* task )
+void ThreadPool::Push(const Job &job)
+{
+  size_t id = CurrentWorker();
+  if (id == m_workers.size()) {
+    id = static_cast<size_t>(++m_nextWorker) % m_workers.size();
+  }
+  Worker &worker = *m_workers[id];
+  {
+    boost::mutex::scoped_lock lock(worker.mutex);
+    if (job.group) {
+      worker.children.push_back(job);
+    } else {
+      worker.submitted.push_back(job);
+    }
+  }
+  ++m_pending;
+  if (m_sleeping > 0) {
+    WakeOne();
+  }
+}
+
+void ThreadPool::WakeOne()
 {
   boost::mutex::scoped_lock lock(m_mutex);
-  if (m_stopping) {
-    throw runtime_error("ThreadPool stopping - unable to accept new jobs");
+  m_threadNeeded.notify_one();
+}
+
+bool ThreadPool::TakeChild(Job &job)
+{
+  const size_t numWorkers = m_workers.size();
+  const size_t self = CurrentWorker();
+  // own deque first, newest job
+  if (self < numWorkers) {
+    Worker &worker = *m_workers[self];
+    boost::mutex::scoped_lock lock(worker.mutex);
+    if (!worker.children.empty()) {
+      job = worker.children.back();
+      worker.children.pop_back();
+      --m_pending;
+      return true;
+    }
   }
-  while (m_queueLimit > 0 && m_tasks.size() >= m_queueLimit) {
-    m_threadAvailable.wait(lock);
+  // steal oldest job from someone else
+  for (size_t i = 1; i <= numWorkers; ++i) {
+    const size_t victim = (self + i) % numWorkers;
+    if (victim == self) continue;
+    Worker &worker = *m_workers[victim];
+    boost::mutex::scoped_lock lock(worker.mutex);
+    if (!worker.children.empty()) {
+      job = worker.children.front();
+      worker.children.pop_front();
+      --m_pending;
+      return true;
+    }
   }
-  m_tasks.push(task);
-  m_threadNeeded.notify_all();
+  return false;
+}
+
+bool ThreadPool::TakeSubmitted(Job &job)
+{
+  const size_t numWorkers = m_workers.size();
+  const size_t self = CurrentWorker();
+  for (size_t i = 0; i < numWorkers; ++i) {
+    Worker &worker = *m_workers[(self + i) % numWorkers];
+    boost::mutex::scoped_lock lock(worker.mutex);
+    if (!worker.submitted.empty()) {
+      job = worker.submitted.front();
+      worker.submitted.pop_front();
+      --m_pending;
+      --m_queued;
+      lock.unlock();
+      {
+        // let a blocked Submit() or Stop() re-check the queue size
+        boost::mutex::scoped_lock poolLock(m_mutex);
+      }
+      m_threadAvailable.notify_all();
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::Run(const Job &job)
+{
+  TaskGroup *group = job.group;
+  job.task->Run();
+  if (job.task->DeleteAfterExecution()) {
+    delete job.task;
+  }
+  if (group) {
+    group->Done();
+  }
+}
+
+void ThreadPool::Submit( Task* task )
+{
+  {
+    boost::mutex::scoped_lock lock(m_mutex);
+    if (m_stopping) {
+      throw runtime_error("ThreadPool stopping - unable to accept new jobs");
+    }
+    while (m_queueLimit > 0 && static_cast<size_t>(m_queued) >= m_queueLimit) {
+      m_threadAvailable.wait(lock);
+    }
+    ++m_queued;
+  }
+  Push(Job(task, NULL));
 }
 
 void ThreadPool::Stop(bool processRemainingJobs)
@@ -88,7 +219,7 @@ void ThreadPool::Stop(bool processRemainingJobs)
   if (processRemainingJobs) {
     boost::mutex::scoped_lock lock(m_mutex);
     //wait for queue to drain.
-    while (!m_tasks.empty() && !m_stopped) {
+    while (m_queued > 0 && !m_stopped) {
       m_threadAvailable.wait(lock);
     }
   }
@@ -102,6 +233,63 @@ void ThreadPool::Stop(bool processRemainingJobs)
   m_threads.join_all();
 }
 
+TaskGroup::TaskGroup(ThreadPool *pool)
+  : m_pool(pool ? pool : ThreadPool::GetCurrent()), m_outstanding(0)
+{
+}
+
+void TaskGroup::Spawn(Task *task)
+{
+  if (m_pool == NULL || m_pool->m_stopped) {
+    task->Run();
+    if (task->DeleteAfterExecution()) {
+      delete task;
+    }
+    return;
+  }
+  ++m_outstanding;
+  m_pool->Push(ThreadPool::Job(task, this));
+}
+
+void TaskGroup::Wait()
+{
+  while (true) {
+    // help out rather than block the worker
+    ThreadPool::Job job;
+    if (m_outstanding > 0 && m_pool->TakeChild(job)) {
+      m_pool->Run(job);
+      continue;
+    }
+    // the remaining children are running on other threads. Checking under
+    // the lock also makes sure Done() has released it before we return.
+    boost::mutex::scoped_lock lock(m_mutex);
+    if (m_outstanding == 0) return;
+    m_finished.wait(lock);
+  }
+}
+
+void TaskGroup::Done()
+{
+  boost::mutex::scoped_lock lock(m_mutex);
+  if (--m_outstanding == 0) {
+    m_finished.notify_all();
+  }
+}
+
+#else
+
+void TaskGroup::Spawn(Task *task)
+{
+  task->Run();
+  if (task->DeleteAfterExecution()) {
+    delete task;
+  }
 }
+
+void TaskGroup::Wait()
+{
+}
+
 #endif //WITH_THREADS
 
+}
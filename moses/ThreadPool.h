@@ -22,12 +22,13 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #ifndef moses_ThreadPool_h
 #define moses_ThreadPool_h
 
+#include <deque>
 #include <iostream>
-#include <queue>
 #include <vector>
 
 #ifdef WITH_THREADS
 #include <boost/bind.hpp>
+#include <boost/detail/atomic_count.hpp>
 #include <boost/thread.hpp>
 #endif
 
@@ -45,6 +46,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 namespace Moses
 {
 
+class ThreadPool;
+
 /** A task to be executed by the ThreadPool
  */
 class Task
@@ -57,8 +60,55 @@ public:
   virtual ~Task() {}
 };
 
+/** A set of child tasks spawned from inside a running task (or from the main
+ *  thread) which the caller can wait for. While waiting, the calling thread
+ *  helps by executing outstanding child tasks itself, so a task can split its
+ *  work without tying up a worker. Without threads, or when the calling
+ *  thread does not belong to a pool, child tasks are run inline.
+ */
+class TaskGroup
+{
+public:
+#ifdef WITH_THREADS
+  /** Spawn into pool, or into the pool owning the calling thread if NULL */
+  explicit TaskGroup(ThreadPool *pool = NULL);
+#else
+  explicit TaskGroup(ThreadPool * = NULL) {}
+#endif
+
+  ~TaskGroup() {
+    Wait();
+  }
+
+  /** Schedule a child task. Ownership follows Task::DeleteAfterExecution() */
+  void Spawn(Task *task);
+
+  /** Block until every task spawned so far has completed */
+  void Wait();
+
+#ifdef WITH_THREADS
+private:
+  friend class ThreadPool;
+
+  void Done();
+
+  ThreadPool *m_pool;
+  boost::detail::atomic_count m_outstanding;
+  boost::mutex m_mutex;
+  boost::condition_variable m_finished;
+#endif
+};
+
 #ifdef WITH_THREADS
 
+/** Work-stealing thread pool. Each worker owns a pair of deques: one for
+ *  tasks handed in with Submit() (distributed round-robin) and one for child
+ *  tasks spawned through a TaskGroup. A worker takes child tasks first, LIFO
+ *  from its own deque, then steals FIFO from the other workers, and only then
+ *  starts a new submitted task, so in-flight sentences finish before new ones
+ *  are started. Each deque has its own lock; the pool-wide mutex is only
+ *  taken to put idle workers to sleep and to wake them up.
+ */
 class ThreadPool
 {
 public:
@@ -67,9 +117,7 @@ public:
    **/
   explicit ThreadPool(size_t numThreads);
 
-  ~ThreadPool() {
-    Stop();
-  }
+  ~ThreadPool();
 
   /**
    * Add a job to the threadpool.
@@ -89,17 +137,54 @@ public:
     m_queueLimit = limit;
   }
 
+  size_t GetNumThreads() const {
+    return m_workers.size();
+  }
+
+  /**
+   * The pool the calling thread is a worker of, or NULL.
+   **/
+  static ThreadPool *GetCurrent();
+
 private:
+  friend class TaskGroup;
+
+  struct Job {
+    Job() : task(NULL), group(NULL) {}
+    Job(Task *t, TaskGroup *g) : task(t), group(g) {}
+    Task *task;
+    TaskGroup *group;
+  };
+
+  struct Worker {
+    boost::mutex mutex;
+    std::deque<Job> submitted;
+    std::deque<Job> children;
+  };
+
   /**
    * The main loop executed by each thread.
    **/
-  void Execute();
+  void Execute(size_t id);
+
+  void Push(const Job &job);
+  void WakeOne();
+  bool TakeChild(Job &job);
+  bool TakeSubmitted(Job &job);
+  void Run(const Job &job);
+
+  /** index of the calling thread's worker, or GetNumThreads() */
+  size_t CurrentWorker() const;
 
-  std::queue<Task*> m_tasks;
+  std::vector<Worker*> m_workers;
   boost::thread_group m_threads;
   boost::mutex m_mutex;
   boost::condition_variable m_threadNeeded;
   boost::condition_variable m_threadAvailable;
+  boost::detail::atomic_count m_pending; // jobs sitting in any deque
+  boost::detail::atomic_count m_queued; // submitted jobs not yet started
+  boost::detail::atomic_count m_sleeping;
+  boost::detail::atomic_count m_nextWorker;
   bool m_stopped;
   bool m_stopping;
   size_t m_queueLimit;
@@ -0,0 +1,233 @@
+/***********************************************************************
+ Moses - statistical machine translation system
+ Copyright (C) 2006-2013 University of Edinburgh
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ ***********************************************************************/
+
+#include "ChartRuleLookupManagerBinary.h"
+
+#include "moses/InputType.h"
+#include "moses/ChartParserCallback.h"
+#include "moses/NonTerminal.h"
+#include "moses/ChartCellCollection.h"
+#include "moses/TargetPhraseCollection.h"
+#include "moses/TranslationModel/PhraseDictionary.h"
+
+namespace Moses
+{
+
+ChartRuleLookupManagerBinary::ChartRuleLookupManagerBinary(
+  const InputType &src,
+  const ChartCellCollectionBase &cellColl,
+  const PhraseDictionary &ruleTable,
+  const RuleTableBinaryImage &image)
+  : ChartRuleLookupManagerCYKPlus(src, cellColl)
+  , m_ruleTable(ruleTable)
+  , m_image(image)
+{
+  size_t sourceSize = src.GetSize();
+  m_dottedRuleColls.resize(sourceSize);
+
+  for (size_t ind = 0; ind < m_dottedRuleColls.size(); ++ind) {
+    DottedRuleBinary *initDottedRule = new DottedRuleBinary(m_image.GetRoot());
+
+    DottedRuleCollBinary *dottedRuleColl = new DottedRuleCollBinary(sourceSize - ind + 1);
+    AddDottedRule(*dottedRuleColl, 0, initDottedRule); // init rule. stores the top node in tree
+
+    m_dottedRuleColls[ind] = dottedRuleColl;
+  }
+}
+
+ChartRuleLookupManagerBinary::~ChartRuleLookupManagerBinary()
+{
+  RemoveAllInColl(m_dottedRuleColls);
+
+  std::map<RuleTableBinaryImage::NodeId, const TargetPhraseCollection*>::iterator iter;
+  for (iter = m_cache.begin(); iter != m_cache.end(); ++iter) {
+    delete iter->second;
+  }
+}
+
+void ChartRuleLookupManagerBinary::GetChartRuleCollection(
+  const WordsRange &range,
+  ChartParserCallback &outColl)
+{
+  size_t relEndPos = range.GetEndPos() - range.GetStartPos();
+  size_t absEndPos = range.GetEndPos();
+
+  // get list of all rules that apply to spans at same starting position
+  DottedRuleCollBinary &dottedRuleCol = *m_dottedRuleColls[range.GetStartPos()];
+  const DottedRuleListBinary &expandableDottedRuleList = dottedRuleCol.GetExpandableDottedRuleList();
+
+  const ChartCellLabel &sourceWordLabel = GetSourceAt(absEndPos);
+
+  // loop through the rules
+  // (note that expandableDottedRuleList can be expanded as the loop runs
+  //  through calls to ExtendPartialRuleApplication())
+  for (size_t ind = 0; ind < expandableDottedRuleList.size(); ++ind) {
+    // rule we are about to extend
+    const DottedRuleBinary &prevDottedRule = *expandableDottedRuleList[ind];
+    // we will now try to extend it, starting after where it ended
+    size_t startPos = prevDottedRule.IsRoot()
+                      ? range.GetStartPos()
+                      : prevDottedRule.GetWordsRange().GetEndPos() + 1;
+
+    // search for terminal symbol
+    // (if only one more word position needs to be covered)
+    if (startPos == absEndPos) {
+      const Word &sourceWord = sourceWordLabel.GetLabel();
+      RuleTableBinaryImage::NodeId node = m_image.GetChild(prevDottedRule.GetLastNode(), sourceWord);
+
+      if (node) {
+        DottedRuleBinary *dottedRule = new DottedRuleBinary(node,
+            sourceWordLabel,
+            prevDottedRule);
+        AddDottedRule(dottedRuleCol, relEndPos+1, dottedRule);
+      }
+    }
+
+    // search for non-terminals
+    size_t endPos, stackInd;
+
+    // span is already complete covered? nothing can be done
+    if (startPos > absEndPos)
+      continue;
+
+    else if (startPos == range.GetStartPos() && range.GetEndPos() > range.GetStartPos()) {
+      // at the root of the prefix tree: don't allow non-lexical unary rules
+      // (see ChartRuleLookupManagerMemory)
+      endPos = absEndPos - 1;
+      stackInd = relEndPos;
+    } else {
+      endPos = absEndPos;
+      stackInd = relEndPos + 1;
+    }
+
+    ExtendPartialRuleApplication(prevDottedRule, startPos, endPos, stackInd,
+                                 dottedRuleCol);
+  }
+
+  // list of rules that that cover the entire span
+  const DottedRuleListBinary &rules = dottedRuleCol.Get(relEndPos + 1);
+
+  // look up target sides for the rules
+  DottedRuleListBinary::const_iterator iterRule;
+  for (iterRule = rules.begin(); iterRule != rules.end(); ++iterRule) {
+    const DottedRuleBinary &dottedRule = **iterRule;
+
+    const TargetPhraseCollection *tpc = GetTargetPhraseCollection(dottedRule.GetLastNode());
+    if (tpc) {
+      AddCompletedRule(dottedRule, *tpc, range, outColl);
+    }
+  }
+}
+
+void ChartRuleLookupManagerBinary::ExtendPartialRuleApplication(
+  const DottedRuleBinary &prevDottedRule,
+  size_t startPos,
+  size_t endPos,
+  size_t stackInd,
+  DottedRuleCollBinary &dottedRuleColl)
+{
+  // source non-terminal labels for the remainder
+  const NonTerminalSet &sourceNonTerms =
+    GetSentence().GetLabelSet(startPos, endPos);
+
+  // target non-terminal labels for the remainder
+  const ChartCellLabelSet &targetNonTerms = GetTargetLabelSet(startPos, endPos);
+
+  RuleTableBinaryImage::NodeId node = prevDottedRule.GetLastNode();
+
+  const size_t numChildren = m_image.GetNumNonTermChildren(node);
+  if (numChildren == 0) {
+    return;
+  }
+  const size_t numSourceNonTerms = sourceNonTerms.size();
+  const size_t numTargetNonTerms = targetNonTerms.GetSize();
+  const size_t numCombinations = numSourceNonTerms * numTargetNonTerms;
+
+  // as in ChartRuleLookupManagerMemory, do whichever of enumerating the
+  // label pairs or the node's children needs fewer lookups
+  if (numCombinations <= numChildren*2) {
+    NonTerminalSet::const_iterator p = sourceNonTerms.begin();
+    NonTerminalSet::const_iterator sEnd = sourceNonTerms.end();
+    for (; p != sEnd; ++p) {
+      const Word & sourceNonTerm = *p;
+
+      ChartCellLabelSet::const_iterator q = targetNonTerms.begin();
+      ChartCellLabelSet::const_iterator tEnd = targetNonTerms.end();
+      for (; q != tEnd; ++q) {
+        const ChartCellLabel &cellLabel = q->second;
+
+        RuleTableBinaryImage::NodeId child =
+          m_image.GetChild(node, sourceNonTerm, cellLabel.GetLabel());
+        if (!child) {
+          continue;
+        }
+
+        DottedRuleBinary *rule = new DottedRuleBinary(child, cellLabel,
+            prevDottedRule);
+        AddDottedRule(dottedRuleColl, stackInd, rule);
+      }
+    }
+  } else {
+    for (size_t ind = 0; ind < numChildren; ++ind) {
+      const Word *sourceNonTerm, *targetNonTerm;
+      RuleTableBinaryImage::NodeId child =
+        m_image.GetNonTermChild(node, ind, sourceNonTerm, targetNonTerm);
+
+      if (sourceNonTerms.find(*sourceNonTerm) == sourceNonTerms.end()) {
+        continue;
+      }
+      const ChartCellLabel *cellLabel = targetNonTerms.Find(*targetNonTerm);
+      if (!cellLabel) {
+        continue;
+      }
+
+      DottedRuleBinary *rule = new DottedRuleBinary(child, *cellLabel,
+          prevDottedRule);
+      AddDottedRule(dottedRuleColl, stackInd, rule);
+    }
+  }
+}
+
+const TargetPhraseCollection *ChartRuleLookupManagerBinary::GetTargetPhraseCollection(RuleTableBinaryImage::NodeId node)
+{
+  {
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(m_cacheMutex);
+#endif
+    std::map<RuleTableBinaryImage::NodeId, const TargetPhraseCollection*>::const_iterator iter = m_cache.find(node);
+    if (iter != m_cache.end()) {
+      return iter->second;
+    }
+  }
+
+  // created outside the lock; if another range got there first, keep theirs
+  const TargetPhraseCollection *tpc = m_image.CreateTargetPhraseCollection(node, m_ruleTable);
+
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(m_cacheMutex);
+#endif
+  std::pair<std::map<RuleTableBinaryImage::NodeId, const TargetPhraseCollection*>::iterator, bool> ret =
+    m_cache.insert(std::make_pair(node, tpc));
+  if (!ret.second) {
+    delete tpc;
+  }
+  return ret.first->second;
+}
+
+}  // namespace Moses
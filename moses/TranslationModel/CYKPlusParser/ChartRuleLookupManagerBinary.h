@@ -0,0 +1,91 @@
+/***********************************************************************
+ Moses - statistical machine translation system
+ Copyright (C) 2006-2013 University of Edinburgh
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ ***********************************************************************/
+
+#pragma once
+#ifndef moses_ChartRuleLookupManagerBinary_h
+#define moses_ChartRuleLookupManagerBinary_h
+
+#include <map>
+#include <vector>
+
+#ifdef WITH_THREADS
+#include <boost/thread/mutex.hpp>
+#endif
+
+#include "ChartRuleLookupManagerCYKPlus.h"
+#include "DotChartBinary.h"
+#include "moses/TranslationModel/RuleTable/BinaryImage.h"
+
+namespace Moses
+{
+
+class ChartParserCallback;
+class PhraseDictionary;
+class WordsRange;
+
+/** Implementation of ChartRuleLookupManager for a compiled rule table
+ * (PhraseDictionaryMemory loaded from a binary image). The search is the
+ * same as in ChartRuleLookupManagerMemory; target phrases are created on
+ * first use and kept for the rest of the sentence. Ranges with different
+ * start positions may be looked up concurrently.
+ */
+class ChartRuleLookupManagerBinary : public ChartRuleLookupManagerCYKPlus
+{
+public:
+  ChartRuleLookupManagerBinary(const InputType &sentence,
+                               const ChartCellCollectionBase &cellColl,
+                               const PhraseDictionary &ruleTable,
+                               const RuleTableBinaryImage &image);
+
+  ~ChartRuleLookupManagerBinary();
+
+  virtual void GetChartRuleCollection(
+    const WordsRange &range,
+    ChartParserCallback &outColl);
+
+  virtual bool IsConcurrent() const {
+    return true;
+  }
+
+private:
+  void ExtendPartialRuleApplication(
+    const DottedRuleBinary &prevDottedRule,
+    size_t startPos,
+    size_t endPos,
+    size_t stackInd,
+    DottedRuleCollBinary &dottedRuleColl);
+
+  void AddDottedRule(DottedRuleCollBinary &dottedRuleColl, size_t pos, const DottedRuleBinary *dottedRule) {
+    dottedRuleColl.Add(pos, dottedRule, m_image.IsLeaf(dottedRule->GetLastNode()));
+  }
+
+  const TargetPhraseCollection *GetTargetPhraseCollection(RuleTableBinaryImage::NodeId node);
+
+  std::vector<DottedRuleCollBinary*> m_dottedRuleColls;
+  const PhraseDictionary &m_ruleTable;
+  const RuleTableBinaryImage &m_image;
+  std::map<RuleTableBinaryImage::NodeId, const TargetPhraseCollection*> m_cache;
+#ifdef WITH_THREADS
+  boost::mutex m_cacheMutex;
+#endif
+};
+
+}  // namespace Moses
+
+#endif
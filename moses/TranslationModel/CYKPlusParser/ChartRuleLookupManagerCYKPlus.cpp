@@ -25,6 +25,7 @@
 #include "moses/NonTerminal.h"
 #include "moses/ChartCellCollection.h"
 #include "moses/ChartParserCallback.h"
+#include "moses/StackVec.h"
 #include "moses/TranslationModel/PhraseDictionaryMemory.h"
 
 namespace Moses
@@ -46,18 +47,18 @@ void ChartRuleLookupManagerCYKPlus::AddCompletedRule(
     node = node->GetPrev();
   }
 
-  // Fill m_stackVec with a stack pointer for each non-terminal.
-  m_stackVec.resize(rank);
+  // Fill stackVec with a stack pointer for each non-terminal.
+  StackVec stackVec(rank);
   node = &dottedRule;
   while (rank > 0) {
     if (node->IsNonTerminal()) {
-      m_stackVec[--rank] = &node->GetChartCellLabel();
+      stackVec[--rank] = &node->GetChartCellLabel();
     }
     node = node->GetPrev();
   }
 
   // Add the (TargetPhraseCollection, StackVec) pair to the collection.
-  outColl.Add(tpc, m_stackVec, range);
+  outColl.Add(tpc, stackVec, range);
 }
 
 }  // namespace Moses
@@ -22,7 +22,6 @@
 #define moses_ChartRuleLookupManagerCYKPlus_h
 
 #include "moses/ChartRuleLookupManager.h"
-#include "moses/StackVec.h"
 
 namespace Moses
 {
@@ -46,8 +45,6 @@ protected:
     const TargetPhraseCollection &tpc,
     const WordsRange &range,
     ChartParserCallback &outColl);
-
-  StackVec m_stackVec;
 };
 
 }  // namespace Moses
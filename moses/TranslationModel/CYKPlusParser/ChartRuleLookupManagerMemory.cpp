@@ -41,7 +41,7 @@ ChartRuleLookupManagerMemory::ChartRuleLookupManagerMemory(
   size_t sourceSize = src.GetSize();
   m_dottedRuleColls.resize(sourceSize);
 
-  const PhraseDictionaryNodeMemory &rootNode = m_ruleTable.GetRootNode();
+  const PhraseDictionaryNodeMemory &rootNode = m_ruleTable.GetRootNode(src);
 
   for (size_t ind = 0; ind < m_dottedRuleColls.size(); ++ind) {
 #ifdef USE_BOOST_POOL
@@ -187,7 +187,7 @@ void ChartRuleLookupManagerMemory::ExtendPartialRuleApplication(
   const PhraseDictionaryNodeMemory::NonTerminalMap & nonTermMap =
     node.GetNonTerminalMap();
 
-  const size_t numChildren = nonTermMap.size();
+  const size_t numChildren = nonTermMap.GetSize();
   if (numChildren == 0) {
     return;
   }
@@ -238,12 +238,9 @@ void ChartRuleLookupManagerMemory::ExtendPartialRuleApplication(
     }
   } else {
     // loop over possible expansions of the rule
-    PhraseDictionaryNodeMemory::NonTerminalMap::const_iterator p;
-    PhraseDictionaryNodeMemory::NonTerminalMap::const_iterator end =
-      nonTermMap.end();
-    for (p = nonTermMap.begin(); p != end; ++p) {
+    for (size_t ind = 0; ind < numChildren; ++ind) {
       // does it match possible source and target non-terminals?
-      const PhraseDictionaryNodeMemory::NonTerminalMapKey &key = p->first;
+      const PhraseDictionaryNodeMemory::NonTerminalMapKey &key = nonTermMap.GetKey(ind);
       const Word &sourceNonTerm = key.first;
       if (sourceNonTerms.find(sourceNonTerm) == sourceNonTerms.end()) {
         continue;
@@ -255,7 +252,7 @@ void ChartRuleLookupManagerMemory::ExtendPartialRuleApplication(
       }
 
       // create new rule
-      const PhraseDictionaryNodeMemory &child = p->second;
+      const PhraseDictionaryNodeMemory &child = nonTermMap.GetValue(ind);
 #ifdef USE_BOOST_POOL
       DottedRuleInMemory *rule = m_dottedRulePool.malloc();
       new (rule) DottedRuleInMemory(child, *cellLabel, prevDottedRule);
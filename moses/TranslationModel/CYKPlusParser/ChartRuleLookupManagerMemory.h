@@ -55,6 +55,15 @@ public:
     const WordsRange &range,
     ChartParserCallback &outColl);
 
+  //! the dotted rules of each start position are only touched by its ranges
+  virtual bool IsConcurrent() const {
+#ifdef USE_BOOST_POOL
+    return false; // m_dottedRulePool is shared
+#else
+    return true;
+#endif
+  }
+
 private:
   void ExtendPartialRuleApplication(
     const DottedRuleInMemory &prevDottedRule,
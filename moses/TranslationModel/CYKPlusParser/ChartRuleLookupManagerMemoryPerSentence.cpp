@@ -186,7 +186,7 @@ void ChartRuleLookupManagerMemoryPerSentence::ExtendPartialRuleApplication(
   const PhraseDictionaryNodeMemory::NonTerminalMap & nonTermMap =
     node.GetNonTerminalMap();
 
-  const size_t numChildren = nonTermMap.size();
+  const size_t numChildren = nonTermMap.GetSize();
   if (numChildren == 0) {
     return;
   }
@@ -237,12 +237,9 @@ void ChartRuleLookupManagerMemoryPerSentence::ExtendPartialRuleApplication(
     }
   } else {
     // loop over possible expansions of the rule
-    PhraseDictionaryNodeMemory::NonTerminalMap::const_iterator p;
-    PhraseDictionaryNodeMemory::NonTerminalMap::const_iterator end =
-      nonTermMap.end();
-    for (p = nonTermMap.begin(); p != end; ++p) {
+    for (size_t ind = 0; ind < numChildren; ++ind) {
       // does it match possible source and target non-terminals?
-      const PhraseDictionaryNodeMemory::NonTerminalMapKey &key = p->first;
+      const PhraseDictionaryNodeMemory::NonTerminalMapKey &key = nonTermMap.GetKey(ind);
       const Word &sourceNonTerm = key.first;
       if (sourceNonTerms.find(sourceNonTerm) == sourceNonTerms.end()) {
         continue;
@@ -254,7 +251,7 @@ void ChartRuleLookupManagerMemoryPerSentence::ExtendPartialRuleApplication(
       }
 
       // create new rule
-      const PhraseDictionaryNodeMemory &child = p->second;
+      const PhraseDictionaryNodeMemory &child = nonTermMap.GetValue(ind);
 #ifdef USE_BOOST_POOL
       DottedRuleInMemory *rule = m_dottedRulePool.malloc();
       new (rule) DottedRuleInMemory(child, *cellLabel, prevDottedRule);
@@ -0,0 +1,94 @@
+/***********************************************************************
+ Moses - statistical machine translation system
+ Copyright (C) 2006-2013 University of Edinburgh
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ ***********************************************************************/
+
+#pragma once
+
+#include "DotChart.h"
+#include "moses/TranslationModel/RuleTable/BinaryImage.h"
+#include "moses/Util.h"
+
+#include "util/check.hh"
+#include <algorithm>
+#include <vector>
+
+namespace Moses
+{
+
+/** Dotted rule whose last node is in a RuleTableBinaryImage
+ */
+class DottedRuleBinary : public DottedRule
+{
+public:
+  // used only to init dot stack.
+  explicit DottedRuleBinary(RuleTableBinaryImage::NodeId node)
+    : DottedRule()
+    , m_node(node) {}
+
+  DottedRuleBinary(RuleTableBinaryImage::NodeId node,
+                   const ChartCellLabel &cellLabel,
+                   const DottedRuleBinary &prev)
+    : DottedRule(cellLabel, prev)
+    , m_node(node) {}
+
+  RuleTableBinaryImage::NodeId GetLastNode() const {
+    return m_node;
+  }
+
+private:
+  RuleTableBinaryImage::NodeId m_node;
+};
+
+typedef std::vector<const DottedRuleBinary*> DottedRuleListBinary;
+
+// As DottedRuleColl, for dotted rules in a binary image
+class DottedRuleCollBinary
+{
+protected:
+  typedef std::vector<DottedRuleListBinary> CollType;
+  CollType m_coll;
+  DottedRuleListBinary m_expandableDottedRuleList;
+
+public:
+  DottedRuleCollBinary(size_t size)
+    : m_coll(size) {
+  }
+
+  ~DottedRuleCollBinary() {
+    std::for_each(m_coll.begin(), m_coll.end(),
+                  RemoveAllInColl<CollType::value_type>);
+  }
+
+  const DottedRuleListBinary &Get(size_t pos) const {
+    return m_coll[pos];
+  }
+
+  void Add(size_t pos, const DottedRuleBinary *dottedRule, bool isLeaf) {
+    CHECK(dottedRule);
+    m_coll[pos].push_back(dottedRule);
+    if (!isLeaf) {
+      m_expandableDottedRuleList.push_back(dottedRule);
+    }
+  }
+
+  const DottedRuleListBinary &GetExpandableDottedRuleList() const {
+    return m_expandableDottedRuleList;
+  }
+};
+
+}
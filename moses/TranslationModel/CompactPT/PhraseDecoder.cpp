@@ -40,6 +40,7 @@ PhraseDecoder::PhraseDecoder(
     m_containsAlignmentInfo(true), m_maxRank(0),
     m_symbolTree(0), m_multipleScoreTrees(false),
     m_scoreTrees(1), m_alignTree(0),
+    m_decodingCache(phraseDictionary.m_cacheMemory),
     m_phraseDictionary(phraseDictionary), m_input(input), m_output(output),
     m_weight(weight),
     m_separator(" ||| ")
@@ -198,7 +199,9 @@ TargetPhraseVectorPtr PhraseDecoder::CreateTargetPhraseCollection(const Phrase &
   TargetPhraseVectorPtr tpv(new TargetPhraseVector());
   size_t bitsLeft = 0;
 
-  if(m_coding == PREnc) {
+  // PREnc caches decoded subphrases, with the other codings only collections
+  // that are ready to be used are worth keeping
+  if(m_coding == PREnc || eval) {
     std::pair<TargetPhraseVectorPtr, size_t> cachedPhraseColl
     = m_decodingCache.Retrieve(sourcePhrase);
 
@@ -438,14 +441,11 @@ TargetPhraseVectorPtr PhraseDecoder::DecodeCollection(
   if(m_coding == PREnc && !extending) {
     bitsLeft = bitsLeft > 8 ? bitsLeft : 0;
     m_decodingCache.Cache(sourcePhrase, tpv, bitsLeft, m_maxRank);
+  } else if(m_coding != PREnc && eval) {
+    m_decodingCache.Cache(sourcePhrase, tpv);
   }
 
   return tpv;
 }
 
-void PhraseDecoder::PruneCache()
-{
-  m_decodingCache.Prune();
-}
-
 }
@@ -139,7 +139,9 @@ public:
                                          bool topLevel,
                                          bool eval);
 
-  void PruneCache();
+  const TargetPhraseCollectionCache &GetCache() const {
+    return m_decodingCache;
+  }
 };
 
 }
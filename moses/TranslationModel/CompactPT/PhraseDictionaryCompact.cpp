@@ -45,6 +45,7 @@ PhraseDictionaryCompact::PhraseDictionaryCompact(const std::string &line)
   :PhraseDictionary("PhraseDictionaryCompact", line)
   ,m_inMemory(true)
   ,m_useAlignmentInfo(true)
+  ,m_cacheMemory(64 << 20)
   ,m_hash(10, 16)
   ,m_phraseDecoder(0)
   ,m_weight(0)
@@ -52,6 +53,15 @@ PhraseDictionaryCompact::PhraseDictionaryCompact(const std::string &line)
   ReadParameters();
 }
 
+void PhraseDictionaryCompact::SetParameter(const std::string& key, const std::string& value)
+{
+  if (key == "cache-memory") {
+    m_cacheMemory = Scan<size_t>(value) << 20;
+  } else {
+    PhraseDictionary::SetParameter(key, value);
+  }
+}
+
 void PhraseDictionaryCompact::Load()
 {
   const StaticData &staticData = StaticData::Instance();
@@ -100,12 +110,6 @@ void PhraseDictionaryCompact::Load()
   CHECK(indexSize && coderSize && phraseSize);
 }
 
-struct CompareTargetPhrase {
-  bool operator() (const TargetPhrase &a, const TargetPhrase &b) {
-    return a.GetFutureScore() > b.GetFutureScore();
-  }
-};
-
 const TargetPhraseCollection*
 PhraseDictionaryCompact::GetTargetPhraseCollection(const Phrase &sourcePhrase) const
 {
@@ -120,18 +124,10 @@ PhraseDictionaryCompact::GetTargetPhraseCollection(const Phrase &sourcePhrase) c
   = m_phraseDecoder->CreateTargetPhraseCollection(sourcePhrase, true, true);
 
   if(decodedPhraseColl != NULL && decodedPhraseColl->size()) {
-    TargetPhraseVectorPtr tpv(new TargetPhraseVector(*decodedPhraseColl));
+    // Apply ttable_limit. The decoded collection may be shared through the
+    // decoding cache, so only the phrases that are kept are copied
     TargetPhraseCollection* phraseColl = new TargetPhraseCollection();
-
-    // Score phrases and if possible apply ttable_limit
-    TargetPhraseVector::iterator nth =
-      (m_tableLimit == 0 || tpv->size() < m_tableLimit) ?
-      tpv->end() : tpv->begin() + m_tableLimit;
-    std::nth_element(tpv->begin(), nth, tpv->end(), CompareTargetPhrase());
-    for(TargetPhraseVector::iterator it = tpv->begin(); it != nth; it++) {
-      TargetPhrase *tp = new TargetPhrase(*it);
-      phraseColl->Add(tp);
-    }
+    phraseColl->AddBest(decodedPhraseColl->begin(), decodedPhraseColl->end(), m_tableLimit);
 
     // Cache phrase pair for for clean-up or retrieval with PREnc
     const_cast<PhraseDictionaryCompact*>(this)->CacheForCleanup(phraseColl);
@@ -162,15 +158,20 @@ PhraseDictionaryCompact::~PhraseDictionaryCompact()
 
 //TO_STRING_BODY(PhraseDictionaryCompact)
 
-void PhraseDictionaryCompact::CacheForCleanup(TargetPhraseCollection* tpc)
+PhraseDictionaryCompact::PhraseCache &PhraseDictionaryCompact::GetSentenceCache()
 {
 #ifdef WITH_THREADS
-  boost::mutex::scoped_lock lock(m_sentenceMutex);
-  PhraseCache &ref = m_sentenceCache[boost::this_thread::get_id()];
+  if(m_sentenceCache.get() == NULL)
+    m_sentenceCache.reset(new PhraseCache());
+  return *m_sentenceCache;
 #else
-  PhraseCache &ref = m_sentenceCache;
+  return m_sentenceCache;
 #endif
-  ref.push_back(tpc);
+}
+
+void PhraseDictionaryCompact::CacheForCleanup(TargetPhraseCollection* tpc)
+{
+  GetSentenceCache().push_back(tpc);
 }
 
 void PhraseDictionaryCompact::AddEquivPhrase(const Phrase &source,
@@ -181,14 +182,16 @@ void PhraseDictionaryCompact::CleanUpAfterSentenceProcessing(const InputType &so
   if(!m_inMemory)
     m_hash.KeepNLastRanges(0.01, 0.2);
 
-  m_phraseDecoder->PruneCache();
+  IFVERBOSE(2) {
+    const TargetPhraseCollectionCache &cache = m_phraseDecoder->GetCache();
+    size_t lookups = cache.GetHits() + cache.GetMisses();
+    VERBOSE(2, GetScoreProducerDescription() << " decoding cache: "
+            << cache.GetHits() << " hits, " << cache.GetMisses() << " misses ("
+            << (lookups ? 100.0 * cache.GetHits() / lookups : 0.0) << "% hit rate), "
+            << (cache.GetMemoryUse() >> 10) << " KB" << endl);
+  }
 
-#ifdef WITH_THREADS
-  boost::mutex::scoped_lock lock(m_sentenceMutex);
-  PhraseCache &ref = m_sentenceCache[boost::this_thread::get_id()];
-#else
-  PhraseCache &ref = m_sentenceCache;
-#endif
+  PhraseCache &ref = GetSentenceCache();
 
   for(PhraseCache::iterator it = ref.begin(); it != ref.end(); it++)
     delete *it;
@@ -25,9 +25,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <boost/unordered_map.hpp>
 
 #ifdef WITH_THREADS
-#ifdef BOOST_HAS_PTHREADS
-#include <boost/thread/mutex.hpp>
-#endif
+#include <boost/thread/tss.hpp>
 #endif
 
 #include "moses/TranslationModel/PhraseDictionary.h"
@@ -50,15 +48,16 @@ protected:
 
   bool m_inMemory;
   bool m_useAlignmentInfo;
+  size_t m_cacheMemory; //! budget of the shared decoding cache in bytes
 
   typedef std::vector<TargetPhraseCollection*> PhraseCache;
 #ifdef WITH_THREADS
-  boost::mutex m_sentenceMutex;
-  typedef std::map<boost::thread::id, PhraseCache> SentenceCache;
+  boost::thread_specific_ptr<PhraseCache> m_sentenceCache;
 #else
-  typedef PhraseCache SentenceCache;
+  PhraseCache m_sentenceCache;
 #endif
-  SentenceCache m_sentenceCache;
+
+  PhraseCache &GetSentenceCache();
 
   BlockHashIndex m_hash;
   PhraseDecoder* m_phraseDecoder;
@@ -74,6 +73,8 @@ public:
 
   void Load();
 
+  void SetParameter(const std::string& key, const std::string& value);
+
   const TargetPhraseCollection* GetTargetPhraseCollection(const Phrase &source) const;
   TargetPhraseVectorPtr GetTargetPhraseCollectionRaw(const Phrase &source) const;
 
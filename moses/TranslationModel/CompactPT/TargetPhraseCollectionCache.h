@@ -22,8 +22,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #ifndef moses_TargetPhraseCollectionCache_h
 #define moses_TargetPhraseCollectionCache_h
 
-#include <map>
-#include <set>
+#include <list>
 #include <vector>
 
 #ifdef WITH_THREADS
@@ -33,6 +32,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #endif
 
 #include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/detail/atomic_count.hpp>
 
 #include "moses/Phrase.h"
 #include "moses/TargetPhraseCollection.h"
@@ -44,119 +45,155 @@ namespace Moses
 typedef std::vector<TargetPhrase> TargetPhraseVector;
 typedef boost::shared_ptr<TargetPhraseVector> TargetPhraseVectorPtr;
 
+/** Cache of decoded target phrase collections shared by all threads.
+ *
+ * Entries are spread over independently locked shards by the hash of the
+ * source phrase, each shard evicts its least recently used entries once
+ * it exceeds its share of the memory budget. Collections are reference
+ * counted, so an evicted entry stays valid for threads still using it.
+ */
 class TargetPhraseCollectionCache
 {
 private:
-  size_t m_max;
-  float m_tolerance;
+  static const size_t s_numShards = 32;
 
   struct LastUsed {
-    clock_t m_clock;
+    Phrase m_sourcePhrase;
     TargetPhraseVectorPtr m_tpv;
     size_t m_bitsLeft;
+    size_t m_bytes;
 
-    LastUsed() : m_clock(0), m_bitsLeft(0) {}
-
-    LastUsed(clock_t clock, TargetPhraseVectorPtr tpv, size_t bitsLeft = 0)
-      : m_clock(clock), m_tpv(tpv), m_bitsLeft(bitsLeft) {}
+    LastUsed(const Phrase &sourcePhrase, TargetPhraseVectorPtr tpv,
+             size_t bitsLeft, size_t bytes)
+      : m_sourcePhrase(sourcePhrase), m_tpv(tpv), m_bitsLeft(bitsLeft),
+        m_bytes(bytes) {}
   };
 
-  typedef std::map<Phrase, LastUsed> CacheMap;
+  // most recently used entry at the front
+  typedef std::list<LastUsed> LRUList;
+  typedef boost::unordered_map<Phrase, LRUList::iterator> CacheMap;
 
-  CacheMap m_phraseCache;
+  struct Shard {
+    Shard() : m_bytes(0) {}
 
 #ifdef WITH_THREADS
-  boost::mutex m_mutex;
+    mutable boost::mutex m_mutex;
 #endif
+    LRUList m_entries;
+    CacheMap m_phraseCache;
+    size_t m_bytes;
+  };
 
-public:
+  Shard m_shards[s_numShards];
+  size_t m_maxShardBytes;
 
-  typedef CacheMap::iterator iterator;
-  typedef CacheMap::const_iterator const_iterator;
+  boost::detail::atomic_count m_hits, m_misses;
 
-  TargetPhraseCollectionCache(size_t max = 5000, float tolerance = 0.2)
-    : m_max(max), m_tolerance(tolerance) {
+  Shard &GetShard(const Phrase &sourcePhrase) {
+    return m_shards[hash_value(sourcePhrase) % s_numShards];
   }
 
-  iterator Begin() {
-    return m_phraseCache.begin();
+  static size_t EstimateBytes(const Phrase &sourcePhrase,
+                              const TargetPhraseVector &tpv) {
+    size_t bytes = sizeof(LastUsed) + sourcePhrase.GetSize() * sizeof(Word)
+                   + tpv.capacity() * sizeof(TargetPhrase);
+    for(TargetPhraseVector::const_iterator it = tpv.begin(); it != tpv.end(); it++)
+      bytes += it->GetSize() * sizeof(Word)
+               + it->GetScoreBreakdown().Size() * sizeof(FValue);
+    return bytes;
   }
 
-  const_iterator Begin() const {
-    return m_phraseCache.begin();
+  // caller holds the shard lock
+  void Evict(Shard &shard) {
+    while(shard.m_bytes > m_maxShardBytes && !shard.m_entries.empty()) {
+      LastUsed &lu = shard.m_entries.back();
+      shard.m_bytes -= lu.m_bytes;
+      shard.m_phraseCache.erase(lu.m_sourcePhrase);
+      shard.m_entries.pop_back();
+    }
   }
 
-  iterator End() {
-    return m_phraseCache.end();
-  }
+public:
 
-  const_iterator End() const {
-    return m_phraseCache.end();
+  TargetPhraseCollectionCache(size_t maxBytes = 64 << 20)
+    : m_maxShardBytes(maxBytes / s_numShards), m_hits(0), m_misses(0) {
   }
 
   void Cache(const Phrase &sourcePhrase, TargetPhraseVectorPtr tpv,
              size_t bitsLeft = 0, size_t maxRank = 0) {
+    if(maxRank && tpv->size() > maxRank) {
+      TargetPhraseVectorPtr tpv_temp(new TargetPhraseVector());
+      tpv_temp->resize(maxRank);
+      std::copy(tpv->begin(), tpv->begin() + maxRank, tpv_temp->begin());
+      tpv = tpv_temp;
+    }
+    size_t bytes = EstimateBytes(sourcePhrase, *tpv);
+
+    Shard &shard = GetShard(sourcePhrase);
 #ifdef WITH_THREADS
-    boost::mutex::scoped_lock lock(m_mutex);
+    boost::mutex::scoped_lock lock(shard.m_mutex);
 #endif
 
-    iterator it = m_phraseCache.find(sourcePhrase);
-    if(it != m_phraseCache.end())
-      it->second.m_clock = clock();
-    else {
-      if(maxRank && tpv->size() > maxRank) {
-        TargetPhraseVectorPtr tpv_temp(new TargetPhraseVector());
-        tpv_temp->resize(maxRank);
-        std::copy(tpv->begin(), tpv->begin() + maxRank, tpv_temp->begin());
-        m_phraseCache[sourcePhrase] = LastUsed(clock(), tpv_temp, bitsLeft);
-      } else
-        m_phraseCache[sourcePhrase] = LastUsed(clock(), tpv, bitsLeft);
+    CacheMap::iterator it = shard.m_phraseCache.find(sourcePhrase);
+    if(it != shard.m_phraseCache.end()) {
+      shard.m_entries.splice(shard.m_entries.begin(), shard.m_entries, it->second);
+    } else {
+      shard.m_entries.push_front(LastUsed(sourcePhrase, tpv, bitsLeft, bytes));
+      shard.m_phraseCache[sourcePhrase] = shard.m_entries.begin();
+      shard.m_bytes += bytes;
+      Evict(shard);
     }
   }
 
   std::pair<TargetPhraseVectorPtr, size_t> Retrieve(const Phrase &sourcePhrase) {
+    Shard &shard = GetShard(sourcePhrase);
+    {
 #ifdef WITH_THREADS
-    boost::mutex::scoped_lock lock(m_mutex);
+      boost::mutex::scoped_lock lock(shard.m_mutex);
 #endif
 
-    iterator it = m_phraseCache.find(sourcePhrase);
-    if(it != m_phraseCache.end()) {
-      LastUsed &lu = it->second;
-      lu.m_clock = clock();
-      return std::make_pair(lu.m_tpv, lu.m_bitsLeft);
-    } else
-      return std::make_pair(TargetPhraseVectorPtr(), 0);
+      CacheMap::iterator it = shard.m_phraseCache.find(sourcePhrase);
+      if(it != shard.m_phraseCache.end()) {
+        shard.m_entries.splice(shard.m_entries.begin(), shard.m_entries, it->second);
+        ++m_hits;
+        LastUsed &lu = *it->second;
+        return std::make_pair(lu.m_tpv, lu.m_bitsLeft);
+      }
+    }
+    ++m_misses;
+    return std::make_pair(TargetPhraseVectorPtr(), 0);
   }
 
-  void Prune() {
+  void CleanUp() {
+    for(size_t i = 0; i < s_numShards; i++) {
+      Shard &shard = m_shards[i];
 #ifdef WITH_THREADS
-    boost::mutex::scoped_lock lock(m_mutex);
+      boost::mutex::scoped_lock lock(shard.m_mutex);
 #endif
+      shard.m_phraseCache.clear();
+      shard.m_entries.clear();
+      shard.m_bytes = 0;
+    }
+  }
 
-    if(m_phraseCache.size() > m_max * (1 + m_tolerance)) {
-      typedef std::set<std::pair<clock_t, Phrase> > Cands;
-      Cands cands;
-      for(CacheMap::iterator it = m_phraseCache.begin();
-          it != m_phraseCache.end(); it++) {
-        LastUsed &lu = it->second;
-        cands.insert(std::make_pair(lu.m_clock, it->first));
-      }
-
-      for(Cands::iterator it = cands.begin(); it != cands.end(); it++) {
-        const Phrase& p = it->second;
-        m_phraseCache.erase(p);
+  size_t GetHits() const {
+    return m_hits;
+  }
 
-        if(m_phraseCache.size() < (m_max * (1 - m_tolerance)))
-          break;
-      }
-    }
+  size_t GetMisses() const {
+    return m_misses;
   }
 
-  void CleanUp() {
+  size_t GetMemoryUse() const {
+    size_t bytes = 0;
+    for(size_t i = 0; i < s_numShards; i++) {
+      const Shard &shard = m_shards[i];
 #ifdef WITH_THREADS
-    boost::mutex::scoped_lock lock(m_mutex);
+      boost::mutex::scoped_lock lock(shard.m_mutex);
 #endif
-    m_phraseCache.clear();
+      bytes += shard.m_bytes;
+    }
+    return bytes;
   }
 
 };
@@ -34,6 +34,8 @@
 #include "moses/TranslationModel/RuleTable/LoaderFactory.h"
 #include "moses/TranslationModel/RuleTable/Loader.h"
 #include "moses/TranslationModel/CYKPlusParser/ChartRuleLookupManagerMemory.h"
+#include "moses/TranslationModel/CYKPlusParser/ChartRuleLookupManagerBinary.h"
+#include "util/exception.hh"
 
 using namespace std;
 
@@ -45,12 +47,26 @@ PhraseDictionaryMemory::PhraseDictionaryMemory(const std::string &line)
   ReadParameters();
 }
 
+void PhraseDictionaryMemory::Load()
+{
+  if (!RuleTableBinaryImage::IsBinaryImage(m_filePath)) {
+    RuleTableTrie::Load();
+    return;
+  }
+
+  SetFeaturesToApply();
+  m_binaryImage.reset(new RuleTableBinaryImage(m_filePath, m_input, m_output));
+  UTIL_THROW_IF(m_binaryImage->GetNumScores() != m_numScoreComponents, util::Exception,
+                m_filePath << " has " << m_binaryImage->GetNumScores()
+                << " scores per rule, expected " << m_numScoreComponents);
+}
+
 TargetPhraseCollection &PhraseDictionaryMemory::GetOrCreateTargetPhraseCollection(
   const Phrase &source
   , const TargetPhrase &target
   , const Word *sourceLHS)
 {
-  PhraseDictionaryNodeMemory &currNode = GetOrCreateNode(source, target, sourceLHS);
+  PhraseDictionaryNodeMemory &currNode = GetOrCreateNode(m_collection, source, target, sourceLHS);
   return currNode.GetTargetPhraseCollection();
 }
 
@@ -59,6 +75,10 @@ const TargetPhraseCollection *PhraseDictionaryMemory::GetTargetPhraseCollection(
   Phrase source(sourceOrig);
   source.OnlyTheseFactors(m_inputFactors);
 
+  if (m_binaryImage) {
+    return GetTargetPhraseCollectionFromImage(source);
+  }
+
   // exactly like CreateTargetPhraseCollection, but don't create
   const size_t size = source.GetSize();
 
@@ -73,7 +93,45 @@ const TargetPhraseCollection *PhraseDictionaryMemory::GetTargetPhraseCollection(
   return &currNode->GetTargetPhraseCollection();
 }
 
-PhraseDictionaryNodeMemory &PhraseDictionaryMemory::GetOrCreateNode(const Phrase &source
+const TargetPhraseCollection *PhraseDictionaryMemory::GetTargetPhraseCollectionFromImage(const Phrase& source) const
+{
+  RuleTableBinaryImage::NodeId node = m_binaryImage->GetRoot();
+  for (size_t pos = 0 ; pos < source.GetSize() ; ++pos) {
+    node = m_binaryImage->GetChild(node, source.GetWord(pos));
+    if (!node)
+      return NULL;
+  }
+
+  const TargetPhraseCollection *coll = m_binaryImage->CreateTargetPhraseCollection(node, *this);
+  if (coll) {
+    GetSentenceCache().push_back(coll);
+  }
+  return coll;
+}
+
+PhraseDictionaryMemory::PhraseCache &PhraseDictionaryMemory::GetSentenceCache() const
+{
+#ifdef WITH_THREADS
+  if (m_sentenceCache.get() == NULL)
+    m_sentenceCache.reset(new PhraseCache());
+  return *m_sentenceCache;
+#else
+  return m_sentenceCache;
+#endif
+}
+
+void PhraseDictionaryMemory::CleanUpAfterSentenceProcessing(const InputType &source)
+{
+  if (!m_binaryImage) {
+    return;
+  }
+
+  PhraseCache &cache = GetSentenceCache();
+  RemoveAllInColl(cache);
+}
+
+PhraseDictionaryNodeMemory &PhraseDictionaryMemory::GetOrCreateNode(PhraseDictionaryNodeMemory &rootNode
+    , const Phrase &source
     , const TargetPhrase &target
     , const Word *sourceLHS)
 {
@@ -82,7 +140,7 @@ PhraseDictionaryNodeMemory &PhraseDictionaryMemory::GetOrCreateNode(const Phrase
   const AlignmentInfo &alignmentInfo = target.GetAlignNonTerm();
   AlignmentInfo::const_iterator iterAlign = alignmentInfo.begin();
 
-  PhraseDictionaryNodeMemory *currNode = &m_collection;
+  PhraseDictionaryNodeMemory *currNode = &rootNode;
   for (size_t pos = 0 ; pos < size ; ++pos) {
     const Word& word = source.GetWord(pos);
 
@@ -116,11 +174,15 @@ ChartRuleLookupManager *PhraseDictionaryMemory::CreateRuleLookupManager(
   const InputType &sentence,
   const ChartCellCollectionBase &cellCollection)
 {
+  if (m_binaryImage) {
+    return new ChartRuleLookupManagerBinary(sentence, cellCollection, *this, *m_binaryImage);
+  }
   return new ChartRuleLookupManagerMemory(sentence, cellCollection, *this);
 }
 
 void PhraseDictionaryMemory::SortAndPrune()
 {
+  m_collection.Freeze();
   if (GetTableLimit()) {
     m_collection.Sort(GetTableLimit());
   }
@@ -135,12 +197,12 @@ ostream& operator<<(ostream& out, const PhraseDictionaryMemory& phraseDict)
   typedef PhraseDictionaryNodeMemory::NonTerminalMap NonTermMap;
 
   const PhraseDictionaryNodeMemory &coll = phraseDict.m_collection;
-  for (NonTermMap::const_iterator p = coll.m_nonTermMap.begin(); p != coll.m_nonTermMap.end(); ++p) {
-    const Word &sourceNonTerm = p->first.first;
+  for (size_t i = 0; i < coll.m_nonTermMap.GetSize(); ++i) {
+    const Word &sourceNonTerm = coll.m_nonTermMap.GetKey(i).first;
     out << sourceNonTerm;
   }
-  for (TermMap::const_iterator p = coll.m_sourceTermMap.begin(); p != coll.m_sourceTermMap.end(); ++p) {
-    const Word &sourceTerm = p->first;
+  for (size_t i = 0; i < coll.m_sourceTermMap.GetSize(); ++i) {
+    const Word &sourceTerm = coll.m_sourceTermMap.GetKey(i);
     out << sourceTerm;
   }
   return out;
@@ -24,13 +24,24 @@
 #include "moses/InputType.h"
 #include "moses/NonTerminal.h"
 #include "moses/TranslationModel/RuleTable/Trie.h"
+#include "moses/TranslationModel/RuleTable/BinaryImage.h"
 #include "util/check.hh"
 
+#include <boost/scoped_ptr.hpp>
+
+#ifdef WITH_THREADS
+#include <boost/thread/tss.hpp>
+#endif
+
 namespace Moses
 {
 
 /** Implementation of a SCFG rule table in a trie.  Looking up a rule of
  * length n symbols requires n look-ups to find the TargetPhraseCollection.
+ *
+ * If the table file is a compiled image (see processRuleTableBin), it is
+ * mapped instead of being loaded into the trie and the target phrases are
+ * created per sentence, as they are looked up.
  */
 class PhraseDictionaryMemory : public RuleTableTrie
 {
@@ -45,7 +56,10 @@ protected:
 public:
   PhraseDictionaryMemory(const std::string &line);
 
-  const PhraseDictionaryNodeMemory &GetRootNode() const {
+  void Load();
+
+  //! root of the rules for source; the same trie for every sentence here
+  virtual const PhraseDictionaryNodeMemory &GetRootNode(const InputType &source) const {
     return m_collection;
   }
 
@@ -53,6 +67,8 @@ public:
     const InputType &,
     const ChartCellCollectionBase &);
 
+  void CleanUpAfterSentenceProcessing(const InputType &source);
+
   TO_STRING();
 
 protected:
@@ -60,13 +76,28 @@ protected:
     const Phrase &source, const TargetPhrase &target, const Word *sourceLHS);
   const TargetPhraseCollection *GetTargetPhraseCollection(const Phrase& source) const;
 
-  PhraseDictionaryNodeMemory &GetOrCreateNode(const Phrase &source
+  PhraseDictionaryNodeMemory &GetOrCreateNode(PhraseDictionaryNodeMemory &rootNode
+      , const Phrase &source
       , const TargetPhrase &target
       , const Word *sourceLHS);
 
   void SortAndPrune();
 
   PhraseDictionaryNodeMemory m_collection;
+
+  // set instead of m_collection when loaded from a compiled image
+  boost::scoped_ptr<RuleTableBinaryImage> m_binaryImage;
+
+  // target phrases created from the image for the current sentence
+  typedef std::vector<const TargetPhraseCollection*> PhraseCache;
+#ifdef WITH_THREADS
+  mutable boost::thread_specific_ptr<PhraseCache> m_sentenceCache;
+#else
+  mutable PhraseCache m_sentenceCache;
+#endif
+
+  PhraseCache &GetSentenceCache() const;
+  const TargetPhraseCollection *GetTargetPhraseCollectionFromImage(const Phrase &source) const;
 };
 
 }  // namespace Moses
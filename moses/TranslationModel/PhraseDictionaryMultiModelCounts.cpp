@@ -350,7 +350,7 @@ float PhraseDictionaryMultiModelCounts::GetTargetCount(const Phrase &target, siz
   // in inverse mode, we want the first score of the first phrase pair (note: if we were to work with truly symmetric models, it would be the third score)
   if (ret_raw && ret_raw->GetSize() > 0) {
     const TargetPhrase * targetPhrase = *(ret_raw->begin());
-    return UntransformScore(targetPhrase->GetScoreBreakdown().GetScoresForProducer(&pd)[0]);
+    return UntransformScore(targetPhrase->GetScoreBreakdown().GetScoreComponent(&pd, 0));
   }
 
   // target phrase unknown
@@ -30,12 +30,14 @@ namespace Moses
 
 void PhraseDictionaryNodeMemory::Prune(size_t tableLimit)
 {
+  CHECK(m_sourceTermMap.IsFrozen() && m_nonTermMap.IsFrozen());
+
   // recusively prune
-  for (TerminalMap::iterator p = m_sourceTermMap.begin(); p != m_sourceTermMap.end(); ++p) {
-    p->second.Prune(tableLimit);
+  for (size_t i = 0; i < m_sourceTermMap.GetSize(); ++i) {
+    m_sourceTermMap.GetValue(i).Prune(tableLimit);
   }
-  for (NonTerminalMap::iterator p = m_nonTermMap.begin(); p != m_nonTermMap.end(); ++p) {
-    p->second.Prune(tableLimit);
+  for (size_t i = 0; i < m_nonTermMap.GetSize(); ++i) {
+    m_nonTermMap.GetValue(i).Prune(tableLimit);
   }
 
   // prune TargetPhraseCollection in this node
@@ -44,21 +46,43 @@ void PhraseDictionaryNodeMemory::Prune(size_t tableLimit)
 
 void PhraseDictionaryNodeMemory::Sort(size_t tableLimit)
 {
+  CHECK(m_sourceTermMap.IsFrozen() && m_nonTermMap.IsFrozen());
+
   // recusively sort
-  for (TerminalMap::iterator p = m_sourceTermMap.begin(); p != m_sourceTermMap.end(); ++p) {
-    p->second.Sort(tableLimit);
+  for (size_t i = 0; i < m_sourceTermMap.GetSize(); ++i) {
+    m_sourceTermMap.GetValue(i).Sort(tableLimit);
   }
-  for (NonTerminalMap::iterator p = m_nonTermMap.begin(); p != m_nonTermMap.end(); ++p) {
-    p->second.Sort(tableLimit);
+  for (size_t i = 0; i < m_nonTermMap.GetSize(); ++i) {
+    m_nonTermMap.GetValue(i).Sort(tableLimit);
   }
 
   // prune TargetPhraseCollection in this node
   m_targetPhraseCollection.Sort(true, tableLimit);
 }
 
+void PhraseDictionaryNodeMemory::Freeze()
+{
+  m_sourceTermMap.Freeze();
+  m_nonTermMap.Freeze();
+
+  for (size_t i = 0; i < m_sourceTermMap.GetSize(); ++i) {
+    m_sourceTermMap.GetValue(i).Freeze();
+  }
+  for (size_t i = 0; i < m_nonTermMap.GetSize(); ++i) {
+    m_nonTermMap.GetValue(i).Freeze();
+  }
+}
+
+void PhraseDictionaryNodeMemory::Swap(PhraseDictionaryNodeMemory &other)
+{
+  m_sourceTermMap.Swap(other.m_sourceTermMap);
+  m_nonTermMap.Swap(other.m_nonTermMap);
+  m_targetPhraseCollection.Swap(other.m_targetPhraseCollection);
+}
+
 PhraseDictionaryNodeMemory *PhraseDictionaryNodeMemory::GetOrCreateChild(const Word &sourceTerm)
 {
-  return &m_sourceTermMap[sourceTerm];
+  return &m_sourceTermMap.GetOrCreate(sourceTerm);
 }
 
 PhraseDictionaryNodeMemory *PhraseDictionaryNodeMemory::GetOrCreateChild(const Word &sourceNonTerm, const Word &targetNonTerm)
@@ -66,16 +90,14 @@ PhraseDictionaryNodeMemory *PhraseDictionaryNodeMemory::GetOrCreateChild(const W
   CHECK(sourceNonTerm.IsNonTerminal());
   CHECK(targetNonTerm.IsNonTerminal());
 
-  NonTerminalMapKey key(sourceNonTerm, targetNonTerm);
-  return &m_nonTermMap[NonTerminalMapKey(sourceNonTerm, targetNonTerm)];
+  return &m_nonTermMap.GetOrCreate(NonTerminalMapKey(sourceNonTerm, targetNonTerm));
 }
 
 const PhraseDictionaryNodeMemory *PhraseDictionaryNodeMemory::GetChild(const Word &sourceTerm) const
 {
   CHECK(!sourceTerm.IsNonTerminal());
 
-  TerminalMap::const_iterator p = m_sourceTermMap.find(sourceTerm);
-  return (p == m_sourceTermMap.end()) ? NULL : &p->second;
+  return m_sourceTermMap.Find(sourceTerm);
 }
 
 const PhraseDictionaryNodeMemory *PhraseDictionaryNodeMemory::GetChild(const Word &sourceNonTerm, const Word &targetNonTerm) const
@@ -84,14 +106,13 @@ const PhraseDictionaryNodeMemory *PhraseDictionaryNodeMemory::GetChild(const Wor
   CHECK(targetNonTerm.IsNonTerminal());
 
   NonTerminalMapKey key(sourceNonTerm, targetNonTerm);
-  NonTerminalMap::const_iterator p = m_nonTermMap.find(key);
-  return (p == m_nonTermMap.end()) ? NULL : &p->second;
+  return m_nonTermMap.Find(key);
 }
 
 void PhraseDictionaryNodeMemory::Clear()
 {
-  m_sourceTermMap.clear();
-  m_nonTermMap.clear();
+  m_sourceTermMap.Clear();
+  m_nonTermMap.Clear();
   m_targetPhraseCollection.Clear();
 }
 
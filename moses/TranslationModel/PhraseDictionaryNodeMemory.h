@@ -29,10 +29,9 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "moses/Word.h"
 #include "moses/TargetPhraseCollection.h"
 #include "moses/Terminal.h"
+#include "TrieChildMap.h"
 
 #include <boost/functional/hash.hpp>
-#include <boost/unordered_map.hpp>
-#include <boost/version.hpp>
 
 namespace Moses
 {
@@ -88,27 +87,40 @@ public:
   }
 };
 
-/** One node of the PhraseDictionaryMemory structure
+//! orders non-terminal keys by the factor ids of their first factors
+class NonTerminalMapKeyLess
+{
+public:
+  bool operator()(const std::pair<Word, Word> & k1,
+                  const std::pair<Word, Word> & k2) const {
+    const size_t s1 = k1.first[0]->GetId(), s2 = k2.first[0]->GetId();
+    if (s1 != s2) {
+      return s1 < s2;
+    }
+    return k1.second[0]->GetId() < k2.second[0]->GetId();
+  }
+};
+
+/** One node of the PhraseDictionaryMemory structure.
+ *  Once the table is loaded, Freeze() packs the children of each node into
+ *  sorted arrays (see TrieChildMap); the lookup functions need a frozen trie.
 */
 class PhraseDictionaryNodeMemory
 {
 public:
   typedef std::pair<Word, Word> NonTerminalMapKey;
 
-#if defined(BOOST_VERSION) && (BOOST_VERSION >= 104200)
-  typedef boost::unordered_map<Word,
+  typedef TrieChildMap<Word,
           PhraseDictionaryNodeMemory,
           TerminalHasher,
-          TerminalEqualityPred> TerminalMap;
+          TerminalEqualityPred,
+          TerminalLess> TerminalMap;
 
-  typedef boost::unordered_map<NonTerminalMapKey,
+  typedef TrieChildMap<NonTerminalMapKey,
           PhraseDictionaryNodeMemory,
           NonTerminalMapKeyHasher,
-          NonTerminalMapKeyEqualityPred> NonTerminalMap;
-#else
-  typedef std::map<Word, PhraseDictionaryNodeMemory> TerminalMap;
-  typedef std::map<NonTerminalMapKey, PhraseDictionaryNodeMemory> NonTerminalMap;
-#endif
+          NonTerminalMapKeyEqualityPred,
+          NonTerminalMapKeyLess> NonTerminalMap;
 
 private:
   friend std::ostream& operator<<(std::ostream&, const PhraseDictionaryMemory&);
@@ -123,11 +135,14 @@ public:
   PhraseDictionaryNodeMemory() {}
 
   bool IsLeaf() const {
-    return m_sourceTermMap.empty() && m_nonTermMap.empty();
+    return m_sourceTermMap.IsEmpty() && m_nonTermMap.IsEmpty();
   }
 
   void Prune(size_t tableLimit);
   void Sort(size_t tableLimit);
+  //! pack the children of this node and below. No children can be added afterwards
+  void Freeze();
+  void Swap(PhraseDictionaryNodeMemory &other);
   PhraseDictionaryNodeMemory *GetOrCreateChild(const Word &sourceTerm);
   PhraseDictionaryNodeMemory *GetOrCreateChild(const Word &sourceNonTerm, const Word &targetNonTerm);
   const PhraseDictionaryNodeMemory *GetChild(const Word &sourceTerm) const;
@@ -140,6 +155,10 @@ public:
     return m_targetPhraseCollection;
   }
 
+  const TerminalMap & GetTerminalMap() const {
+    return m_sourceTermMap;
+  }
+
   const NonTerminalMap & GetNonTerminalMap() const {
     return m_nonTermMap;
   }
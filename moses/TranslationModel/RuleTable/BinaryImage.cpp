@@ -0,0 +1,224 @@
+/***********************************************************************
+ Moses - statistical machine translation system
+ Copyright (C) 2006-2013 University of Edinburgh
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include "BinaryImage.h"
+
+#include "moses/AlignmentInfoCollection.h"
+#include "moses/TargetPhrase.h"
+#include "moses/TargetPhraseCollection.h"
+#include "moses/TranslationModel/PhraseDictionary.h"
+#include "moses/Util.h"
+#include "util/exception.hh"
+#include "util/file.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
+
+namespace Moses
+{
+
+using namespace BinaryRuleTable;
+
+namespace
+{
+bool ChildLess(const Child &child, const std::pair<UINT32, UINT32> &key)
+{
+  return child.first < key.first
+         || (child.first == key.first && child.second < key.second);
+}
+}
+
+bool RuleTableBinaryImage::IsBinaryImage(const std::string &path)
+{
+  std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+  char magic[sizeof(MAGIC)];
+  file.read(magic, sizeof(MAGIC) - 1);
+  return file && std::memcmp(magic, MAGIC, sizeof(MAGIC) - 1) == 0;
+}
+
+RuleTableBinaryImage::RuleTableBinaryImage(const std::string &path,
+    const std::vector<FactorType> &input,
+    const std::vector<FactorType> &output)
+{
+  util::scoped_fd file(util::OpenReadOrThrow(path.c_str()));
+  util::MapRead(util::LAZY, file.get(), 0, util::SizeOrThrow(file.get()), m_mem);
+#ifndef WIN32
+  madvise(m_mem.get(), m_mem.size(), MADV_RANDOM);
+#endif
+
+  UTIL_THROW_IF(m_mem.size() < sizeof(Header)
+                || std::memcmp(GetHeader().magic, MAGIC, sizeof(MAGIC) - 1) != 0,
+                util::Exception, path << " is not a binary rule table");
+
+  LoadVocab(input, output);
+  LoadAlignments();
+}
+
+void RuleTableBinaryImage::LoadVocab(const std::vector<FactorType> &input,
+                                     const std::vector<FactorType> &output)
+{
+  const UINT64 *offsets = reinterpret_cast<const UINT64*>(GetData(GetHeader().vocabOffset));
+  const size_t vocabSize = offsets[0];
+  ++offsets;
+  const char *strings = reinterpret_cast<const char*>(offsets + vocabSize + 1);
+
+  m_sourceWords.resize(vocabSize);
+  m_targetWords.resize(vocabSize);
+  for (size_t id = 0; id < vocabSize; ++id) {
+    const char *entry = strings + offsets[id];
+    const bool isNonTerm = (entry[0] != 0);
+    const StringPiece str(entry + 1, offsets[id + 1] - offsets[id] - 1);
+
+    Word &sourceWord = m_sourceWords[id];
+    Word &targetWord = m_targetWords[id];
+    sourceWord.CreateFromString(Input, input, str, isNonTerm);
+    targetWord.CreateFromString(Output, output, str, isNonTerm);
+
+    if (isNonTerm) {
+      // non-terminals are compared on their first factor only
+      m_sourceNonTermIds[sourceWord[0]] = id;
+      m_targetNonTermIds[targetWord[0]] = id;
+    } else {
+      m_sourceTermIds[sourceWord] = id;
+    }
+  }
+}
+
+void RuleTableBinaryImage::LoadAlignments()
+{
+  const UINT64 *offsets = reinterpret_cast<const UINT64*>(GetData(GetHeader().alignOffset));
+  const size_t numSets = offsets[0];
+  ++offsets;
+  const UINT32 *points = reinterpret_cast<const UINT32*>(offsets + numSets + 1);
+
+  m_alignments.resize(numSets);
+  AlignmentInfo::CollType coll;
+  for (size_t i = 0; i < numSets; ++i) {
+    coll.clear();
+    for (UINT64 j = offsets[i]; j < offsets[i + 1]; ++j) {
+      coll.insert(std::pair<size_t, size_t>(points[2 * j], points[2 * j + 1]));
+    }
+    m_alignments[i] = AlignmentInfoCollection::Instance().Add(coll);
+  }
+}
+
+RuleTableBinaryImage::NodeId RuleTableBinaryImage::FindChild(
+  const Child *begin, const Child *end, UINT32 first, UINT32 second) const
+{
+  const std::pair<UINT32, UINT32> key(first, second);
+  const Child *p = std::lower_bound(begin, end, key, ChildLess);
+  if (p == end || p->first != first || p->second != second) {
+    return 0;
+  }
+  return p->node;
+}
+
+RuleTableBinaryImage::NodeId RuleTableBinaryImage::GetChild(NodeId node, const Word &sourceTerm) const
+{
+  TermIndex::const_iterator id = m_sourceTermIds.find(sourceTerm);
+  if (id == m_sourceTermIds.end()) {
+    return 0;
+  }
+
+  const Child *children = GetChildren(node);
+  return FindChild(children, children + GetNode(node).numTerm, id->second, 0);
+}
+
+RuleTableBinaryImage::NodeId RuleTableBinaryImage::GetChild(NodeId node, const Word &sourceNonTerm, const Word &targetNonTerm) const
+{
+  NonTermIndex::const_iterator sourceId = m_sourceNonTermIds.find(sourceNonTerm[0]);
+  if (sourceId == m_sourceNonTermIds.end()) {
+    return 0;
+  }
+  NonTermIndex::const_iterator targetId = m_targetNonTermIds.find(targetNonTerm[0]);
+  if (targetId == m_targetNonTermIds.end()) {
+    return 0;
+  }
+
+  const NodeHeader &header = GetNode(node);
+  const Child *children = GetChildren(node) + header.numTerm;
+  return FindChild(children, children + header.numNonTerm, sourceId->second, targetId->second);
+}
+
+RuleTableBinaryImage::NodeId RuleTableBinaryImage::GetNonTermChild(NodeId node, size_t ind, const Word *&sourceNonTerm, const Word *&targetNonTerm) const
+{
+  const Child &child = GetChildren(node)[GetNode(node).numTerm + ind];
+  sourceNonTerm = &m_sourceWords[child.first];
+  targetNonTerm = &m_targetWords[child.second];
+  return child.node;
+}
+
+TargetPhraseCollection *RuleTableBinaryImage::CreateTargetPhraseCollection(NodeId node, const PhraseDictionary &phraseDict) const
+{
+  const UINT64 rules = GetNode(node).rules;
+  if (rules == 0) {
+    return NULL;
+  }
+
+  const RuleCollHeader &collHeader = *reinterpret_cast<const RuleCollHeader*>(GetData(rules));
+  const UINT32 *mem = reinterpret_cast<const UINT32*>(&collHeader + 1);
+
+  Phrase sourcePhrase(collHeader.sourceSize);
+  for (size_t i = 0; i < collHeader.sourceSize; ++i) {
+    sourcePhrase.AddWord(m_sourceWords[*mem++]);
+  }
+
+  const size_t numScores = GetNumScores();
+  std::vector<float> scoreVector(numScores);
+
+  TargetPhraseCollection *coll = new TargetPhraseCollection();
+  for (size_t i = 0; i < collHeader.numRules; ++i) {
+    const RuleHeader &ruleHeader = *reinterpret_cast<const RuleHeader*>(mem);
+    mem += sizeof(RuleHeader) / sizeof(UINT32);
+
+    Phrase targetPhrasePhrase(ruleHeader.targetSize);
+    for (size_t j = 0; j < ruleHeader.targetSize; ++j) {
+      targetPhrasePhrase.AddWord(m_targetWords[*mem++]);
+    }
+    // scores are stored already transformed and floored
+    std::memcpy(&scoreVector[0], mem, numScores * sizeof(float));
+    mem += numScores;
+
+    TargetPhrase *targetPhrase = new TargetPhrase(targetPhrasePhrase);
+    targetPhrase->SetSourcePhrase(sourcePhrase);
+    targetPhrase->SetAlignTerm(m_alignments[ruleHeader.alignTerm]);
+    targetPhrase->SetAlignNonTerm(m_alignments[ruleHeader.alignNonTerm]);
+    if (ruleHeader.targetLHS != NO_WORD) {
+      targetPhrase->SetTargetLHS(new Word(m_targetWords[ruleHeader.targetLHS]));
+    }
+
+    targetPhrase->GetScoreBreakdown().Assign(&phraseDict, scoreVector);
+    targetPhrase->Evaluate(sourcePhrase, phraseDict.GetFeaturesToApply());
+
+    coll->Add(targetPhrase);
+  }
+
+  // same as RuleTableTrie::SortAndPrune
+  if (phraseDict.GetTableLimit()) {
+    coll->Sort(true, phraseDict.GetTableLimit());
+  }
+  return coll;
+}
+
+}  // namespace Moses
@@ -0,0 +1,169 @@
+/***********************************************************************
+ Moses - statistical machine translation system
+ Copyright (C) 2006-2013 University of Edinburgh
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#pragma once
+
+#include "moses/AlignmentInfo.h"
+#include "moses/Terminal.h"
+#include "moses/TypeDef.h"
+#include "moses/Word.h"
+#include "util/mmap.hh"
+
+#include <boost/unordered_map.hpp>
+
+#include <string>
+#include <vector>
+
+namespace Moses
+{
+
+class PhraseDictionary;
+class TargetPhraseCollection;
+
+/** On-disk layout of a compiled rule table (see RuleTableBinaryImageCreator).
+ * Everything is stored in host byte order and addressed by byte offsets from
+ * the start of the file, so the image can be mapped and used as it is.
+ *
+ *   Header
+ *   vocabulary: UINT64 count, UINT64 offsets[count + 1], then the entries.
+ *               An entry is a flag byte (1 for non-terminals) and the string.
+ *   alignments: UINT64 count, UINT64 offsets[count + 1], then UINT32 pairs
+ *   nodes:      NodeHeader followed by the sorted terminal children, then the
+ *               sorted non-terminal children. Children come before parents.
+ *   rules:      RuleCollHeader, UINT32 source words, then per rule a
+ *               RuleHeader, UINT32 target words and float scores.
+ *
+ * Terminal children are keyed by source word, non-terminal children by
+ * source and target label, the same as PhraseDictionaryNodeMemory.
+ */
+namespace BinaryRuleTable
+{
+// first line of the file, so the loader factory can tell it from text tables
+const char MAGIC[] = "MosesBinaryRuleTable 1\n";
+// target LHS of rules that have none (phrase-based tables)
+const UINT32 NO_WORD = 0xffffffff;
+
+struct Header {
+  char magic[32];
+  UINT64 numScores;
+  UINT64 vocabOffset;
+  UINT64 alignOffset;
+  UINT64 rootOffset;
+  UINT64 numRules;
+};
+
+struct NodeHeader {
+  UINT64 rules; // 0 if there are no rules for this source phrase
+  UINT32 numTerm;
+  UINT32 numNonTerm;
+};
+
+struct Child {
+  UINT32 first;  // source word, or source label
+  UINT32 second; // 0, or target label
+  UINT64 node;
+};
+
+struct RuleCollHeader {
+  UINT32 numRules;
+  UINT32 sourceSize;
+};
+
+struct RuleHeader {
+  UINT32 targetLHS;
+  UINT32 alignTerm;
+  UINT32 alignNonTerm;
+  UINT32 targetSize;
+};
+}
+
+/** A compiled rule table mapped into memory. The trie is walked in place;
+ * target phrases are only created for the rules that are actually looked up.
+ */
+class RuleTableBinaryImage
+{
+public:
+  //! offset of a node in the image, 0 for none
+  typedef UINT64 NodeId;
+
+  //! true if path starts with the binary rule table magic
+  static bool IsBinaryImage(const std::string &path);
+
+  RuleTableBinaryImage(const std::string &path,
+                       const std::vector<FactorType> &input,
+                       const std::vector<FactorType> &output);
+
+  size_t GetNumScores() const {
+    return GetHeader().numScores;
+  }
+
+  NodeId GetRoot() const {
+    return GetHeader().rootOffset;
+  }
+
+  bool IsLeaf(NodeId node) const {
+    const BinaryRuleTable::NodeHeader &header = GetNode(node);
+    return header.numTerm == 0 && header.numNonTerm == 0;
+  }
+
+  NodeId GetChild(NodeId node, const Word &sourceTerm) const;
+  NodeId GetChild(NodeId node, const Word &sourceNonTerm, const Word &targetNonTerm) const;
+
+  size_t GetNumNonTermChildren(NodeId node) const {
+    return GetNode(node).numNonTerm;
+  }
+  //! ind'th non-terminal child, with its source and target labels
+  NodeId GetNonTermChild(NodeId node, size_t ind, const Word *&sourceNonTerm, const Word *&targetNonTerm) const;
+
+  /** Create the scored and sorted target phrases of a node. Returns NULL if
+   * the node has no rules. The caller owns the collection.
+   */
+  TargetPhraseCollection *CreateTargetPhraseCollection(NodeId node, const PhraseDictionary &phraseDict) const;
+
+private:
+  typedef boost::unordered_map<Word, UINT32, TerminalHasher, TerminalEqualityPred> TermIndex;
+  typedef boost::unordered_map<const Factor*, UINT32> NonTermIndex;
+
+  util::scoped_memory m_mem;
+
+  // vocabulary as source and as target words, indexed by id
+  std::vector<Word> m_sourceWords, m_targetWords;
+  TermIndex m_sourceTermIds;
+  NonTermIndex m_sourceNonTermIds, m_targetNonTermIds;
+  std::vector<const AlignmentInfo*> m_alignments;
+
+  const char *GetData(UINT64 offset) const {
+    return static_cast<const char*>(m_mem.get()) + offset;
+  }
+  const BinaryRuleTable::Header &GetHeader() const {
+    return *reinterpret_cast<const BinaryRuleTable::Header*>(GetData(0));
+  }
+  const BinaryRuleTable::NodeHeader &GetNode(NodeId node) const {
+    return *reinterpret_cast<const BinaryRuleTable::NodeHeader*>(GetData(node));
+  }
+  const BinaryRuleTable::Child *GetChildren(NodeId node) const {
+    return reinterpret_cast<const BinaryRuleTable::Child*>(GetData(node + sizeof(BinaryRuleTable::NodeHeader)));
+  }
+  NodeId FindChild(const BinaryRuleTable::Child *begin, const BinaryRuleTable::Child *end, UINT32 first, UINT32 second) const;
+
+  void LoadVocab(const std::vector<FactorType> &input, const std::vector<FactorType> &output);
+  void LoadAlignments();
+};
+
+}  // namespace Moses
@@ -0,0 +1,379 @@
+/***********************************************************************
+ Moses - statistical machine translation system
+ Copyright (C) 2006-2013 University of Edinburgh
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include "BinaryImageCreator.h"
+
+#include "moses/Util.h"
+#include "util/exception.hh"
+#include "util/file_piece.hh"
+#include "util/tokenize_piece.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace Moses
+{
+
+using namespace BinaryRuleTable;
+
+namespace
+{
+bool ChildOrder(const Child &a, const Child &b)
+{
+  return a.first < b.first || (a.first == b.first && a.second < b.second);
+}
+
+bool SameKey(const Child &a, const Child &b)
+{
+  return a.first == b.first && a.second == b.second;
+}
+
+bool IsNonTerm(const StringPiece &word)
+{
+  return word.size() >= 2 && word.data()[0] == '[' && word.data()[word.size() - 1] == ']';
+}
+
+// label of a non-terminal [source][target] on the source or target side,
+// like Phrase::CreateFromString
+StringPiece NonTermLabel(const StringPiece &word, bool sourceSide)
+{
+  size_t nextPos = word.find('[', 1);
+  UTIL_THROW_IF(nextPos == StringPiece::npos, util::Exception, "Bad non-terminal " << word);
+  if (sourceSide) {
+    return word.substr(1, nextPos - 2);
+  }
+  return word.substr(nextPos + 1, word.size() - nextPos - 2);
+}
+}
+
+RuleTableBinaryImageCreator::RuleTableBinaryImageCreator(const std::string &inPath,
+    const std::string &outPath,
+    size_t numScores)
+  : m_offset(0)
+  , m_numScores(numScores)
+  , m_numRules(0)
+  , m_path(1)
+{
+  m_out.open(outPath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  UTIL_THROW_IF(!m_out.is_open(), util::Exception, "Could not open " << outPath);
+
+  // filled in at the end
+  Header header;
+  std::memset(&header, 0, sizeof(Header));
+  Write(&header, sizeof(Header));
+
+  m_path[0].numRules = 0;
+
+  util::FilePiece in(inPath.c_str(), &std::cerr);
+  size_t lineNum = 0;
+  while (true) {
+    StringPiece line;
+    try {
+      line = in.ReadLine();
+    } catch (const util::EndOfFileException &e) {
+      break;
+    }
+    ProcessLine(line, ++lineNum);
+  }
+
+  CloseNodes(0);
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC) - 1);
+  header.numScores = m_numScores;
+  header.numRules = m_numRules;
+  header.rootOffset = WriteNode(m_path[0]);
+  WriteVocab(header);
+  WriteAlignments(header);
+
+  m_out.seekp(0);
+  m_out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+  m_out.close();
+  UTIL_THROW_IF(!m_out, util::Exception, "Error writing " << outPath);
+}
+
+void RuleTableBinaryImageCreator::ProcessLine(const StringPiece &line, size_t lineNum)
+{
+  util::TokenIter<util::MultiCharacter> pipes(line, "|||");
+  StringPiece sourceString(*pipes);
+  StringPiece targetString(*++pipes);
+  StringPiece scoreString(*++pipes);
+
+  StringPiece alignString;
+  if (++pipes) {
+    alignString = *pipes;
+  }
+  if (++pipes) {
+    // counts, ignored
+  }
+  if (++pipes) {
+    UTIL_THROW_IF(pipes->find_first_not_of(" \t") != StringPiece::npos, util::Exception,
+                  "Sparse features are not supported in binary rule tables, line " << lineNum);
+  }
+
+  std::vector<StringPiece> source, target;
+  for (util::TokenIter<util::AnyCharacter, true> it(sourceString, "\t "); it; ++it) {
+    source.push_back(*it);
+  }
+  for (util::TokenIter<util::AnyCharacter, true> it(targetString, "\t "); it; ++it) {
+    target.push_back(*it);
+  }
+  if (source.empty()) {
+    std::cerr << "line " << lineNum << ": pt entry contains empty source, skipping" << std::endl;
+    return;
+  }
+
+  // the LHS are not part of the phrases
+  if (IsNonTerm(source.back())) {
+    source.pop_back();
+  }
+  UINT32 targetLHS = NO_WORD;
+  if (!target.empty() && IsNonTerm(target.back())) {
+    const StringPiece &lhs = target.back();
+    targetLHS = GetVocabId(lhs.substr(1, lhs.size() - 2), true);
+    target.pop_back();
+  }
+
+  std::vector<UINT32> targetIds(target.size());
+  for (size_t i = 0; i < target.size(); ++i) {
+    targetIds[i] = IsNonTerm(target[i])
+                   ? GetVocabId(NonTermLabel(target[i], false), true)
+                   : GetVocabId(target[i], false);
+  }
+
+  // split the alignment like TargetPhrase::SetAlignmentInfo
+  AlignPoints alignTerm, alignNonTerm;
+  for (util::TokenIter<util::AnyCharacter, true> token(alignString, " \t"); token; ++token) {
+    util::TokenIter<util::SingleCharacter, false> dash(*token, '-');
+    char *endptr;
+    UINT32 sourcePos = std::strtoul(dash->data(), &endptr, 10);
+    UTIL_THROW_IF(endptr != dash->data() + dash->size(), util::Exception, "Error parsing alignment " << *token << " on line " << lineNum);
+    ++dash;
+    UINT32 targetPos = std::strtoul(dash->data(), &endptr, 10);
+    UTIL_THROW_IF(endptr != dash->data() + dash->size(), util::Exception, "Error parsing alignment " << *token << " on line " << lineNum);
+    UTIL_THROW_IF(targetPos >= target.size(), util::Exception, "Alignment point " << *token << " out of range on line " << lineNum);
+
+    if (IsNonTerm(target[targetPos])) {
+      alignNonTerm.push_back(std::make_pair(sourcePos, targetPos));
+    } else {
+      alignTerm.push_back(std::make_pair(sourcePos, targetPos));
+    }
+  }
+  std::sort(alignNonTerm.begin(), alignNonTerm.end());
+  alignNonTerm.erase(std::unique(alignNonTerm.begin(), alignNonTerm.end()), alignNonTerm.end());
+
+  // path through the trie, as PhraseDictionaryMemory::GetOrCreateNode
+  std::vector<NodeKey> keys(source.size());
+  std::vector<UINT32> sourceIds(source.size());
+  AlignPoints::const_iterator iterAlign = alignNonTerm.begin();
+  for (size_t pos = 0; pos < source.size(); ++pos) {
+    NodeKey &key = keys[pos];
+    key.isNonTerm = IsNonTerm(source[pos]);
+    if (key.isNonTerm) {
+      UTIL_THROW_IF(iterAlign == alignNonTerm.end() || iterAlign->first != pos, util::Exception,
+                    "Non-terminal " << source[pos] << " is not aligned on line " << lineNum);
+      sourceIds[pos] = GetVocabId(NonTermLabel(source[pos], true), true);
+      key.first = sourceIds[pos];
+      key.second = targetIds[iterAlign->second];
+      ++iterAlign;
+    } else {
+      sourceIds[pos] = GetVocabId(source[pos], false);
+      key.first = sourceIds[pos];
+      key.second = 0;
+    }
+  }
+
+  // scores
+  std::vector<float> scores;
+  for (util::TokenIter<util::AnyCharacter, true> s(scoreString, " \t"); s; ++s) {
+    char *endptr;
+    float score = std::strtod(s->data(), &endptr);
+    UTIL_THROW_IF(endptr != s->data() + s->size() || std::isnan(score), util::Exception,
+                  "Bad score " << *s << " on line " << lineNum);
+    scores.push_back(FloorScore(TransformScore(score)));
+  }
+  UTIL_THROW_IF(scores.size() != m_numScores, util::Exception,
+                "Size of scoreVector != number (" << scores.size() << "!=" << m_numScores
+                << ") of score components on line " << lineNum);
+
+  // leave the nodes that are not a prefix of this source phrase
+  size_t depth = 0;
+  while (depth < keys.size() && depth + 1 < m_path.size() && m_path[depth + 1].key == keys[depth]) {
+    ++depth;
+  }
+  CloseNodes(depth);
+  for (; depth < keys.size(); ++depth) {
+    m_path.push_back(OpenNode());
+    m_path.back().key = keys[depth];
+    m_path.back().numRules = 0;
+  }
+
+  OpenNode &node = m_path.back();
+  if (node.numRules == 0) {
+    node.source = sourceIds;
+  }
+  ++node.numRules;
+  ++m_numRules;
+
+  std::vector<UINT32> &rules = node.rules;
+  rules.push_back(targetLHS);
+  rules.push_back(GetAlignId(alignTerm));
+  rules.push_back(GetAlignId(alignNonTerm));
+  rules.push_back(targetIds.size());
+  rules.insert(rules.end(), targetIds.begin(), targetIds.end());
+  for (size_t i = 0; i < scores.size(); ++i) {
+    UINT32 bits;
+    std::memcpy(&bits, &scores[i], sizeof(float));
+    rules.push_back(bits);
+  }
+}
+
+void RuleTableBinaryImageCreator::CloseNodes(size_t depth)
+{
+  while (m_path.size() > depth + 1) {
+    OpenNode &node = m_path.back();
+    Child child;
+    child.first = node.key.first;
+    child.second = node.key.second;
+    child.node = WriteNode(node);
+
+    const bool isNonTerm = node.key.isNonTerm;
+    m_path.pop_back();
+    OpenNode &parent = m_path.back();
+    (isNonTerm ? parent.nonTermChildren : parent.termChildren).push_back(child);
+  }
+}
+
+UINT64 RuleTableBinaryImageCreator::WriteNode(OpenNode &node)
+{
+  NodeHeader header;
+  header.rules = 0;
+  if (node.numRules) {
+    Align();
+    header.rules = m_offset;
+
+    RuleCollHeader collHeader;
+    collHeader.numRules = node.numRules;
+    collHeader.sourceSize = node.source.size();
+    Write(&collHeader, sizeof(RuleCollHeader));
+    Write(&node.source[0], node.source.size() * sizeof(UINT32));
+    Write(&node.rules[0], node.rules.size() * sizeof(UINT32));
+  }
+
+  std::sort(node.termChildren.begin(), node.termChildren.end(), ChildOrder);
+  std::sort(node.nonTermChildren.begin(), node.nonTermChildren.end(), ChildOrder);
+  UTIL_THROW_IF(std::adjacent_find(node.termChildren.begin(), node.termChildren.end(), SameKey) != node.termChildren.end()
+                || std::adjacent_find(node.nonTermChildren.begin(), node.nonTermChildren.end(), SameKey) != node.nonTermChildren.end(),
+                util::Exception, "The rule table is not sorted by source phrase, sort it with LC_ALL=C sort");
+
+  header.numTerm = node.termChildren.size();
+  header.numNonTerm = node.nonTermChildren.size();
+
+  Align();
+  UINT64 offset = m_offset;
+  Write(&header, sizeof(NodeHeader));
+  if (!node.termChildren.empty()) {
+    Write(&node.termChildren[0], node.termChildren.size() * sizeof(Child));
+  }
+  if (!node.nonTermChildren.empty()) {
+    Write(&node.nonTermChildren[0], node.nonTermChildren.size() * sizeof(Child));
+  }
+  return offset;
+}
+
+UINT32 RuleTableBinaryImageCreator::GetVocabId(const StringPiece &str, bool isNonTerm)
+{
+  std::string entry(1, isNonTerm ? 1 : 0);
+  entry.append(str.data(), str.size());
+
+  std::pair<boost::unordered_map<std::string, UINT32>::iterator, bool> ret =
+    m_vocabIds.insert(std::make_pair(entry, (UINT32) m_vocab.size()));
+  if (ret.second) {
+    m_vocab.push_back(entry);
+  }
+  return ret.first->second;
+}
+
+UINT32 RuleTableBinaryImageCreator::GetAlignId(AlignPoints &points)
+{
+  std::sort(points.begin(), points.end());
+  points.erase(std::unique(points.begin(), points.end()), points.end());
+
+  std::pair<std::map<AlignPoints, UINT32>::iterator, bool> ret =
+    m_alignIds.insert(std::make_pair(points, (UINT32) m_aligns.size()));
+  if (ret.second) {
+    m_aligns.push_back(&ret.first->first);
+  }
+  return ret.first->second;
+}
+
+void RuleTableBinaryImageCreator::WriteVocab(Header &header)
+{
+  Align();
+  header.vocabOffset = m_offset;
+
+  UINT64 count = m_vocab.size();
+  Write(&count, sizeof(UINT64));
+  UINT64 offset = 0;
+  for (size_t i = 0; i < m_vocab.size(); ++i) {
+    Write(&offset, sizeof(UINT64));
+    offset += m_vocab[i].size();
+  }
+  Write(&offset, sizeof(UINT64));
+  for (size_t i = 0; i < m_vocab.size(); ++i) {
+    Write(m_vocab[i].data(), m_vocab[i].size());
+  }
+}
+
+void RuleTableBinaryImageCreator::WriteAlignments(Header &header)
+{
+  Align();
+  header.alignOffset = m_offset;
+
+  UINT64 count = m_aligns.size();
+  Write(&count, sizeof(UINT64));
+  UINT64 offset = 0;
+  for (size_t i = 0; i < m_aligns.size(); ++i) {
+    Write(&offset, sizeof(UINT64));
+    offset += m_aligns[i]->size();
+  }
+  Write(&offset, sizeof(UINT64));
+  for (size_t i = 0; i < m_aligns.size(); ++i) {
+    const AlignPoints &points = *m_aligns[i];
+    for (size_t j = 0; j < points.size(); ++j) {
+      UINT32 point[2] = { points[j].first, points[j].second };
+      Write(point, sizeof(point));
+    }
+  }
+}
+
+void RuleTableBinaryImageCreator::Write(const void *data, size_t size)
+{
+  m_out.write(static_cast<const char*>(data), size);
+  m_offset += size;
+}
+
+void RuleTableBinaryImageCreator::Align()
+{
+  static const char padding[8] = { 0 };
+  Write(padding, (8 - m_offset % 8) % 8);
+}
+
+}  // namespace Moses
@@ -0,0 +1,96 @@
+/***********************************************************************
+ Moses - statistical machine translation system
+ Copyright (C) 2006-2013 University of Edinburgh
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#pragma once
+
+#include "BinaryImage.h"
+#include "util/string_piece.hh"
+
+#include <boost/unordered_map.hpp>
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Moses
+{
+
+/** Compiles a text rule table (Moses format, as read by
+ * RuleTableLoaderStandard) into the image read by RuleTableBinaryImage.
+ *
+ * Like CreateOnDiskPt, the table must be sorted by source phrase
+ * (LC_ALL=C sort), so the trie can be written bottom-up while reading: each
+ * node is written as soon as the input has moved past it. Only the rules of
+ * the open nodes are held in memory.
+ */
+class RuleTableBinaryImageCreator
+{
+public:
+  RuleTableBinaryImageCreator(const std::string &inPath,
+                              const std::string &outPath,
+                              size_t numScores);
+
+private:
+  typedef std::vector<std::pair<UINT32, UINT32> > AlignPoints;
+
+  struct NodeKey {
+    bool isNonTerm;
+    UINT32 first, second;
+    bool operator==(const NodeKey &other) const {
+      return isNonTerm == other.isNonTerm && first == other.first && second == other.second;
+    }
+  };
+
+  struct OpenNode {
+    NodeKey key; // in the parent
+    std::vector<BinaryRuleTable::Child> termChildren, nonTermChildren;
+    std::vector<UINT32> source; // source words of the rules
+    std::vector<UINT32> rules;  // encoded rules
+    UINT32 numRules;
+  };
+
+  std::ofstream m_out;
+  UINT64 m_offset;
+  size_t m_numScores;
+  UINT64 m_numRules;
+
+  boost::unordered_map<std::string, UINT32> m_vocabIds;
+  std::vector<std::string> m_vocab;
+  std::map<AlignPoints, UINT32> m_alignIds;
+  std::vector<const AlignPoints*> m_aligns;
+
+  // nodes from the root to the source phrase of the last rule
+  std::vector<OpenNode> m_path;
+
+  UINT32 GetVocabId(const StringPiece &str, bool isNonTerm);
+  UINT32 GetAlignId(AlignPoints &points);
+
+  void ProcessLine(const StringPiece &line, size_t lineNum);
+  void CloseNodes(size_t depth);
+  UINT64 WriteNode(OpenNode &node);
+  void WriteVocab(BinaryRuleTable::Header &header);
+  void WriteAlignments(BinaryRuleTable::Header &header);
+
+  void Write(const void *data, size_t size);
+  void Align();
+};
+
+}  // namespace Moses
@@ -22,6 +22,7 @@
 #include "moses/UserMessage.h"
 #include "moses/Util.h"
 #include "moses/InputFileStream.h"
+#include "BinaryImage.h"
 #include "LoaderCompact.h"
 #include "LoaderHiero.h"
 #include "LoaderStandard.h"
@@ -44,6 +45,11 @@ std::auto_ptr<RuleTableLoader> RuleTableLoaderFactory::Create(
   bool cont = std::getline(input, line);
 
   if (cont) {
+    if (line + "\n" == BinaryRuleTable::MAGIC) {
+      UserMessage::Add("Compiled rule tables are only supported by PhraseDictionaryMemory: " + path);
+      return std::auto_ptr<RuleTableLoader>();
+    }
+
     std::vector<std::string> tokens;
     Tokenize(tokens, line);
     if (tokens.size() == 1) {
@@ -13,8 +13,10 @@
 #include "moses/TypeDef.h"
 #include "moses/StaticData.h"
 #include "moses/UserMessage.h"
+#include "moses/Util.h"
 #include "Loader.h"
 #include "LoaderFactory.h"
+#include "util/exception.hh"
 
 using namespace std;
 
@@ -22,38 +24,189 @@ namespace Moses
 {
 PhraseDictionaryALSuffixArray::PhraseDictionaryALSuffixArray(const std::string &line)
   : PhraseDictionaryMemory("PhraseDictionaryALSuffixArray", line)
+  , m_loadingGrammar(NULL)
+  , m_prefetch(2)
+#ifdef WITH_THREADS
+  , m_nextId(0)
+  , m_prefetchEnd(0)
+  , m_stopping(false)
+#endif
 {
-  const StaticData &staticData = StaticData::Instance();
-  if (staticData.ThreadCount() > 1) {
-    throw runtime_error("Suffix array implementation is not threadsafe");
+  ReadParameters();
+}
+
+PhraseDictionaryALSuffixArray::~PhraseDictionaryALSuffixArray()
+{
+#ifdef WITH_THREADS
+  if (m_loaderThread) {
+    {
+      boost::mutex::scoped_lock lock(m_mutex);
+      m_stopping = true;
+    }
+    m_wanted.notify_all();
+    m_loaderThread->join();
   }
+#endif
+  RemoveAllInMap(m_grammars);
+}
 
-  ReadParameters();
+void PhraseDictionaryALSuffixArray::SetParameter(const std::string& key, const std::string& value)
+{
+  if (key == "prefetch") {
+    m_prefetch = Scan<size_t>(value);
+  } else {
+    PhraseDictionaryMemory::SetParameter(key, value);
+  }
 }
 
 void PhraseDictionaryALSuffixArray::Load()
 {
   SetFeaturesToApply();
+
+#ifdef WITH_THREADS
+  // sentences are numbered from the start id, in input order
+  m_nextId = StaticData::Instance().GetStartTranslationId();
+  m_prefetchEnd = m_nextId + m_prefetch;
+  m_loaderThread.reset(new boost::thread(boost::bind(&PhraseDictionaryALSuffixArray::Prefetch, this)));
+#endif
 }
 
-void PhraseDictionaryALSuffixArray::InitializeForInput(InputType const& source)
+PhraseDictionaryNodeMemory *PhraseDictionaryALSuffixArray::LoadGrammar(long translationId)
 {
-  // populate with rules for this sentence
-  long translationId = source.GetTranslationId();
-
   string grammarFile = GetFilePath() + "/grammar." + SPrint(translationId) + ".gz";
+  if (!FileExists(grammarFile)) {
+    return NULL;
+  }
 
   std::auto_ptr<RuleTableLoader> loader =
     RuleTableLoaderFactory::Create(grammarFile);
+  UTIL_THROW_IF(!loader.get(), util::Exception,
+                "Unknown format of grammar " << grammarFile);
+
+  std::auto_ptr<PhraseDictionaryNodeMemory> grammar(new PhraseDictionaryNodeMemory());
+  m_loadingGrammar = grammar.get();
   bool ret = loader->Load(m_input, m_output, grammarFile, m_tableLimit,
                           *this);
+  m_loadingGrammar = NULL;
+
+  UTIL_THROW_IF(!ret, util::Exception, "Could not load grammar " << grammarFile);
+  return grammar.release();
+}
+
+#ifdef WITH_THREADS
+//! loader thread. Requested grammars first, then the ones ahead of them
+void PhraseDictionaryALSuffixArray::Prefetch()
+{
+  boost::mutex::scoped_lock lock(m_mutex);
+  while (true) {
+    while (!m_stopping && m_requested.empty() && m_nextId >= m_prefetchEnd) {
+      m_wanted.wait(lock);
+    }
+    if (m_stopping) {
+      return;
+    }
+
+    long translationId;
+    if (!m_requested.empty()) {
+      translationId = *m_requested.begin();
+      m_requested.erase(m_requested.begin());
+    } else {
+      translationId = m_nextId;
+    }
+    m_nextId = std::max(m_nextId, translationId + 1);
+    if (m_grammars.find(translationId) != m_grammars.end()) {
+      continue;
+    }
+
+    lock.unlock();
+    PhraseDictionaryNodeMemory *grammar = NULL;
+    std::string error;
+    try {
+      grammar = LoadGrammar(translationId);
+    } catch (const std::exception &e) {
+      // thrown again by the decoding thread that waits for this grammar
+      error = e.what();
+    }
+    lock.lock();
+
+    m_grammars[translationId] = grammar;
+    if (!error.empty()) {
+      m_errors[translationId] = error;
+    }
+    m_loaded.notify_all();
+  }
+}
+#endif
+
+void PhraseDictionaryALSuffixArray::InitializeForInput(InputType const& source)
+{
+  // populate with rules for this sentence
+  long translationId = source.GetTranslationId();
+
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(m_mutex);
+  m_prefetchEnd = std::max(m_prefetchEnd, translationId + 1 + (long) m_prefetch);
+  if (m_grammars.find(translationId) == m_grammars.end()) {
+    m_requested.insert(translationId);
+  }
+  m_wanted.notify_one();
+
+  while (m_grammars.find(translationId) == m_grammars.end()) {
+    m_loaded.wait(lock);
+  }
+
+  std::map<long, std::string>::iterator error = m_errors.find(translationId);
+  if (error != m_errors.end()) {
+    const std::string message = error->second;
+    m_errors.erase(error);
+    m_grammars.erase(translationId);
+    UTIL_THROW(util::Exception, "Could not load the grammar of sentence " << translationId << ": " << message);
+  }
+#else
+  m_grammars[translationId] = LoadGrammar(translationId);
+#endif
 
-  CHECK(ret);
+  UTIL_THROW_IF(m_grammars[translationId] == NULL, util::Exception,
+                "No grammar for sentence " << translationId << " in " << GetFilePath());
 }
 
 void PhraseDictionaryALSuffixArray::CleanUpAfterSentenceProcessing(const InputType &source)
 {
-  m_collection.Clear();
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(m_mutex);
+#endif
+  GrammarMap::iterator iter = m_grammars.find(source.GetTranslationId());
+  if (iter != m_grammars.end()) {
+    delete iter->second;
+    m_grammars.erase(iter);
+  }
+}
+
+const PhraseDictionaryNodeMemory &PhraseDictionaryALSuffixArray::GetRootNode(const InputType &source) const
+{
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(m_mutex);
+#endif
+  GrammarMap::const_iterator iter = m_grammars.find(source.GetTranslationId());
+  CHECK(iter != m_grammars.end() && iter->second);
+  return *iter->second;
+}
+
+TargetPhraseCollection &PhraseDictionaryALSuffixArray::GetOrCreateTargetPhraseCollection(
+  const Phrase &source
+  , const TargetPhrase &target
+  , const Word *sourceLHS)
+{
+  PhraseDictionaryNodeMemory &currNode = GetOrCreateNode(*m_loadingGrammar, source, target, sourceLHS);
+  return currNode.GetTargetPhraseCollection();
+}
+
+void PhraseDictionaryALSuffixArray::SortAndPrune()
+{
+  m_loadingGrammar->Freeze();
+  if (GetTableLimit()) {
+    m_loadingGrammar->Sort(GetTableLimit());
+  }
 }
 
 }
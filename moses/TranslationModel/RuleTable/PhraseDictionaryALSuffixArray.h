@@ -9,8 +9,16 @@
 #ifndef moses_PhraseDictionaryALSuffixArray_h
 #define moses_PhraseDictionaryALSuffixArray_h
 
+#include <map>
+#include <set>
+
 #include "moses/TranslationModel/PhraseDictionaryMemory.h"
 
+#ifdef WITH_THREADS
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+#endif
+
 namespace Moses
 {
 
@@ -18,17 +26,51 @@ namespace Moses
  * Does 2 things that the normal in-memory pt doesn't do:
  *  1. Loads grammar for a sentence to be decoded only when the sentence is being decoded. Unload afterwards
     2. Format of the pt file follows Hiero, rather than Moses
+ * Each sentence has its own grammar, keyed by translation id. With threads,
+ * the grammars are read by a background thread, which also loads the
+ * grammars of the next sentences (prefetch=K, default 2) while the current
+ * ones are decoded.
  */
 class PhraseDictionaryALSuffixArray : public PhraseDictionaryMemory
 {
 public:
   PhraseDictionaryALSuffixArray(const std::string &line);
+  ~PhraseDictionaryALSuffixArray();
   void Load();
+  void SetParameter(const std::string& key, const std::string& value);
   void InitializeForInput(InputType const& source);
   void CleanUpAfterSentenceProcessing(const InputType& source);
 
+  const PhraseDictionaryNodeMemory &GetRootNode(const InputType &source) const;
+
 protected:
+  TargetPhraseCollection &GetOrCreateTargetPhraseCollection(
+    const Phrase &source, const TargetPhrase &target, const Word *sourceLHS);
+
+  void SortAndPrune();
 
+private:
+  typedef std::map<long, PhraseDictionaryNodeMemory*> GrammarMap;
+
+  //! NULL if there is no grammar file for translationId
+  PhraseDictionaryNodeMemory *LoadGrammar(long translationId);
+
+  GrammarMap m_grammars; /**< loaded grammars. guarded by m_mutex with threads */
+  PhraseDictionaryNodeMemory *m_loadingGrammar; /**< filled by the loader. only used by the loading thread */
+  size_t m_prefetch;
+
+#ifdef WITH_THREADS
+  void Prefetch();
+
+  std::set<long> m_requested; /**< ids of sentences waiting for their grammar */
+  std::map<long, std::string> m_errors; /**< why a grammar in m_grammars could not be loaded */
+  long m_nextId; /**< next grammar to prefetch */
+  long m_prefetchEnd; /**< prefetch up to, excluding, this id */
+  bool m_stopping;
+  mutable boost::mutex m_mutex;
+  boost::condition_variable m_wanted, m_loaded;
+  boost::scoped_ptr<boost::thread> m_loaderThread;
+#endif
 };
 
 
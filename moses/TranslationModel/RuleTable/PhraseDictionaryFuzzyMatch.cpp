@@ -19,15 +19,9 @@
  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  ***********************************************************************/
 
-#include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
-#include <limits.h>
-#include <sys/types.h>
-#include <unistd.h>
-#include <dirent.h>
 
-#include <fstream>
+#include <sstream>
 #include <string>
 #include <iterator>
 #include <algorithm>
@@ -37,11 +31,9 @@
 #include "moses/FactorCollection.h"
 #include "moses/Word.h"
 #include "moses/Util.h"
-#include "moses/InputFileStream.h"
 #include "moses/StaticData.h"
 #include "moses/WordsRange.h"
 #include "moses/UserMessage.h"
-#include "util/file.hh"
 #include "moses/TranslationModel/CYKPlusParser/ChartRuleLookupManagerMemoryPerSentence.h"
 #include "moses/TranslationModel/fuzzy-match/FuzzyMatchWrapper.h"
 #include "moses/TranslationModel/fuzzy-match/SentenceAlignment.h"
@@ -80,83 +72,26 @@ ChartRuleLookupManager *PhraseDictionaryFuzzyMatch::CreateRuleLookupManager(
 }
 
 
-int removedirectoryrecursively(const char *dirname)
-{
-  DIR *dir;
-  struct dirent *entry;
-  char path[PATH_MAX];
-
-  if (path == NULL) {
-    fprintf(stderr, "Out of memory error\n");
-    return 0;
-  }
-  dir = opendir(dirname);
-  if (dir == NULL) {
-    perror("Error opendir()");
-    return 0;
-  }
-
-  while ((entry = readdir(dir)) != NULL) {
-    if (strcmp(entry->d_name, ".") && strcmp(entry->d_name, "..")) {
-      snprintf(path, (size_t) PATH_MAX, "%s/%s", dirname, entry->d_name);
-      if (entry->d_type == DT_DIR) {
-        removedirectoryrecursively(path);
-      }
-
-      remove(path);
-      /*
-       * Here, the actual deletion must be done.  Beacuse this is
-       * quite a dangerous thing to do, and this program is not very
-       * well tested, we are just printing as if we are deleting.
-       */
-      //printf("(not really) Deleting: %s\n", path);
-      /*
-       * When you are finished testing this and feel you are ready to do the real
-       * deleting, use this: remove*STUB*(path);
-       * (see "man 3 remove")
-       * Please note that I DONT TAKE RESPONSIBILITY for data you delete with this!
-       */
-    }
-
-  }
-  closedir(dir);
-
-  rmdir(dirname);
-  /*
-   * Now the directory is emtpy, finally delete the directory itself. (Just
-   * printing here, see above)
-   */
-  //printf("(not really) Deleting: %s\n", dirname);
-
-  return 1;
-}
-
 void PhraseDictionaryFuzzyMatch::InitializeForInput(InputType const& inputSentence)
 {
-  char dirName[] = "/tmp/moses.XXXXXX";
-  char *temp = mkdtemp(dirName);
-  CHECK(temp);
-  string dirNameStr(dirName);
-
-  string inFileName(dirNameStr + "/in");
-
-  ofstream inFile(inFileName.c_str());
-
+  stringstream inStrme;
   for (size_t i = 1; i < inputSentence.GetSize() - 1; ++i) {
-    inFile << inputSentence.GetWord(i);
+    inStrme << inputSentence.GetWord(i);
   }
-  inFile << endl;
-  inFile.close();
 
   long translationId = inputSentence.GetTranslationId();
-  string ptFileName = m_FuzzyMatchWrapper->Extract(translationId, dirNameStr);
-
-  // populate with rules for this sentence
-  PhraseDictionaryNodeMemory &rootNode = m_collection[translationId];
-  FormatType format = MosesFormat;
-
-  // data from file
-  InputFileStream inStream(ptFileName);
+  vector<tmmt::ScoredRule> rules;
+  m_FuzzyMatchWrapper->Extract(translationId, inStrme.str(), rules);
+
+  // populate with rules for this sentence. Other threads only add and
+  // remove the rules of their own sentences
+  PhraseDictionaryNodeMemory *rootNode;
+  {
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(m_mutex);
+#endif
+    rootNode = &m_collection[translationId];
+  }
 
   // copied from class LoaderStandard
   PrintUserTime("Start loading fuzzy-match phrase model");
@@ -164,53 +99,18 @@ void PhraseDictionaryFuzzyMatch::InitializeForInput(InputType const& inputSenten
   const StaticData &staticData = StaticData::Instance();
   const std::string& factorDelimiter = staticData.GetFactorDelimiter();
 
+  for (size_t i = 0; i < rules.size(); ++i) {
+    const tmmt::ScoredRule &rule = rules[i];
+    vector<float> scoreVector = rule.scores;
 
-  string lineOrig;
-  size_t count = 0;
-
-  while(getline(inStream, lineOrig)) {
-    const string *line;
-    if (format == HieroFormat) { // reformat line
-      assert(false);
-      //line = ReformatHieroRule(lineOrig);
-    } else {
-      // do nothing to format of line
-      line = &lineOrig;
-    }
-
-    vector<string> tokens;
-    vector<float> scoreVector;
-
-    TokenizeMultiCharSeparator(tokens, *line , "|||" );
-
-    if (tokens.size() != 4 && tokens.size() != 5) {
-      stringstream strme;
-      strme << "Syntax error at " << ptFileName << ":" << count;
-      UserMessage::Add(strme.str());
-      abort();
-    }
-
-    const string &sourcePhraseString = tokens[0]
-                                       , &targetPhraseString = tokens[1]
-                                           , &scoreString        = tokens[2]
-                                               , &alignString        = tokens[3];
-
-    bool isLHSEmpty = (sourcePhraseString.find_first_not_of(" \t", 0) == string::npos);
-    if (isLHSEmpty && !staticData.IsWordDeletionEnabled()) {
-      TRACE_ERR( ptFileName << ":" << count << ": pt entry contains empty target, skipping\n");
-      continue;
-    }
-
-    Tokenize<float>(scoreVector, scoreString);
     const size_t numScoreComponents = GetNumScoreComponents();
     if (scoreVector.size() != numScoreComponents) {
       stringstream strme;
       strme << "Size of scoreVector != number (" << scoreVector.size() << "!="
-            << numScoreComponents << ") of score components on line " << count;
+            << numScoreComponents << ") of score components on rule " << i;
       UserMessage::Add(strme.str());
       abort();
     }
-    CHECK(scoreVector.size() == numScoreComponents);
 
     // parse source & find pt node
 
@@ -220,16 +120,15 @@ void PhraseDictionaryFuzzyMatch::InitializeForInput(InputType const& inputSenten
 
     // source
     Phrase sourcePhrase( 0);
-    sourcePhrase.CreateFromString(Input, m_input, sourcePhraseString, factorDelimiter, &sourceLHS);
+    sourcePhrase.CreateFromString(Input, m_input, rule.source, factorDelimiter, &sourceLHS);
 
     // create target phrase obj
     TargetPhrase *targetPhrase = new TargetPhrase();
-    targetPhrase->CreateFromString(Output, m_output, targetPhraseString, factorDelimiter, &targetLHS);
+    targetPhrase->CreateFromString(Output, m_output, rule.target, factorDelimiter, &targetLHS);
 
     // rest of target phrase
-    targetPhrase->SetAlignmentInfo(alignString);
+    targetPhrase->SetAlignmentInfo(rule.alignment);
     targetPhrase->SetTargetLHS(targetLHS);
-    //targetPhrase->SetDebugOutput(string("New Format pt ") + line);
 
     // component score, for n-best output
     std::transform(scoreVector.begin(),scoreVector.end(),scoreVector.begin(),TransformScore);
@@ -238,23 +137,12 @@ void PhraseDictionaryFuzzyMatch::InitializeForInput(InputType const& inputSenten
     targetPhrase->GetScoreBreakdown().Assign(this, scoreVector);
     targetPhrase->Evaluate(sourcePhrase, GetFeaturesToApply());
 
-    TargetPhraseCollection &phraseColl = GetOrCreateTargetPhraseCollection(rootNode, sourcePhrase, *targetPhrase, sourceLHS);
+    TargetPhraseCollection &phraseColl = GetOrCreateTargetPhraseCollection(*rootNode, sourcePhrase, *targetPhrase, sourceLHS);
     phraseColl.Add(targetPhrase);
-
-    count++;
-
-    if (format == HieroFormat) { // reformat line
-      delete line;
-    } else {
-      // do nothing
-    }
-
   }
 
   // sort and prune each target phrase collection
-  SortAndPrune(rootNode);
-
-  //removedirectoryrecursively(dirName);
+  SortAndPrune(*rootNode);
 }
 
 TargetPhraseCollection &PhraseDictionaryFuzzyMatch::GetOrCreateTargetPhraseCollection(PhraseDictionaryNodeMemory &rootNode
@@ -271,7 +159,6 @@ PhraseDictionaryNodeMemory &PhraseDictionaryFuzzyMatch::GetOrCreateNode(PhraseDi
     , const TargetPhrase &target
     , const Word *sourceLHS)
 {
-  cerr << source << endl << target << endl;
   const size_t size = source.GetSize();
 
   const AlignmentInfo &alignmentInfo = target.GetAlignNonTerm();
@@ -309,6 +196,7 @@ PhraseDictionaryNodeMemory &PhraseDictionaryFuzzyMatch::GetOrCreateNode(PhraseDi
 
 void PhraseDictionaryFuzzyMatch::SortAndPrune(PhraseDictionaryNodeMemory &rootNode)
 {
+  rootNode.Freeze();
   if (GetTableLimit()) {
     rootNode.Sort(GetTableLimit());
   }
@@ -316,12 +204,18 @@ void PhraseDictionaryFuzzyMatch::SortAndPrune(PhraseDictionaryNodeMemory &rootNo
 
 void PhraseDictionaryFuzzyMatch::CleanUpAfterSentenceProcessing(const InputType &source)
 {
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(m_mutex);
+#endif
   m_collection.erase(source.GetTranslationId());
 }
 
 const PhraseDictionaryNodeMemory &PhraseDictionaryFuzzyMatch::GetRootNode(const InputType &source) const
 {
   long transId = source.GetTranslationId();
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(m_mutex);
+#endif
   std::map<long, PhraseDictionaryNodeMemory>::const_iterator iter = m_collection.find(transId);
   CHECK(iter != m_collection.end());
   return iter->second;
@@ -329,6 +223,9 @@ const PhraseDictionaryNodeMemory &PhraseDictionaryFuzzyMatch::GetRootNode(const
 PhraseDictionaryNodeMemory &PhraseDictionaryFuzzyMatch::GetRootNode(const InputType &source)
 {
   long transId = source.GetTranslationId();
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(m_mutex);
+#endif
   std::map<long, PhraseDictionaryNodeMemory>::iterator iter = m_collection.find(transId);
   CHECK(iter != m_collection.end());
   return iter->second;
@@ -19,6 +19,10 @@
 
 #pragma once
 
+#ifdef WITH_THREADS
+#include <boost/thread/mutex.hpp>
+#endif
+
 #include "Trie.h"
 #include "moses/TranslationModel/PhraseDictionary.h"
 #include "moses/InputType.h"
@@ -73,9 +77,13 @@ protected:
   void SortAndPrune(PhraseDictionaryNodeMemory &rootNode);
   PhraseDictionaryNodeMemory &GetRootNode(const InputType &source);
 
-  std::map<long, PhraseDictionaryNodeMemory> m_collection;
+  std::map<long, PhraseDictionaryNodeMemory> m_collection; /**< rules of each sentence. guarded by m_mutex with threads */
   std::vector<std::string> m_config;
 
+#ifdef WITH_THREADS
+  mutable boost::mutex m_mutex;
+#endif
+
   tmmt::FuzzyMatchWrapper *m_FuzzyMatchWrapper;
 
 };
@@ -32,6 +32,8 @@ namespace Moses
 {
 PhraseDictionaryOnDisk::PhraseDictionaryOnDisk(const std::string &line)
   : MyBase("PhraseDictionaryOnDisk", line)
+  , m_mmap(false)
+  , m_prefetchDepth(0)
 {
   ReadParameters();
 }
@@ -40,9 +42,25 @@ PhraseDictionaryOnDisk::~PhraseDictionaryOnDisk()
 {
 }
 
+void PhraseDictionaryOnDisk::SetParameter(const std::string& key, const std::string& value)
+{
+  if (key == "mmap") {
+    m_mmap = Scan<bool>(value);
+  } else if (key == "prefetch-depth") {
+    m_prefetchDepth = Scan<size_t>(value);
+  } else {
+    MyBase::SetParameter(key, value);
+  }
+}
+
 void PhraseDictionaryOnDisk::Load()
 {
   SetFeaturesToApply();
+
+  if (m_mmap) {
+    m_sharedImplementation.reset(CreateImplementation());
+    CHECK(m_sharedImplementation);
+  }
 }
 
 //! find list of translations that can translates src. Only for phrase input
@@ -65,7 +83,7 @@ ChartRuleLookupManager *PhraseDictionaryOnDisk::CreateRuleLookupManager(
 OnDiskPt::OnDiskWrapper &PhraseDictionaryOnDisk::GetImplementation()
 {
   OnDiskPt::OnDiskWrapper* dict;
-  dict = m_implementation.get();
+  dict = m_sharedImplementation ? m_sharedImplementation.get() : m_implementation.get();
   CHECK(dict);
   return *dict;
 }
@@ -73,24 +91,37 @@ OnDiskPt::OnDiskWrapper &PhraseDictionaryOnDisk::GetImplementation()
 const OnDiskPt::OnDiskWrapper &PhraseDictionaryOnDisk::GetImplementation() const
 {
   OnDiskPt::OnDiskWrapper* dict;
-  dict = m_implementation.get();
+  dict = m_sharedImplementation ? m_sharedImplementation.get() : m_implementation.get();
   CHECK(dict);
   return *dict;
 }
 
-void PhraseDictionaryOnDisk::InitializeForInput(InputType const& source)
+OnDiskPt::OnDiskWrapper *PhraseDictionaryOnDisk::CreateImplementation() const
 {
-  const StaticData &staticData = StaticData::Instance();
-
   OnDiskPt::OnDiskWrapper *obj = new OnDiskPt::OnDiskWrapper();
-  if (!obj->BeginLoad(m_filePath))
-    return;
+  if (!obj->BeginLoad(m_filePath, m_mmap, m_prefetchDepth)) {
+    delete obj;
+    return NULL;
+  }
 
   CHECK(obj->GetMisc("Version") == OnDiskPt::OnDiskWrapper::VERSION_NUM);
   CHECK(obj->GetMisc("NumSourceFactors") == m_input.size());
   CHECK(obj->GetMisc("NumTargetFactors") == m_output.size());
   CHECK(obj->GetMisc("NumScores") == m_numScoreComponents);
 
+  return obj;
+}
+
+void PhraseDictionaryOnDisk::InitializeForInput(InputType const& /* source */)
+{
+  // the mapped table is read-only and shared, nothing to set up per sentence
+  if (m_sharedImplementation)
+    return;
+
+  OnDiskPt::OnDiskWrapper *obj = CreateImplementation();
+  if (obj == NULL)
+    return;
+
   m_implementation.reset(obj);
 
   return;
@@ -30,10 +30,9 @@
 #include "OnDiskPt/PhraseNode.h"
 #include "util/check.hh"
 
+#include <boost/scoped_ptr.hpp>
 #ifdef WITH_THREADS
 #include <boost/thread/tss.hpp>
-#else
-#include <boost/scoped_ptr.hpp>
 #endif
 
 namespace Moses
@@ -54,6 +53,12 @@ protected:
 #else
   boost::scoped_ptr<OnDiskPt::OnDiskWrapper> m_implementation;
 #endif
+  //! with mmap, one wrapper is loaded up front and shared by all threads
+  boost::scoped_ptr<OnDiskPt::OnDiskWrapper> m_sharedImplementation;
+  bool m_mmap;
+  size_t m_prefetchDepth;
+
+  OnDiskPt::OnDiskWrapper *CreateImplementation() const;
 
   OnDiskPt::OnDiskWrapper &GetImplementation();
   const OnDiskPt::OnDiskWrapper &GetImplementation() const;
@@ -62,6 +67,7 @@ public:
   PhraseDictionaryOnDisk(const std::string &line);
   ~PhraseDictionaryOnDisk();
   void Load();
+  void SetParameter(const std::string& key, const std::string& value);
 
   PhraseTableImplementation GetPhraseTableImplementation() const {
     return OnDisk;
@@ -86,6 +86,7 @@ ChartRuleLookupManager *RuleTableUTrie::CreateRuleLookupManager(
 
 void RuleTableUTrie::SortAndPrune()
 {
+  m_root.Freeze();
   if (GetTableLimit()) {
     m_root.Sort(GetTableLimit());
   }
@@ -24,13 +24,8 @@
 #include "moses/Word.h"
 #include "UTrieNode.h"
 #include "Trie.h"
-#include "moses/TranslationModel/PhraseDictionaryNodeMemory.h"  // For TerminalHasher and TerminalEqualityPred
 
-#include <boost/functional/hash.hpp>
-#include <boost/unordered_map.hpp>
-#include <boost/version.hpp>
-
-#include <map>
+#include <algorithm>
 #include <vector>
 
 namespace Moses
@@ -38,46 +33,65 @@ namespace Moses
 
 void UTrieNode::Prune(size_t tableLimit)
 {
+  CHECK(m_terminalMap.IsFrozen() && m_labelMap.IsFrozen());
+
   // Recusively prune child node values.
-  for (TerminalMap::iterator p = m_terminalMap.begin();
-       p != m_terminalMap.end(); ++p) {
-    p->second.Prune(tableLimit);
+  for (size_t i = 0; i < m_terminalMap.GetSize(); ++i) {
+    m_terminalMap.GetValue(i).Prune(tableLimit);
   }
   if (m_gapNode) {
     m_gapNode->Prune(tableLimit);
   }
 
   // Prune TargetPhraseCollections at this node.
-  for (LabelMap::iterator p = m_labelMap.begin(); p != m_labelMap.end(); ++p) {
-    p->second.Prune(true, tableLimit);
+  for (size_t i = 0; i < m_labelMap.GetSize(); ++i) {
+    m_labelMap.GetValue(i).Prune(true, tableLimit);
   }
 }
 
 void UTrieNode::Sort(size_t tableLimit)
 {
+  CHECK(m_terminalMap.IsFrozen() && m_labelMap.IsFrozen());
+
   // Recusively sort child node values.
-  for (TerminalMap::iterator p = m_terminalMap.begin();
-       p != m_terminalMap.end(); ++p) {
-    p->second.Sort(tableLimit);
+  for (size_t i = 0; i < m_terminalMap.GetSize(); ++i) {
+    m_terminalMap.GetValue(i).Sort(tableLimit);
   }
   if (m_gapNode) {
     m_gapNode->Sort(tableLimit);
   }
 
   // Sort TargetPhraseCollections at this node.
-  for (LabelMap::iterator p = m_labelMap.begin(); p != m_labelMap.end(); ++p) {
-    p->second.Sort(true, tableLimit);
+  for (size_t i = 0; i < m_labelMap.GetSize(); ++i) {
+    m_labelMap.GetValue(i).Sort(true, tableLimit);
   }
 }
 
+void UTrieNode::Freeze()
+{
+  m_terminalMap.Freeze();
+  m_labelMap.Freeze();
+
+  for (size_t i = 0; i < m_terminalMap.GetSize(); ++i) {
+    m_terminalMap.GetValue(i).Freeze();
+  }
+  if (m_gapNode) {
+    m_gapNode->Freeze();
+  }
+}
+
+void UTrieNode::Swap(UTrieNode &other)
+{
+  m_labelTable.swap(other.m_labelTable);
+  m_labelMap.Swap(other.m_labelMap);
+  m_terminalMap.Swap(other.m_terminalMap);
+  std::swap(m_gapNode, other.m_gapNode);
+}
+
 UTrieNode *UTrieNode::GetOrCreateTerminalChild(const Word &sourceTerm)
 {
   assert(!sourceTerm.IsNonTerminal());
-  std::pair<TerminalMap::iterator, bool> result;
-  result = m_terminalMap.insert(std::make_pair(sourceTerm, UTrieNode()));
-  const TerminalMap::iterator &iter = result.first;
-  UTrieNode &child = iter->second;
-  return &child;
+  return &m_terminalMap.GetOrCreate(sourceTerm);
 }
 
 UTrieNode *UTrieNode::GetOrCreateNonTerminalChild(const Word &targetNonTerm)
@@ -108,7 +122,7 @@ TargetPhraseCollection &UTrieNode::GetOrCreateTargetPhraseCollection(
     vec.push_back(InsertLabel(i++, targetNonTerm));
   }
 
-  return m_labelMap[vec];
+  return m_labelMap.GetOrCreate(vec);
 }
 
 }  // namespace Moses
@@ -25,13 +25,12 @@
 #include "moses/Terminal.h"
 #include "moses/Util.h"
 #include "moses/Word.h"
+#include "moses/TranslationModel/TrieChildMap.h"
 #include "Trie.h"
 
 #include <boost/functional/hash.hpp>
-#include <boost/unordered_map.hpp>
-#include <boost/version.hpp>
 
-#include <map>
+#include <functional>
 #include <vector>
 
 namespace Moses
@@ -44,18 +43,17 @@ class UTrieNode
 {
 public:
   typedef std::vector<std::vector<Word> > LabelTable;
-#if defined(BOOST_VERSION) && (BOOST_VERSION >= 104200)
-  typedef boost::unordered_map<Word,
+  typedef TrieChildMap<Word,
           UTrieNode,
           TerminalHasher,
-          TerminalEqualityPred> TerminalMap;
+          TerminalEqualityPred,
+          TerminalLess> TerminalMap;
 
-  typedef boost::unordered_map<std::vector<int>,
-          TargetPhraseCollection> LabelMap;
-#else
-  typedef std::map<Word, UTrieNode> TerminalMap;
-  typedef std::map<std::vector<int>, TargetPhraseCollection> LabelMap;
-#endif
+  typedef TrieChildMap<std::vector<int>,
+          TargetPhraseCollection,
+          boost::hash<std::vector<int> >,
+          std::equal_to<std::vector<int> >,
+          std::less<std::vector<int> > > LabelMap;
 
   ~UTrieNode() {
     delete m_gapNode;
@@ -82,21 +80,24 @@ public:
     const TargetPhrase &);
 
   bool IsLeaf() const {
-    return m_terminalMap.empty() && m_gapNode == NULL;
+    return m_terminalMap.IsEmpty() && m_gapNode == NULL;
   }
 
   bool HasRules() const {
-    return !m_labelMap.empty();
+    return !m_labelMap.IsEmpty();
   }
 
   void Prune(size_t tableLimit);
   void Sort(size_t tableLimit);
+  //! pack the maps of this node and below (see TrieChildMap)
+  void Freeze();
+  void Swap(UTrieNode &other);
+
+  UTrieNode() : m_gapNode(NULL) {}
 
 private:
   friend class RuleTableUTrie;
 
-  UTrieNode() : m_gapNode(NULL) {}
-
   int InsertLabel(int i, const Word &w) {
     std::vector<Word> &inner = m_labelTable[i];
     for (size_t j = 0; j < inner.size(); ++j) {
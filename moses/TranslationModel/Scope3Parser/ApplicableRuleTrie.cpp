@@ -26,10 +26,9 @@ void ApplicableRuleTrie::Extend(const UTrieNode &root, int minPos,
                                 const SentenceMap &sentMap, bool followsGap)
 {
   const UTrieNode::TerminalMap &termMap = root.GetTerminalMap();
-  for (UTrieNode::TerminalMap::const_iterator p = termMap.begin();
-       p != termMap.end(); ++p) {
-    const Word &word = p->first;
-    const UTrieNode &child = p->second;
+  for (size_t i = 0; i < termMap.GetSize(); ++i) {
+    const Word &word = termMap.GetKey(i);
+    const UTrieNode &child = termMap.GetValue(i);
     SentenceMap::const_iterator q = sentMap.find(word);
     if (q == sentMap.end()) {
       continue;
@@ -54,8 +54,8 @@ void Scope3Parser::GetChartRuleCollection(
     const UTrieNode::LabelMap &labelMap = ruleNode.GetLabelMap();
 
     if (varSpanNode.m_rank == 0) {  // Purely lexical rule.
-      assert(labelMap.size() == 1);
-      const TargetPhraseCollection &tpc = labelMap.begin()->second;
+      assert(labelMap.GetSize() == 1);
+      const TargetPhraseCollection &tpc = labelMap.GetValue(0);
       matchCB.m_tpc = &tpc;
       matchCB(m_emptyStackVec);
     } else {  // Rule has at least one non-terminal.
@@ -64,10 +64,9 @@ void Scope3Parser::GetChartRuleCollection(
                              *this, m_lattice,
                              m_quickCheckTable);
       StackLatticeSearcher<MatchCallback> searcher(m_lattice, m_ranges);
-      UTrieNode::LabelMap::const_iterator p = labelMap.begin();
-      for (; p != labelMap.end(); ++p) {
-        const std::vector<int> &labels = p->first;
-        const TargetPhraseCollection &tpc = p->second;
+      for (size_t ind = 0; ind < labelMap.GetSize(); ++ind) {
+        const std::vector<int> &labels = labelMap.GetKey(ind);
+        const TargetPhraseCollection &tpc = labelMap.GetValue(ind);
         assert(labels.size() == varSpanNode.m_rank);
         bool failCheck = false;
         for (size_t i = 0; i < varSpanNode.m_rank; ++i) {
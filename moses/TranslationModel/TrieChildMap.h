@@ -0,0 +1,321 @@
+// vim:tabstop=2
+
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2013 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+#include <boost/type_traits/alignment_of.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "util/check.hh"
+
+namespace Moses
+{
+
+/** The children of a node of an in-memory rule table trie.
+ *
+ * The children are kept in a single block: a header followed by a key array
+ * and a child array. While the table is being loaded the arrays are unsorted
+ * and grow as children are added; once a node has more than
+ * MAX_ARRAY_SIZE children, they are moved into a hash map. Freeze() then packs
+ * the children into an exactly sized block, sorted with Less. Most nodes have
+ * only one or two children, so a hash table per node would cost more than
+ * the children do. Small frozen maps are searched linearly and larger ones by
+ * binary search.
+ *
+ * Children can only be added before Freeze(), and GetKey()/GetValue() only
+ * work after it. References returned by GetOrCreate() are invalidated by the
+ * next insertion into the same map. A map with no children is a single NULL
+ * pointer.
+ *
+ * V must be default constructible, copy constructible when it is empty, and
+ * have a Swap() method.
+ */
+template <class K, class V, class Hash, class Equal, class Less>
+class TrieChildMap
+{
+public:
+  typedef boost::unordered_map<K, V, Hash, Equal> BuildMap;
+
+  TrieChildMap() : m_impl(NULL) {}
+
+  //! only empty maps can be copied; needed to keep nodes in std containers
+  TrieChildMap(const TrieChildMap &other) : m_impl(NULL) {
+    CHECK(other.m_impl == NULL);
+  }
+
+  TrieChildMap &operator=(const TrieChildMap &other) {
+    CHECK(m_impl == NULL && other.m_impl == NULL);
+    return *this;
+  }
+
+  ~TrieChildMap() {
+    Clear();
+  }
+
+  void Swap(TrieChildMap &other) {
+    std::swap(m_impl, other.m_impl);
+  }
+
+  bool IsEmpty() const {
+    return m_impl == NULL;
+  }
+
+  bool IsFrozen() const {
+    return m_impl == NULL || m_impl->frozen;
+  }
+
+  size_t GetSize() const {
+    if (m_impl == NULL) {
+      return 0;
+    }
+    return m_impl->building ? m_impl->building->size() : m_impl->size;
+  }
+
+  V &GetOrCreate(const K &key) {
+    CHECK(!IsFrozen() || m_impl == NULL);
+    if (m_impl && m_impl->building) {
+      return (*m_impl->building)[key];
+    }
+
+    V *value = const_cast<V*>(FindInArray(key));
+    if (value) {
+      return *value;
+    }
+
+    const size_t size = m_impl ? m_impl->size : 0;
+    const size_t capacity = m_impl ? m_impl->capacity : 0;
+    if (size == MAX_ARRAY_SIZE) {
+      MoveToBuildMap();
+      return (*m_impl->building)[key];
+    }
+    if (size == capacity) {
+      Reallocate(capacity ? capacity * 2 : 1, false);
+    }
+
+    new (GetKeys() + size) K(key);
+    new (GetValues() + size) V();
+    ++m_impl->size;
+    return GetValues()[size];
+  }
+
+  const V *Find(const K &key) const {
+    if (m_impl == NULL) {
+      return NULL;
+    }
+    if (m_impl->building) {
+      typename BuildMap::const_iterator p = m_impl->building->find(key);
+      return (p == m_impl->building->end()) ? NULL : &p->second;
+    }
+    if (!m_impl->frozen || m_impl->size <= MAX_ARRAY_SIZE) {
+      return FindInArray(key);
+    }
+
+    const K *keys = GetKeys();
+    const size_t size = m_impl->size;
+    const K *p = std::lower_bound(keys, keys + size, key, Less());
+    if (p == keys + size || !Equal()(*p, key)) {
+      return NULL;
+    }
+    return &GetValues()[p - keys];
+  }
+
+  const K &GetKey(size_t i) const {
+    return GetKeys()[i];
+  }
+  const V &GetValue(size_t i) const {
+    return GetValues()[i];
+  }
+  V &GetValue(size_t i) {
+    return GetValues()[i];
+  }
+
+  //! sort the children into an exactly sized block (not recursive)
+  void Freeze() {
+    if (IsFrozen()) {
+      return;
+    }
+    if (m_impl->building == NULL) {
+      Reallocate(m_impl->size, true);
+      return;
+    }
+
+    BuildMap &building = *m_impl->building;
+    const size_t size = building.size();
+
+    std::vector<typename BuildMap::value_type*> entries;
+    entries.reserve(size);
+    for (typename BuildMap::iterator p = building.begin(); p != building.end(); ++p) {
+      entries.push_back(&*p);
+    }
+    std::sort(entries.begin(), entries.end(), EntryLess());
+
+    Impl *frozen = Allocate(size);
+    K *keys = GetKeys(frozen);
+    V *values = GetValues(frozen);
+    for (size_t i = 0; i < size; ++i) {
+      new (keys + i) K(entries[i]->first);
+      new (values + i) V();
+      values[i].Swap(entries[i]->second);
+    }
+    frozen->size = size;
+    frozen->frozen = true;
+
+    Clear();
+    m_impl = frozen;
+  }
+
+  void Clear() {
+    if (m_impl == NULL) {
+      return;
+    }
+    delete m_impl->building;
+    Destroy(m_impl);
+    m_impl = NULL;
+  }
+
+private:
+  static const size_t MAX_ARRAY_SIZE = 8;
+
+  //! header of the block. It is followed by capacity keys and capacity values
+  struct Impl {
+    BuildMap *building; // children of large nodes until frozen, otherwise NULL
+    unsigned int size;
+    unsigned int capacity;
+    bool frozen;
+  };
+
+  struct EntryLess {
+    bool operator()(const typename BuildMap::value_type *a,
+                    const typename BuildMap::value_type *b) const {
+      return Less()(a->first, b->first);
+    }
+  };
+
+  struct IndexLess {
+    IndexLess(const K *keys) : m_keys(keys) {}
+    bool operator()(size_t a, size_t b) const {
+      return Less()(m_keys[a], m_keys[b]);
+    }
+    const K *m_keys;
+  };
+
+  static size_t Align(size_t offset, size_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+  }
+  static size_t KeysOffset() {
+    return Align(sizeof(Impl), boost::alignment_of<K>::value);
+  }
+  static size_t ValuesOffset(size_t capacity) {
+    return Align(KeysOffset() + capacity * sizeof(K), boost::alignment_of<V>::value);
+  }
+
+  static K *GetKeys(Impl *impl) {
+    return reinterpret_cast<K*>(reinterpret_cast<char*>(impl) + KeysOffset());
+  }
+  static V *GetValues(Impl *impl) {
+    return reinterpret_cast<V*>(reinterpret_cast<char*>(impl) + ValuesOffset(impl->capacity));
+  }
+  K *GetKeys() const {
+    return GetKeys(m_impl);
+  }
+  V *GetValues() const {
+    return GetValues(m_impl);
+  }
+
+  static Impl *Allocate(size_t capacity) {
+    Impl *impl = static_cast<Impl*>(::operator new(ValuesOffset(capacity) + capacity * sizeof(V)));
+    impl->building = NULL;
+    impl->size = 0;
+    impl->capacity = capacity;
+    impl->frozen = false;
+    return impl;
+  }
+
+  static void Destroy(Impl *impl) {
+    K *keys = GetKeys(impl);
+    V *values = GetValues(impl);
+    for (size_t i = 0; i < impl->size; ++i) {
+      keys[i].~K();
+      values[i].~V();
+    }
+    ::operator delete(impl);
+  }
+
+  const V *FindInArray(const K &key) const {
+    if (m_impl == NULL) {
+      return NULL;
+    }
+    const K *keys = GetKeys();
+    Equal equal;
+    for (size_t i = 0; i < m_impl->size; ++i) {
+      if (equal(keys[i], key)) {
+        return &GetValues()[i];
+      }
+    }
+    return NULL;
+  }
+
+  //! move the children into a new block, sorted if freezing
+  void Reallocate(size_t capacity, bool freeze) {
+    const size_t size = m_impl ? m_impl->size : 0;
+    std::vector<size_t> order(size);
+    for (size_t i = 0; i < size; ++i) {
+      order[i] = i;
+    }
+    if (freeze) {
+      std::sort(order.begin(), order.end(), IndexLess(GetKeys()));
+    }
+
+    Impl *impl = Allocate(capacity);
+    K *keys = GetKeys(impl);
+    V *values = GetValues(impl);
+    for (size_t i = 0; i < size; ++i) {
+      new (keys + i) K(GetKeys()[order[i]]);
+      new (values + i) V();
+      values[i].Swap(GetValues()[order[i]]);
+    }
+    impl->size = size;
+    impl->frozen = freeze;
+
+    Clear();
+    m_impl = impl;
+  }
+
+  void MoveToBuildMap() {
+    BuildMap *building = new BuildMap();
+    K *keys = GetKeys();
+    V *values = GetValues();
+    for (size_t i = 0; i < m_impl->size; ++i) {
+      (*building)[keys[i]].Swap(values[i]);
+    }
+    Clear();
+    m_impl = Allocate(0);
+    m_impl->building = building;
+  }
+
+  Impl *m_impl;
+};
+}
@@ -6,20 +6,129 @@
 //  Copyright 2012 __MyCompanyName__. All rights reserved.
 //
 
+#include <algorithm>
+#include <cassert>
 #include <iostream>
+#include <iterator>
 #include "FuzzyMatchWrapper.h"
 #include "SentenceAlignment.h"
 #include "Match.h"
 #include "create_xml.h"
 #include "moses/Util.h"
-#include "moses/StaticData.h"
 #include "util/file.hh"
+#include "moses/ThreadPool.h"
 
 using namespace std;
 
 namespace tmmt
 {
 
+namespace
+{
+
+const size_t kCandidatesPerTask = 32;
+const size_t kLSEDCacheSize = 1 << 20; // entries, per thread
+
+bool IsNonTerminal(const string &word)
+{
+  return word.size() > 2 && word[0] == '[' && word[word.size() - 1] == ']';
+}
+
+/** a rule as score tells rules apart: by its words, and by the alignment
+ * of its non-terminals */
+struct DistinctRule {
+  string source, target, nonTermAlignment;
+
+  bool operator<(const DistinctRule &other) const {
+    if (source != other.source) return source < other.source;
+    if (target != other.target) return target < other.target;
+    return nonTermAlignment < other.nonTermAlignment;
+  }
+};
+
+}
+
+/** candidate tm sentences, scored by one task */
+struct FuzzyMatchWrapper::CandidateBatch {
+  /** state of all batches of a sentence */
+  struct Shared {
+    explicit Shared(int cost) : best_cost(cost) {}
+
+    int best_cost; // lowest cost found so far
+#ifdef WITH_THREADS
+    boost::mutex mutex;
+#endif
+  };
+
+  CandidateBatch(Shared &s, WordIndex &w, long t, const vector< WORD_ID > &i, int l)
+    : shared(&s), wordIndex(&w), translationId(t), input(&i), input_length(l)
+    , count_word_match(0), count_word_match2(0), pruned_match_count(0), clock_validation(0) {}
+
+  Shared *shared;
+  WordIndex *wordIndex;
+  long translationId;
+  const vector< WORD_ID > *input;
+  int input_length;
+
+  map< int, vector< Match > >::iterator first;
+  size_t begin, end;
+  int *cost; // of each candidate, -1 if it was filtered out
+
+  int count_word_match, count_word_match2, pruned_match_count;
+  clock_t clock_validation;
+};
+
+class FuzzyMatchWrapper::MatchRangeTask : public Moses::Task
+{
+public:
+  MatchRangeTask(FuzzyMatchWrapper &wrapper, const vector< WORD > &input, size_t start,
+                 vector< pair< SuffixArray::INDEX, SuffixArray::INDEX > > &range)
+    : m_wrapper(wrapper), m_input(input), m_start(start), m_range(range) {}
+
+  virtual void Run() {
+    m_wrapper.find_match_range(m_input, m_start, m_range);
+  }
+
+private:
+  FuzzyMatchWrapper &m_wrapper;
+  const vector< WORD > &m_input;
+  size_t m_start;
+  vector< pair< SuffixArray::INDEX, SuffixArray::INDEX > > &m_range;
+};
+
+class FuzzyMatchWrapper::CandidateTask : public Moses::Task
+{
+public:
+  CandidateTask(FuzzyMatchWrapper &wrapper, CandidateBatch &batch)
+    : m_wrapper(wrapper), m_batch(batch) {}
+
+  virtual void Run() {
+    m_wrapper.score_candidates(m_batch);
+  }
+
+private:
+  FuzzyMatchWrapper &m_wrapper;
+  CandidateBatch &m_batch;
+};
+
+class FuzzyMatchWrapper::SedTask : public Moses::Task
+{
+public:
+  SedTask(FuzzyMatchWrapper &wrapper, const vector< WORD_ID > &a, const vector< WORD_ID > &b,
+          unsigned int &cost, string &path)
+    : m_wrapper(wrapper), m_a(a), m_b(b), m_cost(cost), m_path(path) {}
+
+  virtual void Run() {
+    m_cost = m_wrapper.sed(m_a, m_b, m_path, true);
+  }
+
+private:
+  FuzzyMatchWrapper &m_wrapper;
+  const vector< WORD_ID > &m_a, &m_b;
+  unsigned int &m_cost;
+  string &m_path;
+};
+
 FuzzyMatchWrapper::FuzzyMatchWrapper(const std::string &sourcePath, const std::string &targetPath, const std::string &alignmentPath)
   :basic_flag(false)
   ,lsed_flag(true)
@@ -49,53 +158,28 @@ FuzzyMatchWrapper::FuzzyMatchWrapper(const std::string &sourcePath, const std::s
   cerr << "loading completed" << endl;
 }
 
-string FuzzyMatchWrapper::Extract(long translationId, const string &dirNameStr)
+void FuzzyMatchWrapper::Extract(long translationId, const string &inputLine, vector<ScoredRule> &rules)
 {
-  const Moses::StaticData &staticData = Moses::StaticData::Instance();
-
   WordIndex wordIndex;
 
-  string fuzzyMatchFile = ExtractTM(wordIndex, translationId, dirNameStr);
+  string inputStr;
+  vector<MatchedSentence> matches;
+  ExtractTM(wordIndex, translationId, inputLine, inputStr, matches);
 
-  // create extrac files
-  create_xml(fuzzyMatchFile);
+  // create extracts
+  vector<ExtractedRule> extracted;
+  create_xml(inputStr, matches, extracted);
 
-  // create phrase table with usual Moses scoring and consolidate programs
-  string cmd;
-  cmd = "LC_ALL=C sort " + fuzzyMatchFile + ".extract | gzip -c > "
-        + fuzzyMatchFile + ".extract.sorted.gz";
-  system(cmd.c_str());
-  cmd = "LC_ALL=C sort " + fuzzyMatchFile + ".extract.inv | gzip -c > "
-        + fuzzyMatchFile + ".extract.inv.sorted.gz";
-  system(cmd.c_str());
-
-#ifdef IS_XCODE
-  cmd = "/Users/hieuhoang/unison/workspace/github/moses-smt/bin";
-#elif IS_ECLIPSE
-  cmd = "/home/hieu/workspace/github/moses-smt/bin";
-#else
-  cmd = staticData.GetBinDirectory();
-#endif
-
-  cmd += string("/../scripts/training/train-model.perl -dont-zip -first-step 6 -last-step 6 -f en -e fr -hierarchical ")
-         + " -extract-file " + fuzzyMatchFile + ".extract -lexical-file - -score-options \"--NoLex\" "
-         + " -phrase-translation-table " + fuzzyMatchFile + ".pt";
-  system(cmd.c_str());
-
-
-  return fuzzyMatchFile + ".pt.gz";
+  // score them, as the usual Moses scoring and consolidate programs would
+  score_rules(extracted, rules);
 }
 
-string FuzzyMatchWrapper::ExtractTM(WordIndex &wordIndex, long translationId, const string &dirNameStr)
+void FuzzyMatchWrapper::ExtractTM(WordIndex &wordIndex, long translationId, const string &inputLine, string &inputStr, vector<MatchedSentence> &matches)
 {
   const std::vector< std::vector< WORD_ID > > &source = suffixArray->GetCorpus();
 
-  string inputPath = dirNameStr + "/in";
-  string fuzzyMatchFile = dirNameStr + "/fuzzyMatchFile";
-  ofstream fuzzyMatchStream(fuzzyMatchFile.c_str());
-
   vector< vector< WORD_ID > > input;
-  load_corpus(inputPath, input);
+  input.push_back( GetVocabulary().Tokenize( inputLine.c_str() ) );
 
   assert(input.size() == 1);
   size_t sentenceInd = 0;
@@ -112,35 +196,19 @@ string FuzzyMatchWrapper::ExtractTM(WordIndex &wordIndex, long translationId, co
   int match_count = 0; // how many substring matches to be considered
   //cerr << endl << "sentence " << i << ", length " << input_length << ", best_cost " << best_cost << endl;
 
-  // find match ranges in suffix array
-  vector< vector< pair< SuffixArray::INDEX, SuffixArray::INDEX > > > match_range;
-  for(size_t start=0; start<input[sentenceInd].size(); start++) {
-    SuffixArray::INDEX prior_first_match = 0;
-    SuffixArray::INDEX prior_last_match = suffixArray->GetSize()-1;
-    vector< string > substring;
-    bool stillMatched = true;
-    vector< pair< SuffixArray::INDEX, SuffixArray::INDEX > > matchedAtThisStart;
-    //cerr << "start: " << start;
-    for(int word=start; stillMatched && word<input[sentenceInd].size(); word++) {
-      substring.push_back( GetVocabulary().GetWord( input[sentenceInd][word] ) );
-
-      // only look up, if needed (i.e. no unnecessary short gram lookups)
-      //				if (! word-start+1 <= short_match_max_length( input_length ) )
-      //			{
-      SuffixArray::INDEX first_match, last_match;
-      stillMatched = false;
-      if (suffixArray->FindMatches( substring, first_match, last_match, prior_first_match, prior_last_match ) ) {
-        stillMatched = true;
-        matchedAtThisStart.push_back( make_pair( first_match, last_match ) );
-        //cerr << " (" << first_match << "," << last_match << ")";
-        //cerr << " " << ( last_match - first_match + 1 );
-        prior_first_match = first_match;
-        prior_last_match = last_match;
-      }
-      //}
+  // surface strings of the input, looked up once for all start positions
+  vector< WORD > inputWords;
+  for(size_t pos=0; pos<input[sentenceInd].size(); pos++) {
+    inputWords.push_back( GetVocabulary().GetWord( input[sentenceInd][pos] ) );
+  }
+
+  // find match ranges in suffix array, for each start position in parallel
+  vector< vector< pair< SuffixArray::INDEX, SuffixArray::INDEX > > > match_range(input[sentenceInd].size());
+  {
+    Moses::TaskGroup group;
+    for(size_t start=0; start<input[sentenceInd].size(); start++) {
+      group.Spawn(new MatchRangeTask(*this, inputWords, start, match_range[start]));
     }
-    //cerr << endl;
-    match_range.push_back( matchedAtThisStart );
   }
 
   clock_t clock_range = clock();
@@ -238,73 +306,51 @@ string FuzzyMatchWrapper::ExtractTM(WordIndex &wordIndex, long translationId, co
 
   clock_t clock_matches = clock();
 
-  // consider each sentence for which we have matches
+  // consider each sentence for which we have matches. They are scored in
+  // parallel, each batch pruned by the best cost found so far by any
   int old_best_cost = best_cost;
-  int tm_count_word_match = 0;
-  int tm_count_word_match2 = 0;
-  int pruned_match_count = 0;
   if (short_match_max_length( input_length )) {
     init_short_matches(wordIndex, translationId, input[sentenceInd] );
   }
-  vector< int > best_tm;
-  typedef map< int, vector< Match > >::iterator I;
-
-  clock_t clock_validation_sum = 0;
-
-  for(I tm=sentence_match.begin(); tm!=sentence_match.end(); tm++) {
-    int tmID = tm->first;
-    int tm_length = suffixArray->GetSentenceLength(tmID);
-    vector< Match > &match = tm->second;
-    add_short_matches(wordIndex, translationId, match, source[tmID], input_length, best_cost );
-
-    //cerr << "match in sentence " << tmID << ": " << match.size() << " [" << tm_length << "]" << endl;
-
-    // quick look: how many words are matched
-    int words_matched = 0;
-    for(int m=0; m<match.size(); m++) {
-
-      if (match[m].min_cost <= best_cost) // makes no difference
-        words_matched += match[m].input_end - match[m].input_start + 1;
-    }
-    if (max(input_length,tm_length) - words_matched > best_cost) {
-      if (length_filter_flag) continue;
-    }
-    tm_count_word_match++;
 
-    // prune, check again how many words are matched
-    vector< Match > pruned = prune_matches( match, best_cost );
-    words_matched = 0;
-    for(int p=0; p<pruned.size(); p++) {
-      words_matched += pruned[p].input_end - pruned[p].input_start + 1;
-    }
-    if (max(input_length,tm_length) - words_matched > best_cost) {
-      if (length_filter_flag) continue;
+  CandidateBatch::Shared shared(best_cost);
+  vector< int > candidateCost(sentence_match.size(), -1);
+  vector< CandidateBatch > batches;
+  typedef map< int, vector< Match > >::iterator I;
+  I tm = sentence_match.begin();
+  for (size_t begin = 0; begin < sentence_match.size(); begin += kCandidatesPerTask) {
+    batches.push_back(CandidateBatch(shared, wordIndex, translationId, input[sentenceInd], input_length));
+    CandidateBatch &batch = batches.back();
+    batch.first = tm;
+    batch.begin = begin;
+    batch.end = min(begin + kCandidatesPerTask, sentence_match.size());
+    batch.cost = &candidateCost[begin];
+    advance(tm, batch.end - begin);
+  }
+  {
+    Moses::TaskGroup group;
+    for (size_t i = 0; i < batches.size(); ++i) {
+      group.Spawn(new CandidateTask(*this, batches[i]));
     }
-    tm_count_word_match2++;
-
-    pruned_match_count += pruned.size();
-    int prior_best_cost = best_cost;
-    int cost;
+  }
+  best_cost = shared.best_cost;
 
-    clock_t clock_validation_start = clock();
-    if (! parse_flag ||
-        pruned.size()>=10) { // to prevent worst cases
-      string path;
-      cost = sed( input[sentenceInd], source[tmID], path, false );
-      if (cost <  best_cost) {
-        best_cost = cost;
-      }
-    }
+  int tm_count_word_match = 0;
+  int tm_count_word_match2 = 0;
+  int pruned_match_count = 0;
+  clock_t clock_validation_sum = 0;
+  for (size_t i = 0; i < batches.size(); ++i) {
+    tm_count_word_match += batches[i].count_word_match;
+    tm_count_word_match2 += batches[i].count_word_match2;
+    pruned_match_count += batches[i].pruned_match_count;
+    clock_validation_sum += batches[i].clock_validation;
+  }
 
-    else {
-      cost = parse_matches( pruned, input_length, tm_length, best_cost );
-      if (prior_best_cost != best_cost) {
-        best_tm.clear();
-      }
-    }
-    clock_validation_sum += clock() - clock_validation_start;
-    if (cost == best_cost) {
-      best_tm.push_back( tmID );
+  vector< int > best_tm;
+  tm = sentence_match.begin();
+  for (size_t c = 0; c < candidateCost.size(); ++c, ++tm) {
+    if (candidateCost[c] == best_cost) {
+      best_tm.push_back( tm->first );
     }
   }
   cerr << "reduced best cost from " << old_best_cost << " to " << best_cost << endl;
@@ -316,9 +362,18 @@ string FuzzyMatchWrapper::ExtractTM(WordIndex &wordIndex, long translationId, co
   cerr << "pruned matches: " << ((float)pruned_match_count/(float)tm_count_word_match2) << endl;
 
   // create xml and extract files
-  string inputStr, sourceStr;
   for (size_t pos = 0; pos < input_length; ++pos) {
-    inputStr += GetVocabulary().GetWord(input[sentenceInd][pos]) + " ";
+    inputStr += inputWords[pos] + " ";
+  }
+
+  // letter edit distances to the best matches, in parallel
+  vector< unsigned int > letter_costs(best_tm.size());
+  vector< string > paths(best_tm.size());
+  if (multiple_flag || lsed_flag) {
+    Moses::TaskGroup group;
+    for(size_t si=0; si<best_tm.size(); si++) {
+      group.Spawn(new SedTask(*this, input[sentenceInd], source[best_tm[si]], letter_costs[si], paths[si]));
+    }
   }
 
   // do not try to find the best ... report multiple matches
@@ -326,8 +381,7 @@ string FuzzyMatchWrapper::ExtractTM(WordIndex &wordIndex, long translationId, co
     int input_letter_length = compute_length( input[sentenceInd] );
     for(int si=0; si<best_tm.size(); si++) {
       int s = best_tm[si];
-      string path;
-      unsigned int letter_cost = sed( input[sentenceInd], source[s], path, true );
+      const string &path = paths[si];
       // do not report multiple identical sentences, but just their count
       //cout << sentenceInd << " "; // sentence number
       //cout << letter_cost << "/" << input_letter_length << " ";
@@ -336,7 +390,7 @@ string FuzzyMatchWrapper::ExtractTM(WordIndex &wordIndex, long translationId, co
 
       const vector<WORD_ID> &sourceSentence = source[s];
       vector<SentenceAlignment> &targets = targetAndAlignment[s];
-      create_extract(sentenceInd, best_cost, sourceSentence, targets, inputStr, path, fuzzyMatchStream);
+      create_extract(sourceSentence, targets, path, matches);
 
     }
   } // if (multiple_flag)
@@ -350,11 +404,10 @@ string FuzzyMatchWrapper::ExtractTM(WordIndex &wordIndex, long translationId, co
       best_letter_cost = compute_length( input[sentenceInd] ) * min_match / 100 + 1;
       for(int si=0; si<best_tm.size(); si++) {
         int s = best_tm[si];
-        string path;
-        unsigned int letter_cost = sed( input[sentenceInd], source[s], path, true );
+        unsigned int letter_cost = letter_costs[si];
         if (letter_cost < best_letter_cost) {
           best_letter_cost = letter_cost;
-          best_path = path;
+          best_path = paths[si];
           best_match = s;
         }
       }
@@ -391,13 +444,107 @@ string FuzzyMatchWrapper::ExtractTM(WordIndex &wordIndex, long translationId, co
     // creat xml & extracts
     const vector<WORD_ID> &sourceSentence = source[best_match];
     vector<SentenceAlignment> &targets = targetAndAlignment[best_match];
-    create_extract(sentenceInd, best_cost, sourceSentence, targets, inputStr, best_path, fuzzyMatchStream);
+    create_extract(sourceSentence, targets, best_path, matches);
 
   } // else if (multiple_flag)
+}
+
+void FuzzyMatchWrapper::find_match_range(const vector< WORD > &input, size_t start, vector< pair< SuffixArray::INDEX, SuffixArray::INDEX > > &matchedAtThisStart)
+{
+  SuffixArray::INDEX prior_first_match = 0;
+  SuffixArray::INDEX prior_last_match = suffixArray->GetSize()-1;
+  vector< string > substring;
+  bool stillMatched = true;
+  //cerr << "start: " << start;
+  for(int word=start; stillMatched && word<input.size(); word++) {
+    substring.push_back( input[word] );
+
+    // only look up, if needed (i.e. no unnecessary short gram lookups)
+    //				if (! word-start+1 <= short_match_max_length( input_length ) )
+    //			{
+    SuffixArray::INDEX first_match, last_match;
+    stillMatched = false;
+    if (suffixArray->FindMatches( substring, first_match, last_match, prior_first_match, prior_last_match ) ) {
+      stillMatched = true;
+      matchedAtThisStart.push_back( make_pair( first_match, last_match ) );
+      //cerr << " (" << first_match << "," << last_match << ")";
+      //cerr << " " << ( last_match - first_match + 1 );
+      prior_first_match = first_match;
+      prior_last_match = last_match;
+    }
+    //}
+  }
+  //cerr << endl;
+}
+
+void FuzzyMatchWrapper::score_candidates(CandidateBatch &batch)
+{
+  const std::vector< std::vector< WORD_ID > > &source = suffixArray->GetCorpus();
+  const vector< WORD_ID > &input = *batch.input;
+  const int input_length = batch.input_length;
+
+  map< int, vector< Match > >::iterator tm = batch.first;
+  for (size_t c = batch.begin; c < batch.end; ++c, ++tm) {
+    int best_cost;
+    {
+#ifdef WITH_THREADS
+      boost::mutex::scoped_lock lock(batch.shared->mutex);
+#endif
+      best_cost = batch.shared->best_cost;
+    }
+    int &cost = batch.cost[c - batch.begin];
+
+    int tmID = tm->first;
+    int tm_length = suffixArray->GetSentenceLength(tmID);
+    vector< Match > &match = tm->second;
+    add_short_matches(*batch.wordIndex, batch.translationId, match, source[tmID], input_length, best_cost );
+
+    //cerr << "match in sentence " << tmID << ": " << match.size() << " [" << tm_length << "]" << endl;
+
+    // quick look: how many words are matched
+    int words_matched = 0;
+    for(int m=0; m<match.size(); m++) {
+
+      if (match[m].min_cost <= best_cost) // makes no difference
+        words_matched += match[m].input_end - match[m].input_start + 1;
+    }
+    if (max(input_length,tm_length) - words_matched > best_cost) {
+      if (length_filter_flag) continue;
+    }
+    batch.count_word_match++;
+
+    // prune, check again how many words are matched
+    vector< Match > pruned = prune_matches( match, best_cost );
+    words_matched = 0;
+    for(int p=0; p<pruned.size(); p++) {
+      words_matched += pruned[p].input_end - pruned[p].input_start + 1;
+    }
+    if (max(input_length,tm_length) - words_matched > best_cost) {
+      if (length_filter_flag) continue;
+    }
+    batch.count_word_match2++;
 
-  fuzzyMatchStream.close();
+    batch.pruned_match_count += pruned.size();
+
+    clock_t clock_validation_start = clock();
+    if (! parse_flag ||
+        pruned.size()>=10) { // to prevent worst cases
+      string path;
+      cost = sed( input, source[tmID], path, false );
+    }
 
-  return fuzzyMatchFile;
+    else {
+      cost = parse_matches( pruned, input_length, tm_length, best_cost );
+    }
+    batch.clock_validation += clock() - clock_validation_start;
+
+    {
+#ifdef WITH_THREADS
+      boost::mutex::scoped_lock lock(batch.shared->mutex);
+#endif
+      batch.shared->best_cost = min(batch.shared->best_cost, cost);
+    }
+  }
 }
 
 void FuzzyMatchWrapper::load_corpus( const std::string &fileName, vector< vector< WORD_ID > > &corpus )
@@ -526,44 +673,30 @@ void FuzzyMatchWrapper::load_alignment(const std::string &fileName, vector< vect
   }
 }
 
-bool FuzzyMatchWrapper::GetLSEDCache(const std::pair< WORD_ID, WORD_ID > &key, unsigned int &value) const
+FuzzyMatchWrapper::LSEDCache &FuzzyMatchWrapper::GetLSEDCache()
 {
 #ifdef WITH_THREADS
-  boost::shared_lock<boost::shared_mutex> read_lock(m_accessLock);
-#endif
-  map< pair< WORD_ID, WORD_ID >, unsigned int >::const_iterator lookup = m_lsed.find( key );
-  if (lookup != m_lsed.end()) {
-    value = lookup->second;
-    return true;
+  if (m_lsed.get() == NULL) {
+    m_lsed.reset(new LSEDCache());
   }
-
-  return false;
-}
-
-void FuzzyMatchWrapper::SetLSEDCache(const std::pair< WORD_ID, WORD_ID > &key, const unsigned int &value)
-{
-#ifdef WITH_THREADS
-  boost::unique_lock<boost::shared_mutex> lock(m_accessLock);
+  return *m_lsed;
+#else
+  return m_lsed;
 #endif
-  m_lsed[ key ] = value;
 }
 
 /* Letter string edit distance, e.g. sub 'their' to 'there' costs 2 */
 
-unsigned int FuzzyMatchWrapper::letter_sed( WORD_ID aIdx, WORD_ID bIdx )
+unsigned int FuzzyMatchWrapper::letter_sed( WORD_ID aIdx, const WORD &a, WORD_ID bIdx, const WORD &b )
 {
   // check if already computed -> lookup in cache
+  LSEDCache &cache = GetLSEDCache();
   pair< WORD_ID, WORD_ID > pIdx = make_pair( aIdx, bIdx );
-  unsigned int value;
-  bool ret = GetLSEDCache(pIdx, value);
-  if (ret) {
-    return value;
+  LSEDCache::const_iterator lookup = cache.find( pIdx );
+  if (lookup != cache.end()) {
+    return lookup->second;
   }
 
-  // get surface strings for word indices
-  const string &a = GetVocabulary().GetWord( aIdx );
-  const string &b = GetVocabulary().GetWord( bIdx );
-
   // initialize cost matrix
   unsigned int **cost  = (unsigned int**) calloc( sizeof( unsigned int*  ), a.size()+1 );
   for( unsigned int i=0; i<=a.size(); i++ ) {
@@ -580,7 +713,7 @@ unsigned int FuzzyMatchWrapper::letter_sed( WORD_ID aIdx, WORD_ID bIdx )
 
       unsigned int ins = cost[i-1][j] + 1;
       unsigned int del = cost[i][j-1] + 1;
-      bool match = (a.substr(i-1,1).compare( b.substr(j-1,1) ) == 0);
+      bool match = (a[i-1] == b[j-1]);
       unsigned int diag = cost[i-1][j-1] + (match ? 0 : 1);
 
       unsigned int min = (ins < del) ? ins : del;
@@ -597,8 +730,11 @@ unsigned int FuzzyMatchWrapper::letter_sed( WORD_ID aIdx, WORD_ID bIdx )
   }
   free( cost );
 
-  // cache and return result
-  SetLSEDCache(pIdx, final);
+  // cache and return result. The cache is emptied when full
+  if (cache.size() >= kLSEDCacheSize) {
+    cache.clear();
+  }
+  cache[ pIdx ] = final;
   return final;
 }
 
@@ -606,6 +742,16 @@ unsigned int FuzzyMatchWrapper::letter_sed( WORD_ID aIdx, WORD_ID bIdx )
 
 unsigned int FuzzyMatchWrapper::sed( const vector< WORD_ID > &a, const vector< WORD_ID > &b, string &best_path, bool use_letter_sed )
 {
+  // surface strings, looked up once rather than in every cell
+  vector< const WORD* > aWord, bWord;
+  if (use_letter_sed) {
+    for( unsigned int i=0; i<a.size(); i++ ) {
+      aWord.push_back( &GetVocabulary().GetWord( a[i] ) );
+    }
+    for( unsigned int j=0; j<b.size(); j++ ) {
+      bWord.push_back( &GetVocabulary().GetWord( b[j] ) );
+    }
+  }
 
   // initialize cost and path matrices
   unsigned int **cost  = (unsigned int**) calloc( sizeof( unsigned int* ), a.size()+1 );
@@ -617,7 +763,7 @@ unsigned int FuzzyMatchWrapper::sed( const vector< WORD_ID > &a, const vector< W
     if (i>0) {
       cost[i][0] = cost[i-1][0];
       if (use_letter_sed) {
-        cost[i][0] += GetVocabulary().GetWord( a[i-1] ).size();
+        cost[i][0] += aWord[i-1]->size();
       } else {
         cost[i][0]++;
       }
@@ -631,7 +777,7 @@ unsigned int FuzzyMatchWrapper::sed( const vector< WORD_ID > &a, const vector< W
     if (j>0) {
       cost[0][j] = cost[0][j-1];
       if (use_letter_sed) {
-        cost[0][j] +=	GetVocabulary().GetWord( b[j-1] ).size();
+        cost[0][j] += bWord[j-1]->size();
       } else {
         cost[0][j]++;
       }
@@ -648,9 +794,9 @@ unsigned int FuzzyMatchWrapper::sed( const vector< WORD_ID > &a, const vector< W
       unsigned int del = cost[i][j-1];
       unsigned int match;
       if (use_letter_sed) {
-        ins += GetVocabulary().GetWord( a[i-1] ).size();
-        del += GetVocabulary().GetWord( b[j-1] ).size();
-        match = letter_sed( a[i-1], b[j-1] );
+        ins += aWord[i-1]->size();
+        del += bWord[j-1]->size();
+        match = letter_sed( a[i-1], *aWord[i-1], b[j-1], *bWord[j-1] );
       } else {
         ins++;
         del++;
@@ -1015,7 +1161,7 @@ int FuzzyMatchWrapper::parse_matches( vector< Match > &match, int input_length,
 }
 
 
-void FuzzyMatchWrapper::create_extract(int sentenceInd, int cost, const vector< WORD_ID > &sourceSentence, const vector<SentenceAlignment> &targets, const string &inputStr, const string  &path, ofstream &outputFile)
+void FuzzyMatchWrapper::create_extract(const vector< WORD_ID > &sourceSentence, const vector<SentenceAlignment> &targets, const string  &path, vector< MatchedSentence > &matches)
 {
   string sourceStr;
   for (size_t pos = 0; pos < sourceSentence.size(); ++pos) {
@@ -1025,19 +1171,82 @@ void FuzzyMatchWrapper::create_extract(int sentenceInd, int cost, const vector<
 
   for (size_t targetInd = 0; targetInd < targets.size(); ++targetInd) {
     const SentenceAlignment &sentenceAlignment = targets[targetInd];
-    string targetStr = sentenceAlignment.getTargetString(GetVocabulary());
-    string alignStr = sentenceAlignment.getAlignmentString();
-
-    outputFile
-        << sentenceInd << endl
-        << cost << endl
-        << sourceStr << endl
-        << inputStr << endl
-        << targetStr << endl
-        << alignStr << endl
-        << path << endl
-        << sentenceAlignment.count << endl;
 
+    MatchedSentence match;
+    match.source = sourceStr;
+    match.target = sentenceAlignment.getTargetString(GetVocabulary());
+    match.alignment = sentenceAlignment.getAlignmentString();
+    match.path = path;
+    match.count = sentenceAlignment.count;
+    matches.push_back(match);
+  }
+}
+
+/* score the rules as score --Hierarchical --NoLex does in both directions,
+ * and consolidate combines. Rules that only differ in the alignment of
+ * their words are one rule, with the alignment seen most often; rules that
+ * align their non-terminals differently are kept apart */
+void FuzzyMatchWrapper::score_rules(const vector< ExtractedRule > &extracted, vector< ScoredRule > &rules) const
+{
+  // count of each word alignment of a rule, and of each side of the rules
+  map< DistinctRule, map< string, float > > ruleCount;
+  map< string, float > sourceCount, targetCount;
+
+  for (size_t i = 0; i < extracted.size(); ++i) {
+    const ExtractedRule &rule = extracted[i];
+    vector<string> targetToks = Moses::Tokenize(rule.target);
+    vector<string> points = Moses::Tokenize(rule.alignment);
+    sort(points.begin(), points.end());
+
+    DistinctRule key;
+    key.source = rule.source;
+    key.target = rule.target;
+    for (size_t p = 0; p < points.size(); ++p) {
+      vector<size_t> point = Moses::Tokenize<size_t>(points[p], "-");
+      assert(point.size() == 2 && point[1] < targetToks.size());
+      if (IsNonTerminal(targetToks[point[1]])) {
+        key.nonTermAlignment += points[p] + " ";
+      }
+    }
+
+    // keyed by the rest of the extract line, so that ties are broken in the
+    // order of the sorted extract file
+    ruleCount[key][rule.alignment + " |||"] += rule.count;
+    sourceCount[rule.source] += rule.count;
+    targetCount[rule.target] += rule.count;
+  }
+
+  map< DistinctRule, map< string, float > >::const_iterator iterRule;
+  for (iterRule = ruleCount.begin(); iterRule != ruleCount.end(); ++iterRule) {
+    const DistinctRule &key = iterRule->first;
+    const map< string, float > &alignments = iterRule->second;
+
+    float count = 0, bestAlignmentCount = -1;
+    map< string, float >::const_iterator bestAlignment;
+    map< string, float >::const_iterator iterAlign;
+    for (iterAlign = alignments.begin(); iterAlign != alignments.end(); ++iterAlign) {
+      count += iterAlign->second;
+      if (iterAlign->second > bestAlignmentCount) {
+        bestAlignmentCount = iterAlign->second;
+        bestAlignment = iterAlign;
+      }
+    }
+
+    // all points of the best alignment, sorted as strings
+    vector<string> points = Moses::Tokenize(bestAlignment->first);
+    points.pop_back();
+    sort(points.begin(), points.end());
+
+    ScoredRule rule;
+    rule.source = key.source + " [X]";
+    rule.target = key.target + " [X]";
+    for (size_t p = 0; p < points.size(); ++p) {
+      rule.alignment += (p ? " " : "") + points[p];
+    }
+    rule.scores.push_back(count / targetCount.find(key.target)->second);
+    rule.scores.push_back(count / sourceCount.find(key.source)->second);
+    rule.scores.push_back(2.718f); // phrase penalty
+    rules.push_back(rule);
   }
 }
 
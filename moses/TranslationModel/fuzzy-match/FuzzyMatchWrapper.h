@@ -10,14 +10,17 @@
 #define moses_FuzzyMatchWrapper_h
 
 #ifdef WITH_THREADS
-#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
 #endif
+#include <boost/unordered_map.hpp>
 
 #include <fstream>
 #include <string>
 #include "SuffixArray.h"
 #include "Vocabulary.h"
 #include "Match.h"
+#include "create_xml.h"
 #include "moses/InputType.h"
 
 namespace tmmt
@@ -25,12 +28,22 @@ namespace tmmt
 class Match;
 class SentenceAlignment;
 
+/** a line of the phrase table that train-model.perl builds from an extract
+ * with score --Hierarchical --NoLex and consolidate. Both sides end in the
+ * [X] label, the scores are p(s|t), p(t|s) and the phrase penalty */
+struct ScoredRule {
+  std::string source, target, alignment;
+  std::vector<float> scores;
+};
+
 class FuzzyMatchWrapper
 {
 public:
   FuzzyMatchWrapper(const std::string &source, const std::string &target, const std::string &alignment);
 
-  std::string Extract(long translationId, const std::string &dirNameStr);
+  /** rules for an input sentence, from its best matches in the translation
+   * memory. May be called by several threads at once */
+  void Extract(long translationId, const std::string &input, std::vector<ScoredRule> &rules);
 
 protected:
   // tm-mt
@@ -48,13 +61,21 @@ protected:
 
   typedef std::map< WORD_ID,std::vector< int > > WordIndex;
 
-  // global cache for word pairs
-  std::map< std::pair< WORD_ID, WORD_ID >, unsigned int > m_lsed;
+  // cache for word pairs, one per thread so that it needs no lock. It is
+  // kept from sentence to sentence, and bounded in size
+  typedef boost::unordered_map< std::pair< WORD_ID, WORD_ID >, unsigned int > LSEDCache;
 #ifdef WITH_THREADS
-  //reader-writer lock
-  mutable boost::shared_mutex m_accessLock;
+  boost::thread_specific_ptr<LSEDCache> m_lsed;
+#else
+  LSEDCache m_lsed;
 #endif
 
+  // matching is split into tasks for the thread pool of the calling thread
+  struct CandidateBatch;
+  class MatchRangeTask;
+  class CandidateTask;
+  class SedTask;
+
   void load_corpus( const std::string &fileName, std::vector< std::vector< tmmt::WORD_ID > > &corpus );
   void load_target( const std::string &fileName, std::vector< std::vector< tmmt::SentenceAlignment > > &corpus);
   void load_alignment( const std::string &fileName, std::vector< std::vector< tmmt::SentenceAlignment > > &corpus );
@@ -66,23 +87,25 @@ protected:
   /** utlility function: compute length of sentence in characters
    (spaces do not count) */
   unsigned int compute_length( const std::vector< tmmt::WORD_ID > &sentence );
-  unsigned int letter_sed( WORD_ID aIdx, WORD_ID bIdx );
+  unsigned int letter_sed( WORD_ID aIdx, const WORD &a, WORD_ID bIdx, const WORD &b );
   unsigned int sed( const std::vector< WORD_ID > &a, const std::vector< WORD_ID > &b, std::string &best_path, bool use_letter_sed );
+  void find_match_range(const std::vector< WORD > &input, size_t start, std::vector< std::pair< SuffixArray::INDEX, SuffixArray::INDEX > > &matchedAtThisStart);
+  void score_candidates(CandidateBatch &batch);
   void init_short_matches(WordIndex &wordIndex, long translationId, const std::vector< WORD_ID > &input );
   int short_match_max_length( int input_length );
   void add_short_matches(WordIndex &wordIndex, long translationId, std::vector< Match > &match, const std::vector< WORD_ID > &tm, int input_length, int best_cost );
   std::vector< Match > prune_matches( const std::vector< Match > &match, int best_cost );
   int parse_matches( std::vector< Match > &match, int input_length, int tm_length, int &best_cost );
 
-  void create_extract(int sentenceInd, int cost, const std::vector< WORD_ID > &sourceSentence, const std::vector<SentenceAlignment> &targets, const std::string &inputStr, const std::string  &path, std::ofstream &outputFile);
+  void create_extract(const std::vector< WORD_ID > &sourceSentence, const std::vector<SentenceAlignment> &targets, const std::string  &path, std::vector< MatchedSentence > &matches);
+  void score_rules(const std::vector< ExtractedRule > &extracted, std::vector< ScoredRule > &rules) const;
 
-  std::string ExtractTM(WordIndex &wordIndex, long translationId, const std::string &inputPath);
+  void ExtractTM(WordIndex &wordIndex, long translationId, const std::string &inputLine, std::string &inputStr, std::vector< MatchedSentence > &matches);
   Vocabulary &GetVocabulary() {
     return suffixArray->GetVocabulary();
   }
 
-  bool GetLSEDCache(const std::pair< WORD_ID, WORD_ID > &key, unsigned int &value) const;
-  void SetLSEDCache(const std::pair< WORD_ID, WORD_ID > &key, const unsigned int &value);
+  LSEDCache &GetLSEDCache();
 
 };
 
@@ -2,17 +2,60 @@
 #include <string>
 #include <stdlib.h>
 #include <cstring>
+#include <cstdio>
+#include <sstream>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "util/file.hh"
 
 using namespace std;
 
 namespace tmmt
 {
 
+namespace
+{
+
+const char kIndexMagic[8] = { 't', 'm', 'm', 't', 'S', 'A', '2', '\0' };
+
+/** start of the index file. It goes on with m_sentence, m_array, m_index,
+ * m_wordInSentence and m_sentenceLength, and the words of the vocabulary in
+ * order of their ids, each ended by a 0 */
+struct IndexHeader {
+  char magic[8];
+  uint64_t corpusBytes; // size of the corpus it was built from
+  uint64_t corpusMTime; // and its modification time
+  uint64_t size;
+  uint64_t sentenceCount;
+  uint64_t vocabBytes;
+};
+
+// size and modification time, which tell whether the corpus changed
+void FileStamp(const string &fileName, uint64_t &bytes, uint64_t &mtime)
+{
+  util::scoped_fd file(util::OpenReadOrThrow(fileName.c_str()));
+  struct stat sb;
+  UTIL_THROW_IF(fstat(file.get(), &sb) == -1, util::ErrnoException, "Couldn't stat " << fileName);
+  bytes = sb.st_size;
+  mtime = sb.st_mtime;
+}
+
+}
+
 SuffixArray::SuffixArray( string fileName )
 {
   m_vcb.StoreIfNew( "<uNk>" );
   m_endOfSentence = m_vcb.StoreIfNew( "<s>" );
 
+  // built once, then shared by all processes through the page cache
+  const string indexFileName = fileName + ".suffix-array";
+  uint64_t corpusBytes, corpusMTime;
+  FileStamp(fileName, corpusBytes, corpusMTime);
+  if (Load(indexFileName, corpusBytes, corpusMTime)) {
+    cerr << "loaded " << m_size << " words (incl. sentence boundaries) from " << indexFileName << endl;
+    return;
+  }
+
   ifstream extractFile;
   char line[LINE_MAX_LENGTH];
 
@@ -66,6 +109,7 @@ SuffixArray::SuffixArray( string fileName )
   }
   extractFile.close();
   cerr << "done reading " << wordIndex << " words, " << sentenceId << " sentences." << endl;
+  StoreCorpusWords();
   // List(0,9);
 
   // sort
@@ -73,6 +117,119 @@ SuffixArray::SuffixArray( string fileName )
   Sort( 0, m_size-1 );
   free( m_buffer );
   cerr << "done sorting" << endl;
+
+  m_sentenceCount = sentenceCount;
+  Save(indexFileName, corpusBytes, corpusMTime);
+}
+
+bool SuffixArray::Load(const string &fileName, uint64_t corpusBytes, uint64_t corpusMTime)
+{
+  if (access(fileName.c_str(), R_OK) != 0) {
+    return false;
+  }
+  util::scoped_fd file(util::OpenReadOrThrow(fileName.c_str()));
+  util::MapRead(util::POPULATE_OR_LAZY, file.get(), 0, util::SizeOrThrow(file.get()), m_mapped);
+
+  const char *data = m_mapped.begin();
+  IndexHeader header;
+  if (m_mapped.size() < sizeof(header)) {
+    m_mapped.reset();
+    return false;
+  }
+  memcpy(&header, data, sizeof(header));
+  const uint64_t expected = sizeof(header)
+                            + header.size * (sizeof(size_t) + sizeof(WORD_ID) + sizeof(INDEX) + sizeof(char))
+                            + header.sentenceCount * sizeof(char) + header.vocabBytes;
+  if (memcmp(header.magic, kIndexMagic, sizeof(kIndexMagic)) != 0
+      || header.corpusBytes != corpusBytes || header.corpusMTime != corpusMTime
+      || expected != m_mapped.size()) {
+    cerr << "ignoring " << fileName << ", it was not built from this corpus" << endl;
+    m_mapped.reset();
+    return false;
+  }
+
+  // point into the mapping
+  data += sizeof(header);
+  m_size = header.size;
+  m_sentenceCount = header.sentenceCount;
+  m_sentence = (size_t*) data;
+  data += sizeof(size_t) * m_size;
+  m_array = (WORD_ID*) data;
+  data += sizeof(WORD_ID) * m_size;
+  m_index = (INDEX*) data;
+  data += sizeof(INDEX) * m_size;
+  m_wordInSentence = (char*) data;
+  data += sizeof(char) * m_size;
+  m_sentenceLength = (char*) data;
+  data += sizeof(char) * m_sentenceCount;
+
+  // the vocabulary, in order, so that the ids are the same
+  for (const char *word = data; word < m_mapped.end(); word += strlen(word) + 1) {
+    m_vcb.StoreIfNew( word );
+  }
+  StoreCorpusWords();
+
+  // the corpus, from the words of the array
+  corpus.resize(m_sentenceCount);
+  INDEX wordIndex = 0;
+  for (size_t sentenceId = 0; sentenceId < m_sentenceCount; ++sentenceId) {
+    INDEX end = wordIndex;
+    while (m_array[ end ] != m_endOfSentence) {
+      end++;
+    }
+    corpus[sentenceId].assign(m_array + wordIndex, m_array + end);
+    wordIndex = end + 1;
+  }
+  return true;
+}
+
+void SuffixArray::Save(const string &fileName, uint64_t corpusBytes, uint64_t corpusMTime) const
+{
+  // written under another name first, so that no process can see half of it
+  ostringstream tempName;
+  tempName << fileName << "." << getpid();
+  ofstream indexFile(tempName.str().c_str(), ios::out | ios::binary);
+  if (!indexFile) {
+    cerr << "could not write " << fileName << ", the suffix array will be built again next time" << endl;
+    return;
+  }
+
+  string vocab;
+  for (size_t id = 0; id < m_vcb.vocab.size(); ++id) {
+    vocab += m_vcb.vocab[id];
+    vocab.push_back('\0');
+  }
+
+  IndexHeader header;
+  memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+  header.corpusBytes = corpusBytes;
+  header.corpusMTime = corpusMTime;
+  header.size = m_size;
+  header.sentenceCount = m_sentenceCount;
+  header.vocabBytes = vocab.size();
+
+  indexFile.write((const char*) &header, sizeof(header));
+  indexFile.write((const char*) m_sentence, sizeof(size_t) * m_size);
+  indexFile.write((const char*) m_array, sizeof(WORD_ID) * m_size);
+  indexFile.write((const char*) m_index, sizeof(INDEX) * m_size);
+  indexFile.write(m_wordInSentence, sizeof(char) * m_size);
+  indexFile.write(m_sentenceLength, sizeof(char) * m_sentenceCount);
+  indexFile.write(vocab.data(), vocab.size());
+  indexFile.close();
+
+  if (!indexFile || rename(tempName.str().c_str(), fileName.c_str()) != 0) {
+    cerr << "could not write " << fileName << ", the suffix array will be built again next time" << endl;
+    remove(tempName.str().c_str());
+  }
+}
+
+void SuffixArray::StoreCorpusWords()
+{
+  // words stay where they are in the vocabulary's deque
+  m_words.resize(m_vcb.vocab.size());
+  for (WORD_ID id = 0; id < m_words.size(); ++id) {
+    m_words[id] = &m_vcb.GetWord(id);
+  }
 }
 
 // good ol' quick sort
@@ -108,8 +265,14 @@ void SuffixArray::Sort(INDEX start, INDEX end)
 
 SuffixArray::~SuffixArray()
 {
-  free(m_index);
-  free(m_array);
+  // a loaded index is unmapped by m_mapped
+  if (m_mapped.get() == NULL) {
+    free(m_index);
+    free(m_array);
+    free(m_wordInSentence);
+    free(m_sentence);
+    free(m_sentenceLength);
+  }
 }
 
 int SuffixArray::CompareIndex( INDEX a, INDEX b ) const
@@ -130,7 +293,7 @@ int SuffixArray::CompareIndex( INDEX a, INDEX b ) const
 inline int SuffixArray::CompareWord( WORD_ID a, WORD_ID b ) const
 {
   // cerr << "c(" << m_vcb.GetWord(a) << ":" << m_vcb.GetWord(b) << ")=" << m_vcb.GetWord(a).compare( m_vcb.GetWord(b) ) << endl;
-  return m_vcb.GetWord(a).compare( m_vcb.GetWord(b) );
+  return m_words[a]->compare( *m_words[b] );
 }
 
 int SuffixArray::Count( const vector< WORD > &phrase )
@@ -186,7 +349,8 @@ SuffixArray::INDEX SuffixArray::FindLast( const vector< WORD > &phrase, INDEX st
     INDEX mid = ( start + end + (direction>0 ? 0 : 1) )/2;
 
     int match = Match( phrase, mid );
-    int matchNext = Match( phrase, mid+direction );
+    // past either end of the array counts as no match
+    int matchNext = (mid+direction < m_size) ? Match( phrase, mid+direction ) : 1;
     //cerr << "\t" << start << ";" << mid << ";" << end << " -> " << match << "," << matchNext << endl;
 
     if (match == 0 && matchNext != 0) return mid;
@@ -219,7 +383,7 @@ int SuffixArray::Match( const vector< WORD > &phrase, INDEX index )
 {
   INDEX pos = m_index[ index ];
   for(INDEX i=0; i<phrase.size() && i+pos<m_size; i++) {
-    int match = CompareWord( m_vcb.GetWordID( phrase[i] ), m_array[ pos+i ] );
+    int match = phrase[i].compare( *m_words[ m_array[ pos+i ] ] );
     // cerr << "{" << index << "+" << i << "," << pos+i << ":" << match << "}" << endl;
     if (match != 0)
       return match;
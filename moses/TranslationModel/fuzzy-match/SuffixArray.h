@@ -1,7 +1,10 @@
 #include "Vocabulary.h"
+#include "util/mmap.hh"
 
 #pragma once
 
+#include <stdint.h>
+
 #define LINE_MAX_LENGTH 10000
 
 namespace tmmt
@@ -23,9 +26,20 @@ private:
   char *m_sentenceLength;
   WORD_ID m_endOfSentence;
   Vocabulary m_vcb;
+  // the words of the corpus by id. Fixed once the array is built, so that
+  // searches read them without taking the vocabulary lock
+  std::vector< const WORD* > m_words;
   INDEX m_size;
+  size_t m_sentenceCount;
+  util::scoped_memory m_mapped; // the index file, if it was loaded
+
+  bool Load(const std::string &fileName, uint64_t corpusBytes, uint64_t corpusMTime);
+  void Save(const std::string &fileName, uint64_t corpusBytes, uint64_t corpusMTime) const;
+  void StoreCorpusWords();
 
 public:
+  /** Loads the index from fileName.suffix-array if it was built from this
+   * corpus, otherwise builds it and writes it there */
   SuffixArray( std::string fileName );
   ~SuffixArray();
 
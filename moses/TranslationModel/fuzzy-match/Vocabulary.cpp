@@ -49,6 +49,11 @@ WORD_ID Vocabulary::StoreIfNew( const WORD& word )
 #ifdef WITH_THREADS
   boost::unique_lock<boost::shared_mutex> lock(m_accessLock);
 #endif
+  // another thread may have stored it since
+  map<WORD, WORD_ID>::iterator i = lookup.find( word );
+  if( i != lookup.end() )
+    return i->second;
+
   WORD_ID id = vocab.size();
   vocab.push_back( word );
   lookup[ word ] = id;
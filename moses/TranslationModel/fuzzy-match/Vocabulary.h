@@ -7,11 +7,13 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <string>
+#include <deque>
 #include <queue>
 #include <map>
 #include <cmath>
 
 #ifdef WITH_THREADS
+#include <boost/thread/locks.hpp>
 #include <boost/thread/shared_mutex.hpp>
 #endif
 
@@ -38,13 +40,16 @@ class Vocabulary
 {
 public:
   std::map<WORD, WORD_ID> lookup;
-  std::vector< WORD > vocab;
+  // a deque, so that words stay where they are while others are added
+  std::deque< WORD > vocab;
   WORD_ID StoreIfNew( const WORD& );
   WORD_ID GetWordID( const WORD& );
   std::vector<WORD_ID> Tokenize( const char[] );
-  inline WORD &GetWord( WORD_ID id ) const {
-    WORD &i = (WORD&) vocab[ id ];
-    return i;
+  inline const WORD &GetWord( WORD_ID id ) const {
+#ifdef WITH_THREADS
+    boost::shared_lock<boost::shared_mutex> read_lock(m_accessLock);
+#endif
+    return vocab[ id ];
   }
 
 protected:
@@ -1,5 +1,24 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
-void create_xml(const std::string &inPath);
+namespace tmmt
+{
+
+/** a target sentence of a translation memory entry that matches the input,
+ * with the edit path from the tm source to the input */
+struct MatchedSentence {
+  std::string source, target, alignment, path;
+  int count;
+};
+
+/** a line of the extract file: a hierarchical rule without its [X] labels */
+struct ExtractedRule {
+  std::string source, target, alignment;
+  int count;
+};
+
+}
+
+void create_xml(const std::string &input, const std::vector<tmmt::MatchedSentence> &matches, std::vector<tmmt::ExtractedRule> &rules);
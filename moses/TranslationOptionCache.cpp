@@ -0,0 +1,185 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2013 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <boost/functional/hash.hpp>
+
+#include "TranslationOptionCache.h"
+#include "TranslationOption.h"
+#include "TranslationOptionList.h"
+#include "SentenceArena.h"
+
+namespace Moses
+{
+
+namespace
+{
+// enough to keep threads apart without spreading small budgets too thin
+const size_t kNumShards = 64;
+
+size_t EstimateBytes(const TranslationOptionList &transOptList)
+{
+  size_t bytes = sizeof(TranslationOptionList);
+  TranslationOptionList::const_iterator iter;
+  for (iter = transOptList.begin(); iter != transOptList.end(); ++iter) {
+    const TranslationOption &transOpt = **iter;
+    const TargetPhrase &targetPhrase = transOpt.GetTargetPhrase();
+    bytes += sizeof(TranslationOption*) + sizeof(TranslationOption)
+             + (targetPhrase.GetSize() + targetPhrase.GetSourcePhrase().GetSize()) * sizeof(Word)
+             + targetPhrase.GetScoreBreakdown().Size() * sizeof(FValue);
+  }
+  return bytes;
+}
+}
+
+TranslationOptionCache::TranslationOptionCache(size_t maxEntries, size_t maxBytes)
+  : m_maxShardEntries(maxEntries ? (maxEntries + kNumShards - 1) / kNumShards : 0)
+  , m_maxShardBytes(maxBytes ? (maxBytes + kNumShards - 1) / kNumShards : 0)
+  , m_hits(0), m_misses(0)
+{
+  for (size_t i = 0; i < kNumShards; ++i) {
+    m_shards.push_back(new Shard);
+  }
+}
+
+TranslationOptionCache::~TranslationOptionCache()
+{
+  for (size_t i = 0; i < m_shards.size(); ++i) {
+    delete m_shards[i];
+  }
+}
+
+TranslationOptionCache::KeyRef TranslationOptionCache::MakeKeyRef(size_t decodeGraph, const std::string &weightSetting, const Phrase &sourcePhrase)
+{
+  KeyRef key;
+  key.decodeGraph = decodeGraph;
+  key.weightSetting = &weightSetting;
+  key.sourcePhrase = &sourcePhrase;
+  key.hash = hash_value(sourcePhrase);
+  boost::hash_combine(key.hash, decodeGraph);
+  boost::hash_combine(key.hash, weightSetting);
+  return key;
+}
+
+TranslationOptionCache::ListPtr TranslationOptionCache::Find(size_t decodeGraph, const std::string &weightSetting, const Phrase &sourcePhrase) const
+{
+  const KeyRef key = MakeKeyRef(decodeGraph, weightSetting, sourcePhrase);
+  Shard &shard = GetShard(key.hash);
+  {
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(shard.mutex);
+#endif
+    Index::iterator iter = shard.index.find(key, KeyHasher(), KeyEquals());
+    if (iter != shard.index.end()) {
+      // move to the front of the LRU list
+      shard.entries.splice(shard.entries.begin(), shard.entries, iter->second);
+      ++m_hits;
+      return iter->second->transOptList;
+    }
+  }
+  ++m_misses;
+  return ListPtr();
+}
+
+void TranslationOptionCache::Add(size_t decodeGraph, const std::string &weightSetting, const Phrase &sourcePhrase, const TranslationOptionList &transOptList)
+{
+  if (m_maxShardEntries == 0 && m_maxShardBytes == 0) return;
+
+  // copy outside the lock. the cache outlives the sentence, so the options
+  // have to live on the heap
+  Entry entry;
+  {
+    SentenceArena::Scope heapScope(NULL);
+    entry.transOptList.reset(new TranslationOptionList(transOptList));
+  }
+  entry.bytes = EstimateBytes(transOptList) + sizeof(Entry) + sourcePhrase.GetSize() * sizeof(Word);
+  const KeyRef keyRef = MakeKeyRef(decodeGraph, weightSetting, sourcePhrase);
+  entry.key.decodeGraph = decodeGraph;
+  entry.key.weightSetting = weightSetting;
+  entry.key.sourcePhrase = sourcePhrase;
+  entry.key.hash = keyRef.hash;
+
+  Shard &shard = GetShard(keyRef.hash);
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(shard.mutex);
+#endif
+  Index::iterator iter = shard.index.find(keyRef, KeyHasher(), KeyEquals());
+  if (iter != shard.index.end()) {
+    // another thread got there first, keep the newer copy
+    shard.bytes -= iter->second->bytes;
+    shard.entries.erase(iter->second);
+    shard.index.erase(iter);
+  }
+  shard.entries.push_front(entry);
+  shard.index[entry.key] = shard.entries.begin();
+  shard.bytes += entry.bytes;
+  Evict(shard);
+}
+
+void TranslationOptionCache::Evict(Shard &shard)
+{
+  while (!shard.entries.empty()
+         && ((m_maxShardEntries && shard.index.size() > m_maxShardEntries)
+             || (m_maxShardBytes && shard.bytes > m_maxShardBytes))) {
+    Entry &victim = shard.entries.back();
+    shard.bytes -= victim.bytes;
+    shard.index.erase(victim.key);
+    shard.entries.pop_back();
+  }
+}
+
+void TranslationOptionCache::Clear()
+{
+  for (size_t i = 0; i < m_shards.size(); ++i) {
+    Shard &shard = *m_shards[i];
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(shard.mutex);
+#endif
+    shard.index.clear();
+    shard.entries.clear();
+    shard.bytes = 0;
+  }
+}
+
+size_t TranslationOptionCache::GetSize() const
+{
+  size_t size = 0;
+  for (size_t i = 0; i < m_shards.size(); ++i) {
+    Shard &shard = *m_shards[i];
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(shard.mutex);
+#endif
+    size += shard.index.size();
+  }
+  return size;
+}
+
+size_t TranslationOptionCache::GetMemoryUse() const
+{
+  size_t bytes = 0;
+  for (size_t i = 0; i < m_shards.size(); ++i) {
+    Shard &shard = *m_shards[i];
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(shard.mutex);
+#endif
+    bytes += shard.bytes;
+  }
+  return bytes;
+}
+
+}
@@ -0,0 +1,158 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2013 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#ifndef moses_TranslationOptionCache_h
+#define moses_TranslationOptionCache_h
+
+#include <list>
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/detail/atomic_count.hpp>
+
+#ifdef WITH_THREADS
+#include <boost/thread/mutex.hpp>
+#endif
+
+#include "Phrase.h"
+
+namespace Moses
+{
+
+class TranslationOptionList;
+
+/** Persistent (cross-sentence) cache of translation options, keyed by
+ * decode graph, weight setting and source phrase.
+ *
+ * Entries are spread over independently locked shards by the hash of their
+ * key, so decoding threads rarely wait for each other. Each shard keeps its
+ * entries in least recently used order; eviction drops entries from the
+ * tail until the shard is within its share of the entry and byte limits.
+ * Lists are handed out by shared pointer, so an entry evicted by one
+ * thread stays valid for threads still copying from it.
+ */
+class TranslationOptionCache
+{
+public:
+  typedef boost::shared_ptr<const TranslationOptionList> ListPtr;
+
+  /** \param maxEntries maximum number of source phrases, 0 for no limit
+   *  \param maxBytes approximate memory budget, 0 for no limit
+   */
+  TranslationOptionCache(size_t maxEntries, size_t maxBytes);
+  ~TranslationOptionCache();
+
+  //! cached options, or an empty pointer on a miss
+  ListPtr Find(size_t decodeGraph, const std::string &weightSetting, const Phrase &sourcePhrase) const;
+
+  //! store a copy of transOptList, replacing an existing entry
+  void Add(size_t decodeGraph, const std::string &weightSetting, const Phrase &sourcePhrase, const TranslationOptionList &transOptList);
+
+  void Clear();
+
+  size_t GetHits() const {
+    return m_hits;
+  }
+  size_t GetMisses() const {
+    return m_misses;
+  }
+  //! number of cached source phrases
+  size_t GetSize() const;
+  //! approximate memory used by the cached options
+  size_t GetMemoryUse() const;
+
+private:
+  struct Key {
+    size_t decodeGraph;
+    std::string weightSetting;
+    Phrase sourcePhrase;
+    size_t hash;
+  };
+
+  //! lookup key that refers to the caller's data instead of copying it
+  struct KeyRef {
+    size_t decodeGraph;
+    const std::string *weightSetting;
+    const Phrase *sourcePhrase;
+    size_t hash;
+  };
+
+  struct KeyHasher {
+    size_t operator()(const Key &key) const {
+      return key.hash;
+    }
+    size_t operator()(const KeyRef &key) const {
+      return key.hash;
+    }
+  };
+
+  struct KeyEquals {
+    bool operator()(const Key &a, const Key &b) const {
+      return a.hash == b.hash && a.decodeGraph == b.decodeGraph
+             && a.weightSetting == b.weightSetting && a.sourcePhrase == b.sourcePhrase;
+    }
+    bool operator()(const KeyRef &a, const Key &b) const {
+      return a.hash == b.hash && a.decodeGraph == b.decodeGraph
+             && *a.weightSetting == b.weightSetting && *a.sourcePhrase == b.sourcePhrase;
+    }
+  };
+
+  struct Entry {
+    Key key;
+    ListPtr transOptList;
+    size_t bytes;
+  };
+
+  //! most recently used entry at the front
+  typedef std::list<Entry> LRUList;
+  typedef boost::unordered_map<Key, LRUList::iterator, KeyHasher, KeyEquals> Index;
+
+  struct Shard {
+    Shard() : bytes(0) {}
+#ifdef WITH_THREADS
+    boost::mutex mutex;
+#endif
+    LRUList entries;
+    Index index;
+    size_t bytes;
+  };
+
+  std::vector<Shard*> m_shards;
+  size_t m_maxShardEntries, m_maxShardBytes;
+  mutable boost::detail::atomic_count m_hits, m_misses;
+
+  static KeyRef MakeKeyRef(size_t decodeGraph, const std::string &weightSetting, const Phrase &sourcePhrase);
+
+  Shard &GetShard(size_t hash) const {
+    return *m_shards[hash % m_shards.size()];
+  }
+
+  //! drop least recently used entries. caller holds the shard lock
+  void Evict(Shard &shard);
+
+  // no copying
+  TranslationOptionCache(const TranslationOptionCache &);
+  void operator=(const TranslationOptionCache &);
+};
+
+}
+
+#endif
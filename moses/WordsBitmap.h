@@ -22,6 +22,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #ifndef moses_WordsBitmap_h
 #define moses_WordsBitmap_h
 
+#include <algorithm>
 #include <limits>
 #include <vector>
 #include <iostream>
@@ -30,35 +31,100 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <cstdlib>
 #include "TypeDef.h"
 #include "WordsRange.h"
+#include "util/murmur_hash.hh"
 
 namespace Moses
 {
 typedef unsigned long WordsBitmapID;
 
-/** vector of boolean used to represent whether a word has been translated or not
+/** vector of boolean used to represent whether a word has been translated or not.
+ *  Stored as 64-bit blocks, first word in the most significant bit, so that
+ *  gaps and edges are found with bit scans and overlap is a mask test.
+ *  Bitmaps of up to INLINE_BLOCKS * 64 words need no allocation.
 */
 class WordsBitmap
 {
   friend std::ostream& operator<<(std::ostream& out, const WordsBitmap& wordsBitmap);
 protected:
+  typedef uint64_t Block;
+  static const size_t BLOCK_BITS = 64;
+  static const size_t INLINE_BLOCKS = 2;
+
   const size_t m_size; /**< number of words in sentence */
-  bool	*m_bitmap;	/**< ticks of words that have been done */
+  size_t m_numWordsCovered; /**< number of bits set, kept up to date by SetValue() */
+  Block	*m_bitmap;	/**< ticks of words that have been done, points to m_inline for short sentences */
+  Block m_inline[INLINE_BLOCKS];
 
   WordsBitmap(); // not implemented
 
+  size_t GetNumBlocks() const {
+    return (m_size + BLOCK_BITS - 1) / BLOCK_BITS;
+  }
+
+  //! bit of a position within its block
+  static Block GetBit(size_t pos) {
+    return Block(1) << (BLOCK_BITS - 1 - pos % BLOCK_BITS);
+  }
+
+  //! bits of positions startPos to endPos (inclusive) of block block
+  static Block GetMask(size_t block, size_t startPos, size_t endPos) {
+    const size_t first = (startPos > block * BLOCK_BITS) ? startPos - block * BLOCK_BITS : 0;
+    const size_t last = std::min(endPos - block * BLOCK_BITS, BLOCK_BITS - 1);
+    return (~Block(0) >> first) & (~Block(0) << (BLOCK_BITS - 1 - last));
+  }
+
+  //! bits of the positions of block block that are in the sentence
+  Block GetValidMask(size_t block) const {
+    return GetMask(block, 0, m_size - 1);
+  }
+
+  //! index of the most significant set bit, i.e. the first position set
+  static size_t FirstSet(Block block) {
+#ifdef __GNUC__
+    return __builtin_clzll(block);
+#else
+    size_t ret = 0;
+    for (; !(block & (Block(1) << (BLOCK_BITS - 1))); block <<= 1) ++ret;
+    return ret;
+#endif
+  }
+  //! index of the least significant set bit, i.e. the last position set
+  static size_t LastSet(Block block) {
+#ifdef __GNUC__
+    return BLOCK_BITS - 1 - __builtin_ctzll(block);
+#else
+    size_t ret = BLOCK_BITS - 1;
+    for (; !(block & 1); block >>= 1) --ret;
+    return ret;
+#endif
+  }
+  static size_t CountSet(Block block) {
+#ifdef __GNUC__
+    return __builtin_popcountll(block);
+#else
+    size_t ret = 0;
+    for (; block; block &= block - 1) ++ret;
+    return ret;
+#endif
+  }
+
+  void Allocate() {
+    const size_t numBlocks = GetNumBlocks();
+    m_bitmap = (numBlocks <= INLINE_BLOCKS) ? m_inline : (Block*) malloc(sizeof(Block) * numBlocks);
+  }
+
   //! set all elements to false
   void Initialize() {
-    for (size_t pos = 0 ; pos < m_size ; pos++) {
-      m_bitmap[pos] = false;
-    }
+    std::memset(m_bitmap, 0, sizeof(Block) * GetNumBlocks());
+    m_numWordsCovered = 0;
   }
 
   //sets elements by vector
   void Initialize(std::vector<bool> vector) {
-    size_t vector_size = vector.size();
-    for (size_t pos = 0 ; pos < m_size ; pos++) {
-      if (pos < vector_size && vector[pos] == true) m_bitmap[pos] = true;
-      else m_bitmap[pos] = false;
+    Initialize();
+    size_t vector_size = std::min(vector.size(), m_size);
+    for (size_t pos = 0 ; pos < vector_size ; pos++) {
+      if (vector[pos] == true) SetValue(pos, true);
     }
   }
 
@@ -67,41 +133,38 @@ public:
   //! create WordsBitmap of length size and initialise with vector
   WordsBitmap(size_t size, std::vector<bool> initialize_vector)
     :m_size	(size) {
-    m_bitmap = (bool*) malloc(sizeof(bool) * size);
+    Allocate();
     Initialize(initialize_vector);
   }
   //! create WordsBitmap of length size and initialise
   WordsBitmap(size_t size)
     :m_size	(size) {
-    m_bitmap = (bool*) malloc(sizeof(bool) * size);
+    Allocate();
     Initialize();
   }
   //! deep copy
   WordsBitmap(const WordsBitmap &copy)
-    :m_size	(copy.m_size) {
-    m_bitmap = (bool*) malloc(sizeof(bool) * m_size);
-    for (size_t pos = 0 ; pos < copy.m_size ; pos++) {
-      m_bitmap[pos] = copy.GetValue(pos);
-    }
+    :m_size	(copy.m_size)
+    ,m_numWordsCovered(copy.m_numWordsCovered) {
+    Allocate();
+    std::memcpy(m_bitmap, copy.m_bitmap, sizeof(Block) * GetNumBlocks());
   }
   ~WordsBitmap() {
-    free(m_bitmap);
+    if (m_bitmap != m_inline)
+      free(m_bitmap);
   }
   //! count of words translated
   size_t GetNumWordsCovered() const {
-    size_t count = 0;
-    for (size_t pos = 0 ; pos < m_size ; pos++) {
-      if (m_bitmap[pos])
-        count++;
-    }
-    return count;
+    return m_numWordsCovered;
   }
 
   //! position of 1st word not yet translated, or NOT_FOUND if everything already translated
   size_t GetFirstGapPos() const {
-    for (size_t pos = 0 ; pos < m_size ; pos++) {
-      if (!m_bitmap[pos]) {
-        return pos;
+    const size_t numBlocks = GetNumBlocks();
+    for (size_t block = 0 ; block < numBlocks ; block++) {
+      Block gaps = ~m_bitmap[block] & GetValidMask(block);
+      if (gaps) {
+        return block * BLOCK_BITS + FirstSet(gaps);
       }
     }
     // no starting pos
@@ -111,9 +174,10 @@ public:
 
   //! position of last word not yet translated, or NOT_FOUND if everything already translated
   size_t GetLastGapPos() const {
-    for (int pos = (int) m_size - 1 ; pos >= 0 ; pos--) {
-      if (!m_bitmap[pos]) {
-        return pos;
+    for (size_t block = GetNumBlocks() ; block-- > 0 ; ) {
+      Block gaps = ~m_bitmap[block] & GetValidMask(block);
+      if (gaps) {
+        return block * BLOCK_BITS + LastSet(gaps);
       }
     }
     // no starting pos
@@ -123,9 +187,9 @@ public:
 
   //! position of last translated word
   size_t GetLastPos() const {
-    for (int pos = (int) m_size - 1 ; pos >= 0 ; pos--) {
-      if (m_bitmap[pos]) {
-        return pos;
+    for (size_t block = GetNumBlocks() ; block-- > 0 ; ) {
+      if (m_bitmap[block]) {
+        return block * BLOCK_BITS + LastSet(m_bitmap[block]);
       }
     }
     // no starting pos
@@ -134,16 +198,26 @@ public:
 
   //! whether a word has been translated at a particular position
   bool GetValue(size_t pos) const {
-    return m_bitmap[pos];
+    return (m_bitmap[pos / BLOCK_BITS] & GetBit(pos)) != 0;
   }
   //! set value at a particular position
   void SetValue( size_t pos, bool value ) {
-    m_bitmap[pos] = value;
+    if (GetValue(pos) == value) return;
+    m_bitmap[pos / BLOCK_BITS] ^= GetBit(pos);
+    if (value) ++m_numWordsCovered;
+    else --m_numWordsCovered;
   }
   //! set value between 2 positions, inclusive
   void SetValue( size_t startPos, size_t endPos, bool value ) {
-    for(size_t pos = startPos ; pos <= endPos ; pos++) {
-      m_bitmap[pos] = value;
+    for (size_t block = startPos / BLOCK_BITS ; block <= endPos / BLOCK_BITS ; block++) {
+      const Block mask = GetMask(block, startPos, endPos);
+      if (value) {
+        m_numWordsCovered += CountSet(mask & ~m_bitmap[block]);
+        m_bitmap[block] |= mask;
+      } else {
+        m_numWordsCovered -= CountSet(mask & m_bitmap[block]);
+        m_bitmap[block] &= ~mask;
+      }
     }
   }
   //! whether every word has been translated
@@ -152,8 +226,9 @@ public:
   }
   //! whether the wordrange overlaps with any translated word in this bitmap
   bool Overlap(const WordsRange &compare) const {
-    for (size_t pos = compare.GetStartPos() ; pos <= compare.GetEndPos() ; pos++) {
-      if (m_bitmap[pos])
+    const size_t startPos = compare.GetStartPos(), endPos = compare.GetEndPos();
+    for (size_t block = startPos / BLOCK_BITS ; block <= endPos / BLOCK_BITS ; block++) {
+      if (m_bitmap[block] & GetMask(block, startPos, endPos))
         return true;
     }
     return false;
@@ -163,7 +238,7 @@ public:
     return m_size;
   }
 
-  //! transitive comparison of WordsBitmap
+  //! transitive comparison of WordsBitmap, same order as comparing the words one by one
   inline int Compare (const WordsBitmap &compare) const {
     // -1 = less than
     // +1 = more than
@@ -175,27 +250,47 @@ public:
     if (thisSize != compareSize) {
       return (thisSize < compareSize) ? -1 : 1;
     }
-    return std::memcmp(m_bitmap, compare.m_bitmap, thisSize * sizeof(bool));
+    const size_t numBlocks = GetNumBlocks();
+    for (size_t block = 0 ; block < numBlocks ; block++) {
+      if (m_bitmap[block] != compare.m_bitmap[block]) {
+        return (m_bitmap[block] < compare.m_bitmap[block]) ? -1 : 1;
+      }
+    }
+    return 0;
   }
 
   bool operator< (const WordsBitmap &compare) const {
     return Compare(compare) < 0;
   }
 
+  //! hash consistent with Compare()
+  size_t Hash() const {
+    return util::MurmurHashNative(m_bitmap, GetNumBlocks() * sizeof(Block), m_size);
+  }
+
+  //! one past the last translated word left of l, or 0
   inline size_t GetEdgeToTheLeftOf(size_t l) const {
     if (l == 0) return l;
-    while (l && !m_bitmap[l-1]) {
-      --l;
+    for (size_t block = (l - 1) / BLOCK_BITS + 1 ; block-- > 0 ; ) {
+      Block covered = m_bitmap[block] & GetMask(block, 0, l - 1);
+      if (covered) {
+        return block * BLOCK_BITS + LastSet(covered) + 1;
+      }
     }
-    return l;
+    return 0;
   }
 
+  //! one before the first translated word right of r, or the last position
   inline size_t GetEdgeToTheRightOf(size_t r) const {
-    if (r+1 == m_size) return r;
-    while (r+1 < m_size && !m_bitmap[r+1]) {
-      ++r;
+    if (r+1 >= m_size) return r;
+    const size_t numBlocks = GetNumBlocks();
+    for (size_t block = (r + 1) / BLOCK_BITS ; block < numBlocks ; block++) {
+      Block covered = m_bitmap[block] & GetMask(block, r + 1, m_size - 1);
+      if (covered) {
+        return block * BLOCK_BITS + FirstSet(covered) - 1;
+      }
     }
-    return r;
+    return m_size - 1;
   }
 
 
@@ -249,7 +344,7 @@ public:
 // friend
 inline std::ostream& operator<<(std::ostream& out, const WordsBitmap& wordsBitmap)
 {
-  for (size_t i = 0 ; i < wordsBitmap.m_size ; i++) {
+  for (size_t i = 0 ; i < wordsBitmap.GetSize() ; i++) {
     out << (wordsBitmap.GetValue(i) ? 1 : 0);
   }
   return out;
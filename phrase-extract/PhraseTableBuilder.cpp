@@ -0,0 +1,793 @@
+/***********************************************************************
+  Moses - factored phrase-based language decoder
+  Copyright (C) 2013- University of Edinburgh
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ ***********************************************************************/
+
+#include "PhraseTableBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <sstream>
+
+#include "util/stream/chain.hh"
+#include "util/stream/sort.hh"
+#include "util/stream/stream.hh"
+
+#include "moses/ThreadPool.h"
+
+#include "InputFileStream.h"
+#include "OutputFileStream.h"
+#include "SentenceAlignment.h"
+
+using namespace std;
+
+namespace MosesTraining
+{
+
+const char SortedVocabulary::kPhraseEnd[] = "|||";
+const WORD_ID SortedVocabulary::kNotFound;
+
+void SortedVocabulary::AddWords(const string &line)
+{
+  vector<string> words = tokenize(line.c_str());
+  for (size_t i = 0; i < words.size(); ++i) {
+    m_lookup.insert(make_pair(words[i], 0));
+  }
+}
+
+void SortedVocabulary::Finish()
+{
+  m_lookup.insert(make_pair(string(kPhraseEnd), 0));
+  m_words.clear();
+  m_words.reserve(m_lookup.size());
+  for (boost::unordered_map<string, WORD_ID>::const_iterator i = m_lookup.begin(); i != m_lookup.end(); ++i) {
+    m_words.push_back(i->first);
+  }
+  // std::string compares as unsigned char, as LC_ALL=C sort does
+  sort(m_words.begin(), m_words.end());
+  for (size_t i = 0; i < m_words.size(); ++i) {
+    m_lookup[m_words[i]] = i;
+  }
+  m_phraseEnd = m_lookup[kPhraseEnd];
+}
+
+PhrasePairLayout::PhrasePairLayout(int maxPhraseLength, bool scored)
+  : maxPhraseLength(maxPhraseLength)
+{
+  count = 0;
+  if (scored) {
+    sourceCount = count + sizeof(float);
+    targetCount = sourceCount + sizeof(float);
+    lexDirect = targetCount + sizeof(float);
+    lexInverse = lexDirect + sizeof(float);
+    source = lexInverse + sizeof(float);
+  } else {
+    sourceCount = targetCount = lexDirect = lexInverse = 0;
+    source = count + sizeof(float);
+  }
+  target = source + (maxPhraseLength + 1) * sizeof(WORD_ID);
+  alignment = target + (maxPhraseLength + 1) * sizeof(WORD_ID);
+  alignment = (alignment + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t);
+  alignmentWords = (maxPhraseLength * maxPhraseLength + 63) / 64;
+  size = alignment + alignmentWords * sizeof(uint64_t);
+}
+
+void LexicalWeights::Load(const string &fileName, const SortedVocabulary &vcbS, const SortedVocabulary &vcbT)
+{
+  cerr << "Loading lexical translation table from " << fileName;
+  Moses::InputFileStream inFile(fileName);
+  if (inFile.fail()) {
+    cerr << " - ERROR: could not open file\n";
+    exit(1);
+  }
+
+  // NULL is not a word of the corpus, but it may be one
+  m_null = vcbS.GetWordID("NULL");
+
+  string line;
+  for (size_t i = 1; getline(inFile, line); ++i) {
+    vector<string> token = tokenize(line.c_str());
+    if (token.size() != 3) {
+      cerr << "line " << i << " in " << fileName
+           << " has wrong number of tokens, skipping:\n"
+           << token.size() << " " << line << endl;
+      continue;
+    }
+    // words not in the corpus do not matter
+    WORD_ID wordT = vcbT.GetWordID(token[0]);
+    WORD_ID wordS = token[1] == "NULL" ? m_null : vcbS.GetWordID(token[1]);
+    if (wordT == SortedVocabulary::kNotFound ||
+        (wordS == SortedVocabulary::kNotFound && token[1] != "NULL")) {
+      continue;
+    }
+    m_table[Key(wordS, wordT)] = atof(token[2].c_str());
+  }
+  cerr << endl;
+}
+
+void ExtractPhrasePairs(const SentenceAlignment &sentence,
+                        const vector<WORD_ID> &source, WORD_ID sourceEnd,
+                        const vector<WORD_ID> &target, WORD_ID targetEnd,
+                        const PhrasePairLayout &layout, vector<uint8_t> &records)
+{
+  const int maxPhraseLength = layout.maxPhraseLength;
+  const int countE = target.size();
+  const int countF = source.size();
+
+  // loop over extracted phrases which are compatible with the word-alignments
+  for(int startE=0; startE<countE; startE++) {
+    for(int endE=startE; endE<countE && endE<startE+maxPhraseLength; endE++) {
+
+      int minF = 9999;
+      int maxF = -1;
+      vector< int > usedF = sentence.alignedCountS;
+      for(int ei=startE; ei<=endE; ei++) {
+        for(size_t i=0; i<sentence.alignedToT[ei].size(); i++) {
+          int fi = sentence.alignedToT[ei][i];
+          minF = min(minF, fi);
+          maxF = max(maxF, fi);
+          usedF[ fi ]--;
+        }
+      }
+
+      if (maxF < 0 || maxF-minF >= maxPhraseLength) {
+        continue;
+      }
+
+      // check if source words are aligned to out of bound target words
+      bool out_of_bounds = false;
+      for(int fi=minF; fi<=maxF && !out_of_bounds; fi++) {
+        out_of_bounds = usedF[fi]>0;
+      }
+      if (out_of_bounds) {
+        continue;
+      }
+
+      // start point of source phrase may retreat over unaligned
+      for(int startF=minF;
+          (startF>=0 &&
+           startF>maxF-maxPhraseLength && // within length limit
+           (startF==minF || sentence.alignedCountS[startF]==0)); // unaligned
+          startF--) {
+        // end point of source phrase may advance over unaligned
+        for(int endF=maxF;
+            (endF<countF &&
+             endF<startF+maxPhraseLength && // within length limit
+             (endF==maxF || sentence.alignedCountS[endF]==0)); // unaligned
+            endF++) {
+          const size_t offset = records.size();
+          records.resize(offset + layout.size);
+          uint8_t *record = &records[offset];
+
+          *reinterpret_cast<float*>(record + layout.count) = 1.0f;
+          WORD_ID *phraseS = reinterpret_cast<WORD_ID*>(record + layout.source);
+          fill(copy(source.begin() + startF, source.begin() + endF + 1, phraseS),
+               phraseS + maxPhraseLength + 1, sourceEnd);
+          WORD_ID *phraseT = reinterpret_cast<WORD_ID*>(record + layout.target);
+          fill(copy(target.begin() + startE, target.begin() + endE + 1, phraseT),
+               phraseT + maxPhraseLength + 1, targetEnd);
+
+          uint64_t *alignment = reinterpret_cast<uint64_t*>(record + layout.alignment);
+          for(int ei=startE; ei<=endE; ei++) {
+            for(size_t i=0; i<sentence.alignedToT[ei].size(); i++) {
+              size_t bit = (ei-startE) * maxPhraseLength + sentence.alignedToT[ei][i] - startF;
+              alignment[bit / 64] |= static_cast<uint64_t>(1) << (bit % 64);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+}
+
+namespace
+{
+
+using namespace MosesTraining;
+
+const size_t kSentencesPerTask = 512;
+const size_t kTasksPerThread = 4;
+
+template <class T> T &Field(void *record, size_t offset)
+{
+  return *reinterpret_cast<T*>(static_cast<uint8_t*>(record) + offset);
+}
+
+template <class T> const T &Field(const void *record, size_t offset)
+{
+  return *reinterpret_cast<const T*>(static_cast<const uint8_t*>(record) + offset);
+}
+
+size_t PhraseLength(const WORD_ID *phrase, size_t maxPhraseLength, WORD_ID phraseEnd)
+{
+  return find(phrase, phrase + maxPhraseLength, phraseEnd) - phrase;
+}
+
+bool IsAligned(const uint64_t *alignment, size_t maxPhraseLength, size_t ti, size_t si)
+{
+  size_t bit = ti * maxPhraseLength + si;
+  return (alignment[bit / 64] >> (bit % 64)) & 1;
+}
+
+/**
+ * The alignment as extract writes it, " s-t" for each point by target and
+ * then source position, or " t-s" in the inverse extract file.
+ */
+string AlignmentString(const uint64_t *alignment, size_t maxPhraseLength,
+                       size_t sourceLength, size_t targetLength, bool inverse)
+{
+  ostringstream out;
+  for (size_t ti = 0; ti < targetLength; ++ti) {
+    for (size_t si = 0; si < sourceLength; ++si) {
+      if (IsAligned(alignment, maxPhraseLength, ti, si)) {
+        if (inverse) {
+          out << " " << ti << "-" << si;
+        } else {
+          out << " " << si << "-" << ti;
+        }
+      }
+    }
+  }
+  return out.str();
+}
+
+//! orders records by source and target phrase, or by target and source phrase
+class PhraseOrder : public std::binary_function<const void *, const void *, bool>
+{
+public:
+  PhraseOrder(const PhrasePairLayout &layout, bool targetFirst)
+    : m_first(targetFirst ? layout.target : layout.source),
+      m_second(targetFirst ? layout.source : layout.target),
+      m_length(layout.maxPhraseLength + 1) {}
+
+  bool operator()(const void *lhs, const void *rhs) const {
+    int compare = Compare(lhs, rhs, m_first);
+    if (compare) {
+      return compare < 0;
+    }
+    return Compare(lhs, rhs, m_second) < 0;
+  }
+
+  //! same phrase in the first position
+  bool SameFirst(const void *lhs, const void *rhs) const {
+    return Compare(lhs, rhs, m_first) == 0;
+  }
+
+private:
+  int Compare(const void *lhs, const void *rhs, size_t offset) const {
+    const WORD_ID *l = &Field<WORD_ID>(lhs, offset);
+    const WORD_ID *r = &Field<WORD_ID>(rhs, offset);
+    for (size_t i = 0; i < m_length; ++i) {
+      if (l[i] != r[i]) {
+        return l[i] < r[i] ? -1 : 1;
+      }
+    }
+    return 0;
+  }
+
+  size_t m_first, m_second, m_length;
+};
+
+//! sum the counts of records with the same phrases and alignment
+class AddCount
+{
+public:
+  explicit AddCount(const PhrasePairLayout &layout) : m_layout(layout) {}
+
+  bool operator()(void *into, const void *option, const PhraseOrder &) const {
+    if (memcmp(static_cast<uint8_t*>(into) + m_layout.KeyBegin(),
+               static_cast<const uint8_t*>(option) + m_layout.KeyBegin(),
+               m_layout.KeyEnd() - m_layout.KeyBegin())) {
+      return false;
+    }
+    Field<float>(into, m_layout.count) += Field<float>(option, m_layout.count);
+    return true;
+  }
+
+private:
+  PhrasePairLayout m_layout;
+};
+
+//! extract the phrase pairs of some sentences
+class ExtractTask : public Moses::Task
+{
+public:
+  ExtractTask(const vector<string> &lines, size_t begin, size_t end, size_t firstId,
+              const SortedVocabulary &vcbS, const SortedVocabulary &vcbT,
+              const PhrasePairLayout &layout, vector<uint8_t> &records)
+    : m_lines(lines), m_begin(begin), m_end(end), m_firstId(firstId),
+      m_vcbS(vcbS), m_vcbT(vcbT), m_layout(layout), m_records(records) {}
+
+  virtual void Run() {
+    m_records.clear();
+    vector<WORD_ID> source, target;
+    for (size_t i = m_begin; i < m_end; ++i) {
+      vector<char> englishString(m_lines[3*i].begin(), m_lines[3*i].end());
+      vector<char> foreignString(m_lines[3*i+1].begin(), m_lines[3*i+1].end());
+      vector<char> alignmentString(m_lines[3*i+2].begin(), m_lines[3*i+2].end());
+      englishString.push_back('\0');
+      foreignString.push_back('\0');
+      alignmentString.push_back('\0');
+      char weightString[] = "";
+
+      SentenceAlignment sentence;
+      if (!sentence.create(&englishString[0], &foreignString[0], &alignmentString[0],
+                           weightString, static_cast<int>(m_firstId + (i - m_begin)), false)) {
+        continue;
+      }
+      source.resize(sentence.source.size());
+      for (size_t j = 0; j < source.size(); ++j) {
+        source[j] = m_vcbS.GetWordID(sentence.source[j]);
+      }
+      target.resize(sentence.target.size());
+      for (size_t j = 0; j < target.size(); ++j) {
+        target[j] = m_vcbT.GetWordID(sentence.target[j]);
+      }
+      ExtractPhrasePairs(sentence, source, m_vcbS.GetPhraseEnd(),
+                         target, m_vcbT.GetPhraseEnd(), m_layout, m_records);
+    }
+  }
+
+private:
+  const vector<string> &m_lines;
+  size_t m_begin, m_end, m_firstId;
+  const SortedVocabulary &m_vcbS, &m_vcbT;
+  const PhrasePairLayout &m_layout;
+  vector<uint8_t> &m_records;
+};
+
+/**
+ * Reads the corpus in batches, extracts the phrase pairs of each batch with
+ * the tasks of a pool and streams the records out in corpus order.
+ */
+class ExtractSentences
+{
+public:
+  ExtractSentences(const string &fileNameE, const string &fileNameF, const string &fileNameA,
+                   const SortedVocabulary &vcbS, const SortedVocabulary &vcbT,
+                   const PhrasePairLayout &layout, Moses::ThreadPool *pool, size_t threads)
+    : m_fileNameE(fileNameE), m_fileNameF(fileNameF), m_fileNameA(fileNameA),
+      m_vcbS(&vcbS), m_vcbT(&vcbT), m_layout(layout), m_pool(pool),
+      m_tasks(threads * kTasksPerThread) {}
+
+  void Run(const util::stream::ChainPosition &position) {
+    Moses::InputFileStream eFile(m_fileNameE);
+    Moses::InputFileStream fFile(m_fileNameF);
+    Moses::InputFileStream aFile(m_fileNameA);
+
+    util::stream::Stream out(position);
+    vector<string> lines(3 * kSentencesPerTask * m_tasks);
+    vector<vector<uint8_t> > records(m_tasks);
+    size_t sentenceId = 1;
+    while (true) {
+      size_t read = 0;
+      for (; read < lines.size() / 3; ++read) {
+        if (!getline(eFile, lines[3*read])) {
+          break;
+        }
+        if (!getline(fFile, lines[3*read+1]) || !getline(aFile, lines[3*read+2])) {
+          cerr << "ERROR: the source and alignment files have fewer lines than " << m_fileNameE << endl;
+          exit(1);
+        }
+      }
+      if (!read) {
+        break;
+      }
+
+      {
+        Moses::TaskGroup group(m_pool);
+        for (size_t t = 0; t * kSentencesPerTask < read; ++t) {
+          size_t begin = t * kSentencesPerTask;
+          size_t end = min(read, begin + kSentencesPerTask);
+          group.Spawn(new ExtractTask(lines, begin, end, sentenceId + begin,
+                                      *m_vcbS, *m_vcbT, m_layout, records[t]));
+        }
+      }
+      for (size_t t = 0; t * kSentencesPerTask < read; ++t) {
+        for (size_t offset = 0; offset < records[t].size(); offset += m_layout.size) {
+          memcpy(out.Get(), &records[t][offset], m_layout.size);
+          ++out;
+        }
+      }
+
+      if (sentenceId / 10000 != (sentenceId + read) / 10000) cerr << "." << flush;
+      sentenceId += read;
+    }
+    out.Poison();
+    cerr << endl;
+  }
+
+private:
+  string m_fileNameE, m_fileNameF, m_fileNameA;
+  const SortedVocabulary *m_vcbS, *m_vcbT;
+  PhrasePairLayout m_layout;
+  Moses::ThreadPool *m_pool;
+  size_t m_tasks;
+};
+
+/**
+ * Takes the extracted phrase pairs in source order and writes one scored
+ * record for each distinct phrase pair: its count, the count of its source
+ * phrase and both lexical weights. The alignment of a phrase pair, for the
+ * output and for lex(e|f), is its most frequent one, the first in the
+ * order of the extract file on ties; lex(f|e) uses the most frequent one
+ * that comes last in the inverse extract file, as score --Inverse does.
+ */
+class ScorePhrasePairs
+{
+public:
+  ScorePhrasePairs(const PhrasePairLayout &in, const PhrasePairLayout &out,
+                   const util::stream::ChainPosition &output,
+                   const SortedVocabulary &vcbS, const SortedVocabulary &vcbT,
+                   const LexicalWeights *lexF2E, const LexicalWeights *lexE2F, bool logProb)
+    : m_in(in), m_out(out), m_output(output), m_sourceEnd(vcbS.GetPhraseEnd()),
+      m_targetEnd(vcbT.GetPhraseEnd()), m_lexF2E(lexF2E), m_lexE2F(lexE2F), m_logProb(logProb) {}
+
+  void Run(const util::stream::ChainPosition &position) {
+    util::stream::Stream out(m_output);
+    const size_t words = 2 * (m_in.maxPhraseLength + 1);
+    for (util::stream::Stream in(position); in; ++in) {
+      const WORD_ID *phrases = &Field<WORD_ID>(in.Get(), m_in.source);
+      if (!m_counts.empty() && !equal(phrases, phrases + words, m_phrases.begin())) {
+        AddPhrasePair();
+        if (!equal(phrases, phrases + m_in.maxPhraseLength + 1, m_phrases.begin())) {
+          Flush(out);
+        }
+      }
+      if (m_counts.empty()) {
+        m_phrases.assign(phrases, phrases + words);
+      }
+
+      // distinct alignments of the phrase pair are few
+      const uint64_t *alignment = &Field<uint64_t>(in.Get(), m_in.alignment);
+      size_t i = 0;
+      for (; i < m_counts.size(); ++i) {
+        if (equal(alignment, alignment + m_in.alignmentWords, m_alignments.begin() + i * m_in.alignmentWords)) {
+          break;
+        }
+      }
+      if (i == m_counts.size()) {
+        m_alignments.insert(m_alignments.end(), alignment, alignment + m_in.alignmentWords);
+        m_counts.push_back(0.0f);
+      }
+      m_counts[i] += Field<float>(in.Get(), m_in.count);
+    }
+    if (!m_counts.empty()) {
+      AddPhrasePair();
+      Flush(out);
+    }
+    out.Poison();
+  }
+
+private:
+  void AddPhrasePair() {
+    const size_t maxPhraseLength = m_in.maxPhraseLength;
+    const WORD_ID *phraseS = &m_phrases[0];
+    const WORD_ID *phraseT = phraseS + maxPhraseLength + 1;
+    const size_t sourceLength = PhraseLength(phraseS, maxPhraseLength, m_sourceEnd);
+    const size_t targetLength = PhraseLength(phraseT, maxPhraseLength, m_targetEnd);
+
+    float count = 0.0f;
+    size_t bestDirect = 0, bestInverse = 0;
+    for (size_t i = 0; i < m_counts.size(); ++i) {
+      count += m_counts[i];
+      if (i == 0) {
+        continue;
+      }
+      if (m_counts[i] > m_counts[bestDirect] ||
+          (m_counts[i] == m_counts[bestDirect] &&
+           AlignmentString(Alignment(i), maxPhraseLength, sourceLength, targetLength, false) <
+           AlignmentString(Alignment(bestDirect), maxPhraseLength, sourceLength, targetLength, false))) {
+        bestDirect = i;
+      }
+      if (m_counts[i] > m_counts[bestInverse] ||
+          (m_counts[i] == m_counts[bestInverse] &&
+           AlignmentString(Alignment(i), maxPhraseLength, sourceLength, targetLength, true) >
+           AlignmentString(Alignment(bestInverse), maxPhraseLength, sourceLength, targetLength, true))) {
+        bestInverse = i;
+      }
+    }
+
+    const size_t offset = m_group.size();
+    m_group.resize(offset + m_out.size);
+    uint8_t *record = &m_group[offset];
+    Field<float>(record, m_out.count) = count;
+    copy(m_phrases.begin(), m_phrases.end(), &Field<WORD_ID>(record, m_out.source));
+    copy(Alignment(bestDirect), Alignment(bestDirect) + m_in.alignmentWords,
+         &Field<uint64_t>(record, m_out.alignment));
+
+    if (m_lexF2E) {
+      // lex(e|f): all target words have to be explained
+      const uint64_t *alignment = Alignment(bestDirect);
+      double lexScore = 1.0;
+      for (size_t ti = 0; ti < targetLength; ++ti) {
+        double thisWordScore = 0;
+        size_t aligned = 0;
+        for (size_t si = 0; si < sourceLength; ++si) {
+          if (IsAligned(alignment, maxPhraseLength, ti, si)) {
+            thisWordScore += m_lexF2E->Get(phraseS[si], phraseT[ti]);
+            ++aligned;
+          }
+        }
+        lexScore *= aligned ? thisWordScore / (double)aligned : m_lexF2E->Get(m_lexF2E->GetNull(), phraseT[ti]);
+      }
+      Field<float>(record, m_out.lexDirect) = MaybeLog(lexScore);
+    }
+    if (m_lexE2F) {
+      // lex(f|e): all source words have to be explained
+      const uint64_t *alignment = Alignment(bestInverse);
+      double lexScore = 1.0;
+      for (size_t si = 0; si < sourceLength; ++si) {
+        double thisWordScore = 0;
+        size_t aligned = 0;
+        for (size_t ti = 0; ti < targetLength; ++ti) {
+          if (IsAligned(alignment, maxPhraseLength, ti, si)) {
+            thisWordScore += m_lexE2F->Get(phraseT[ti], phraseS[si]);
+            ++aligned;
+          }
+        }
+        lexScore *= aligned ? thisWordScore / (double)aligned : m_lexE2F->Get(m_lexE2F->GetNull(), phraseS[si]);
+      }
+      Field<float>(record, m_out.lexInverse) = MaybeLog(lexScore);
+    }
+
+    m_alignments.clear();
+    m_counts.clear();
+  }
+
+  //! write out the phrase pairs of the current source phrase
+  void Flush(util::stream::Stream &out) {
+    float sourceCount = 0.0f;
+    for (size_t offset = 0; offset < m_group.size(); offset += m_out.size) {
+      sourceCount += Field<float>(&m_group[offset], m_out.count);
+    }
+    for (size_t offset = 0; offset < m_group.size(); offset += m_out.size) {
+      Field<float>(&m_group[offset], m_out.sourceCount) = sourceCount;
+      memcpy(out.Get(), &m_group[offset], m_out.size);
+      ++out;
+    }
+    m_group.clear();
+  }
+
+  const uint64_t *Alignment(size_t i) const {
+    return &m_alignments[i * m_in.alignmentWords];
+  }
+
+  // as score: the weight is rounded to float before its log is taken
+  float MaybeLog(float a) const {
+    return m_logProb ? log(static_cast<double>(a)) : a;
+  }
+
+  PhrasePairLayout m_in, m_out;
+  util::stream::ChainPosition m_output;
+  WORD_ID m_sourceEnd, m_targetEnd;
+  const LexicalWeights *m_lexF2E, *m_lexE2F;
+  bool m_logProb;
+
+  // the current phrase pair: source and target phrase, distinct alignments
+  vector<WORD_ID> m_phrases;
+  vector<uint64_t> m_alignments;
+  vector<float> m_counts;
+  // scored records of the current source phrase
+  vector<uint8_t> m_group;
+};
+
+//! fill in the count of the target phrase of records in target order
+class CountTargetPhrases
+{
+public:
+  CountTargetPhrases(const PhrasePairLayout &layout, const util::stream::ChainPosition &output)
+    : m_layout(layout), m_output(output) {}
+
+  void Run(const util::stream::ChainPosition &position) {
+    util::stream::Stream out(m_output);
+    const PhraseOrder order(m_layout, true);
+    vector<uint8_t> group;
+    for (util::stream::Stream in(position); in; ++in) {
+      if (!group.empty() && !order.SameFirst(in.Get(), &group[0])) {
+        Flush(group, out);
+      }
+      const uint8_t *record = static_cast<const uint8_t*>(in.Get());
+      group.insert(group.end(), record, record + m_layout.size);
+    }
+    Flush(group, out);
+    out.Poison();
+  }
+
+private:
+  void Flush(vector<uint8_t> &group, util::stream::Stream &out) {
+    float targetCount = 0.0f;
+    for (size_t offset = 0; offset < group.size(); offset += m_layout.size) {
+      targetCount += Field<float>(&group[offset], m_layout.count);
+    }
+    for (size_t offset = 0; offset < group.size(); offset += m_layout.size) {
+      Field<float>(&group[offset], m_layout.targetCount) = targetCount;
+      memcpy(out.Get(), &group[offset], m_layout.size);
+      ++out;
+    }
+    group.clear();
+  }
+
+  PhrasePairLayout m_layout;
+  util::stream::ChainPosition m_output;
+};
+
+//! write the records, in source order, as consolidate writes the phrase table
+class WritePhraseTable
+{
+public:
+  WritePhraseTable(const PhrasePairLayout &layout, const PhraseTableBuilderOptions &options,
+                   const SortedVocabulary &vcbS, const SortedVocabulary &vcbT, ostream &out)
+    : m_layout(layout), m_options(&options), m_vcbS(&vcbS), m_vcbT(&vcbT), m_out(&out) {}
+
+  void Run(const util::stream::ChainPosition &position) {
+    const size_t maxPhraseLength = m_layout.maxPhraseLength;
+    ostream &out = *m_out;
+    for (util::stream::Stream in(position); in; ++in) {
+      const void *record = in.Get();
+      const WORD_ID *phraseS = &Field<WORD_ID>(record, m_layout.source);
+      const WORD_ID *phraseT = &Field<WORD_ID>(record, m_layout.target);
+      const size_t sourceLength = PhraseLength(phraseS, maxPhraseLength, m_vcbS->GetPhraseEnd());
+      const size_t targetLength = PhraseLength(phraseT, maxPhraseLength, m_vcbT->GetPhraseEnd());
+
+      for (size_t i = 0; i < sourceLength; ++i) {
+        out << m_vcbS->GetWord(phraseS[i]) << " ";
+      }
+      out << "|||";
+      for (size_t i = 0; i < targetLength; ++i) {
+        out << " " << m_vcbT->GetWord(phraseT[i]);
+      }
+      out << " |||";
+
+      const float countEF = Field<float>(record, m_layout.count);
+      const float countF = Field<float>(record, m_layout.sourceCount);
+      const float countE = Field<float>(record, m_layout.targetCount);
+      if (!m_options->onlyDirectFlag) {
+        out << " " << MaybeLog(countEF / countE);
+        if (m_options->lexFlag) {
+          out << " " << Field<float>(record, m_layout.lexInverse);
+        }
+      }
+      out << " " << MaybeLog(countEF / countF);
+      if (m_options->lexFlag) {
+        out << " " << Field<float>(record, m_layout.lexDirect);
+      }
+      if (m_options->phraseCountFlag) {
+        out << " " << MaybeLog(2.718);
+      }
+
+      out << " |||";
+      if (m_options->wordAlignmentFlag) {
+        out << AlignmentString(&Field<uint64_t>(record, m_layout.alignment), maxPhraseLength,
+                               sourceLength, targetLength, false);
+      }
+      out << " ||| " << countE << " " << countF << " " << countEF << "\n";
+    }
+  }
+
+private:
+  float MaybeLog(float a) const {
+    return m_options->logProbFlag ? log(a) : a;
+  }
+
+  PhrasePairLayout m_layout;
+  const PhraseTableBuilderOptions *m_options;
+  const SortedVocabulary *m_vcbS, *m_vcbT;
+  ostream *m_out;
+};
+
+void ReadVocabulary(const string &fileName, SortedVocabulary &vocabulary)
+{
+  Moses::InputFileStream file(fileName);
+  if (file.fail()) {
+    cerr << "ERROR: could not open " << fileName << endl;
+    exit(1);
+  }
+  string line;
+  while (getline(file, line)) {
+    vocabulary.AddWords(line);
+  }
+  vocabulary.Finish();
+}
+
+} // namespace
+
+namespace MosesTraining
+{
+
+PhraseTableBuilder::PhraseTableBuilder(const PhraseTableBuilderOptions &options)
+  : m_options(options)
+{
+  util::NormalizeTempPrefix(m_options.sort.temp_prefix);
+}
+
+void PhraseTableBuilder::Build(const string &fileNameE, const string &fileNameF,
+                               const string &fileNameA, const string &fileNameLex,
+                               const string &fileNamePhraseTable)
+{
+  cerr << "Reading vocabulary" << endl;
+  ReadVocabulary(fileNameF, m_vcbS);
+  ReadVocabulary(fileNameE, m_vcbT);
+  if (m_options.lexFlag) {
+    m_lexF2E.Load(fileNameLex + ".f2e", m_vcbS, m_vcbT);
+    m_lexE2F.Load(fileNameLex + ".e2f", m_vcbT, m_vcbS);
+  }
+
+  Moses::OutputFileStream phraseTableFile;
+  if (!phraseTableFile.Open(fileNamePhraseTable)) {
+    cerr << "ERROR: could not open phrase table file " << fileNamePhraseTable << endl;
+    exit(1);
+  }
+
+  Moses::ThreadPool *pool = NULL;
+#ifdef WITH_THREADS
+  if (m_options.threads > 1) {
+    pool = new Moses::ThreadPool(m_options.threads);
+  }
+#endif
+
+  // the chains of one step share the memory with the merge of the sort
+  const size_t total = m_options.sort.total_memory;
+  const PhrasePairLayout extracted(m_options.maxPhraseLength, false);
+  const PhrasePairLayout scored(m_options.maxPhraseLength, true);
+  const util::stream::ChainConfig extractedChain(extracted.size, 2, total / 4);
+  const util::stream::ChainConfig scoredChain(scored.size, 2, total / 4);
+
+  cerr << "Extracting phrase pairs" << endl;
+  util::stream::Chain extraction(util::stream::ChainConfig(extracted.size, 2, total / 2));
+  extraction >> ExtractSentences(fileNameE, fileNameF, fileNameA, m_vcbS, m_vcbT,
+                                 extracted, pool, m_options.threads);
+  util::stream::Sort<PhraseOrder, AddCount> bySource(extraction, m_options.sort,
+      PhraseOrder(extracted, false), AddCount(extracted));
+  extraction.Wait(true);
+
+  cerr << "Scoring phrase pairs" << endl;
+  util::stream::Chain sorted(extractedChain), scoredPairs(scoredChain);
+  bySource.Output(sorted, total / 2);
+  sorted >> ScorePhrasePairs(extracted, scored, scoredPairs.Add(), m_vcbS, m_vcbT,
+                             m_options.lexFlag ? &m_lexF2E : NULL,
+                             m_options.lexFlag ? &m_lexE2F : NULL,
+                             m_options.logProbFlag) >> util::stream::kRecycle;
+  util::stream::Sort<PhraseOrder> byTarget(scoredPairs, m_options.sort, PhraseOrder(scored, true));
+  sorted.Wait(true);
+  scoredPairs.Wait(true);
+
+  cerr << "Counting target phrases" << endl;
+  util::stream::Chain targetSorted(scoredChain), counted(scoredChain);
+  byTarget.Output(targetSorted, total / 2);
+  targetSorted >> CountTargetPhrases(scored, counted.Add()) >> util::stream::kRecycle;
+  util::stream::Sort<PhraseOrder> bySourceAgain(counted, m_options.sort, PhraseOrder(scored, false));
+  targetSorted.Wait(true);
+  counted.Wait(true);
+
+  cerr << "Writing phrase table" << endl;
+  util::stream::Chain output(scoredChain);
+  bySourceAgain.Output(output, total / 2);
+  output >> WritePhraseTable(scored, m_options, m_vcbS, m_vcbT, phraseTableFile) >> util::stream::kRecycle;
+  output.Wait(true);
+  phraseTableFile.Close();
+
+  delete pool;
+}
+
+}
@@ -0,0 +1,195 @@
+/***********************************************************************
+  Moses - factored phrase-based language decoder
+  Copyright (C) 2013- University of Edinburgh
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ ***********************************************************************/
+
+#pragma once
+#ifndef PHRASE_TABLE_BUILDER_H_INCLUDED_
+#define PHRASE_TABLE_BUILDER_H_INCLUDED_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <boost/unordered_map.hpp>
+
+#include "util/stream/config.hh"
+
+#include "tables-core.h"
+
+namespace MosesTraining
+{
+
+class SentenceAlignment;
+
+/**
+ * The words of one side of a corpus, numbered in byte order. The word
+ * kPhraseEnd ends every phrase, so comparing two phrases by word ids gives
+ * the order in which LC_ALL=C sort puts the lines of an extract file:
+ * "a b |||" comes before "a |||".
+ */
+class SortedVocabulary
+{
+public:
+  static const char kPhraseEnd[];
+  static const WORD_ID kNotFound = static_cast<WORD_ID>(-1);
+
+  //! add the words of a line; only allowed before Finish()
+  void AddWords(const std::string &line);
+
+  //! number the words
+  void Finish();
+
+  WORD_ID GetWordID(const std::string &word) const {
+    boost::unordered_map<std::string, WORD_ID>::const_iterator i = m_lookup.find(word);
+    return i == m_lookup.end() ? kNotFound : i->second;
+  }
+
+  const std::string &GetWord(WORD_ID id) const {
+    return m_words[id];
+  }
+
+  WORD_ID GetPhraseEnd() const {
+    return m_phraseEnd;
+  }
+
+  std::size_t Size() const {
+    return m_words.size();
+  }
+
+private:
+  boost::unordered_map<std::string, WORD_ID> m_lookup;
+  std::vector<std::string> m_words;
+  WORD_ID m_phraseEnd;
+};
+
+/**
+ * Byte offsets of the fields of the fixed-size phrase pair records that are
+ * sorted. Each phrase is stored as maxPhraseLength+1 word ids, padded with
+ * the phrase end; the alignment is a bit matrix, target position major.
+ * Scored records, one per distinct phrase pair, add the marginal counts and
+ * the lexical weights.
+ */
+struct PhrasePairLayout {
+  PhrasePairLayout(int maxPhraseLength, bool scored);
+
+  int maxPhraseLength;
+  std::size_t count, sourceCount, targetCount, lexDirect, lexInverse;
+  std::size_t source, target, alignment, alignmentWords;
+  std::size_t size;
+
+  // key of a record, as compared for combining: the phrases and the alignment
+  std::size_t KeyBegin() const {
+    return source;
+  }
+  std::size_t KeyEnd() const {
+    return alignment + alignmentWords * sizeof(uint64_t);
+  }
+};
+
+//! lexical translation probabilities p(target|source), as read by score
+class LexicalWeights
+{
+public:
+  void Load(const std::string &fileName, const SortedVocabulary &vcbS, const SortedVocabulary &vcbT);
+
+  //! 1 if there is no entry, as LexicalTable::permissiveLookup
+  double Get(WORD_ID wordS, WORD_ID wordT) const {
+    boost::unordered_map<uint64_t, double>::const_iterator i = m_table.find(Key(wordS, wordT));
+    return i == m_table.end() ? 1.0 : i->second;
+  }
+
+  //! id standing for the empty word of the source side
+  WORD_ID GetNull() const {
+    return m_null;
+  }
+
+private:
+  static uint64_t Key(WORD_ID wordS, WORD_ID wordT) {
+    return (static_cast<uint64_t>(wordS) << 32) | wordT;
+  }
+
+  boost::unordered_map<uint64_t, double> m_table;
+  WORD_ID m_null;
+};
+
+struct PhraseTableBuilderOptions {
+  PhraseTableBuilderOptions()
+    : maxPhraseLength(7), threads(1), lexFlag(true), onlyDirectFlag(false),
+      phraseCountFlag(true), wordAlignmentFlag(true), logProbFlag(false) {
+    sort.temp_prefix = "/tmp/";
+    sort.buffer_size = 64 << 20;
+    sort.total_memory = 1 << 30;
+  }
+
+  int maxPhraseLength;
+  std::size_t threads;
+  util::stream::SortConfig sort;
+
+  bool lexFlag;
+  bool onlyDirectFlag;
+  bool phraseCountFlag;
+  bool wordAlignmentFlag;
+  bool logProbFlag;
+};
+
+/**
+ * Builds a phrase table from a word-aligned parallel corpus in one process,
+ * with the scores of extract, score (in both directions) and consolidate.
+ * Phrase pairs are extracted in parallel into binary records of word ids,
+ * which util::stream sorts in memory and on disk three times: by source
+ * phrase to score p(e|f) and both lexical weights, by target phrase to
+ * count the target phrases, and back to source order for the output.
+ * No text is written but the phrase table itself, which comes out in the
+ * order of the table built by train-model.perl.
+ */
+class PhraseTableBuilder
+{
+public:
+  PhraseTableBuilder(const PhraseTableBuilderOptions &options);
+
+  /**
+   * \param fileNameE  target side of the corpus
+   * \param fileNameF  source side of the corpus
+   * \param fileNameA  alignment, source-target pairs as for extract
+   * \param fileNameLex prefix of the lexical tables, .f2e and .e2f are read
+   * \param fileNamePhraseTable output, gzipped if it ends in .gz
+   */
+  void Build(const std::string &fileNameE, const std::string &fileNameF,
+             const std::string &fileNameA, const std::string &fileNameLex,
+             const std::string &fileNamePhraseTable);
+
+private:
+  PhraseTableBuilderOptions m_options;
+  SortedVocabulary m_vcbS, m_vcbT;
+  LexicalWeights m_lexF2E, m_lexE2F;
+};
+
+/**
+ * Append a record for every phrase pair of sentence (as extract does without
+ * orientation), each with count 1.
+ * \param source  word ids of sentence.source
+ * \param target  word ids of sentence.target
+ */
+void ExtractPhrasePairs(const SentenceAlignment &sentence,
+                        const std::vector<WORD_ID> &source, WORD_ID sourceEnd,
+                        const std::vector<WORD_ID> &target, WORD_ID targetEnd,
+                        const PhrasePairLayout &layout, std::vector<uint8_t> &records);
+
+}
+
+#endif
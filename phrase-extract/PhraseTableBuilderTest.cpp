@@ -0,0 +1,195 @@
+/***********************************************************************
+  Moses - factored phrase-based language decoder
+  Copyright (C) 2013- University of Edinburgh
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ ***********************************************************************/
+
+#include "PhraseTableBuilder.h"
+#include "SentenceAlignment.h"
+
+#define  BOOST_TEST_MODULE MosesTrainingPhraseTableBuilder
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace MosesTraining;
+using namespace std;
+
+namespace
+{
+
+vector<WORD_ID> Phrase(const SortedVocabulary &vocabulary, const string &words, size_t length)
+{
+  vector<string> tokens = tokenize(words.c_str());
+  vector<WORD_ID> phrase(length, vocabulary.GetPhraseEnd());
+  for (size_t i = 0; i < tokens.size(); ++i) {
+    phrase[i] = vocabulary.GetWordID(tokens[i]);
+  }
+  return phrase;
+}
+
+// test.a test.e test.f test.lex.e2f test.lex.f2e, as given by the Jamfile
+string TestFile(size_t index, const char *name)
+{
+  if (boost::unit_test::framework::master_test_suite().argc < 6) {
+    return name;
+  }
+  return boost::unit_test::framework::master_test_suite().argv[index];
+}
+
+vector<string> Build(PhraseTableBuilderOptions options)
+{
+  options.sort.buffer_size = 1 << 20;
+  options.sort.total_memory = 16 << 20;
+  char fileNamePhraseTable[] = "/tmp/PhraseTableBuilderTest.XXXXXX";
+  int fd = mkstemp(fileNamePhraseTable);
+  BOOST_REQUIRE(fd != -1);
+  close(fd);
+
+  string fileNameLex = TestFile(5, "test.lex.f2e");
+  fileNameLex.erase(fileNameLex.size() - strlen(".f2e"));
+  PhraseTableBuilder builder(options);
+  builder.Build(TestFile(2, "test.e"), TestFile(3, "test.f"), TestFile(1, "test.a"),
+                fileNameLex, fileNamePhraseTable);
+
+  vector<string> lines;
+  ifstream in(fileNamePhraseTable);
+  for (string line; getline(in, line); ) {
+    lines.push_back(line);
+  }
+  unlink(fileNamePhraseTable);
+  return lines;
+}
+
+void CheckLines(const vector<string> &lines, const char *const *expected, size_t size)
+{
+  BOOST_REQUIRE_EQUAL(lines.size(), size);
+  for (size_t i = 0; i < size; ++i) {
+    BOOST_CHECK_EQUAL(lines[i], expected[i]);
+  }
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(vocabulary_sorts_as_extract_file)
+{
+  SortedVocabulary vocabulary;
+  vocabulary.AddWords("b ab a");
+  vocabulary.AddWords("|| Z");
+  vocabulary.Finish();
+  BOOST_CHECK_EQUAL(vocabulary.Size(), 6u);
+  BOOST_CHECK_EQUAL(vocabulary.GetWord(vocabulary.GetPhraseEnd()), "|||");
+  BOOST_CHECK_EQUAL(vocabulary.GetWordID("c"), SortedVocabulary::kNotFound);
+
+  // as LC_ALL=C sort orders "a b |||", "a |||", "ab |||", ...
+  const char *phrases[] = { "a b", "a", "a ||", "ab", "b", "Z", "||" };
+  vector<string> lines;
+  vector<vector<WORD_ID> > ids;
+  for (size_t i = 0; i < sizeof(phrases) / sizeof(phrases[0]); ++i) {
+    lines.push_back(string(phrases[i]) + " |||");
+    ids.push_back(Phrase(vocabulary, phrases[i], 3));
+  }
+  sort(lines.begin(), lines.end());
+  sort(ids.begin(), ids.end());
+  for (size_t i = 0; i < lines.size(); ++i) {
+    string line;
+    for (size_t j = 0; j < ids[i].size() && ids[i][j] != vocabulary.GetPhraseEnd(); ++j) {
+      line += vocabulary.GetWord(ids[i][j]) + " ";
+    }
+    BOOST_CHECK_EQUAL(line + "|||", lines[i]);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(extract_phrase_pairs)
+{
+  SortedVocabulary vcbS, vcbT;
+  vcbS.AddWords("das haus");
+  vcbS.Finish();
+  vcbT.AddWords("the house");
+  vcbT.Finish();
+
+  char target[] = "the house";
+  char source[] = "das haus";
+  char alignment[] = "0-0 1-1";
+  char weight[] = "";
+  SentenceAlignment sentence;
+  BOOST_REQUIRE(sentence.create(target, source, alignment, weight, 1, false));
+
+  const PhrasePairLayout layout(2, false);
+  vector<uint8_t> records;
+  ExtractPhrasePairs(sentence,
+                     Phrase(vcbS, "das haus", 2), vcbS.GetPhraseEnd(),
+                     Phrase(vcbT, "the house", 2), vcbT.GetPhraseEnd(),
+                     layout, records);
+  BOOST_REQUIRE_EQUAL(records.size(), 3 * layout.size);
+
+  // "das haus ||| the house" with alignment 0-0 1-1
+  const uint8_t *record = &records[layout.size];
+  float count;
+  memcpy(&count, record + layout.count, sizeof(count));
+  BOOST_CHECK_EQUAL(count, 1.0f);
+  vector<WORD_ID> phraseS(3), phraseT(3);
+  memcpy(&phraseS[0], record + layout.source, 3 * sizeof(WORD_ID));
+  memcpy(&phraseT[0], record + layout.target, 3 * sizeof(WORD_ID));
+  BOOST_CHECK(phraseS == Phrase(vcbS, "das haus", 3));
+  BOOST_CHECK(phraseT == Phrase(vcbT, "the house", 3));
+  uint64_t bits;
+  memcpy(&bits, record + layout.alignment, sizeof(bits));
+  BOOST_CHECK_EQUAL(bits, (1u << 0) | (1u << 3));
+}
+
+/* The phrase tables below are what extract, score (in both directions) and
+ * consolidate write for the test corpus.  "a b ||| x y" is seen once with
+ * each of two alignments: the output and lex(e|f) take 0-0 0-1 1-1, which
+ * comes first in the extract file, and lex(f|e) takes it too, as it comes
+ * last in the inverse extract file.  "b c ||| y" and "c ||| z x" have an
+ * unaligned word, scored with the NULL entry of the lexical table. */
+BOOST_AUTO_TEST_CASE(build_as_train_model)
+{
+  const char *expected[] = {
+    "a b ||| x y ||| 1 0.1875 1 0.25 2.718 ||| 0-0 0-1 1-1 ||| 2 2 2",
+    "a ||| y ||| 0.333333 0.25 1 0.25 2.718 ||| 0-0 ||| 3 1 1",
+    "b c ||| y ||| 0.333333 0.3125 1 0.75 2.718 ||| 0-0 ||| 3 1 1",
+    "b ||| y ||| 0.333333 0.5 1 0.75 2.718 ||| 0-0 ||| 3 1 1",
+    "c a ||| y z ||| 1 0.1875 1 0.09375 2.718 ||| 1-0 0-1 ||| 1 1 1",
+    "c ||| z x ||| 1 0.75 0.333333 0.046875 2.718 ||| 0-0 ||| 1 3 1",
+    "c ||| z ||| 1 0.75 0.666667 0.375 2.718 ||| 0-0 ||| 2 3 2"
+  };
+  CheckLines(Build(PhraseTableBuilderOptions()), expected, sizeof(expected) / sizeof(expected[0]));
+}
+
+BOOST_AUTO_TEST_CASE(build_log_prob)
+{
+  const char *expected[] = {
+    "a b ||| x y ||| 0 -1.67398 0 -1.38629 0.999896 ||| 0-0 0-1 1-1 ||| 2 2 2",
+    "a ||| y ||| -1.09861 -1.38629 0 -1.38629 0.999896 ||| 0-0 ||| 3 1 1",
+    "b c ||| y ||| -1.09861 -1.16315 0 -0.287682 0.999896 ||| 0-0 ||| 3 1 1",
+    "b ||| y ||| -1.09861 -0.693147 0 -0.287682 0.999896 ||| 0-0 ||| 3 1 1",
+    "c a ||| y z ||| 0 -1.67398 0 -2.36712 0.999896 ||| 1-0 0-1 ||| 1 1 1",
+    "c ||| z x ||| 0 -0.287682 -1.09861 -3.06027 0.999896 ||| 0-0 ||| 1 3 1",
+    "c ||| z ||| 0 -0.287682 -0.405465 -0.980829 0.999896 ||| 0-0 ||| 2 3 2"
+  };
+  PhraseTableBuilderOptions options;
+  options.logProbFlag = true;
+#ifdef WITH_THREADS
+  options.threads = 2;
+#endif
+  CheckLines(Build(options), expected, sizeof(expected) / sizeof(expected[0]));
+}
@@ -0,0 +1,100 @@
+/***********************************************************************
+  Moses - factored phrase-based language decoder
+  Copyright (C) 2013- University of Edinburgh
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ ***********************************************************************/
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "util/exception.hh"
+#include "util/usage.hh"
+
+#include "PhraseTableBuilder.h"
+
+using namespace std;
+using namespace MosesTraining;
+
+int main(int argc, char* argv[])
+{
+  cerr << "build-phrase-table: extract, score and consolidate in one process\n";
+
+  PhraseTableBuilderOptions options;
+  if (argc < 7) {
+    cerr << "syntax: build-phrase-table en de align lex phrase-table max-length"
+         << " [--Threads n] [--TempPrefix prefix]"
+         << " [--SortMemory size[" << (options.sort.total_memory >> 20) << "M]]"
+         << " [--SortBuffer size[" << (options.sort.buffer_size >> 20) << "M]]"
+         << " [--NoLex] [--OnlyDirect] [--NoPhraseCount] [--NoWordAlignment] [--LogProb]\n"
+         << "reads lex.f2e and lex.e2f; the phrase table is written as consolidate writes it\n";
+    exit(1);
+  }
+  const string fileNameE = argv[1];
+  const string fileNameF = argv[2];
+  const string fileNameA = argv[3];
+  const string fileNameLex = argv[4];
+  const string fileNamePhraseTable = argv[5];
+  options.maxPhraseLength = atoi(argv[6]);
+  if (options.maxPhraseLength < 1) {
+    cerr << "build-phrase-table: max-length must be positive" << endl;
+    exit(1);
+  }
+
+  try {
+    for(int i=7; i<argc; i++) {
+      if (strcmp(argv[i],"--Threads") == 0 && i+1 < argc) {
+#ifdef WITH_THREADS
+        const int threads = atoi(argv[++i]);
+        if (threads < 1) {
+          cerr << "build-phrase-table: number of threads must be positive" << endl;
+          exit(1);
+        }
+        options.threads = threads;
+#else
+        cerr << "thread support not compiled in." << '\n';
+        exit(1);
+#endif
+      } else if (strcmp(argv[i],"--TempPrefix") == 0 && i+1 < argc) {
+        options.sort.temp_prefix = argv[++i];
+      } else if (strcmp(argv[i],"--SortMemory") == 0 && i+1 < argc) {
+        options.sort.total_memory = util::ParseSize(argv[++i]);
+      } else if (strcmp(argv[i],"--SortBuffer") == 0 && i+1 < argc) {
+        options.sort.buffer_size = util::ParseSize(argv[++i]);
+      } else if (strcmp(argv[i],"--NoLex") == 0) {
+        options.lexFlag = false;
+      } else if (strcmp(argv[i],"--OnlyDirect") == 0) {
+        options.onlyDirectFlag = true;
+      } else if (strcmp(argv[i],"--NoPhraseCount") == 0) {
+        options.phraseCountFlag = false;
+      } else if (strcmp(argv[i],"--NoWordAlignment") == 0) {
+        options.wordAlignmentFlag = false;
+      } else if (strcmp(argv[i],"--LogProb") == 0) {
+        options.logProbFlag = true;
+      } else {
+        cerr << "build-phrase-table: syntax error, unknown option '" << string(argv[i]) << "'\n";
+        exit(1);
+      }
+    }
+
+    PhraseTableBuilder builder(options);
+    builder.Build(fileNameE, fileNameF, fileNameA, fileNameLex, fileNamePhraseTable);
+  } catch (const util::Exception &e) {
+    cerr << "build-phrase-table: " << e.what() << endl;
+    exit(1);
+  }
+}
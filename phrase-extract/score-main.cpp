@@ -27,6 +27,7 @@
 #include <cstring>
 #include <set>
 #include <algorithm>
+#include <deque>
 
 #include "SafeGetline.h"
 #include "ScoreFeature.h"
@@ -37,6 +38,12 @@
 #include "InputFileStream.h"
 #include "OutputFileStream.h"
 
+#include "moses/ThreadPool.h"
+
+#ifdef WITH_THREADS
+#include <boost/thread/mutex.hpp>
+#endif
+
 using namespace std;
 using namespace MosesTraining;
 
@@ -65,6 +72,15 @@ bool crossedNonTerm = false;
 int countOfCounts[COC_MAX+1];
 int totalDistinct = 0;
 float minCountHierarchical = 0;
+#ifdef WITH_THREADS
+boost::mutex countOfCountsMutex;
+#endif
+
+// with threads, the source phrases of this many phrase pairs per thread are
+// read, and then scored in parallel while the vocabularies do not change;
+// small batches are still in the cache when they are scored
+const size_t kPhrasePairsPerThread = 1000;
+const size_t kTasksPerThread = 4;
 
 Vocabulary vcbT;
 Vocabulary vcbS;
@@ -75,6 +91,7 @@ vector<string> tokenize( const char [] );
 
 void writeCountOfCounts( const string &fileNameCountOfCounts );
 void processPhrasePairs( vector< PhraseAlignment > & , ostream &phraseTableFile, bool isSingleton, const ScoreFeatureManager& featureManager, const MaybeLog& maybeLog);
+void processBatch( deque< vector< PhraseAlignment > > &batch, vector< bool > &batchIsSingleton, ostream &phraseTableFile, const ScoreFeatureManager& featureManager, const MaybeLog& maybeLog, Moses::ThreadPool *pool, size_t threadCount );
 const PhraseAlignment &findBestAlignment(const PhraseAlignmentCollection &phrasePair );
 void outputPhrasePair(const PhraseAlignmentCollection &phrasePair, float, int, ostream &phraseTableFile, bool isSingleton, const ScoreFeatureManager& featureManager, const MaybeLog& maybeLog );
 double computeLexicalTranslation( const PHRASE &, const PHRASE &, const PhraseAlignment & );
@@ -95,7 +112,7 @@ int main(int argc, char* argv[])
 
   ScoreFeatureManager featureManager;
   if (argc < 4) {
-    cerr << "syntax: score extract lex phrase-table [--Inverse] [--Hierarchical] [--LogProb] [--NegLogProb] [--NoLex] [--GoodTuring] [--KneserNey] [--NoWordAlignment] [--UnalignedPenalty] [--UnalignedFunctionWordPenalty function-word-file] [--MinCountHierarchical count] [--OutputNTLengths] [--PCFG] [--UnpairedExtractFormat] [--ConditionOnTargetLHS] [--Singleton] [--CrossedNonTerm] \n";
+    cerr << "syntax: score extract lex phrase-table [--Inverse] [--Hierarchical] [--LogProb] [--NegLogProb] [--NoLex] [--GoodTuring] [--KneserNey] [--NoWordAlignment] [--UnalignedPenalty] [--UnalignedFunctionWordPenalty function-word-file] [--MinCountHierarchical count] [--OutputNTLengths] [--PCFG] [--UnpairedExtractFormat] [--ConditionOnTargetLHS] [--Singleton] [--CrossedNonTerm] [--Threads n] \n";
     cerr << featureManager.usage() << endl;
     exit(1);
   }
@@ -105,6 +122,7 @@ int main(int argc, char* argv[])
   string fileNameCountOfCounts;
   char* fileNameFunctionWords = NULL;
   vector<string> featureArgs; //all unknown args passed to feature manager
+  int threadCount = 1;
 
   for(int i=4; i<argc; i++) {
     if (strcmp(argv[i],"inverse") == 0 || strcmp(argv[i],"--Inverse") == 0) {
@@ -166,6 +184,24 @@ int main(int argc, char* argv[])
     } else if (strcmp(argv[i],"--CrossedNonTerm") == 0) {
       crossedNonTerm = true;
       cerr << "crossed non-term reordering feature\n";
+    } else if (strcmp(argv[i],"-threads") == 0 ||
+               strcmp(argv[i],"--threads") == 0 ||
+               strcmp(argv[i],"--Threads") == 0) {
+#ifdef WITH_THREADS
+      if (i+1==argc) {
+        cerr << "ERROR: specify the number of threads!\n";
+        exit(1);
+      }
+      threadCount = atoi(argv[++i]);
+      if (threadCount < 1) {
+        cerr << "ERROR: number of threads must be positive\n";
+        exit(1);
+      }
+      cerr << "scoring with " << threadCount << " threads\n";
+#else
+      cerr << "thread support not compiled in." << '\n';
+      exit(1);
+#endif
     } else {
       featureArgs.push_back(argv[i]);
       ++i;
@@ -219,6 +255,18 @@ int main(int argc, char* argv[])
     phraseTableFile = outputFile;
   }
 
+  // with threads, source phrases are scored in batches while no new
+  // words are read, and written out in input order
+  Moses::ThreadPool *pool = NULL;
+#ifdef WITH_THREADS
+  if (threadCount > 1) {
+    pool = new Moses::ThreadPool(threadCount);
+  }
+#endif
+  deque< vector< PhraseAlignment > > batch;
+  vector< bool > batchIsSingleton;
+  size_t batchPhrasePairs = 0;
+
   // loop through all extracted phrase translations
   float lastCount = 0.0f;
   float lastPcfgSum = 0.0f;
@@ -260,7 +308,18 @@ int main(int argc, char* argv[])
     // if new source phrase, process last batch
     if (lastPhrasePair != NULL &&
         lastPhrasePair->GetSource() != phrasePair.GetSource()) {
-      processPhrasePairs( phrasePairsWithSameF, *phraseTableFile, isSingleton, featureManager, maybeLogProb );
+      if (pool) {
+        batchPhrasePairs += phrasePairsWithSameF.size();
+        batch.push_back( vector< PhraseAlignment >() );
+        batch.back().swap( phrasePairsWithSameF );
+        batchIsSingleton.push_back( isSingleton );
+        if (batchPhrasePairs >= threadCount * kPhrasePairsPerThread) {
+          processBatch( batch, batchIsSingleton, *phraseTableFile, featureManager, maybeLogProb, pool, threadCount );
+          batchPhrasePairs = 0;
+        }
+      } else {
+        processPhrasePairs( phrasePairsWithSameF, *phraseTableFile, isSingleton, featureManager, maybeLogProb );
+      }
 
       phrasePairsWithSameF.clear();
       isSingleton = false;
@@ -273,7 +332,17 @@ int main(int argc, char* argv[])
     phrasePairsWithSameF.push_back( phrasePair );
     lastPhrasePair = &phrasePairsWithSameF.back();
   }
-  processPhrasePairs( phrasePairsWithSameF, *phraseTableFile, isSingleton, featureManager, maybeLogProb );
+  if (pool) {
+    batch.push_back( vector< PhraseAlignment >() );
+    batch.back().swap( phrasePairsWithSameF );
+    batchIsSingleton.push_back( isSingleton );
+    processBatch( batch, batchIsSingleton, *phraseTableFile, featureManager, maybeLogProb, pool, threadCount );
+  } else {
+    processPhrasePairs( phrasePairsWithSameF, *phraseTableFile, isSingleton, featureManager, maybeLogProb );
+  }
+#ifdef WITH_THREADS
+  delete pool;
+#endif
 
   phraseTableFile->flush();
   if (phraseTableFile != &cout) {
@@ -307,6 +376,57 @@ void writeCountOfCounts( const string &fileNameCountOfCounts )
   countOfCountsFile.Close();
 }
 
+namespace
+{
+
+// scores a range of source phrases of a batch into a string of its own
+class ScoreTask : public Moses::Task
+{
+public:
+  ScoreTask(deque< vector< PhraseAlignment > > &batch, const vector< bool > &batchIsSingleton,
+            size_t begin, size_t end, const ScoreFeatureManager& featureManager,
+            const MaybeLog& maybeLogProb, string &output)
+    : m_batch(batch), m_batchIsSingleton(batchIsSingleton), m_begin(begin), m_end(end),
+      m_featureManager(featureManager), m_maybeLogProb(maybeLogProb), m_output(output) {}
+
+  virtual void Run() {
+    ostringstream out;
+    for (size_t i = m_begin; i < m_end; ++i) {
+      processPhrasePairs( m_batch[i], out, m_batchIsSingleton[i], m_featureManager, m_maybeLogProb );
+    }
+    m_output = out.str();
+  }
+
+private:
+  deque< vector< PhraseAlignment > > &m_batch;
+  const vector< bool > &m_batchIsSingleton;
+  size_t m_begin, m_end;
+  const ScoreFeatureManager &m_featureManager;
+  const MaybeLog &m_maybeLogProb;
+  string &m_output;
+};
+
+} // namespace
+
+void processBatch( deque< vector< PhraseAlignment > > &batch, vector< bool > &batchIsSingleton, ostream &phraseTableFile, const ScoreFeatureManager& featureManager, const MaybeLog& maybeLogProb, Moses::ThreadPool *pool, size_t threadCount )
+{
+  const size_t tasks = min(batch.size(), threadCount * kTasksPerThread);
+  vector< string > output(tasks);
+  {
+    Moses::TaskGroup group(pool);
+    for (size_t t = 0; t < tasks; ++t) {
+      group.Spawn(new ScoreTask(batch, batchIsSingleton,
+                                batch.size() * t / tasks, batch.size() * (t+1) / tasks,
+                                featureManager, maybeLogProb, output[t]));
+    }
+  }
+  for (size_t t = 0; t < tasks; ++t) {
+    phraseTableFile << output[t];
+  }
+  batch.clear();
+  batchIsSingleton.clear();
+}
+
 void processPhrasePairs( vector< PhraseAlignment > &phrasePair, ostream &phraseTableFile, bool isSingleton, const ScoreFeatureManager& featureManager, const MaybeLog& maybeLogProb )
 {
   if (phrasePair.size() == 0) return;
@@ -520,6 +640,9 @@ void outputPhrasePair(const PhraseAlignmentCollection &phrasePair, float totalCo
 
   // collect count of count statistics
   if (goodTuringFlag || kneserNeyFlag) {
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(countOfCountsMutex);
+#endif
     totalDistinct++;
     int countInt = count + 0.99999;
     if(countInt <= COC_MAX)
@@ -0,0 +1,5 @@
+x y
+x y
+y
+y z
+z x
@@ -0,0 +1,5 @@
+a b
+a b
+b c
+c a
+c
@@ -89,6 +89,7 @@ my $___RETURN_BEST_DEV = 0; # return the best weights according to dev, not the
 
 # Flags related to PRO (Hopkins & May, 2011)
 my $___PAIRWISE_RANKED_OPTIMIZER = 0; # flag to enable PRO.
+my $___PRO_BUILTIN_OPTIMIZER = 0; # train PRO's classifier in pro instead of megam
 my $___PRO_STARTING_POINT = 0; # get a starting point from pairwise ranked optimizer
 my $___HISTORIC_INTERPOLATION = 0; # interpolate optimize weights with previous iteration's weights [Hopkins&May,2011,5.4.3]
 # MegaM's options for PRO optimization.
@@ -204,6 +205,7 @@ GetOptions(
   "maximum-iterations=i" => \$maximum_iterations,
   "pairwise-ranked" => \$___PAIRWISE_RANKED_OPTIMIZER,
   "pro-starting-point" => \$___PRO_STARTING_POINT,
+  "pro-builtin-optimizer" => \$___PRO_BUILTIN_OPTIMIZER,
   "historic-interpolation=f" => \$___HISTORIC_INTERPOLATION,
   "batch-mira" => \$___BATCH_MIRA,
   "batch-mira-args=s" => \$batch_mira_args,
@@ -294,6 +296,7 @@ Options:
                                         (also works with regular optimizer, default: 0)
   --pairwise-ranked         ... Use PRO for optimisation (Hopkins and May, emnlp 2011)
   --pro-starting-point      ... Use PRO to get a starting point for MERT
+  --pro-builtin-optimizer   ... Train the PRO classifier within pro, instead of with megam
   --batch-mira              ... Use Batch MIRA for optimisation (Cherry and Foster, NAACL 2012)
   --batch-mira-args=STRING  ... args to pass through to batch MIRA. This flag is useful to
                                 change MIRA's hyperparameters such as regularization parameter C,
@@ -346,7 +349,7 @@ die "Not executable: $mert_eval_cmd"    if ! -x $mert_eval_cmd;
 
 my $pro_optimizer = File::Spec->catfile($mertdir, "megam_i686.opt");  # or set to your installation
 
-if (($___PAIRWISE_RANKED_OPTIMIZER || $___PRO_STARTING_POINT) && ! -x $pro_optimizer) {
+if (($___PAIRWISE_RANKED_OPTIMIZER || $___PRO_STARTING_POINT) && ! $___PRO_BUILTIN_OPTIMIZER && ! -x $pro_optimizer) {
   print "Could not find $pro_optimizer, installing it in $mertdir\n";
   my $megam_url = "http://hal3.name/megam";
   if (&is_mac_osx()) {
@@ -847,6 +850,11 @@ while (1) {
   if ($___BATCH_MIRA && $batch_mira_args) {
     $mira_settings .= "$batch_mira_args ";
   }
+  my $pro_settings = $proargs;
+  if ($__THREADS) {
+    $mira_settings .= " --threads $__THREADS";
+    $pro_settings .= " --threads $__THREADS";
+  }
 
   $mira_settings .= " --dense-init run$run.$weights_in_file";
   if (-e "run$run.sparse-weights") {
@@ -871,12 +879,17 @@ while (1) {
 
   my %sparse_weights; # sparse features
   my $pro_optimizer_cmd = "$pro_optimizer $megam_default_options run$run.pro.data";
+  my $pro_sample_cmd = "$mert_pro_cmd $pro_settings $seed_settings $pro_file_settings -o run$run.pro.data";
+  if ($___PRO_BUILTIN_OPTIMIZER) {
+    $pro_sample_cmd = "$mert_pro_cmd $pro_settings $seed_settings $pro_file_settings --train";
+    $pro_optimizer_cmd = "true";
+  }
   if ($___PAIRWISE_RANKED_OPTIMIZER) {  # pro optimization
-    $cmd = "$mert_pro_cmd $proargs $seed_settings $pro_file_settings -o run$run.pro.data ; echo 'not used' > $weights_out_file; $pro_optimizer_cmd";
+    $cmd = "$pro_sample_cmd ; echo 'not used' > $weights_out_file; $pro_optimizer_cmd";
     &submit_or_exec($cmd, $mert_outfile, $mert_logfile);
   } elsif ($___PRO_STARTING_POINT) {  # First, run pro, then mert
     # run pro...
-    my $pro_cmd = "$mert_pro_cmd $proargs $seed_settings $pro_file_settings -o run$run.pro.data ; $pro_optimizer_cmd";
+    my $pro_cmd = "$pro_sample_cmd ; $pro_optimizer_cmd";
     &submit_or_exec($pro_cmd, "run$run.pro.out", "run$run.pro.err");
     # ... get results ...
     ($bestpoint,$devbleu) = &get_weights_from_mert("run$run.pro.out","run$run.pro.err",scalar @{$featlist->{"names"}},\%sparse_weights, \@promix_weights);
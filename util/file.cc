@@ -199,6 +199,31 @@ void PReadOrThrow(int fd, void *to_void, std::size_t size, uint64_t off) {
   }
 }
 
+void PWriteOrThrow(int fd, const void *data_void, std::size_t size, uint64_t off) {
+#if defined(_WIN32) || defined(_WIN64)
+  UTIL_THROW(Exception, "pwrite is not implemented for windows.");
+#else
+  const uint8_t *data = static_cast<const uint8_t*>(data_void);
+  while (size) {
+    ssize_t ret;
+    errno = 0;
+    do {
+      ret =
+#ifdef OS_ANDROID
+        pwrite64
+#else
+        pwrite
+#endif
+        (fd, data, GuardLarge(size), off);
+    } while (ret == -1 && errno == EINTR);
+    UTIL_THROW_IF_ARG(ret < 1, FDException, (fd), "while writing " << size << " bytes at offset " << off);
+    size -= ret;
+    off += ret;
+    data += ret;
+  }
+#endif
+}
+
 void WriteOrThrow(int fd, const void *data_void, std::size_t size) {
   const uint8_t *data = static_cast<const uint8_t*>(data_void);
   while (size) {
@@ -70,6 +70,7 @@ class Recycler {
 
 extern const Recycler kRecycle;
 class WriteAndRecycle;
+class PWriteAndRecycle;
 
 class Chain {
   private:
@@ -128,6 +129,7 @@ class Chain {
     }
 
     Chain &operator>>(const WriteAndRecycle &writer);
+    Chain &operator>>(const PWriteAndRecycle &writer);
 
     // Chains are reusable.  Call Wait to wait for everything to finish and free memory.  
     void Wait(bool release_memory = true);
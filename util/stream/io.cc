@@ -29,20 +29,20 @@ void Read::Run(const ChainPosition &position) {
 void PRead::Run(const ChainPosition &position) {
   scoped_fd owner;
   if (own_) owner.reset(file_);
-  const uint64_t size = SizeOrThrow(file_);
-  UTIL_THROW_IF(size % static_cast<uint64_t>(position.GetChain().EntrySize()), ReadSizeException, "File size " << file_ << " size is " << size << " not a multiple of " << position.GetChain().EntrySize());
+  const uint64_t end = (end_ == kBadSize) ? SizeOrThrow(file_) : end_;
+  UTIL_THROW_IF((end - begin_) % static_cast<uint64_t>(position.GetChain().EntrySize()), ReadSizeException, "File size " << file_ << " size is " << (end - begin_) << " not a multiple of " << position.GetChain().EntrySize());
   const std::size_t block_size = position.GetChain().BlockSize();
   const uint64_t block_size64 = static_cast<uint64_t>(block_size);
   Link link(position);
-  uint64_t offset = 0;
-  for (; offset + block_size64 < size; offset += block_size64, ++link) {
+  uint64_t offset = begin_;
+  for (; offset + block_size64 < end; offset += block_size64, ++link) {
     PReadOrThrow(file_, link->Get(), block_size, offset);
     link->SetValidSize(block_size);
   }
-  // size - offset is <= block_size, so it casts to 32-bit fine.
-  if (size - offset) {
-    PReadOrThrow(file_, link->Get(), size - offset, offset);
-    link->SetValidSize(size - offset);
+  // end - offset is <= block_size, so it casts to 32-bit fine.
+  if (end - offset) {
+    PReadOrThrow(file_, link->Get(), end - offset, offset);
+    link->SetValidSize(end - offset);
     ++link;
   }
   link.Poison();
@@ -62,5 +62,14 @@ void WriteAndRecycle::Run(const ChainPosition &position) {
   }
 }
 
+void PWriteAndRecycle::Run(const ChainPosition &position) {
+  const std::size_t block_size = position.GetChain().BlockSize();
+  for (Link link(position); link; ++link) {
+    PWriteOrThrow(file_, link->Get(), link->ValidSize(), offset_);
+    offset_ += link->ValidSize();
+    link->SetValidSize(block_size);
+  }
+}
+
 } // namespace stream
 } // namespace util
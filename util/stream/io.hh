@@ -26,11 +26,14 @@ class Read {
 // Like read but uses pread so that the file can be accessed from multiple threads.  
 class PRead {
   public:
-    explicit PRead(int fd, bool take_own = false) : file_(fd), own_(take_own) {}
+    explicit PRead(int fd, bool take_own = false) : file_(fd), own_(take_own), begin_(0), end_(kBadSize) {}
+    // Read just bytes [begin, end) of the file.  
+    PRead(int fd, uint64_t begin, uint64_t end, bool take_own = false) : file_(fd), own_(take_own), begin_(begin), end_(end) {}
     void Run(const ChainPosition &position);
   private:
     int file_;
     bool own_;
+    uint64_t begin_, end_;
 };
 
 class Write {
@@ -49,6 +52,17 @@ class WriteAndRecycle {
     int file_;
 };
 
+// Write with pwrite starting at offset then recycle.  Chains can fill disjoint
+// regions of the same file concurrently.  
+class PWriteAndRecycle {
+  public:
+    PWriteAndRecycle(int fd, uint64_t offset) : file_(fd), offset_(offset) {}
+    void Run(const ChainPosition &position);
+  private:
+    int file_;
+    uint64_t offset_;
+};
+
 // Reuse the same file over and over again to buffer output.  
 class FileBuffer {
   public:
@@ -67,6 +81,8 @@ class FileBuffer {
       return SizeOrThrow(file_.get());
     }
 
+    int File() const { return file_.get(); }
+
   private:
     scoped_fd file_;
 };
@@ -28,6 +28,9 @@
 #include "util/scoped.hh"
 #include "util/sized_iterator.hh"
 
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
 #include <algorithm>
 #include <iostream>
 #include <queue>
@@ -382,6 +385,42 @@ template <class Compare> class BlockSorter {
     SizedCompare<Compare> compare_;
 };
 
+// Don't use this directly.  Sorts blocks from one of several chains that
+// feed the same Sort, appending them to the shared file under a lock.  
+template <class Compare> class SharedBlockSorter {
+  public:
+    SharedBlockSorter(boost::mutex &lock, std::size_t &remaining, int fd, Offsets &offsets, const Compare &compare) :
+      lock_(&lock), remaining_(&remaining), file_(fd), offsets_(&offsets), compare_(compare) {}
+
+    void Run(const ChainPosition &position) {
+      const std::size_t entry_size = position.GetChain().EntrySize();
+      for (Link link(position); link; ++link) {
+        void *end = static_cast<uint8_t*>(link->Get()) + link->ValidSize();
+#if defined(_WIN32) || defined(_WIN64)
+        std::stable_sort
+#else
+        std::sort
+#endif
+          (SizedIt(link->Get(), entry_size),
+           SizedIt(end, entry_size),
+           compare_);
+        boost::unique_lock<boost::mutex> lock(*lock_);
+        // The offset and data must be appended in the same order.  
+        offsets_->Append(link->ValidSize());
+        WriteOrThrow(file_, link->Get(), link->ValidSize());
+      }
+      boost::unique_lock<boost::mutex> lock(*lock_);
+      if (!--*remaining_) offsets_->FinishedAppending();
+    }
+
+  private:
+    boost::mutex *lock_;
+    std::size_t *remaining_;
+    int file_;
+    Offsets *offsets_;
+    SizedCompare<Compare> compare_;
+};
+
 class BadSortConfig : public Exception {
   public:
     BadSortConfig() throw() {}
@@ -395,15 +434,32 @@ template <class Compare, class Combine = NeverCombine> class Sort {
         data_(MakeTemp(config.temp_prefix)),
         offsets_file_(MakeTemp(config.temp_prefix)), offsets_(offsets_file_.get()),
         compare_(compare), combine_(combine),
-        entry_size_(in.EntrySize()) {
-      UTIL_THROW_IF(!entry_size_, BadSortConfig, "Sorting entries of size 0");
-      // Make buffer_size a multiple of the entry_size.  
-      config_.buffer_size -= config_.buffer_size % entry_size_;
-      UTIL_THROW_IF(!config_.buffer_size, BadSortConfig, "Sort buffer too small");
-      UTIL_THROW_IF(config_.total_memory < config_.buffer_size * 4, BadSortConfig, "Sorting memory " << config_.total_memory << " is too small for four buffers (two read and two write).");
+        entry_size_(in.EntrySize()),
+        inputs_remaining_(0) {
+      CheckConfig();
       in >> BlockSorter<Compare>(offsets_, compare_) >> WriteAndRecycle(data_.get());
     }
 
+    /* Sort the union of several chains.  Call Input exactly inputs times,
+     * once per chain, before merging.  Chains sort and write their blocks
+     * concurrently.  
+     */
+    Sort(std::size_t inputs, std::size_t entry_size, const SortConfig &config, const Compare &compare = Compare(), const Combine &combine = Combine())
+      : config_(config),
+        data_(MakeTemp(config.temp_prefix)),
+        offsets_file_(MakeTemp(config.temp_prefix)), offsets_(offsets_file_.get()),
+        compare_(compare), combine_(combine),
+        entry_size_(entry_size),
+        inputs_remaining_(inputs) {
+      CheckConfig();
+      if (!inputs_remaining_) offsets_.FinishedAppending();
+    }
+
+    void Input(Chain &in) {
+      UTIL_THROW_IF(in.EntrySize() != entry_size_, BadSortConfig, "Sort input has entry size " << in.EntrySize() << " but expected " << entry_size_);
+      in >> SharedBlockSorter<Compare>(input_lock_, inputs_remaining_, data_.get(), offsets_, compare_) >> kRecycle;
+    }
+
     uint64_t Size() const {
       return SizeOrThrow(data_.get());
     }
@@ -521,6 +577,14 @@ template <class Compare, class Combine = NeverCombine> class Sort {
     }
 
   private:
+    void CheckConfig() {
+      UTIL_THROW_IF(!entry_size_, BadSortConfig, "Sorting entries of size 0");
+      // Make buffer_size a multiple of the entry_size.  
+      config_.buffer_size -= config_.buffer_size % entry_size_;
+      UTIL_THROW_IF(!config_.buffer_size, BadSortConfig, "Sort buffer too small");
+      UTIL_THROW_IF(config_.total_memory < config_.buffer_size * 4, BadSortConfig, "Sorting memory " << config_.total_memory << " is too small for four buffers (two read and two write).");
+    }
+
     SortConfig config_;
 
     scoped_fd data_;
@@ -531,6 +595,10 @@ template <class Compare, class Combine = NeverCombine> class Sort {
     const Compare compare_;
     const Combine combine_;
     const std::size_t entry_size_;
+
+    // Only used with multiple inputs.  
+    boost::mutex input_lock_;
+    std::size_t inputs_remaining_;
 };
 
 // returns bytes to be read on demand.  
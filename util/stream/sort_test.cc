@@ -59,4 +59,40 @@ BOOST_AUTO_TEST_CASE(FromShuffled) {
   BOOST_CHECK(!sorted);
 }
 
+BOOST_AUTO_TEST_CASE(FromSeveralChains) {
+  std::vector<uint64_t> shuffled[3];
+  for (uint64_t i = 0; i < kSize; ++i) {
+    shuffled[i % 3].push_back(i);
+  }
+  
+  ChainConfig config;
+  config.entry_size = 8;
+  config.total_memory = 800;
+  config.block_count = 3;
+
+  SortConfig merge_config;
+  merge_config.temp_prefix = "sort_test_temp";
+  merge_config.buffer_size = 800;
+  merge_config.total_memory = 3300;
+
+  Sort<CompareUInt64> sorter(3, 8, merge_config, CompareUInt64());
+  {
+    Chain first(config), second(config), third(config);
+    Chain *chains[3] = {&first, &second, &third};
+    for (unsigned i = 0; i < 3; ++i) {
+      std::random_shuffle(shuffled[i].begin(), shuffled[i].end());
+      *chains[i] >> Putter(shuffled[i]);
+      sorter.Input(*chains[i]);
+    }
+  }
+  Chain chain(config);
+  sorter.Output(chain);
+  Stream sorted;
+  chain >> sorted >> kRecycle;
+  for (uint64_t i = 0; i < kSize; ++i, ++sorted) {
+    BOOST_CHECK_EQUAL(i, *static_cast<const uint64_t*>(sorted.Get()));
+  }
+  BOOST_CHECK(!sorted);
+}
+
 }}} // namespaces